@@ -0,0 +1,348 @@
+/*!
+ * Typed object arenas (slab allocators with free lists)
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BGRT_ARENA_H_
+#define BGRT_ARENA_H_
+
+#include <cstdlib>
+#include <new>
+
+/*!
+ * Default number of objects per arena chunk.
+ */
+#ifndef ARENA_CHUNK_SIZE
+#define ARENA_CHUNK_SIZE 4096
+#endif
+
+/*!
+ * Arena for objects of type T.
+ *
+ * Objects are carved out of large chunks instead of being allocated one
+ * by one. Released objects are kept in a free list and reused by the next
+ * create() call. Destroying the arena runs the destructors of all objects
+ * that are still alive and releases the memory chunk by chunk.
+ *
+ * The arena is not thread-safe.
+ */
+template<typename T> class ObjectArena {
+public:
+    /*!
+     * Constructor.
+     * \param chunk_size Number of objects per allocated chunk.
+     */
+    ObjectArena(unsigned int chunk_size = ARENA_CHUNK_SIZE);
+
+    /*!
+     * Destructor. Destroys all live objects and frees all chunks.
+     */
+    ~ObjectArena();
+
+    /*!
+     * Creates a new (default-constructed) object.
+     * \return Pointer to the object. NULL, if out of memory.
+     */
+    T *create();
+
+    /*!
+     * Creates a new object, passing 'arg' to its constructor.
+     * \return Pointer to the object. NULL, if out of memory.
+     */
+    template<typename A> T *create(const A &arg);
+
+    /*!
+     * Destroys an object that was created by this arena.
+     * Its slot is put into the free list.
+     */
+    void destroy(T *obj);
+
+    /*!
+     * Calls 'func' for every live object in the arena.
+     */
+    void visit(void (*func)(T *obj));
+
+    /*!
+     * Destroys all live objects and frees all chunks.
+     */
+    void clear();
+
+    /*!
+     * Takes over all objects of another arena (e.g. one that was filled
+     * by a worker thread). The objects keep their addresses, 'arena' is
+     * empty afterwards.
+     */
+    void adopt(ObjectArena<T> *arena);
+
+    /*!
+     * Number of live objects.
+     */
+    unsigned long size() const;
+
+    /*!
+     * Number of bytes allocated by the arena itself (without memory
+     * that is allocated by the objects).
+     */
+    unsigned long allocated() const;
+protected:
+    /*!
+     * An object slot. Free slots are chained via 'next_free'.
+     */
+    struct Slot {
+        union {
+            char data[sizeof(T)];
+            Slot *next_free;
+            void *align_ptr;
+            double align_double;
+            long long align_ll;
+        } u;
+        bool live;
+    };
+
+    /*!
+     * A chunk of slots. The slots follow the chunk header.
+     */
+    struct Chunk {
+        Chunk *next;
+        unsigned int used;
+        Slot *slots;
+    };
+
+    /*!
+     * Returns a free slot. NULL, if out of memory.
+     */
+    Slot *fetch();
+
+    /*!
+     * Linked list of allocated chunks (most recent chunk first).
+     */
+    Chunk *m_chunks;
+
+    /*!
+     * Linked list of free slots.
+     */
+    Slot *m_free;
+
+    /*!
+     * Number of objects per chunk.
+     */
+    unsigned int m_chunk_size;
+
+    /*!
+     * Number of live objects.
+     */
+    unsigned long m_live;
+
+    /*!
+     * Number of allocated chunks.
+     */
+    unsigned long m_num_chunks;
+private:
+    /*!
+     * Copy constructor.
+     * Not implemented --> private.
+     */
+    ObjectArena(const ObjectArena<T>&);
+
+    /*!
+     * Assignment operator.
+     * Not implemented. --> private.
+     */
+    ObjectArena<T> &operator=(const ObjectArena<T>&);
+};
+
+/*!
+ * Constructor.
+ * \param chunk_size Number of objects per allocated chunk.
+ */
+template<typename T> ObjectArena<T>::ObjectArena(unsigned int chunk_size) :
+        m_chunks(NULL), m_free(NULL), m_chunk_size(chunk_size), m_live(0),
+        m_num_chunks(0) {
+    if (m_chunk_size == 0)
+        m_chunk_size = 1;
+}
+
+/*!
+ * Destructor. Destroys all live objects and frees all chunks.
+ */
+template<typename T> ObjectArena<T>::~ObjectArena() {
+    clear();
+}
+
+/*!
+ * Returns a free slot. NULL, if out of memory.
+ */
+template<typename T> typename ObjectArena<T>::Slot *ObjectArena<T>::fetch() {
+    // Reuse a previously released slot...
+    if (m_free) {
+        Slot *slot = m_free;
+        m_free = slot->u.next_free;
+        return slot;
+    }
+
+    // ...or take the next unused slot from the current chunk.
+    if (!m_chunks || m_chunks->used == m_chunk_size) {
+        Chunk *chunk = (Chunk*) malloc(sizeof(Chunk));
+        if (!chunk)
+            return NULL;
+        chunk->slots = (Slot*) malloc(m_chunk_size * sizeof(Slot));
+        if (!chunk->slots) {
+            free(chunk);
+            return NULL;
+        }
+        chunk->used = 0;
+        chunk->next = m_chunks;
+        m_chunks = chunk;
+        ++m_num_chunks;
+    }
+    return &m_chunks->slots[m_chunks->used++];
+}
+
+/*!
+ * Creates a new (default-constructed) object.
+ * \return Pointer to the object. NULL, if out of memory.
+ */
+template<typename T> T *ObjectArena<T>::create() {
+    Slot *slot = fetch();
+    if (!slot)
+        return NULL;
+    T *obj = new (slot->u.data) T();
+    slot->live = true;
+    ++m_live;
+    return obj;
+}
+
+/*!
+ * Creates a new object, passing 'arg' to its constructor.
+ * \return Pointer to the object. NULL, if out of memory.
+ */
+template<typename T> template<typename A> T *ObjectArena<T>::create(
+        const A &arg) {
+    Slot *slot = fetch();
+    if (!slot)
+        return NULL;
+    T *obj = new (slot->u.data) T(arg);
+    slot->live = true;
+    ++m_live;
+    return obj;
+}
+
+/*!
+ * Destroys an object that was created by this arena.
+ * Its slot is put into the free list.
+ */
+template<typename T> void ObjectArena<T>::destroy(T *obj) {
+    if (!obj)
+        return;
+    // The object is stored at the very beginning of its slot.
+    Slot *slot = reinterpret_cast<Slot*>(obj);
+    obj->~T();
+    slot->live = false;
+    slot->u.next_free = m_free;
+    m_free = slot;
+    --m_live;
+}
+
+/*!
+ * Calls 'func' for every live object in the arena.
+ */
+template<typename T> void ObjectArena<T>::visit(void (*func)(T *obj)) {
+    for (Chunk *chunk = m_chunks; chunk; chunk = chunk->next)
+        for (unsigned int i = 0; i < chunk->used; ++i)
+            if (chunk->slots[i].live)
+                func(reinterpret_cast<T*>(chunk->slots[i].u.data));
+}
+
+/*!
+ * Destroys all live objects and frees all chunks.
+ */
+template<typename T> void ObjectArena<T>::clear() {
+    Chunk *chunk = m_chunks;
+    while (chunk) {
+        Chunk *next = chunk->next;
+        for (unsigned int i = 0; i < chunk->used; ++i)
+            if (chunk->slots[i].live)
+                reinterpret_cast<T*>(chunk->slots[i].u.data)->~T();
+        free(chunk->slots);
+        free(chunk);
+        chunk = next;
+    }
+    m_chunks = NULL;
+    m_free = NULL;
+    m_live = 0;
+    m_num_chunks = 0;
+}
+
+/*!
+ * Takes over all objects of another arena (e.g. one that was filled
+ * by a worker thread). The objects keep their addresses, 'arena' is
+ * empty afterwards.
+ */
+template<typename T> void ObjectArena<T>::adopt(ObjectArena<T> *arena) {
+    if (!arena || arena == this)
+        return;
+
+    // Link the chunks behind the current chunk, which stays the one new
+    // objects are taken from.
+    if (arena->m_chunks) {
+        Chunk *last = arena->m_chunks;
+        while (last->next)
+            last = last->next;
+        if (m_chunks) {
+            last->next = m_chunks->next;
+            m_chunks->next = arena->m_chunks;
+        } else
+            m_chunks = arena->m_chunks;
+    }
+
+    // Prepend the free slots.
+    if (arena->m_free) {
+        Slot *last = arena->m_free;
+        while (last->u.next_free)
+            last = last->u.next_free;
+        last->u.next_free = m_free;
+        m_free = arena->m_free;
+    }
+
+    m_live += arena->m_live;
+    m_num_chunks += arena->m_num_chunks;
+    arena->m_chunks = NULL;
+    arena->m_free = NULL;
+    arena->m_live = 0;
+    arena->m_num_chunks = 0;
+}
+
+/*!
+ * Number of live objects.
+ */
+template<typename T> unsigned long ObjectArena<T>::size() const {
+    return m_live;
+}
+
+/*!
+ * Number of bytes allocated by the arena itself (without memory
+ * that is allocated by the objects).
+ */
+template<typename T> unsigned long ObjectArena<T>::allocated() const {
+    return m_num_chunks * (sizeof(Chunk) + m_chunk_size * sizeof(Slot));
+}
+
+#endif /* BGRT_ARENA_H_ */
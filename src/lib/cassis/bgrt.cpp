@@ -28,6 +28,10 @@
 #include <cstring>
 #include <cassert>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /*!
  * Base4 - Constructor.
  */
@@ -89,18 +93,41 @@ void Base4::toBase4(const char *sequence) {
 /*!
  * Convert Base4 to string.
  */
-char *Base4::toChar(bool RNA) {
-    char *sequence = (char *) malloc(m_len + 1);
+char *Base4::toChar(bool RNA) const {
+    return toChar((char *) malloc(m_len + 1), RNA);
+}
 
+/*!
+ * Convert Base4 to string. The string is written into 'buffer',
+ * which has to hold at least len() + 1 characters.
+ */
+char *Base4::toChar(char *buffer, bool RNA) const {
     char CONV[4] = { 'A', 'C', 'G', 'T' };
     if (RNA)
         CONV[3] = 'U';
 
     for (unsigned int i = 0; i < m_len; ++i)
-        sequence[i] = CONV[(m_seq[i / 4] >> ((i % 4) * 2)) & 0x03];
+        buffer[i] = CONV[(m_seq[i / 4] >> ((i % 4) * 2)) & 0x03];
+
+    buffer[m_len] = 0x00;
+    return buffer;
+}
+
+/*!
+ * Create a copy of this sequence.
+ */
+Base4 *Base4::clone() const {
+    unsigned int base4_len = m_len / 4;
+    if (m_len % 4)
+        ++base4_len;
+
+    char *seq = (char *) malloc(base4_len);
+    if (base4_len)
+        memcpy(seq, m_seq, base4_len);
 
-    sequence[m_len] = 0x00;
-    return sequence;
+    Base4 *copy = new Base4();
+    copy->set(seq, m_len);
+    return copy;
 }
 
 /*!
@@ -126,53 +153,173 @@ const char *Base4::seq() const {
     return m_seq;
 }
 
-static void fast_append(IntSet **ss, unsigned int val) {
-    IntSet *s = *ss;
-    if (NULL == s) {
-        s = new IntSet();
-        *ss = s;
-    }
 
-    s->add(val);
-}
+/*!
+ * Result of a three-way split of two sorted sets of integers.
+ * The arrays point into the scratch buffer of the tree and stay valid
+ * until the next split.
+ */
+struct IntSetSplit {
+    const unsigned int *s1ms2;
+    unsigned int s1ms2_size;
+    const unsigned int *s2ms1;
+    unsigned int s2ms1_size;
+    const unsigned int *s1is2;
+    unsigned int s1is2_size;
+};
 
 /*!
  * Compute the differences between two sets of integers.
  *
- * \param s1 first set to consider
- * \param s2 second set to consider
- * \param s1ms2 set to a set with all elements that are in s1 but not in s2, NULL if that set would be empty
- * \param s2ms1 set to a set with all elements that are in s2 but not in s1, NULL if that set would be empty
- * \param s1is2 set to a set with intersection of s1 and s2, NULL if the intersection is empty
- */
-void IntSet_diff(const IntSet *s1, const IntSet *s2, IntSet **s1ms2,
-        IntSet **s2ms1, IntSet **s1is2) {
-    unsigned int o1;
-    unsigned int o2;
-
-    *s1ms2 = NULL;
-    *s2ms1 = NULL;
-    o1 = 0;
-    o2 = 0;
-    while ((o1 < s1->size()) || (o2 < s2->size())) {
-        if (o1 == s1->size()) {
-            fast_append(s2ms1, s2->val(o2));
-            o2++;
-        } else if (o2 == s2->size()) {
-            fast_append(s1ms2, s1->val(o1));
-            o1++;
-        } else if (s1->val(o1) < s2->val(o2)) {
-            fast_append(s1ms2, s1->val(o1));
-            o1++;
-        } else if (s1->val(o1) > s2->val(o2)) {
-            fast_append(s2ms1, s2->val(o2));
-            o2++;
+ * The results are written into the scratch buffer of the tree (no
+ * allocation, unless the buffer has to grow). Both inputs are sorted,
+ * so the outputs are produced in sorted order with plain appends.
+ * With SSE2, blocks of four values are compared at once and copied as
+ * a whole if they are identical or lie completely before the other set.
+ *
+ * \param tree tree that provides the scratch buffer
+ * \param v1 first set to consider
+ * \param n1 number of elements in v1
+ * \param v2 second set to consider
+ * \param n2 number of elements in v2
+ * \param split set to the elements that are in s1 but not in s2 (s1ms2),
+ *        in s2 but not in s1 (s2ms1), and in both sets (s1is2)
+ * \return false on error (the scratch buffer could not be allocated)
+ */
+static bool IntSet_diff(struct BgrTree *tree, const unsigned int *v1,
+        const unsigned int n1, const unsigned int *v2, const unsigned int n2,
+        struct IntSetSplit *split) {
+
+    // Make sure that each of the three regions can hold the result.
+    unsigned int needed = (n1 > n2) ? n1 : n2;
+    if (needed > tree->diff_buffer_size) {
+        unsigned int size = tree->diff_buffer_size * 2;
+        if (size < needed)
+            size = needed;
+        if (size < 64)
+            size = 64;
+        free(tree->diff_buffer);
+        tree->diff_buffer = (unsigned int *) malloc(
+                3 * size * sizeof(unsigned int));
+        tree->diff_buffer_size = tree->diff_buffer ? size : 0;
+        if (!tree->diff_buffer)
+            return false;
+    }
+    unsigned int *s1ms2 = tree->diff_buffer;
+    unsigned int *s2ms1 = s1ms2 + tree->diff_buffer_size;
+    unsigned int *s1is2 = s2ms1 + tree->diff_buffer_size;
+
+    unsigned int o1 = 0, o2 = 0;
+    unsigned int c1 = 0, c2 = 0, ci = 0;
+#ifdef __SSE2__
+    while ((o1 + 4 <= n1) && (o2 + 4 <= n2)) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (v1 + o1));
+        __m128i b = _mm_loadu_si128((const __m128i *) (v2 + o2));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, b)) == 0xFFFF) {
+            // Identical blocks: all four values are in the intersection.
+            _mm_storeu_si128((__m128i *) (s1is2 + ci), a);
+            ci += 4;
+            o1 += 4;
+            o2 += 4;
+        } else if (v1[o1 + 3] < v2[o2]) {
+            // The whole block of s1 lies before the next value of s2.
+            _mm_storeu_si128((__m128i *) (s1ms2 + c1), a);
+            c1 += 4;
+            o1 += 4;
+        } else if (v2[o2 + 3] < v1[o1]) {
+            // The whole block of s2 lies before the next value of s1.
+            _mm_storeu_si128((__m128i *) (s2ms1 + c2), b);
+            c2 += 4;
+            o2 += 4;
         } else {
-            fast_append(s1is2, s2->val(o2));
-            o1++;
+            // Overlapping blocks: merge until one of them is consumed.
+            const unsigned int e1 = o1 + 4;
+            const unsigned int e2 = o2 + 4;
+            while ((o1 < e1) && (o2 < e2)) {
+                if (v1[o1] < v2[o2])
+                    s1ms2[c1++] = v1[o1++];
+                else if (v1[o1] > v2[o2])
+                    s2ms1[c2++] = v2[o2++];
+                else {
+                    s1is2[ci++] = v1[o1++];
+                    o2++;
+                }
+            }
+        }
+    }
+#endif
+    while ((o1 < n1) && (o2 < n2)) {
+        if (v1[o1] < v2[o2])
+            s1ms2[c1++] = v1[o1++];
+        else if (v1[o1] > v2[o2])
+            s2ms1[c2++] = v2[o2++];
+        else {
+            s1is2[ci++] = v1[o1++];
             o2++;
         }
     }
+    if (o1 < n1) {
+        memcpy(s1ms2 + c1, v1 + o1, (n1 - o1) * sizeof(unsigned int));
+        c1 += n1 - o1;
+    }
+    if (o2 < n2) {
+        memcpy(s2ms1 + c2, v2 + o2, (n2 - o2) * sizeof(unsigned int));
+        c2 += n2 - o2;
+    }
+
+    split->s1ms2 = s1ms2;
+    split->s1ms2_size = c1;
+    split->s2ms1 = s2ms1;
+    split->s2ms1_size = c2;
+    split->s1is2 = s1is2;
+    split->s1is2_size = ci;
+    return true;
+}
+
+/*!
+ * Returns the scratch buffer of the tree, which can hold at least
+ * 'size' species (e.g. to decode the species set of a node).
+ * The buffer is reused by the next call and by the insertion functions.
+ *
+ * \param tree tree that owns the buffer
+ * \param size number of entries needed
+ * \return NULL on error
+ */
+unsigned int *BgrTree_species_buffer(struct BgrTree *tree, unsigned int size) {
+    if (size > tree->species_buffer_size) {
+        unsigned int buffer_size = tree->species_buffer_size * 2;
+        if (buffer_size < size)
+            buffer_size = size;
+        if (buffer_size < 64)
+            buffer_size = 64;
+        free(tree->species_buffer);
+        tree->species_buffer = (unsigned int *) malloc(
+                buffer_size * sizeof(unsigned int));
+        tree->species_buffer_size = tree->species_buffer ? buffer_size : 0;
+    }
+    return tree->species_buffer;
+}
+
+/*!
+ * Split a species set against the (compressed) species set of a node.
+ * The species of the node are decoded into the scratch buffer of the
+ * tree first.
+ *
+ * \param tree tree that provides the scratch buffers
+ * \param species species set to split
+ * \param node node to split against
+ * \param split see IntSet_diff()
+ * \return false on error
+ */
+static bool IntSet_split(struct BgrTree *tree, const IntSet *species,
+        const struct BgrTreeNode *node, struct IntSetSplit *split) {
+    unsigned int *node_species = BgrTree_species_buffer(tree,
+            node->species.size());
+    if (!node_species)
+        return false;
+    unsigned int n = node->species.decode(node_species);
+    return IntSet_diff(tree, species->val_ptr(), species->size(),
+            node_species, n, split);
 }
 
 /*!
@@ -198,42 +345,27 @@ struct BgrTree *BgrTree_create(unsigned int num_species,
     tree->max_gc = 0;
     tree->min_temp = 0;
     tree->max_temp = 0;
+
+    tree->node_arena = new ObjectArena<BgrTreeNode>();
+    tree->uintset_arena = new ObjectArena<UnorderedIntSet>();
+    tree->signature_pool = new SignaturePool(base4_compressed);
     return tree;
 }
 
 /*!
- * Free subtree of the PgTree.  Helper-function
- * for BgrTree_destroy.
+ * Free the child index of a node.
+ * Helper-function for BgrTree_destroy and BgrTree_freeze.
  *
- * \param node root of the subtree to free
+ * \param node node to clean up
  */
-static void free_node(struct BgrTreeNode *node, bool base4_compressed) {
-    struct BgrTreeNode *pos;
-    struct BgrTreeNode *next;
-
-    if (node == NULL)
-        return;
-    pos = node->children;
-    while (NULL != pos) {
-        next = pos->next;
-        free_node(pos, base4_compressed);
-        pos = next;
-    }
-    delete node->species;
-
-    if (base4_compressed)
-        delete node->signatures.base4;
-    else
-        delete node->signatures.str;
-
-    delete node->supposed_outgroup_matches;
-
-    free(node->ingroup_array);
-    free(node);
+static void free_node_arrays(struct BgrTreeNode *node) {
+    free(node->child_index);
+    node->child_index = NULL;
 }
 
 /*!
  * Free memory occupied by a PG tree.
+ * The nodes and their sets are released arena by arena.
  *
  * \param tree tree to free
  */
@@ -243,87 +375,564 @@ void BgrTree_destroy(struct BgrTree *tree) {
 
     free(tree->comment);
 
-    for (unsigned int i = 0; i < tree->num_species; i++)
-        free_node(tree->nodes[i], tree->base4_compressed);
+    if (tree->node_arena)
+        tree->node_arena->visit(free_node_arrays);
+    delete tree->node_arena;
+    delete tree->uintset_arena;
+    delete tree->signature_pool;
+
+    free(tree->diff_buffer);
+    free(tree->species_buffer);
+    free(tree->set_index);
+    BgrTreeFlat_destroy(tree->flat);
     free(tree->nodes);
     free(tree);
 }
 
+/*!
+ * Merge a node without signatures into its only child. The child takes
+ * over the species of the node and its position in the tree, the node
+ * is released. The smallest species of the child has to be larger than
+ * the smallest species of the node, so that the child can be found by
+ * the same (first) species.
+ *
+ * \param tree tree the node belongs to
+ * \param node node to remove
+ * \return The child that replaces the node, NULL on error (the tree is
+ *         left unchanged)
+ */
+static struct BgrTreeNode *compact_merge(struct BgrTree *tree,
+        struct BgrTreeNode *node) {
+    struct BgrTreeNode *child = node->children;
+    assert((node->num_children == 1) && child && !child->next);
+    assert(node->signatures->size() == 0);
+
+    // The species sets of a node and its child are disjoint.
+    unsigned int n1 = node->species.size();
+    unsigned int n2 = child->species.size();
+    unsigned int *buffer = BgrTree_species_buffer(tree, 2 * (n1 + n2));
+    if (!buffer)
+        return NULL;
+    node->species.decode(buffer);
+    child->species.decode(buffer + n1);
+    unsigned int *merged = buffer + n1 + n2;
+    unsigned int i = 0, j = n1, k = 0;
+    while ((i < n1) && (j < n1 + n2))
+        merged[k++] = (buffer[i] < buffer[j]) ? buffer[i++] : buffer[j++];
+    while (i < n1)
+        merged[k++] = buffer[i++];
+    while (j < n1 + n2)
+        merged[k++] = buffer[j++];
+    child->species.assign(merged, k);
+    assert(child->species.first() == node->species.first());
+
+    // Put the child in place of the node (the caller updates the roots).
+    struct BgrTreeNode *parent = node->parent;
+    child->parent = parent;
+    child->next = node->next;
+    if (parent) {
+        struct BgrTreeNode **link = &parent->children;
+        while (*link != node)
+            link = &(*link)->next;
+        *link = child;
+        if (parent->child_index) {
+            for (unsigned int c = 0; c < parent->num_children; ++c)
+                if (parent->child_index[c] == node) {
+                    parent->child_index[c] = child;
+                    break;
+                }
+        }
+    }
+
+    free_node_arrays(node);
+    tree->uintset_arena->destroy(node->signatures);
+    tree->uintset_arena->destroy(node->supposed_outgroup_matches);
+    tree->node_arena->destroy(node);
+    return child;
+}
+
+/*!
+ * Compact a subtree (see BgrTree_compact).
+ *
+ * \param tree tree the subtree belongs to
+ * \param node root of the subtree; replaced by its child, if merged
+ * \param stats statistics to update
+ * \param depth number of nodes on the path to the node (after the
+ *        compaction), without the node itself
+ * \return false on error
+ */
+static bool compact_subtree(struct BgrTree *tree, struct BgrTreeNode *&node,
+        struct BgrTreeCompactStats *stats, unsigned int depth) {
+    while ((node->num_children == 1) && (node->signatures->size() == 0)
+            && (node->children->species.first() > node->species.first())) {
+        struct BgrTreeNode *child = compact_merge(tree, node);
+        if (!child)
+            return false;
+        node = child;
+        ++stats->removed_nodes;
+    }
+    if (stats->depth_after < depth + 1)
+        stats->depth_after = depth + 1;
+
+    for (struct BgrTreeNode *child = node->children; child;
+            child = child->next)
+        if (!compact_subtree(tree, child, stats, depth + 1))
+            return false;
+    return true;
+}
+
+/*!
+ * Count the nodes of a subtree and update the maximum depth.
+ *
+ * \param node root of the subtree
+ * \param stats statistics to update
+ * \param depth number of nodes on the path to the node, without the
+ *        node itself
+ */
+static void compact_count(const struct BgrTreeNode *node,
+        struct BgrTreeCompactStats *stats, unsigned int depth) {
+    ++stats->num_nodes;
+    if (stats->depth_before < depth + 1)
+        stats->depth_before = depth + 1;
+    for (const struct BgrTreeNode *child = node->children; child;
+            child = child->next)
+        compact_count(child, stats, depth + 1);
+}
+
+/*!
+ * Compact the tree: Nodes without signatures and with a single child are
+ * merged into their child, i.e. the child takes over their species and
+ * their position in the tree. The species set of each path from a root
+ * (the union of its species sets) stays the same, as do the signatures
+ * and their species. Nodes are only merged, if the smallest species of
+ * the child is larger than the smallest species of the node (the nodes
+ * are found and ordered by their smallest species).
+ *
+ * The species set index is reset, it only speeds up insertions.
+ *
+ * \param tree tree to compact (not frozen)
+ * \param stats filled with statistics, may be NULL
+ * \return false on error
+ */
+bool BgrTree_compact(struct BgrTree *tree, struct BgrTreeCompactStats *stats) {
+    if (tree->flat)
+        return false;
+
+    struct BgrTreeCompactStats local;
+    if (!stats)
+        stats = &local;
+    memset(stats, 0, sizeof(struct BgrTreeCompactStats));
+
+    free(tree->set_index);
+    tree->set_index = NULL;
+    tree->set_index_size = 0;
+    tree->set_index_capacity = 0;
+
+    for (unsigned int i = 0; i < tree->num_species; ++i) {
+        if (!tree->nodes[i])
+            continue;
+        compact_count(tree->nodes[i], stats, 0);
+        if (!compact_subtree(tree, tree->nodes[i], stats, 0))
+            return false;
+    }
+    return true;
+}
+
+/*!
+ * Freeze the tree: Converts the tree into the flat layout that is used
+ * by the signature search and releases the nodes. The tree can not be
+ * modified or written afterwards. Freezing a frozen tree does nothing.
+ *
+ * \param tree tree to freeze
+ * \return false on error (the tree is left unchanged)
+ */
+bool BgrTree_freeze(struct BgrTree *tree) {
+    if (tree->flat)
+        return true;
+    tree->flat = BgrTreeFlat_create(tree);
+    if (!tree->flat)
+        return false;
+
+    // The pointer-based nodes are not needed anymore.
+    tree->node_arena->visit(free_node_arrays);
+    tree->node_arena->clear();
+    tree->uintset_arena->clear();
+    for (unsigned int i = 0; i < tree->num_species; ++i)
+        tree->nodes[i] = NULL;
+
+    free(tree->set_index);
+    tree->set_index = NULL;
+    tree->set_index_size = 0;
+    tree->set_index_capacity = 0;
+    return true;
+}
+
+/*!
+ * Thaw a frozen tree: Rebuilds the nodes from the flat layout and
+ * releases it (including a BGRT file the layout was mapped from), so
+ * that the tree can be modified and written again. Thawing a mutable
+ * tree does nothing.
+ *
+ * \param tree tree to thaw
+ * \return false on error
+ */
+bool BgrTree_thaw(struct BgrTree *tree) {
+    const struct BgrTreeFlat *flat = tree->flat;
+    if (!flat)
+        return true;
+
+    // The signatures might be part of a mapped file.
+    if (!tree->signature_pool->detach())
+        return false;
+
+    // Nodes by index and the last child of each node (to append children).
+    struct BgrTreeNode **nodes = (BgrTreeNode **) malloc(
+            flat->num_nodes * sizeof(struct BgrTreeNode*));
+    struct BgrTreeNode **last = (BgrTreeNode **) calloc(flat->num_nodes,
+            sizeof(struct BgrTreeNode*));
+    bool success = nodes && last;
+
+    // Parents are stored before their children (pre-order).
+    for (uint32_t n = 0; success && (n < flat->num_nodes); ++n) {
+        unsigned int *species = BgrTree_species_buffer(tree,
+                flat->species_size[n]);
+        if (!species) {
+            success = false;
+            break;
+        }
+        unsigned int size = SpeciesSet::decode(
+                (SpeciesSet::Encoding) flat->species_encoding[n],
+                flat->species_first[n], flat->species_size[n],
+                flat->species_data + flat->species_offset[n],
+                flat->species_offset[n + 1] - flat->species_offset[n],
+                species);
+        struct BgrTreeNode *node = BgrTree_create_node(tree, species, size);
+        if (!node) {
+            success = false;
+            break;
+        }
+        for (uint32_t s = flat->signature_offset[n];
+                s < flat->signature_offset[n + 1]; ++s) {
+            node->signatures->add(flat->signatures[s]);
+            node->supposed_outgroup_matches->add(
+                    flat->supposed_outgroup_matches[s]);
+        }
+
+        uint32_t p = flat->parent[n];
+        if (p != BGRT_FLAT_UNDEF) {
+            node->parent = nodes[p];
+            if (last[p])
+                last[p]->next = node;
+            else
+                nodes[p]->children = node;
+            last[p] = node;
+            ++nodes[p]->num_children;
+        }
+        nodes[n] = node;
+    }
+
+    if (success) {
+        for (unsigned int i = 0; i < tree->num_species; ++i)
+            if (flat->roots[i] != BGRT_FLAT_UNDEF)
+                tree->nodes[i] = nodes[flat->roots[i]];
+        BgrTreeFlat_destroy(tree->flat);
+        tree->flat = NULL;
+    } else {
+        tree->node_arena->clear();
+        tree->uintset_arena->clear();
+    }
+    free(nodes);
+    free(last);
+    return success;
+}
+
+/*!
+ * Create a new (empty) node. The node and its sets are allocated from
+ * the tree arenas and are freed with the tree. The node is not linked
+ * into the tree.
+ *
+ * \param tree tree the node belongs to
+ * \param species species of the node (sorted in ascending order)
+ * \param num_species number of species
+ * \return NULL on error
+ */
+struct BgrTreeNode *BgrTree_create_node(struct BgrTree *tree,
+        const unsigned int *species, unsigned int num_species) {
+    struct BgrTreeNode *node = tree->node_arena->create();
+    if (!node)
+        return NULL;
+    node->species.assign(species, num_species);
+    node->signatures = tree->uintset_arena->create();
+    node->supposed_outgroup_matches = tree->uintset_arena->create();
+    return node;
+}
+
+/*!
+ * Build the sorted child index of a node from its 'children' list.
+ *
+ * \param node node to index
+ */
+static void build_child_index(struct BgrTreeNode *node) {
+    unsigned int size = node->num_children * 2;
+    node->child_index = (BgrTreeNode **) malloc(
+            size * sizeof(struct BgrTreeNode*));
+    node->child_index_size = size;
+
+    unsigned int i = 0;
+    for (BgrTreeNode *child = node->children; child; child = child->next)
+        node->child_index[i++] = child;
+    assert(i == node->num_children);
+}
+
+/*!
+ * Insert a child into the child index of a node.
+ * The child has to be already counted in 'num_children'.
+ *
+ * \param node node with a child index
+ * \param pos position of the new child in the index
+ * \param child child to insert
+ */
+static void child_index_insert(struct BgrTreeNode *node, unsigned int pos,
+        struct BgrTreeNode *child) {
+    if (node->num_children > node->child_index_size) {
+        node->child_index_size *= 2;
+        node->child_index = (BgrTreeNode **) realloc(node->child_index,
+                node->child_index_size * sizeof(struct BgrTreeNode*));
+    }
+    memmove(&node->child_index[pos + 1], &node->child_index[pos],
+            (node->num_children - 1 - pos) * sizeof(struct BgrTreeNode*));
+    node->child_index[pos] = child;
+}
+
+/*!
+ * Binary search in the child index of a node.
+ *
+ * \param node node with a child index
+ * \param first_species species to look for
+ * \return Position of the first child whose first species is not
+ *         smaller than 'first_species'
+ */
+static unsigned int child_index_find(const struct BgrTreeNode *node,
+        unsigned int first_species) {
+    unsigned int i = 0, max = node->num_children;
+    while (i < max) {
+        unsigned int mid = i + ((max - i) / 2);
+        if (node->child_index[mid]->species.first() < first_species)
+            i = mid + 1;
+        else
+            max = mid;
+    }
+    return i;
+}
+
+/*!
+ * Initial number of entries of the species set index.
+ */
+#define BGRT_SET_INDEX_INITIAL_CAPACITY 1024
+
+/*!
+ * Compute the 64-bit hash value of a species set.
+ *
+ * \param species set to hash
+ * \return Hash value
+ */
+static uint64_t set_index_hash(const IntSet *species) {
+    const unsigned int n = species->size();
+    const unsigned int *v = species->val_ptr();
+    uint64_t hash = 0xcbf29ce484222325ULL ^ n;
+    for (unsigned int i = 0; i < n; ++i) {
+        hash ^= v[i];
+        hash *= 0x100000001b3ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+/*!
+ * Check if a node represents exactly the given species set, i.e. if the
+ * species on the path from the root to the node are the species set.
+ * The species of the nodes on a path are disjoint, so it is sufficient
+ * to check that they are all contained and that the sizes add up.
+ *
+ * \param node node to check
+ * \param species complete species set
+ * \return true, if the node represents the species set
+ */
+static bool set_index_matches(const struct BgrTreeNode *node,
+        const IntSet *species) {
+    const unsigned int n = species->size();
+    unsigned int total = 0;
+
+    for (; node; node = node->parent) {
+        const unsigned int m = node->species.size();
+        total += m;
+        if ((total > n)
+                || (node->species.count(species->val_ptr(), n) != m))
+            return false;
+    }
+    return total == n;
+}
+
+/*!
+ * Look up a species set in the species set index.
+ *
+ * \param tree tree to search
+ * \param hash hash value of the species set
+ * \param species complete species set
+ * \return Node that represents the species set, NULL if not indexed
+ */
+static struct BgrTreeNode *set_index_find(const struct BgrTree *tree,
+        uint64_t hash, const IntSet *species) {
+    if (tree->set_index_capacity == 0)
+        return NULL;
+    const unsigned long mask = tree->set_index_capacity - 1;
+    for (unsigned long i = hash & mask; tree->set_index[i].node;
+            i = (i + 1) & mask) {
+        if ((tree->set_index[i].hash == hash)
+                && set_index_matches(tree->set_index[i].node, species))
+            return tree->set_index[i].node;
+    }
+    return NULL;
+}
+
+/*!
+ * Double the size of the species set index, or create it.
+ *
+ * \param tree tree to update
+ * \return false on error (the index is left unchanged)
+ */
+static bool set_index_grow(struct BgrTree *tree) {
+    unsigned long capacity = tree->set_index_capacity ?
+            tree->set_index_capacity * 2 : BGRT_SET_INDEX_INITIAL_CAPACITY;
+    struct BgrTreeSetIndexEntry *index =
+            (BgrTreeSetIndexEntry *) calloc(capacity,
+                    sizeof(struct BgrTreeSetIndexEntry));
+    if (!index)
+        return false;
+    const unsigned long mask = capacity - 1;
+    for (unsigned long j = 0; j < tree->set_index_capacity; ++j) {
+        if (!tree->set_index[j].node)
+            continue;
+        unsigned long i = tree->set_index[j].hash & mask;
+        while (index[i].node)
+            i = (i + 1) & mask;
+        index[i] = tree->set_index[j];
+    }
+    free(tree->set_index);
+    tree->set_index = index;
+    tree->set_index_capacity = capacity;
+    return true;
+}
+
+/*!
+ * Add a node to the species set index. The index is doubled in size
+ * if it is half full. The index only accelerates the insertion: If it
+ * can not be grown, the node is not added (and found by descending
+ * into the tree instead).
+ *
+ * \param tree tree to update
+ * \param hash hash value of the (complete) species set of the node
+ * \param node node to add
+ */
+static void set_index_add(struct BgrTree *tree, uint64_t hash,
+        struct BgrTreeNode *node) {
+    if (!node)
+        return;
+    if (((tree->set_index_size + 1) * 2 > tree->set_index_capacity)
+            && !set_index_grow(tree))
+        return;
+
+    const unsigned long mask = tree->set_index_capacity - 1;
+    unsigned long i = hash & mask;
+    while (tree->set_index[i].node)
+        i = (i + 1) & mask;
+    tree->set_index[i].hash = hash;
+    tree->set_index[i].node = node;
+    ++tree->set_index_size;
+}
+
 /*!
  * We need to insert the given signature and species
  * list into the subtree of the given parent node.
  *
+ * \param tree tree to update; its arenas are used for all allocations
  * \param parent parent node in the tree; all species
  *        of the ancestors of this node (inclusive)
  *        are matching the signature;
- * \param signature the signature, will be freed with the tree
  * \param species list of species not already given by the
  *        ancestors of parent (inclusive) that also
- *        match 'signature'; guaranteed to be non-empty,
- *        will be freed!
+ *        match 'signature'; guaranteed to be non-empty;
+ *        will be modified
+ * \return Node that represents the species set, NULL on error (a
+ *         failed split leaves the subtree unchanged)
  */
-static struct BgrTreeNode *BgrTree_nodelevel_insertion(
-        struct BgrTreeNode *parent, IntSet *species, bool base4_compressed) {
+static struct BgrTreeNode *BgrTree_nodelevel_insertion(struct BgrTree *tree,
+        struct BgrTreeNode *parent, IntSet *species) {
     unsigned int first_species;
     struct BgrTreeNode *pos;
     struct BgrTreeNode *prev;
     struct BgrTreeNode *tree_node;
     struct BgrTreeNode *overlap_node;
-    IntSet *new_left;
-    IntSet *tree_left;
-    IntSet *overlap;
+    struct IntSetSplit split;
+
+    unsigned int index_pos = 0;
 
     struct BgrTreeNode *return_node = NULL;
 
     /* find responsible child node with overlap in
      'first_species', or at least position in list
-     for insertion */
+     for insertion; wide nodes are searched via their
+     child index */
     first_species = species->val(0);
-    prev = NULL;
-    pos = parent->children;
-    while ((pos != NULL) && (pos->species->val(0) < first_species)) {
-        prev = pos;
-        pos = pos->next;
+    if (!parent->child_index
+            && parent->num_children >= BGRT_CHILD_INDEX_THRESHOLD)
+        build_child_index(parent);
+    if (parent->child_index) {
+        index_pos = child_index_find(parent, first_species);
+        prev = index_pos ? parent->child_index[index_pos - 1] : NULL;
+        pos = (index_pos < parent->num_children) ?
+                parent->child_index[index_pos] : NULL;
+    } else {
+        prev = NULL;
+        pos = parent->children;
+        while ((pos != NULL) && (pos->species.first() < first_species)) {
+            prev = pos;
+            pos = pos->next;
+        }
     }
-    if ((pos != NULL) && (pos->species->val(0) == first_species)) {
+    if ((pos != NULL) && (pos->species.first() == first_species)) {
         /* 'pos' is where we need to do the insertion
          and an overlap exists; calculate which
          specific type of overlap we are dealing with;
          the logic is virtually identical to that
          in BgrTree_insert for the top-level  */
 
-        new_left = tree_left = overlap = NULL;
-        IntSet_diff(species, pos->species, &new_left, &tree_left, &overlap);
-        delete species;
-        assert(overlap);
-        if ((tree_left != NULL) && (new_left != NULL)) {
+        if (!IntSet_split(tree, species, pos, &split))
+            return NULL;
+        assert(split.s1is2_size);
+        if ((split.s2ms1_size > 0) && (split.s1ms2_size > 0)) {
             /* no subset/superset relationship; create a new overlap
              node and create two child-nodes (with new_left and
-             tree_left for the species) */
-            overlap_node = (BgrTreeNode *) calloc(1,
-                    sizeof(struct BgrTreeNode));
+             tree_left for the species); 'species' is re-used for
+             new_left */
+            overlap_node = BgrTree_create_node(tree, split.s1is2,
+                    split.s1is2_size);
             overlap_node->parent = parent;
             overlap_node->children = pos;
+            overlap_node->num_children = 1;
             pos->parent = overlap_node;
-            overlap_node->species = overlap;
-
-            if (base4_compressed)
-                overlap_node->signatures.base4 = new Base4Set();
-            else
-                overlap_node->signatures.str = new StrSet();
-
-            overlap_node->supposed_outgroup_matches = new UnorderedIntSet();
 
             overlap_node->next = pos->next;
             if (prev == NULL)
                 parent->children = overlap_node;
             else
                 prev->next = overlap_node;
+            if (parent->child_index)
+                parent->child_index[index_pos] = overlap_node;
 
             /* reduce species of first child set since some are now
              covered by the new parent */
-            delete pos->species;
-            pos->species = tree_left;
+            pos->species.assign(split.s2ms1, split.s2ms1_size);
             pos->next = NULL;
             /* now insert remaining species as second child;
              re-using code from recursive procedure even
@@ -332,24 +941,20 @@ static struct BgrTreeNode *BgrTree_nodelevel_insertion(
              of the (empty) overlap between 'tree_left' and 'new_left',
              so some performance could be gained here through
              specialization in the future.  */
-            return_node = BgrTree_nodelevel_insertion(overlap_node, new_left,
-                    base4_compressed);
-        } else if (tree_left != NULL) {
-            /* existing tree is superset (new_left == NULL), create
+            species->assign(split.s1ms2, split.s1ms2_size);
+            return_node = BgrTree_nodelevel_insertion(tree, overlap_node,
+                    species);
+        } else if (split.s2ms1_size > 0) {
+            /* existing tree is superset (new_left is empty), create
              a new parent node with the overlapping species and
-             make the existing node (pos) a subtree */
-            overlap_node = (BgrTreeNode*) calloc(1, sizeof(struct BgrTreeNode));
+             make the existing node (pos) a subtree; the overlap
+             equals 'species' */
+            overlap_node = BgrTree_create_node(tree, species->val_ptr(),
+                    species->size());
             overlap_node->children = pos;
+            overlap_node->num_children = 1;
             pos->parent = overlap_node;
             overlap_node->parent = parent;
-            overlap_node->species = overlap;
-
-            if (base4_compressed)
-                overlap_node->signatures.base4 = new Base4Set();
-            else
-                overlap_node->signatures.str = new StrSet;
-
-            overlap_node->supposed_outgroup_matches = new UnorderedIntSet();
 
             return_node = overlap_node;
 
@@ -358,41 +963,33 @@ static struct BgrTreeNode *BgrTree_nodelevel_insertion(
                 parent->children = overlap_node;
             else
                 prev->next = overlap_node;
+            if (parent->child_index)
+                parent->child_index[index_pos] = overlap_node;
 
             /* reduce species of child set since some are now
              covered by the new parent */
-            delete pos->species;
-            pos->species = tree_left;
+            pos->species.assign(split.s2ms1, split.s2ms1_size);
             pos->next = NULL;
-        } else if (new_left != NULL) {
+        } else if (split.s1ms2_size > 0) {
             /* not all of our species were matched by the
              top-level node; insert the rest somewhere
              within the children of the top-level node
              (need to do more set checks to see where they
              fit; requires recursion) */
-            return_node = BgrTree_nodelevel_insertion(pos, new_left,
-                    base4_compressed);
-            delete overlap;
+            species->assign(split.s1ms2, split.s1ms2_size);
+            return_node = BgrTree_nodelevel_insertion(tree, pos, species);
         } else {
             /* perfect match, only extend signature list */
-            delete overlap;
             return_node = pos;
         }
     } else {
         /* species never matched as the lowest-numbered
          species among the children of the given parent;
          create a new child (insert between prev and pos) */
-        tree_node = (BgrTreeNode *) calloc(1, sizeof(struct BgrTreeNode));
-        tree_node->species = species;
+        tree_node = BgrTree_create_node(tree, species->val_ptr(),
+                species->size());
         tree_node->parent = parent;
 
-        if (base4_compressed)
-            tree_node->signatures.base4 = new Base4Set();
-        else
-            tree_node->signatures.str = new StrSet();
-
-        tree_node->supposed_outgroup_matches = new UnorderedIntSet();
-
         return_node = tree_node;
 
         tree_node->next = pos;
@@ -400,9 +997,11 @@ static struct BgrTreeNode *BgrTree_nodelevel_insertion(
             parent->children = tree_node;
         else
             prev->next = tree_node;
+        ++parent->num_children;
+        if (parent->child_index)
+            child_index_insert(parent, index_pos, tree_node);
     }
 
-    assert(return_node);
     return return_node;
 }
 
@@ -410,18 +1009,14 @@ static struct BgrTreeNode *BgrTree_nodelevel_insertion(
  * Insert a signature into the tree.
  *
  * \param tree tree to update
- * \param signature signature to store, will be freed with the tree
- * \param species list of species to associate,
- *        will be freed (or kept in the resulting tree)
- * \param supposed_outgroup_matches number of matches m, with m1 < m < m2
+ * \param species list of species to associate; will be modified
+ * \return Node that represents the species set, NULL on error
  */
 static struct BgrTreeNode *BgrTree_treelevel_insertion(struct BgrTree *tree,
         IntSet *species) {
     struct BgrTreeNode *tree_node;
     struct BgrTreeNode *overlap_node;
-    IntSet *new_left;
-    IntSet *tree_left;
-    IntSet *overlap;
+    struct IntSetSplit split;
     unsigned int first_species;
 
     struct BgrTreeNode *return_node = NULL;
@@ -430,34 +1025,25 @@ static struct BgrTreeNode *BgrTree_treelevel_insertion(struct BgrTree *tree,
     tree_node = tree->nodes[first_species];
     if (NULL != tree_node) {
         /* insert here !*/
-        new_left = tree_left = overlap = NULL;
-        IntSet_diff(species, tree_node->species, &new_left, &tree_left,
-                &overlap);
-        delete species;
-        assert(overlap);
-        if ((tree_left != NULL) && (new_left != NULL)) {
+        if (!IntSet_split(tree, species, tree_node, &split))
+            return NULL;
+        assert(split.s1is2_size);
+        if ((split.s2ms1_size > 0) && (split.s1ms2_size > 0)) {
             /* no subset/superset relationship; create a new overlap
              node and create two child-nodes (with new_left and
-             tree_left for the species) */
-            overlap_node = (BgrTreeNode *) calloc(1,
-                    sizeof(struct BgrTreeNode));
+             tree_left for the species); 'species' is re-used for
+             new_left */
+            overlap_node = BgrTree_create_node(tree, split.s1is2,
+                    split.s1is2_size);
             overlap_node->parent = tree_node->parent;
             overlap_node->children = tree_node;
+            overlap_node->num_children = 1;
             tree_node->parent = overlap_node;
-            overlap_node->species = overlap;
-
-            if (tree->base4_compressed)
-                overlap_node->signatures.base4 = new Base4Set();
-            else
-                overlap_node->signatures.str = new StrSet();
-
-            overlap_node->supposed_outgroup_matches = new UnorderedIntSet;
 
             tree->nodes[first_species] = overlap_node;
             /* reduce species of first child set since some are now
              covered by the new parent */
-            delete tree_node->species;
-            tree_node->species = tree_left;
+            tree_node->species.assign(split.s2ms1, split.s2ms1_size);
             /* now insert remaining species as second child;
              re-using code from recursive procedure even
              though we know that here no recursion will happen;
@@ -465,118 +1051,131 @@ static struct BgrTreeNode *BgrTree_treelevel_insertion(struct BgrTree *tree,
              of the (empty) overlap between 'tree_left' and 'new_left',
              so some performance could be gained here through
              specialization in the future.  */
-            return_node = BgrTree_nodelevel_insertion(overlap_node, new_left,
-                    tree->base4_compressed);
+            species->assign(split.s1ms2, split.s1ms2_size);
+            return_node = BgrTree_nodelevel_insertion(tree, overlap_node,
+                    species);
 
-        } else if (tree_left != NULL) {
-            /* existing tree is superset (new_left == NULL), create
+        } else if (split.s2ms1_size > 0) {
+            /* existing tree is superset (new_left is empty), create
              a new parent node with the overlapping species and
-             make the existing node a subtree */
-            overlap_node = (BgrTreeNode *) calloc(1,
-                    sizeof(struct BgrTreeNode));
+             make the existing node a subtree; the overlap
+             equals 'species' */
+            overlap_node = BgrTree_create_node(tree, species->val_ptr(),
+                    species->size());
             overlap_node->parent = tree_node->parent;
             overlap_node->children = tree_node;
+            overlap_node->num_children = 1;
             tree_node->parent = overlap_node;
-            overlap_node->species = overlap;
-
-            if (tree->base4_compressed)
-                overlap_node->signatures.base4 = new Base4Set();
-            else
-                overlap_node->signatures.str = new StrSet();
-
-            overlap_node->supposed_outgroup_matches = new UnorderedIntSet();
 
             return_node = overlap_node;
 
             tree->nodes[first_species] = overlap_node;
             /* reduce species of child set since some are now
              covered by the new parent */
-            delete tree_node->species;
-            tree_node->species = tree_left;
-        } else if (new_left != NULL) {
+            tree_node->species.assign(split.s2ms1, split.s2ms1_size);
+        } else if (split.s1ms2_size > 0) {
             /* not all of our species were matched by the
              top-level node; insert the rest somewhere
              within the children of the top-level node
              (need to do more set checks to see where they
              fit; requires recursion) */
-            return_node = BgrTree_nodelevel_insertion(tree_node, new_left,
-                    tree->base4_compressed);
-            delete overlap;
+            species->assign(split.s1ms2, split.s1ms2_size);
+            return_node = BgrTree_nodelevel_insertion(tree, tree_node,
+                    species);
         } else {
             /* perfect match, only extend signature list */
-            delete overlap;
-
             return_node = tree_node;
         }
     } else {
         /* new top-level node needed (species never matched
          as the lowest-numbered species in a species set before) */
-        tree_node = (BgrTreeNode *) calloc(1, sizeof(struct BgrTreeNode));
-        tree_node->species = species;
-
-        if (tree->base4_compressed)
-            tree_node->signatures.base4 = new Base4Set();
-        else
-            tree_node->signatures.str = new StrSet();
-
-        tree_node->supposed_outgroup_matches = new UnorderedIntSet();
+        tree_node = BgrTree_create_node(tree, species->val_ptr(),
+                species->size());
 
         return_node = tree_node;
 
         tree->nodes[first_species] = tree_node;
     }
 
-    assert(return_node);
     return return_node;
 }
 
+/*!
+ * Insert a species set into the tree.
+ *
+ * Species sets that are already represented by a node are looked up in
+ * the species set index. Only unknown sets descend into the tree; the
+ * resulting node is added to the index.
+ *
+ * \param tree tree to update
+ * \param species list of species; will be freed
+ * \return Node that represents the species set, NULL on error
+ */
+struct BgrTreeNode *BgrTree_insert_node(struct BgrTree *tree,
+        IntSet *species) {
+    assert(!tree->flat);
+    uint64_t hash = set_index_hash(species);
+    struct BgrTreeNode *node = set_index_find(tree, hash, species);
+    if (!node) {
+        node = BgrTree_treelevel_insertion(tree, species);
+        if (node)
+            set_index_add(tree, hash, node);
+    }
+    delete species;
+    return node;
+}
+
 /*!
  * Insert a signature into the tree.
  *
  * \param tree tree to update
- * \param signature signature to store, will be freed with the tree
+ * \param signature signature to store; will be copied into the
+ *        signature pool of the tree
  * \param species list of species to associate,
- *        will be freed (or kept in the resulting tree)
+ *        will be freed
  * \param supposed_outgroup_matches number of matches m, with m1 < m < m2
+ * \return false on error
  */
-void BgrTree_insert(struct BgrTree *tree, const char *signature,
+bool BgrTree_insert(struct BgrTree *tree, const char *signature,
         IntSet *species, unsigned int supposed_outgroup_matches) {
-    BgrTreeNode *insert_node = BgrTree_treelevel_insertion(tree, species);
-
-    if (tree->base4_compressed) {
-        Base4 *base4 = new Base4();
-        base4->toBase4(signature);
-        insert_node->signatures.base4->add(base4);
-    } else
-        insert_node->signatures.str->add(strdup(signature));
+    BgrTreeNode *insert_node = BgrTree_insert_node(tree, species);
+    if (!insert_node)
+        return false;
 
+    uint32_t handle = tree->signature_pool->add(signature);
+    assert(handle != SIGNATURE_HANDLE_UNDEF);
+    insert_node->signatures->add(handle);
     insert_node->supposed_outgroup_matches->add(supposed_outgroup_matches);
+    return true;
 }
 
 /*!
- * Insert a signature into the tree.
+ * Insert signatures from a (foreign) signature pool into the tree.
  *
  * \param tree tree to update
- * \param signatures signature list to store; will be copied.
+ * \param pool signature pool the handles refer to
+ * \param signatures signature handles; the signatures will be copied
+ *        into the signature pool of the tree.
  * \param species list of species to associate,
- *        will be freed (or kept in the resulting tree)
+ *        will be freed
  * \param supposed_outgroup_matches number of matches m, with m1 < m < m2
+ * \return false on error
  */
-void BgrTree_insert(struct BgrTree *tree, StrSet *signatures, IntSet *species,
-        UnorderedIntSet *supposed_outgroup_matches) {
-    BgrTreeNode *insert_node = BgrTree_treelevel_insertion(tree, species);
+bool BgrTree_insert(struct BgrTree *tree, const SignaturePool *pool,
+        const UnorderedIntSet *signatures, IntSet *species,
+        const UnorderedIntSet *supposed_outgroup_matches) {
+    BgrTreeNode *insert_node = BgrTree_insert_node(tree, species);
+    if (!insert_node)
+        return false;
 
     assert(signatures->size() == supposed_outgroup_matches->size());
 
     for (unsigned int i = 0; i < signatures->size(); ++i) {
-        if (tree->base4_compressed) {
-            Base4 *base4 = new Base4();
-            base4->toBase4(signatures->val(i));
-            insert_node->signatures.base4->add(base4);
-        } else
-            insert_node->signatures.str->add(signatures->val(i));
-
+        uint32_t handle = tree->signature_pool->add(pool, signatures->val(i));
+        assert(handle != SIGNATURE_HANDLE_UNDEF);
+        insert_node->signatures->add(handle);
         insert_node->supposed_outgroup_matches->add(
                 supposed_outgroup_matches->val(i));
     }
+    return true;
 }
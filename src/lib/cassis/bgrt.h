@@ -25,6 +25,10 @@
 #ifndef BGRT_H_
 #define BGRT_H_
 
+#include "arena.h"
+#include "flat.h"
+#include "sigpool.h"
+#include "specset.h"
 #include "types.h"
 
 #include <cstdlib>
@@ -37,73 +41,12 @@
 #endif
 
 /*!
- * A DNA4/Base4 type (2 bits/char)
+ * Number of children from which on a node keeps a sorted child index
+ * to find children by binary search instead of walking the list.
  */
-class Base4 {
-public:
-    /*!
-     * Base4 - Constructor.
-     */
-    Base4();
-
-    /*!
-     * Base4 - Destructor.
-     */
-    ~Base4();
-
-    /*!
-     * Convert string to DNA4/Base4 encoding.
-     */
-    void toBase4(const char *sequence);
-
-    /*!
-     * Convert DNA4/Base4 to string.
-     */
-    char *toChar(bool RNA = false);
-
-    /*!
-     * Directly add a base4 encoded string s and its length l.
-     * Handle with care!
-     */
-    void set(char *s, unsigned short l);
-
-    /*!
-     * Return the (uncompressed) sequence length.
-     */
-    unsigned short len() const;
-
-    /*!
-     * Return a pointer to the sequence.
-     */
-    const char *seq() const;
-protected:
-    /*!
-     * Sequence string. Base4 encoded. No terminal '0' character.
-     */
-    char *m_seq;
-
-    /*!
-     * Number of base4-encoded characters. Not(!) the length in bytes.
-     */
-    unsigned short m_len;
-private:
-    /*!
-     * Copy constructor.
-     * Not implemented --> private.
-     */
-    Base4(const Base4&);
-
-    /*!
-     * Assignment operator.
-     * Not implemented. --> private.
-     */
-    Base4 &operator=(const Base4&);
-};
-
-/*!
- * Set of base4-encoded strings.
- */
-typedef USet<Base4*> Base4Set;
+#ifndef BGRT_CHILD_INDEX_THRESHOLD
+#define BGRT_CHILD_INDEX_THRESHOLD 32
+#endif
 
 /*!
  * Node in the main data structure that we are building
@@ -127,17 +70,15 @@ struct BgrTreeNode {
     struct BgrTreeNode *parent;
 
     /*!
-     * Set of species for this node.
+     * Set of species for this node (compressed).
      */
-    IntSet *species;
+    SpeciesSet species;
 
     /*!
-     * List of signatures for this node.
+     * List of signatures for this node (handles into the signature pool
+     * of the tree).
      */
-    union {
-        StrSet *str;
-        Base4Set *base4;
-    } signatures;
+    UnorderedIntSet *signatures;
 
     /*!
      * Number of supposed matches m, with m1 < m < m2
@@ -145,10 +86,36 @@ struct BgrTreeNode {
     UnorderedIntSet *supposed_outgroup_matches;
 
     /*!
-     * Array used to store the MAXIMUM number of ingroup hits
-     * for the BGR-subtree. The index is the depth of the phy_node.
+     * Number of children in the 'children' list.
+     */
+    unsigned int num_children;
+
+    /*!
+     * Children ordered by their first species. Only built for nodes with
+     * at least BGRT_CHILD_INDEX_THRESHOLD children, otherwise NULL.
+     * The 'children' list is always kept up to date as well.
+     */
+    struct BgrTreeNode **child_index;
+
+    /*!
+     * Number of entries allocated for the child index.
      */
-    unsigned int *ingroup_array;
+    unsigned int child_index_size;
+};
+
+/*!
+ * Entry of the species set index of a tree.
+ */
+struct BgrTreeSetIndexEntry {
+    /*!
+     * Hash value of the species set.
+     */
+    uint64_t hash;
+
+    /*!
+     * Node that represents the species set. NULL for empty entries.
+     */
+    struct BgrTreeNode *node;
 };
 
 /*!
@@ -202,6 +169,52 @@ struct BgrTree {
      * A comment that can be added to the BGRTree file.
      */
     char *comment;
+
+    /*!
+     * Arenas for the tree nodes and their sets. All nodes and node sets
+     * of the tree are allocated from these arenas and are released
+     * together with the tree.
+     */
+    ObjectArena<BgrTreeNode> *node_arena;
+    ObjectArena<UnorderedIntSet> *uintset_arena;
+
+    /*!
+     * Storage for all signatures of the tree. The nodes refer to their
+     * signatures by handle. Signatures are stored base4-encoded, if the
+     * tree is base4 compressed.
+     */
+    SignaturePool *signature_pool;
+
+    /*!
+     * Scratch buffer used to split species sets during the insertion.
+     * Holds three regions of 'diff_buffer_size' entries each.
+     */
+    unsigned int *diff_buffer;
+    unsigned int diff_buffer_size;
+
+    /*!
+     * Scratch buffer for decoded species sets (see BgrTree_species_buffer).
+     */
+    unsigned int *species_buffer;
+    unsigned int species_buffer_size;
+
+    /*!
+     * Hash index over the complete species sets (the union of the species
+     * on the path from the root) of the nodes that were returned by an
+     * insertion. Species sets that are already represented by a node are
+     * found here without descending into the tree.
+     * Open addressing; 'set_index_capacity' is a power of two.
+     */
+    struct BgrTreeSetIndexEntry *set_index;
+    unsigned long set_index_size;
+    unsigned long set_index_capacity;
+
+    /*!
+     * Frozen (flat) layout of the tree, NULL while the tree is mutable.
+     * Once the tree is frozen, the nodes are only available in the flat
+     * layout (see BgrTree_freeze).
+     */
+    struct BgrTreeFlat *flat;
 };
 
 /*!
@@ -219,28 +232,125 @@ struct BgrTree *BgrTree_create(unsigned int num_species, bool base4_compressed);
  */
 void BgrTree_destroy(struct BgrTree *tree);
 
+/*!
+ * Create a new (empty) node. The node and its sets are allocated from
+ * the tree arenas and are freed with the tree. The node is not linked
+ * into the tree.
+ *
+ * \param tree tree the node belongs to
+ * \param species species of the node (sorted in ascending order)
+ * \param num_species number of species
+ * \return NULL on error
+ */
+struct BgrTreeNode *BgrTree_create_node(struct BgrTree *tree,
+        const unsigned int *species, unsigned int num_species);
+
+/*!
+ * Returns the scratch buffer of the tree, which can hold at least
+ * 'size' species (e.g. to decode the species set of a node).
+ * The buffer is reused by the next call and by the insertion functions.
+ *
+ * \param tree tree that owns the buffer
+ * \param size number of entries needed
+ * \return NULL on error
+ */
+unsigned int *BgrTree_species_buffer(struct BgrTree *tree, unsigned int size);
+
+/*!
+ * Insert a species set into the tree. The caller adds the signatures
+ * to the returned node.
+ *
+ * \param tree tree to update
+ * \param species list of species; will be freed
+ * \return Node that represents the species set, NULL on error
+ */
+struct BgrTreeNode *BgrTree_insert_node(struct BgrTree *tree,
+        IntSet *species);
+
 /*!
  * Insert a signature into the tree.
  *
  * \param tree tree to update
- * \param signature signature to store, will be freed with the tree
+ * \param signature signature to store; will be copied into the
+ *        signature pool of the tree
  * \param species list of species to associate,
- *        will be freed (or kept in the resulting tree)
+ *        will be freed
  * \param supposed_outgroup_matches number of matches m, with m1 < m < m2
+ * \return false on error
  */
-void BgrTree_insert(struct BgrTree *tree, const char *signature,
+bool BgrTree_insert(struct BgrTree *tree, const char *signature,
         IntSet *species, unsigned int supposed_outgroup_matches);
 
 /*!
- * Insert a signature into the tree.
+ * Insert signatures from a (foreign) signature pool into the tree.
  *
  * \param tree tree to update
- * \param signatures signature list to store; will be copied.
+ * \param pool signature pool the handles refer to
+ * \param signatures signature handles; the signatures will be copied
+ *        into the signature pool of the tree.
  * \param species list of species to associate,
- *        will be freed (or kept in the resulting tree)
+ *        will be freed
  * \param supposed_outgroup_matches number of matches m, with m1 < m < m2
+ * \return false on error
+ */
+bool BgrTree_insert(struct BgrTree *tree, const SignaturePool *pool,
+        const UnorderedIntSet *signatures, IntSet *species,
+        const UnorderedIntSet *supposed_outgroup_matches);
+
+/*!
+ * Statistics of a BGRT compaction (see BgrTree_compact).
+ */
+struct BgrTreeCompactStats {
+    /*!
+     * Number of nodes before the compaction and number of removed nodes.
+     */
+    unsigned long num_nodes;
+    unsigned long removed_nodes;
+
+    /*!
+     * Number of nodes on the longest path from a root to a leaf, before
+     * and after the compaction.
+     */
+    unsigned int depth_before;
+    unsigned int depth_after;
+};
+
+/*!
+ * Compact the tree: Nodes without signatures and with a single child are
+ * merged into their child, i.e. the child takes over their species and
+ * their position in the tree. The species set of each path from a root
+ * (the union of its species sets) stays the same, as do the signatures
+ * and their species. Nodes are only merged, if the smallest species of
+ * the child is larger than the smallest species of the node (the nodes
+ * are found and ordered by their smallest species).
+ *
+ * The species set index is reset, it only speeds up insertions.
+ *
+ * \param tree tree to compact (not frozen)
+ * \param stats filled with statistics, may be NULL
+ * \return false on error
+ */
+bool BgrTree_compact(struct BgrTree *tree, struct BgrTreeCompactStats *stats);
+
+/*!
+ * Freeze the tree: Converts the tree into the flat layout that is used
+ * by the signature search and releases the nodes. The tree can not be
+ * modified or written afterwards. Freezing a frozen tree does nothing.
+ *
+ * \param tree tree to freeze
+ * \return false on error (the tree is left unchanged)
+ */
+bool BgrTree_freeze(struct BgrTree *tree);
+
+/*!
+ * Thaw a frozen tree: Rebuilds the nodes from the flat layout and
+ * releases it (including a BGRT file the layout was mapped from), so
+ * that the tree can be modified and written again. Thawing a mutable
+ * tree does nothing.
+ *
+ * \param tree tree to thaw
+ * \return false on error
  */
-void BgrTree_insert(struct BgrTree *tree, StrSet *signatures, IntSet *species,
-        UnorderedIntSet *supposed_outgroup_matches);
+bool BgrTree_thaw(struct BgrTree *tree);
 
 #endif /* BGRT_H_ */
@@ -0,0 +1,398 @@
+/*!
+ * Buffered block I/O of the BGRT files
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "blockio.h"
+
+#include <cstdlib>
+
+/*!
+ * Converts a little-endian value into machine byte order (and back).
+ */
+static inline uint32_t littleEndian(uint32_t value) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return __builtin_bswap32(value);
+#else
+    return value;
+#endif
+}
+
+/*!
+ * Reads from a stream buffer (e.g. a file) in blocks.
+ * \param source stream buffer to read from
+ * \param type checksum computed over the read blocks
+ */
+BlockReader::BlockReader(std::streambuf *source, ChecksumType type) :
+        m_source(source), m_type(type), m_checksum(checksumInit(type)),
+        m_buffer(NULL), m_capacity(0), m_pos(NULL), m_end(NULL),
+        m_left(BLOCK_IO_UNKNOWN_SIZE), m_good(true) {
+    m_buffer = (unsigned char *) malloc(BLOCK_IO_SIZE);
+    if (m_buffer)
+        m_capacity = BLOCK_IO_SIZE;
+    else
+        m_good = false;
+    m_pos = m_end = m_buffer;
+
+    // Determine the rest of the stream (see available()), if possible.
+    const std::streampos pos = source->pubseekoff(0, std::ios_base::cur,
+            std::ios_base::in);
+    if (pos != std::streampos(-1)) {
+        const std::streampos end = source->pubseekoff(0, std::ios_base::end,
+                std::ios_base::in);
+        if ((source->pubseekpos(pos, std::ios_base::in) == pos)
+                && (end != std::streampos(-1)) && (end >= pos))
+            m_left = (uint64_t) (end - pos);
+    }
+}
+
+/*!
+ * Reads from a memory block. The block is not copied.
+ */
+BlockReader::BlockReader(const char *data, unsigned long size) :
+        m_source(NULL), m_type(CHECKSUM_NONE), m_checksum(0), m_buffer(NULL),
+        m_capacity(0), m_pos((const unsigned char *) data),
+        m_end((const unsigned char *) data + size), m_left(0), m_good(true) {
+}
+
+/*!
+ * Destructor.
+ */
+BlockReader::~BlockReader() {
+    free(m_buffer);
+}
+
+/*!
+ * Provides at least 'size' bytes within the buffer, if possible.
+ * \return false, if less than 'size' bytes are left.
+ */
+bool BlockReader::fill(unsigned long size) {
+    unsigned long available = m_end - m_pos;
+    if (available >= size)
+        return true;
+    if (!m_source || !m_buffer || (size - available > m_left))
+        return false;
+
+    // Move the remaining bytes to the front and grow the buffer, if the
+    // requested bytes do not fit.
+    memmove(m_buffer, m_pos, available);
+    if (size > m_capacity) {
+        unsigned long capacity = m_capacity;
+        while (capacity < size)
+            capacity *= 2;
+        unsigned char *buffer = (unsigned char *) realloc(m_buffer, capacity);
+        if (!buffer)
+            return false;
+        m_buffer = buffer;
+        m_capacity = capacity;
+    }
+
+    // Read the next block(s) and update the checksum.
+    while (available < size) {
+        std::streamsize n = m_source->sgetn((char *) m_buffer + available,
+                m_capacity - available);
+        if (n <= 0)
+            break;
+        m_checksum = checksumUpdate(m_type, m_checksum, m_buffer + available,
+                n);
+        available += n;
+        if (m_left != BLOCK_IO_UNKNOWN_SIZE)
+            m_left = ((uint64_t) n < m_left) ? m_left - n : 0;
+    }
+    m_pos = m_buffer;
+    m_end = m_buffer + available;
+    return available >= size;
+}
+
+/*!
+ * VarUInt decoder for the last bytes of the data (bounds checked).
+ */
+uint32_t BlockReader::readVarUIntTail() {
+    uint32_t value = 0;
+    unsigned char bits;
+    do {
+        if (m_pos == m_end) {
+            m_good = false;
+            break;
+        }
+        bits = *m_pos++;
+        value = (value << 7) | (bits & 0x7F);
+    } while (bits & 0x80);
+    return value;
+}
+
+/*!
+ * Reads 'size' bytes into 'buffer'.
+ * \return false, if the end of the data was reached.
+ */
+bool BlockReader::read(void *buffer, unsigned long size) {
+    unsigned char *dest = (unsigned char *) buffer;
+    while (size > 0) {
+        if ((m_pos == m_end) && !fill(1)) {
+            m_good = false;
+            return false;
+        }
+        unsigned long n = m_end - m_pos;
+        if (n > size)
+            n = size;
+        memcpy(dest, m_pos, n);
+        dest += n;
+        m_pos += n;
+        size -= n;
+    }
+    return true;
+}
+
+/*!
+ * Returns a pointer to the next 'size' bytes within the buffer and
+ * skips them. The pointer is valid until the next read.
+ * \return NULL, if the end of the data was reached.
+ */
+const char *BlockReader::fetch(unsigned long size) {
+    if (!fill(size)) {
+        m_good = false;
+        return NULL;
+    }
+    const char *data = (const char *) m_pos;
+    m_pos += size;
+    return data;
+}
+
+/*!
+ * Reads a string (length as VarUInt, followed by the characters).
+ * \return Allocated string (free() it), NULL on error.
+ */
+char *BlockReader::readString() {
+    unsigned int len = readVarUInt();
+    if (!available(len))
+        return NULL;
+    char *str = (char *) malloc(len + 1);
+    if (!str) {
+        m_good = false;
+        return NULL;
+    }
+    if (len && !read(str, len))
+        len = 0;
+    str[len] = 0x00;
+    return str;
+}
+
+/*!
+ * Reads 'n' integers in the stream-vbyte layout (see
+ * BlockWriter::writeVByte) into 'values'.
+ * \return false, if the end of the data was reached.
+ */
+bool BlockReader::readVByte(uint32_t *values, unsigned int n) {
+    if (n == 0)
+        return true;
+
+    // Sum up the value lengths of the control bytes. The codes of the
+    // padding values in the last control byte are 0 (one byte each).
+    // (A list takes at most five bytes per value, the buffer is refilled
+    // only if less than that is left.)
+    const unsigned long control_bytes = (n + 3) / 4;
+    const unsigned long max_bytes = control_bytes + 4 * (unsigned long) n;
+    if (((unsigned long) (m_end - m_pos) < max_bytes) && !fill(max_bytes)
+            && !fill(control_bytes)) {
+        m_good = false;
+        return false;
+    }
+    unsigned long bytes = 0;
+    for (unsigned long i = 0; i < control_bytes; ++i) {
+        unsigned int c = m_pos[i];
+        bytes += 4 + (c & 3) + ((c >> 2) & 3) + ((c >> 4) & 3) + (c >> 6);
+    }
+    bytes -= 4 * control_bytes - n;
+    if (((unsigned long) (m_end - m_pos) < control_bytes + bytes)
+            && !fill(control_bytes + bytes)) {
+        m_good = false;
+        return false;
+    }
+
+    // Decode the values. Each value is loaded with a single (unaligned)
+    // four byte read and masked, except for the last few bytes.
+    static const uint32_t MASK[4] = { 0xFF, 0xFFFF, 0xFFFFFF, 0xFFFFFFFF };
+    const unsigned char *control = m_pos;
+    const unsigned char *p = control + control_bytes;
+    const unsigned char *end = p + bytes;
+    for (unsigned int i = 0; i < n; ++i) {
+        unsigned int code = (control[i >> 2] >> ((i & 3) * 2)) & 3;
+        uint32_t value = 0;
+        if (end - p >= 4) {
+            memcpy(&value, p, 4);
+            value = littleEndian(value) & MASK[code];
+        } else {
+            for (unsigned int k = 0; k <= code; ++k)
+                value |= (uint32_t) p[k] << (8 * k);
+        }
+        values[i] = value;
+        p += code + 1;
+    }
+    m_pos = end;
+    return true;
+}
+
+/*!
+ * Checksum of the whole data. Reads (and checksums) the rest of the
+ * data, if the parser stopped early.
+ */
+uint32_t BlockReader::checksum() {
+    if (m_source && m_buffer) {
+        std::streamsize n;
+        while ((n = m_source->sgetn((char *) m_buffer, m_capacity)) > 0)
+            m_checksum = checksumUpdate(m_type, m_checksum, m_buffer, n);
+        m_pos = m_end = m_buffer;
+    }
+    return m_checksum;
+}
+
+/*!
+ * Writes to a stream buffer (e.g. a file) in blocks, or collects the
+ * data in memory if 'sink' is NULL.
+ * \param sink stream buffer to write to
+ * \param type checksum computed over the written blocks
+ */
+BlockWriter::BlockWriter(std::streambuf *sink, ChecksumType type) :
+        m_sink(sink), m_type(type), m_checksum(checksumInit(type)),
+        m_written(0), m_buffer(NULL), m_capacity(0), m_pos(NULL),
+        m_end(NULL), m_good(true) {
+    m_buffer = (unsigned char *) malloc(BLOCK_IO_SIZE);
+    if (m_buffer)
+        m_capacity = BLOCK_IO_SIZE;
+    else
+        m_good = false;
+    m_pos = m_buffer;
+    m_end = m_buffer + m_capacity;
+}
+
+/*!
+ * Destructor. Flushes the buffer.
+ */
+BlockWriter::~BlockWriter() {
+    flush();
+    free(m_buffer);
+}
+
+/*!
+ * Provides at least 'size' bytes of free space within the buffer.
+ * \return false on error.
+ */
+bool BlockWriter::space(unsigned long size) {
+    if ((unsigned long) (m_end - m_pos) >= size)
+        return true;
+    if (!m_good)
+        return false;
+    if (m_sink) {
+        flush();
+        if ((unsigned long) (m_end - m_pos) >= size)
+            return m_good;
+    }
+
+    // Grow the buffer.
+    unsigned long used = m_pos - m_buffer;
+    unsigned long capacity = m_capacity ? m_capacity : BLOCK_IO_SIZE;
+    while (capacity - used < size)
+        capacity *= 2;
+    unsigned char *buffer = (unsigned char *) realloc(m_buffer, capacity);
+    if (!buffer) {
+        m_good = false;
+        return false;
+    }
+    m_buffer = buffer;
+    m_capacity = capacity;
+    m_pos = m_buffer + used;
+    m_end = m_buffer + capacity;
+    return true;
+}
+
+/*!
+ * Writes 'size' bytes.
+ */
+void BlockWriter::write(const void *data, unsigned long size) {
+    if (m_sink && (size >= m_capacity)) {
+        // Pass large blocks on directly.
+        if (!flush())
+            return;
+        m_checksum = checksumUpdate(m_type, m_checksum, data, size);
+        m_good = (unsigned long) m_sink->sputn((const char *) data, size)
+                == size;
+        m_written += size;
+        return;
+    }
+    if (!space(size))
+        return;
+    memcpy(m_pos, data, size);
+    m_pos += size;
+}
+
+/*!
+ * Writes a string (length as VarUInt, followed by the characters).
+ * NULL strings are handled as empty strings.
+ */
+void BlockWriter::writeString(const char *str) {
+    unsigned int len = str ? strlen(str) : 0;
+    writeVarUInt(len);
+    if (len)
+        write(str, len);
+}
+
+/*!
+ * Writes 'n' integers in the stream-vbyte layout: One control byte
+ * per four values (two bits per value: number of bytes - 1, starting
+ * at the lowest bits), followed by the values (little-endian, one to
+ * four bytes each).
+ */
+void BlockWriter::writeVByte(const uint32_t *values, unsigned int n) {
+    const unsigned long control_bytes = (n + 3) / 4;
+    if ((n == 0) || !space(control_bytes + 4 * (unsigned long) n))
+        return;
+    unsigned char *control = m_pos;
+    unsigned char *p = control + control_bytes;
+    memset(control, 0, control_bytes);
+    for (unsigned int i = 0; i < n; ++i) {
+        uint32_t value = values[i];
+        unsigned int code = (value > 0xFF) + (value > 0xFFFF)
+                + (value > 0xFFFFFF);
+        control[i >> 2] |= (unsigned char) (code << ((i & 3) * 2));
+        // Four bytes are stored, the next value overwrites the surplus.
+        uint32_t le = littleEndian(value);
+        memcpy(p, &le, 4);
+        p += code + 1;
+    }
+    m_pos = p;
+}
+
+/*!
+ * Passes the buffered data on to the stream buffer.
+ * \return false, if an error occurred (now or before).
+ */
+bool BlockWriter::flush() {
+    if (!m_sink || !m_buffer)
+        return m_good;
+    std::streamsize n = m_pos - m_buffer;
+    if (n > 0) {
+        m_checksum = checksumUpdate(m_type, m_checksum, m_buffer, n);
+        m_good = m_good && (m_sink->sputn((const char *) m_buffer, n) == n);
+        m_written += n;
+        m_pos = m_buffer;
+    }
+    return m_good;
+}
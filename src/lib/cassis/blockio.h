@@ -0,0 +1,334 @@
+/*!
+ * Buffered block I/O of the BGRT files
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BGRT_BLOCKIO_H_
+#define BGRT_BLOCKIO_H_
+
+#include "checksum.h"
+
+#include <streambuf>
+#include <cstring>
+#include <stdint.h>
+
+/*!
+ * Size of the blocks in which BGRT files are read and written.
+ */
+#define BLOCK_IO_SIZE 65536
+
+/*!
+ * Size of the rest of a stream that can not be seeked (see
+ * BlockReader::available).
+ */
+#define BLOCK_IO_UNKNOWN_SIZE (~(uint64_t) 0)
+
+/*!
+ * Buffered reader for the BGRT stream format.
+ *
+ * The data is pulled from a stream buffer in large blocks (or read from
+ * a memory block) and decoded directly from the buffer, instead of
+ * calling the stream once per byte. Each block is checksummed when it is
+ * read, i.e. the checksum is computed over the same bytes the parser
+ * consumes. The reader may read ahead of the decoded data.
+ */
+class BlockReader {
+public:
+    /*!
+     * Reads from a stream buffer (e.g. a file) in blocks.
+     * \param source stream buffer to read from
+     * \param type checksum computed over the read blocks
+     */
+    BlockReader(std::streambuf *source, ChecksumType type = CHECKSUM_NONE);
+
+    /*!
+     * Reads from a memory block. The block is not copied.
+     */
+    BlockReader(const char *data, unsigned long size);
+
+    /*!
+     * Destructor.
+     */
+    ~BlockReader();
+
+    /*!
+     * False, if a read went past the end of the data.
+     */
+    bool good() const {
+        return m_good;
+    }
+
+    /*!
+     * Marks the data as invalid (e.g. if a decoded value is out of range).
+     */
+    void fail() {
+        m_good = false;
+    }
+
+    /*!
+     * Number of bytes left within the buffer, i.e. the rest of the data
+     * for memory blocks.
+     */
+    unsigned long buffered() const {
+        return m_end - m_pos;
+    }
+
+    /*!
+     * Number of bytes left, i.e. within the buffer and not yet read from
+     * the stream. The size of a stream is known if it can be seeked,
+     * BLOCK_IO_UNKNOWN_SIZE otherwise.
+     */
+    uint64_t left() const {
+        if (m_left == BLOCK_IO_UNKNOWN_SIZE)
+            return m_left;
+        return m_left + buffered();
+    }
+
+    /*!
+     * Checks a decoded size or count against the rest of the data, e.g.
+     * the number of values of a list (each value takes at least one
+     * byte).
+     * \return false, if less than 'size' bytes are left. The data is
+     *         marked as invalid then.
+     */
+    bool available(uint64_t size) {
+        if (size <= left())
+            return true;
+        m_good = false;
+        return false;
+    }
+
+    /*!
+     * Reads an unsigned variable-length quantity integer (VLQ/Base128
+     * VarUInt, most significant group first).
+     */
+    uint32_t readVarUInt() {
+        if ((m_end - m_pos < 5) && !fill(5))
+            return readVarUIntTail();
+        // At most five bytes per value, even if the data is corrupted.
+        const unsigned char *p = m_pos;
+        const unsigned char *stop = p + 5;
+        uint32_t value = 0;
+        unsigned char bits;
+        do {
+            bits = *p++;
+            value = (value << 7) | (bits & 0x7F);
+        } while ((bits & 0x80) && (p < stop));
+        m_pos = p;
+        return value;
+    }
+
+    /*!
+     * Reads a fixed-length quantity type (in machine byte order).
+     */
+    template<typename T> T readType() {
+        T value;
+        read(&value, sizeof(T));
+        return value;
+    }
+
+    /*!
+     * Reads 'size' bytes into 'buffer'.
+     * \return false, if the end of the data was reached.
+     */
+    bool read(void *buffer, unsigned long size);
+
+    /*!
+     * Returns a pointer to the next 'size' bytes within the buffer and
+     * skips them. The pointer is valid until the next read.
+     * \return NULL, if the end of the data was reached.
+     */
+    const char *fetch(unsigned long size);
+
+    /*!
+     * Reads a string (length as VarUInt, followed by the characters).
+     * \return Allocated string (free() it), NULL on error.
+     */
+    char *readString();
+
+    /*!
+     * Reads 'n' integers in the stream-vbyte layout (see
+     * BlockWriter::writeVByte) into 'values'.
+     * \return false, if the end of the data was reached.
+     */
+    bool readVByte(uint32_t *values, unsigned int n);
+
+    /*!
+     * Checksum of the whole data. Reads (and checksums) the rest of the
+     * data, if the parser stopped early.
+     */
+    uint32_t checksum();
+private:
+    /*!
+     * Provides at least 'size' bytes within the buffer, if possible.
+     * \return false, if less than 'size' bytes are left.
+     */
+    bool fill(unsigned long size);
+
+    /*!
+     * VarUInt decoder for the last bytes of the data (bounds checked).
+     */
+    uint32_t readVarUIntTail();
+
+    std::streambuf *m_source;
+    ChecksumType m_type;
+    uint32_t m_checksum;
+    unsigned char *m_buffer;
+    unsigned long m_capacity;
+    const unsigned char *m_pos;
+    const unsigned char *m_end;
+    uint64_t m_left;
+    bool m_good;
+
+    /*!
+     * Copy constructor and assignment operator.
+     * Not implemented --> private.
+     */
+    BlockReader(const BlockReader&);
+    BlockReader &operator=(const BlockReader&);
+};
+
+/*!
+ * Buffered writer for the BGRT stream format.
+ *
+ * The data is encoded into a buffer and passed on to a stream buffer in
+ * large blocks. Each block is checksummed when it is passed on. Without
+ * a stream buffer, all data is collected in memory (see data()).
+ */
+class BlockWriter {
+public:
+    /*!
+     * Writes to a stream buffer (e.g. a file) in blocks, or collects the
+     * data in memory if 'sink' is NULL.
+     * \param sink stream buffer to write to
+     * \param type checksum computed over the written blocks
+     */
+    BlockWriter(std::streambuf *sink = NULL,
+            ChecksumType type = CHECKSUM_NONE);
+
+    /*!
+     * Destructor. Flushes the buffer.
+     */
+    ~BlockWriter();
+
+    /*!
+     * False, if an error occurred (allocation or write error).
+     */
+    bool good() const {
+        return m_good;
+    }
+
+    /*!
+     * Writes an unsigned variable-length quantity integer (VLQ/Base128
+     * VarUInt, most significant group first).
+     */
+    void writeVarUInt(uint32_t value) {
+        if ((m_end - m_pos < 5) && !space(5))
+            return;
+        unsigned char buffer[5];
+        buffer[4] = 0x7F & value;
+        int pos = 4;
+        while (value > 0x7F) {
+            value >>= 7;
+            buffer[--pos] = (0x7F & value) | 0x80;
+        }
+        memcpy(m_pos, buffer + pos, 5 - pos);
+        m_pos += 5 - pos;
+    }
+
+    /*!
+     * Writes a fixed-length quantity type (in machine byte order).
+     */
+    template<typename T> void writeType(const T &value) {
+        write(&value, sizeof(T));
+    }
+
+    /*!
+     * Writes 'size' bytes.
+     */
+    void write(const void *data, unsigned long size);
+
+    /*!
+     * Writes a string (length as VarUInt, followed by the characters).
+     * NULL strings are handled as empty strings.
+     */
+    void writeString(const char *str);
+
+    /*!
+     * Writes 'n' integers in the stream-vbyte layout: One control byte
+     * per four values (two bits per value: number of bytes - 1, starting
+     * at the lowest bits), followed by the values (little-endian, one to
+     * four bytes each).
+     */
+    void writeVByte(const uint32_t *values, unsigned int n);
+
+    /*!
+     * Passes the buffered data on to the stream buffer.
+     * \return false, if an error occurred (now or before).
+     */
+    bool flush();
+
+    /*!
+     * Checksum of the data passed on so far (call flush() first).
+     */
+    uint32_t checksum() const {
+        return m_checksum;
+    }
+
+    /*!
+     * Number of bytes written so far (including buffered bytes).
+     */
+    uint64_t written() const {
+        return m_written + (m_pos - m_buffer);
+    }
+
+    /*!
+     * Collected data (if there is no stream buffer).
+     */
+    const char *data() const {
+        return (const char *) m_buffer;
+    }
+private:
+    /*!
+     * Provides at least 'size' bytes of free space within the buffer.
+     * \return false on error.
+     */
+    bool space(unsigned long size);
+
+    std::streambuf *m_sink;
+    ChecksumType m_type;
+    uint32_t m_checksum;
+    uint64_t m_written;
+    unsigned char *m_buffer;
+    unsigned long m_capacity;
+    unsigned char *m_pos;
+    unsigned char *m_end;
+    bool m_good;
+
+    /*!
+     * Copy constructor and assignment operator.
+     * Not implemented --> private.
+     */
+    BlockWriter(const BlockWriter&);
+    BlockWriter &operator=(const BlockWriter&);
+};
+
+#endif /* BGRT_BLOCKIO_H_ */
@@ -0,0 +1,638 @@
+/*!
+ * Bulk (bottom-up) construction of Bipartite Graph Representation Trees
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bulk.h"
+#include "config.h"
+
+#ifdef PTHREADS
+#include "pool.h"
+#include <pthread.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+/*!
+ * Marks a plan node without signatures.
+ */
+#define BULK_NO_SET ((unsigned long)-1)
+
+/*!
+ * Tuple reference used to sort the tuples by their species sets.
+ */
+struct BulkEntry {
+    const unsigned int *vals;
+    unsigned int size;
+    unsigned long tuple;
+};
+
+/*!
+ * A distinct species set and the range of its tuples
+ * in the (sorted) entry array.
+ */
+struct BulkSet {
+    const unsigned int *vals;
+    unsigned int size;
+    unsigned long first;
+    unsigned long count;
+};
+
+/*!
+ * A species set during the construction of a subtree. 'rem' are the
+ * species that are not covered by the ancestors of the current node.
+ */
+struct BulkItem {
+    unsigned long set;
+    unsigned long rem;
+    unsigned int rem_size;
+    unsigned int first;
+};
+
+/*!
+ * Per-thread scratch buffers (stacks of items and remainder species).
+ */
+struct BulkScratch {
+    struct BulkItem *items;
+    unsigned long num_items;
+    unsigned long items_capacity;
+    unsigned int *vals;
+    unsigned long num_vals;
+    unsigned long vals_capacity;
+};
+
+/*!
+ * A node of a planned subtree. The nodes are stored in pre-order.
+ */
+struct BulkPlanNode {
+    unsigned long species;
+    unsigned int species_size;
+    unsigned long set;
+    unsigned int num_children;
+};
+
+/*!
+ * The planned subtree of one root.
+ */
+struct BulkPlan {
+    struct BulkPlanNode *nodes;
+    unsigned long num_nodes;
+    unsigned long nodes_capacity;
+    unsigned int *species;
+    unsigned long species_size;
+    unsigned long species_capacity;
+};
+
+/*!
+ * Shared (read-only) state of a bulk construction.
+ */
+struct BulkContext {
+    const struct BulkSet *sets;
+    const unsigned long *root_begin;
+    const unsigned long *root_end;
+    struct BulkPlan *plans;
+};
+
+/*!
+ * Grow a buffer so that it can hold at least 'needed' elements.
+ */
+template<typename T> static inline bool bulk_reserve(T *&buffer,
+        unsigned long &capacity, unsigned long needed) {
+    if (needed <= capacity)
+        return true;
+    unsigned long size = capacity ? capacity * 2 : 1024;
+    if (size < needed)
+        size = needed;
+    T *tmp = (T *) realloc(buffer, size * sizeof(T));
+    if (!tmp)
+        return false;
+    buffer = tmp;
+    capacity = size;
+    return true;
+}
+
+/*!
+ * Lexicographic order of the species sets. Tuples with identical sets
+ * keep their insertion order.
+ */
+static bool bulk_entry_less(const BulkEntry &e1, const BulkEntry &e2) {
+    unsigned int n = (e1.size < e2.size) ? e1.size : e2.size;
+    for (unsigned int i = 0; i < n; ++i)
+        if (e1.vals[i] != e2.vals[i])
+            return e1.vals[i] < e2.vals[i];
+    if (e1.size != e2.size)
+        return e1.size < e2.size;
+    return e1.tuple < e2.tuple;
+}
+
+/*!
+ * Order of the items by their first remaining species.
+ */
+static bool bulk_item_less(const BulkItem &i1, const BulkItem &i2) {
+    if (i1.first != i2.first)
+        return i1.first < i2.first;
+    return i1.set < i2.set;
+}
+
+/*!
+ * Intersect the sorted values in 'v1' with 'v2' (in place).
+ * \return Size of the intersection
+ */
+static unsigned int bulk_intersect(unsigned int *v1, unsigned int n1,
+        const unsigned int *v2, unsigned int n2) {
+    unsigned int o1 = 0, o2 = 0, c = 0;
+    while ((o1 < n1) && (o2 < n2)) {
+        if (v1[o1] < v2[o2])
+            ++o1;
+        else if (v1[o1] > v2[o2])
+            ++o2;
+        else {
+            v1[c++] = v1[o1++];
+            ++o2;
+        }
+    }
+    return c;
+}
+
+/*!
+ * Plan the subtree for the items in [begin, end). All items share their
+ * first remaining species. The node species are the intersection of the
+ * item sets, the (non-empty) remainders are grouped by their first
+ * species and become the children. An item without remainder provides
+ * the signatures of the node.
+ *
+ * \return false, if out of memory
+ */
+static bool bulk_plan_subtree(struct BulkScratch *s, struct BulkPlan *plan,
+        unsigned long begin, unsigned long end) {
+    // Create the plan node with the intersection of all items.
+    if (!bulk_reserve(plan->nodes, plan->nodes_capacity, plan->num_nodes + 1)
+            || !bulk_reserve(plan->species, plan->species_capacity,
+                    plan->species_size + s->items[begin].rem_size))
+        return false;
+    unsigned long node = plan->num_nodes++;
+    unsigned int *species = plan->species + plan->species_size;
+    unsigned int n = s->items[begin].rem_size;
+    memcpy(species, s->vals + s->items[begin].rem, n * sizeof(unsigned int));
+    for (unsigned long i = begin + 1; i < end; ++i)
+        n = bulk_intersect(species, n, s->vals + s->items[i].rem,
+                s->items[i].rem_size);
+    assert(n > 0);
+    plan->nodes[node].species = plan->species_size;
+    plan->nodes[node].species_size = n;
+    plan->nodes[node].set = BULK_NO_SET;
+    plan->nodes[node].num_children = 0;
+    plan->species_size += n;
+
+    // Compute the remainders of the items.
+    unsigned long child_begin = s->num_items;
+    unsigned long vals_mark = s->num_vals;
+    for (unsigned long i = begin; i < end; ++i) {
+        unsigned int rem_size = s->items[i].rem_size;
+        if (!bulk_reserve(s->vals, s->vals_capacity, s->num_vals + rem_size)
+                || !bulk_reserve(s->items, s->items_capacity,
+                        s->num_items + 1))
+            return false;
+        species = plan->species + plan->nodes[node].species;
+        const unsigned int *rem = s->vals + s->items[i].rem;
+        unsigned int *out = s->vals + s->num_vals;
+        unsigned int o1 = 0, o2 = 0, c = 0;
+        while (o1 < rem_size) {
+            if ((o2 < n) && (rem[o1] == species[o2])) {
+                ++o1;
+                ++o2;
+            } else
+                out[c++] = rem[o1++];
+        }
+
+        if (c == 0) {
+            // Perfect match: the item provides the signatures of the node.
+            assert(plan->nodes[node].set == BULK_NO_SET);
+            plan->nodes[node].set = s->items[i].set;
+        } else {
+            struct BulkItem *item = &s->items[s->num_items++];
+            item->set = s->items[i].set;
+            item->rem = s->num_vals;
+            item->rem_size = c;
+            item->first = out[0];
+            s->num_vals += c;
+        }
+    }
+    unsigned long child_end = s->num_items;
+
+    // Group the remainders by their first species and plan the children.
+    std::sort(s->items + child_begin, s->items + child_end, bulk_item_less);
+    unsigned long pos = child_begin;
+    while (pos < child_end) {
+        unsigned long group_end = pos + 1;
+        while ((group_end < child_end)
+                && (s->items[group_end].first == s->items[pos].first))
+            ++group_end;
+        ++plan->nodes[node].num_children;
+        if (!bulk_plan_subtree(s, plan, pos, group_end))
+            return false;
+        pos = group_end;
+    }
+
+    // Release the scratch space of this level.
+    s->num_items = child_begin;
+    s->num_vals = vals_mark;
+    return true;
+}
+
+/*!
+ * Plan the subtree of a root (all sets in [first_set, last_set)).
+ *
+ * \return false, if out of memory
+ */
+static bool bulk_plan_root(const struct BulkContext *ctx,
+        struct BulkScratch *s, unsigned long root) {
+    s->num_items = 0;
+    s->num_vals = 0;
+    for (unsigned long i = ctx->root_begin[root]; i < ctx->root_end[root];
+            ++i) {
+        const struct BulkSet *set = &ctx->sets[i];
+        if (!bulk_reserve(s->vals, s->vals_capacity, s->num_vals + set->size)
+                || !bulk_reserve(s->items, s->items_capacity,
+                        s->num_items + 1))
+            return false;
+        memcpy(s->vals + s->num_vals, set->vals,
+                set->size * sizeof(unsigned int));
+        struct BulkItem *item = &s->items[s->num_items++];
+        item->set = i;
+        item->rem = s->num_vals;
+        item->rem_size = set->size;
+        item->first = set->vals[0];
+        s->num_vals += set->size;
+    }
+    return bulk_plan_subtree(s, &ctx->plans[root], 0, s->num_items);
+}
+
+/*!
+ * Create the tree nodes of a planned subtree (pre-order).
+ *
+ * \param bulk builder with the collected tuples
+ * \param entries sorted tuple references
+ * \param sets distinct species sets
+ * \param plan planned subtree
+ * \param pos position of the next plan node
+ * \param parent parent of the subtree root
+ * \return subtree root
+ */
+static struct BgrTreeNode *bulk_materialize(struct BgrTreeBulk *bulk,
+        const struct BulkEntry *entries, const struct BulkSet *sets,
+        const struct BulkPlan *plan, unsigned long *pos,
+        struct BgrTreeNode *parent) {
+    struct BgrTree *tree = bulk->tree;
+    const struct BulkPlanNode *p = &plan->nodes[(*pos)++];
+
+    struct BgrTreeNode *node = BgrTree_create_node(tree,
+            plan->species + p->species, p->species_size);
+    node->parent = parent;
+    node->num_children = p->num_children;
+
+    if (p->set != BULK_NO_SET) {
+        const struct BulkSet *set = &sets[p->set];
+        for (unsigned long i = 0; i < set->count; ++i) {
+            const struct BgrTreeBulkTuple *t =
+                    &bulk->tuples[entries[set->first + i].tuple];
+            node->signatures->add(t->signature);
+            node->supposed_outgroup_matches->add(t->supposed_outgroup_matches);
+        }
+    }
+
+    struct BgrTreeNode *prev = NULL;
+    for (unsigned int c = 0; c < p->num_children; ++c) {
+        struct BgrTreeNode *child = bulk_materialize(bulk, entries, sets,
+                plan, pos, node);
+        if (prev)
+            prev->next = child;
+        else
+            node->children = child;
+        prev = child;
+    }
+    return node;
+}
+
+#ifdef PTHREADS
+/*!
+ * Parameters for our pThread
+ */
+struct BulkPlan_work {
+    pthread_mutex_t mutex;
+    const struct BulkContext *ctx;
+    const unsigned long *roots;
+    unsigned long remaining;
+    unsigned long pos;
+    bool failed;
+};
+
+/*!
+ * Plan the subtrees of the roots using pThreads.
+ */
+static void *bulk_plan_pthread(void *ptr) {
+    struct BulkPlan_work *work = (struct BulkPlan_work*) ptr;
+    struct BulkScratch scratch;
+    memset(&scratch, 0, sizeof(struct BulkScratch));
+
+    // The threads working loop...
+    while (1) {
+        // Fetch a root to process...
+        pthread_mutex_lock(&(work->mutex));
+        if (work->remaining == 0 || work->failed) {
+            // Stop, if no work is remaining...
+            pthread_mutex_unlock(&(work->mutex));
+            break;
+        }
+        unsigned long pos = work->pos++;
+        work->remaining--;
+        pthread_mutex_unlock(&(work->mutex));
+
+        if (!bulk_plan_root(work->ctx, &scratch, work->roots[pos])) {
+            pthread_mutex_lock(&(work->mutex));
+            work->failed = true;
+            pthread_mutex_unlock(&(work->mutex));
+        }
+    }
+
+    free(scratch.items);
+    free(scratch.vals);
+    return NULL;
+}
+#endif /* #ifdef PTHREADS */
+
+/*!
+ * Create a new bulk builder for a tree.
+ */
+struct BgrTreeBulk *BgrTreeBulk_create(struct BgrTree *tree) {
+    if (!tree)
+        return NULL;
+    struct BgrTreeBulk *bulk = (BgrTreeBulk *) calloc(1,
+            sizeof(struct BgrTreeBulk));
+    if (bulk)
+        bulk->tree = tree;
+    return bulk;
+}
+
+/*!
+ * Free the collected tuples.
+ */
+static void bulk_clear(struct BgrTreeBulk *bulk) {
+    free(bulk->species);
+    bulk->species = NULL;
+    bulk->species_size = 0;
+    bulk->species_capacity = 0;
+    free(bulk->tuples);
+    bulk->tuples = NULL;
+    bulk->num_tuples = 0;
+    bulk->tuples_capacity = 0;
+}
+
+/*!
+ * Free a bulk builder (without building the tree).
+ */
+void BgrTreeBulk_destroy(struct BgrTreeBulk *bulk) {
+    if (bulk == NULL)
+        return;
+    bulk_clear(bulk);
+    free(bulk);
+}
+
+/*!
+ * Append a tuple. The species are shared with the previous tuple,
+ * if both species sets are identical.
+ */
+static bool bulk_append(struct BgrTreeBulk *bulk, uint32_t signature,
+        const IntSet *species, unsigned int supposed_outgroup_matches) {
+    if (signature == SIGNATURE_HANDLE_UNDEF || !species
+            || species->size() == 0)
+        return false;
+    if (!bulk_reserve(bulk->tuples, bulk->tuples_capacity,
+            bulk->num_tuples + 1))
+        return false;
+
+    struct BgrTreeBulkTuple *t = &bulk->tuples[bulk->num_tuples];
+    const struct BgrTreeBulkTuple *last =
+            bulk->num_tuples ? t - 1 : NULL;
+    if (last && last->size == species->size()
+            && !memcmp(bulk->species + last->offset, species->val_ptr(),
+                    species->size() * sizeof(unsigned int)))
+        t->offset = last->offset;
+    else {
+        if (!bulk_reserve(bulk->species, bulk->species_capacity,
+                bulk->species_size + species->size()))
+            return false;
+        memcpy(bulk->species + bulk->species_size, species->val_ptr(),
+                species->size() * sizeof(unsigned int));
+        t->offset = bulk->species_size;
+        bulk->species_size += species->size();
+    }
+    t->size = species->size();
+    t->signature = signature;
+    t->supposed_outgroup_matches = supposed_outgroup_matches;
+    ++bulk->num_tuples;
+    return true;
+}
+
+/*!
+ * Add a signature to the bulk builder.
+ */
+bool BgrTreeBulk_add(struct BgrTreeBulk *bulk, const char *signature,
+        const IntSet *species, unsigned int supposed_outgroup_matches) {
+    if (!species || species->size() == 0)
+        return false;
+    return bulk_append(bulk, bulk->tree->signature_pool->add(signature),
+            species, supposed_outgroup_matches);
+}
+
+/*!
+ * Add signatures from a (foreign) signature pool to the bulk builder.
+ */
+bool BgrTreeBulk_add(struct BgrTreeBulk *bulk, const SignaturePool *pool,
+        const UnorderedIntSet *signatures, const IntSet *species,
+        const UnorderedIntSet *supposed_outgroup_matches) {
+    assert(signatures->size() == supposed_outgroup_matches->size());
+    if (!species || species->size() == 0)
+        return false;
+    for (unsigned int i = 0; i < signatures->size(); ++i)
+        if (!bulk_append(bulk,
+                bulk->tree->signature_pool->add(pool, signatures->val(i)),
+                species, supposed_outgroup_matches->val(i)))
+            return false;
+    return true;
+}
+
+/*!
+ * Build the tree from the collected tuples.
+ */
+bool BgrTreeBulk_build(struct BgrTreeBulk *bulk) {
+    struct BgrTree *tree = bulk->tree;
+    bool success = true;
+
+    // Frozen trees can not be modified.
+    if (tree->flat)
+        return false;
+
+    // Sort the tuples by their species sets.
+    unsigned long num_entries = bulk->num_tuples;
+    struct BulkEntry *entries = (BulkEntry *) malloc(
+            (num_entries + 1) * sizeof(struct BulkEntry));
+    struct BulkSet *sets = (BulkSet *) malloc(
+            (num_entries + 1) * sizeof(struct BulkSet));
+    unsigned long *root_begin = (unsigned long *) malloc(
+            (num_entries + 1) * sizeof(unsigned long));
+    unsigned long *root_end = (unsigned long *) malloc(
+            (num_entries + 1) * sizeof(unsigned long));
+    if (!entries || !sets || !root_begin || !root_end) {
+        free(entries);
+        free(sets);
+        free(root_begin);
+        free(root_end);
+        return false;
+    }
+    for (unsigned long i = 0; i < num_entries; ++i) {
+        entries[i].vals = bulk->species + bulk->tuples[i].offset;
+        entries[i].size = bulk->tuples[i].size;
+        entries[i].tuple = i;
+    }
+    std::sort(entries, entries + num_entries, bulk_entry_less);
+
+    // Group identical species sets...
+    unsigned long num_sets = 0;
+    for (unsigned long i = 0; i < num_entries; ++i) {
+        if (num_sets > 0) {
+            struct BulkSet *last = &sets[num_sets - 1];
+            if (last->size == entries[i].size
+                    && !memcmp(last->vals, entries[i].vals,
+                            last->size * sizeof(unsigned int))) {
+                ++last->count;
+                continue;
+            }
+        }
+        sets[num_sets].vals = entries[i].vals;
+        sets[num_sets].size = entries[i].size;
+        sets[num_sets].first = i;
+        sets[num_sets].count = 1;
+        ++num_sets;
+    }
+
+    // ...and the sets by their roots (first species).
+    unsigned long num_roots = 0;
+    for (unsigned long i = 0; i < num_sets; ++i) {
+        if (num_roots == 0
+                || sets[root_begin[num_roots - 1]].vals[0] != sets[i].vals[0])
+            root_begin[num_roots++] = i;
+        root_end[num_roots - 1] = i + 1;
+    }
+
+    // Roots that already exist in the tree are extended incrementally,
+    // all others are planned from scratch.
+    unsigned long *planned = (unsigned long *) malloc(
+            (num_roots + 1) * sizeof(unsigned long));
+    struct BulkPlan *plans = (BulkPlan *) calloc(num_roots + 1,
+            sizeof(struct BulkPlan));
+    unsigned long num_planned = 0;
+    for (unsigned long r = 0; success && r < num_roots; ++r) {
+        unsigned int first_species = sets[root_begin[r]].vals[0];
+        assert(first_species < tree->num_species);
+        if (tree->nodes[first_species] == NULL) {
+            planned[num_planned++] = r;
+            continue;
+        }
+        for (unsigned long i = root_begin[r]; i < root_end[r]; ++i) {
+            IntSet *species = new IntSet();
+            species->assign(sets[i].vals, sets[i].size);
+            struct BgrTreeNode *node = BgrTree_insert_node(tree, species);
+            if (!node) {
+                success = false;
+                break;
+            }
+            for (unsigned long j = 0; j < sets[i].count; ++j) {
+                const struct BgrTreeBulkTuple *t =
+                        &bulk->tuples[entries[sets[i].first + j].tuple];
+                node->signatures->add(t->signature);
+                node->supposed_outgroup_matches->add(
+                        t->supposed_outgroup_matches);
+            }
+        }
+    }
+
+    // Plan the new roots (in parallel, if available).
+    struct BulkContext ctx;
+    ctx.sets = sets;
+    ctx.root_begin = root_begin;
+    ctx.root_end = root_end;
+    ctx.plans = plans;
+#ifndef PTHREADS
+    struct BulkScratch scratch;
+    memset(&scratch, 0, sizeof(struct BulkScratch));
+    for (unsigned long i = 0; success && i < num_planned; ++i)
+        success = bulk_plan_root(&ctx, &scratch, planned[i]);
+    free(scratch.items);
+    free(scratch.vals);
+#else
+    if (success && num_planned > 0) {
+        unsigned int num_threads = num_processors();
+        BulkPlan_work work;
+        pthread_mutex_init(&(work.mutex), (pthread_mutexattr_t*) 0);
+        work.ctx = &ctx;
+        work.roots = planned;
+        work.remaining = num_planned;
+        work.pos = 0;
+        work.failed = false;
+
+        pool_init(num_threads);
+        for (unsigned int i = 0; i < num_threads; i++)
+            pool_run(bulk_plan_pthread, &work);
+        pool_barrier();
+        pool_shutdown();
+
+        pthread_mutex_destroy(&(work.mutex));
+        success = !work.failed;
+    }
+#endif
+
+    // Create the nodes of the planned roots.
+    for (unsigned long i = 0; i < num_planned; ++i) {
+        struct BulkPlan *plan = &plans[planned[i]];
+        if (success) {
+            unsigned long pos = 0;
+            struct BgrTreeNode *root = bulk_materialize(bulk, entries, sets,
+                    plan, &pos, NULL);
+            assert(pos == plan->num_nodes);
+            tree->nodes[root->species.first()] = root;
+        }
+        free(plan->nodes);
+        free(plan->species);
+    }
+
+    free(plans);
+    free(planned);
+    free(root_end);
+    free(root_begin);
+    free(sets);
+    free(entries);
+    bulk_clear(bulk);
+    return success;
+}
@@ -0,0 +1,144 @@
+/*!
+ * Bulk (bottom-up) construction of Bipartite Graph Representation Trees
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BGRT_BULK_H_
+#define BGRT_BULK_H_
+
+#include "bgrt.h"
+
+/*!
+ * A single (species set, signature, outgroup matches) tuple.
+ * The species are stored in the species buffer of the bulk builder.
+ */
+struct BgrTreeBulkTuple {
+    /*!
+     * Position and number of the species in the species buffer.
+     */
+    unsigned long offset;
+    unsigned int size;
+
+    /*!
+     * Signature handle (signature pool of the tree).
+     */
+    uint32_t signature;
+
+    /*!
+     * Number of supposed matches m, with m1 < m < m2
+     */
+    unsigned int supposed_outgroup_matches;
+};
+
+/*!
+ * Collects tuples for a bulk construction of a BGRT.
+ *
+ * Instead of inserting one signature after the other (and splitting
+ * overlapping nodes on the way), all tuples are collected first. The
+ * tuples are then sorted, identical species sets are grouped and the
+ * subset/overlap hierarchy below each root is computed in one pass.
+ * The roots are independent of each other and are processed in parallel,
+ * if the library was built with pThreads support.
+ *
+ * The resulting tree is equivalent to the tree that is built by inserting
+ * the same tuples with BgrTree_insert(): every signature is stored with
+ * the same species set and, for identical species sets, in insertion
+ * order. Unlike the incremental tree, its shape does not depend on the
+ * insertion order. Each node holds the intersection of all species sets
+ * below it, so the tree may have fewer nodes.
+ */
+struct BgrTreeBulk {
+    /*!
+     * Tree the tuples are inserted into.
+     */
+    struct BgrTree *tree;
+
+    /*!
+     * Species of all tuples. Consecutive tuples with identical
+     * species sets share their entries.
+     */
+    unsigned int *species;
+    unsigned long species_size;
+    unsigned long species_capacity;
+
+    /*!
+     * Collected tuples (in insertion order).
+     */
+    struct BgrTreeBulkTuple *tuples;
+    unsigned long num_tuples;
+    unsigned long tuples_capacity;
+};
+
+/*!
+ * Create a new bulk builder for a tree.
+ *
+ * \param tree tree to build; the signatures are stored in its signature
+ *        pool right away, the nodes are created by BgrTreeBulk_build()
+ * \return NULL on error
+ */
+struct BgrTreeBulk *BgrTreeBulk_create(struct BgrTree *tree);
+
+/*!
+ * Free a bulk builder (without building the tree).
+ *
+ * \param bulk builder to free
+ */
+void BgrTreeBulk_destroy(struct BgrTreeBulk *bulk);
+
+/*!
+ * Add a signature to the bulk builder.
+ *
+ * \param bulk builder to update
+ * \param signature signature to store; will be copied into the
+ *        signature pool of the tree
+ * \param species list of species to associate; will be copied
+ * \param supposed_outgroup_matches number of matches m, with m1 < m < m2
+ * \return false on error
+ */
+bool BgrTreeBulk_add(struct BgrTreeBulk *bulk, const char *signature,
+        const IntSet *species, unsigned int supposed_outgroup_matches);
+
+/*!
+ * Add signatures from a (foreign) signature pool to the bulk builder.
+ *
+ * \param bulk builder to update
+ * \param pool signature pool the handles refer to
+ * \param signatures signature handles; the signatures will be copied
+ *        into the signature pool of the tree.
+ * \param species list of species to associate; will be copied
+ * \param supposed_outgroup_matches number of matches m, with m1 < m < m2
+ * \return false on error
+ */
+bool BgrTreeBulk_add(struct BgrTreeBulk *bulk, const SignaturePool *pool,
+        const UnorderedIntSet *signatures, const IntSet *species,
+        const UnorderedIntSet *supposed_outgroup_matches);
+
+/*!
+ * Build the tree from the collected tuples. Tuples of roots that already
+ * exist in the tree are inserted one by one. The collected tuples are
+ * released afterwards, i.e. the builder can be reused.
+ *
+ * \param bulk builder with the collected tuples
+ * \return false on error
+ */
+bool BgrTreeBulk_build(struct BgrTreeBulk *bulk);
+
+#endif /* BGRT_BULK_H_ */
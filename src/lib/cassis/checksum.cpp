@@ -0,0 +1,187 @@
+/*!
+ * Checksums of the BGRT files
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "checksum.h"
+
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CRC32C_SSE42 1
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#define CRC32C_ARM 1
+#include <arm_acle.h>
+#endif
+
+/*!
+ * Adler32 checksum of a memory block. Blocks can be chained by passing
+ * the checksum of the previous block, the first block starts with 1.
+ *
+ * \param adler Checksum of the preceding data (1 at the start)
+ * \param data Memory block
+ * \param size Size of the block in bytes
+ * \return Adler32 checksum
+ */
+uint32_t adler32(uint32_t adler, const unsigned char *data,
+        unsigned long size) {
+    uint32_t s1 = adler & 0xFFFF;
+    uint32_t s2 = adler >> 16;
+    while (size > 0) {
+        // 5552 bytes can be summed up before s2 might overflow.
+        unsigned long n = (size < 5552) ? size : 5552;
+        size -= n;
+        while (n--) {
+            s1 += *data++;
+            s2 += s1;
+        }
+        s1 %= 65521;
+        s2 %= 65521;
+    }
+    return (s2 << 16) | s1;
+}
+
+/*!
+ * Lookup tables of the software CRC32C ("slicing-by-8"): table[0] holds
+ * the CRC of each byte value, table[k] the CRC of a byte followed by k
+ * zero bytes. Computed once when the library is loaded.
+ */
+static struct Crc32cTable {
+    uint32_t table[8][256];
+
+    Crc32cTable() {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t crc = n;
+            for (unsigned int k = 0; k < 8; ++k)
+                crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78 : 0);
+            table[0][n] = crc;
+        }
+        for (uint32_t n = 0; n < 256; ++n)
+            for (unsigned int k = 1; k < 8; ++k)
+                table[k][n] = (table[k - 1][n] >> 8)
+                        ^ table[0][table[k - 1][n] & 0xFF];
+    }
+} crc32c_table;
+
+/*!
+ * Software CRC32C (processes 8 bytes per step).
+ */
+static uint32_t crc32cSoftware(uint32_t crc, const unsigned char *data,
+        unsigned long size) {
+    const uint32_t (*t)[256] = crc32c_table.table;
+    while (size && ((uintptr_t) data & 7)) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+        --size;
+    }
+    while (size >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data + 4, 4);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF]
+                ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+                ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF]
+                ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    return crc;
+}
+
+#ifdef CRC32C_SSE42
+/*!
+ * CRC32C using the SSE4.2 CRC32 instruction. Only called if the CPU
+ * supports SSE4.2 (see crc32c).
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHardware(uint32_t crc, const unsigned char *data,
+        unsigned long size) {
+    while (size && ((uintptr_t) data & 7)) {
+        crc = _mm_crc32_u8(crc, *data++);
+        --size;
+    }
+    uint64_t crc64 = crc;
+    while (size >= 8) {
+        uint64_t value;
+        memcpy(&value, data, 8);
+        crc64 = _mm_crc32_u64(crc64, value);
+        data += 8;
+        size -= 8;
+    }
+    crc = (uint32_t) crc64;
+    while (size--)
+        crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+#endif
+
+#ifdef CRC32C_ARM
+/*!
+ * CRC32C using the ARMv8 CRC32 instructions.
+ */
+static uint32_t crc32cHardware(uint32_t crc, const unsigned char *data,
+        unsigned long size) {
+    while (size >= 8) {
+        uint64_t value;
+        memcpy(&value, data, 8);
+        crc = __crc32cd(crc, value);
+        data += 8;
+        size -= 8;
+    }
+    while (size--)
+        crc = __crc32cb(crc, *data++);
+    return crc;
+}
+#endif
+
+/*!
+ * CRC32C (Castagnoli) checksum of a memory block. Uses the CRC32
+ * instruction of the CPU, if available (SSE4.2, ARMv8 CRC), and a
+ * table-driven implementation otherwise. Blocks can be chained by passing
+ * the checksum of the previous block, the first block starts with 0.
+ *
+ * \param crc Checksum of the preceding data (0 at the start)
+ * \param data Memory block
+ * \param size Size of the block in bytes
+ * \return CRC32C checksum
+ */
+uint32_t crc32c(uint32_t crc, const unsigned char *data, unsigned long size) {
+    crc = ~crc;
+#if defined(CRC32C_SSE42)
+    static const bool sse42 = __builtin_cpu_supports("sse4.2");
+    if (sse42)
+        crc = crc32cHardware(crc, data, size);
+    else
+        crc = crc32cSoftware(crc, data, size);
+#elif defined(CRC32C_ARM)
+    crc = crc32cHardware(crc, data, size);
+#else
+    crc = crc32cSoftware(crc, data, size);
+#endif
+    return ~crc;
+}
@@ -0,0 +1,84 @@
+/*!
+ * Checksums of the BGRT files
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BGRT_CHECKSUM_H_
+#define BGRT_CHECKSUM_H_
+
+#include <stdint.h>
+
+/*!
+ * Adler32 checksum of a memory block. Blocks can be chained by passing
+ * the checksum of the previous block, the first block starts with 1.
+ *
+ * \param adler Checksum of the preceding data (1 at the start)
+ * \param data Memory block
+ * \param size Size of the block in bytes
+ * \return Adler32 checksum
+ */
+uint32_t adler32(uint32_t adler, const unsigned char *data,
+        unsigned long size);
+
+/*!
+ * CRC32C (Castagnoli) checksum of a memory block. Uses the CRC32
+ * instruction of the CPU, if available (SSE4.2, ARMv8 CRC), and a
+ * table-driven implementation otherwise. Blocks can be chained by passing
+ * the checksum of the previous block, the first block starts with 0.
+ *
+ * \param crc Checksum of the preceding data (0 at the start)
+ * \param data Memory block
+ * \param size Size of the block in bytes
+ * \return CRC32C checksum
+ */
+uint32_t crc32c(uint32_t crc, const unsigned char *data, unsigned long size);
+
+/*!
+ * Checksum types of the BGRT file formats.
+ */
+enum ChecksumType {
+    CHECKSUM_NONE = 0, CHECKSUM_ADLER32, CHECKSUM_CRC32C
+};
+
+/*!
+ * Checksum of an empty block.
+ */
+static inline uint32_t checksumInit(ChecksumType type) {
+    return (type == CHECKSUM_ADLER32) ? 1 : 0;
+}
+
+/*!
+ * Continue a checksum with the next block.
+ */
+static inline uint32_t checksumUpdate(ChecksumType type, uint32_t checksum,
+        const void *data, unsigned long size) {
+    const unsigned char *p = (const unsigned char *) data;
+    switch (type) {
+    case CHECKSUM_ADLER32:
+        return adler32(checksum, p, size);
+    case CHECKSUM_CRC32C:
+        return crc32c(checksum, p, size);
+    default:
+        return checksum;
+    }
+}
+
+#endif /* BGRT_CHECKSUM_H_ */
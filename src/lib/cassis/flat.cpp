@@ -0,0 +1,422 @@
+/*!
+ * Frozen (flat) layout of a Bipartite Graph Representation Tree
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flat.h"
+#include "bgrt.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <cstdio>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*!
+ * Count the nodes, container bytes and signatures of a subtree.
+ *
+ * \param node subtree root
+ * \param nodes incremented by the number of nodes
+ * \param species_bytes incremented by the size of the species containers
+ * \param signatures incremented by the number of signatures
+ */
+static void flat_count(const struct BgrTreeNode *node, unsigned long *nodes,
+        unsigned long *species_bytes, unsigned long *signatures) {
+    ++(*nodes);
+    *species_bytes += node->species.bytes();
+    *signatures += node->signatures->size();
+    for (const BgrTreeNode *child = node->children; child; child = child->next)
+        flat_count(child, nodes, species_bytes, signatures);
+}
+
+/*!
+ * Copy a subtree into the flat layout (depth-first, pre-order).
+ *
+ * \param flat flat BGRT to fill
+ * \param node subtree root
+ * \param parent index of the parent node
+ * \param depth depth of the node (1 for root nodes)
+ * \param pos index of the next node; incremented
+ * \return index of the subtree root
+ */
+static uint32_t flat_fill(struct BgrTreeFlat *flat,
+        const struct BgrTreeNode *node, uint32_t parent, uint32_t depth,
+        uint32_t *pos) {
+    uint32_t n = (*pos)++;
+    flat->parent[n] = parent;
+    if (depth > flat->max_depth)
+        flat->max_depth = depth;
+
+    flat->species_size[n] = node->species.size();
+    flat->species_first[n] = node->species.first();
+    flat->species_encoding[n] = (uint8_t) node->species.encoding();
+    uint32_t offset = flat->species_offset[n];
+    if (node->species.bytes())
+        memcpy(flat->species_data + offset, node->species.container(),
+                node->species.bytes());
+    flat->species_offset[n + 1] = offset + node->species.bytes();
+
+    assert(node->signatures->size()
+            == node->supposed_outgroup_matches->size());
+    uint32_t sig = flat->signature_offset[n];
+    for (unsigned int i = 0; i < node->signatures->size(); ++i) {
+        flat->signatures[sig + i] = node->signatures->val(i);
+        flat->supposed_outgroup_matches[sig + i] =
+                node->supposed_outgroup_matches->val(i);
+    }
+    flat->signature_offset[n + 1] = sig + node->signatures->size();
+
+    for (const BgrTreeNode *child = node->children; child; child = child->next)
+        flat_fill(flat, child, n, depth + 1, pos);
+    flat->subtree_end[n] = *pos;
+    return n;
+}
+
+/*!
+ * Compute the subtree bounds of all nodes. Children are stored after
+ * their parents, i.e. a single backwards pass is sufficient.
+ *
+ * \param flat flat BGRT to update
+ */
+static void flat_bounds(struct BgrTreeFlat *flat) {
+    for (uint32_t n = 0; n < flat->num_nodes; ++n) {
+        flat->subtree_max_species[n] = 0;
+        flat->subtree_min_outgroup[n] = BGRT_FLAT_UNDEF;
+        for (uint32_t s = flat->signature_offset[n];
+                s < flat->signature_offset[n + 1]; ++s) {
+            flat->subtree_max_species[n] = flat->species_size[n];
+            if (flat->supposed_outgroup_matches[s]
+                    < flat->subtree_min_outgroup[n])
+                flat->subtree_min_outgroup[n] =
+                        flat->supposed_outgroup_matches[s];
+        }
+    }
+    for (uint32_t n = flat->num_nodes; n-- > 0;) {
+        uint32_t p = flat->parent[n];
+        if ((p == BGRT_FLAT_UNDEF)
+                || (flat->subtree_min_outgroup[n] == BGRT_FLAT_UNDEF))
+            continue;
+        uint32_t max_species = flat->species_size[p]
+                + flat->subtree_max_species[n];
+        if (max_species > flat->subtree_max_species[p])
+            flat->subtree_max_species[p] = max_species;
+        if (flat->subtree_min_outgroup[n] < flat->subtree_min_outgroup[p])
+            flat->subtree_min_outgroup[p] = flat->subtree_min_outgroup[n];
+    }
+}
+
+/*!
+ * Create the flat layout of a BGRT.
+ *
+ * \param tree tree to convert
+ * \return NULL on error
+ */
+struct BgrTreeFlat *BgrTreeFlat_create(const struct BgrTree *tree) {
+    unsigned long num_nodes = 0;
+    unsigned long species_bytes = 0;
+    unsigned long num_signatures = 0;
+    for (unsigned int i = 0; i < tree->num_species; ++i)
+        if (tree->nodes[i])
+            flat_count(tree->nodes[i], &num_nodes, &species_bytes,
+                    &num_signatures);
+    if ((num_nodes >= BGRT_FLAT_UNDEF) || (species_bytes >= BGRT_FLAT_UNDEF)
+            || (num_signatures >= BGRT_FLAT_UNDEF))
+        return NULL;
+
+    struct BgrTreeFlat *flat = (BgrTreeFlat *) calloc(1,
+            sizeof(struct BgrTreeFlat));
+    if (!flat)
+        return NULL;
+    flat->num_nodes = num_nodes;
+    flat->num_species = tree->num_species;
+    flat->roots = (uint32_t *) malloc(tree->num_species * sizeof(uint32_t));
+    flat->subtree_end = (uint32_t *) malloc(num_nodes * sizeof(uint32_t));
+    flat->parent = (uint32_t *) malloc(num_nodes * sizeof(uint32_t));
+    flat->species_size = (uint32_t *) malloc(num_nodes * sizeof(uint32_t));
+    flat->species_first = (uint32_t *) malloc(num_nodes * sizeof(uint32_t));
+    flat->species_encoding = (uint8_t *) malloc(num_nodes * sizeof(uint8_t));
+    flat->species_offset = (uint32_t *) malloc(
+            (num_nodes + 1) * sizeof(uint32_t));
+    flat->species_data = (unsigned char *) malloc(species_bytes + 1);
+    flat->signature_offset = (uint32_t *) malloc(
+            (num_nodes + 1) * sizeof(uint32_t));
+    flat->signatures = (uint32_t *) malloc(
+            (num_signatures + 1) * sizeof(uint32_t));
+    flat->supposed_outgroup_matches = (uint32_t *) malloc(
+            (num_signatures + 1) * sizeof(uint32_t));
+    flat->subtree_max_species = (uint32_t *) malloc(
+            num_nodes * sizeof(uint32_t));
+    flat->subtree_min_outgroup = (uint32_t *) malloc(
+            num_nodes * sizeof(uint32_t));
+    if (!flat->roots || !flat->subtree_end || !flat->parent
+            || !flat->species_size || !flat->species_first
+            || !flat->species_encoding || !flat->species_offset
+            || !flat->species_data || !flat->signature_offset
+            || !flat->signatures || !flat->supposed_outgroup_matches
+            || !flat->subtree_max_species || !flat->subtree_min_outgroup) {
+        BgrTreeFlat_destroy(flat);
+        return NULL;
+    }
+
+    uint32_t pos = 0;
+    flat->species_offset[0] = 0;
+    flat->signature_offset[0] = 0;
+    for (unsigned int i = 0; i < tree->num_species; ++i) {
+        if (tree->nodes[i])
+            flat->roots[i] = flat_fill(flat, tree->nodes[i], BGRT_FLAT_UNDEF,
+                    1, &pos);
+        else
+            flat->roots[i] = BGRT_FLAT_UNDEF;
+    }
+    assert(pos == num_nodes);
+    flat_bounds(flat);
+    return flat;
+}
+
+/*!
+ * Free memory occupied by a flat BGRT.
+ *
+ * \param flat flat BGRT to free
+ */
+void BgrTreeFlat_destroy(struct BgrTreeFlat *flat) {
+    if (flat == NULL)
+        return;
+    BgrTreeFlat_ingroup_clear(flat, 0);
+    free(flat->ingroup_layers);
+    if (flat->file_data) {
+        // The node arrays are part of the file.
+        BgrTreeFlat_unmap(flat->file_data, flat->file_size);
+        free(flat);
+        return;
+    }
+    free(flat->roots);
+    free(flat->subtree_end);
+    free(flat->parent);
+    free(flat->species_size);
+    free(flat->species_first);
+    free(flat->species_encoding);
+    free(flat->species_offset);
+    free(flat->species_data);
+    free(flat->signature_offset);
+    free(flat->signatures);
+    free(flat->supposed_outgroup_matches);
+    free(flat->subtree_max_species);
+    free(flat->subtree_min_outgroup);
+    free(flat);
+}
+
+/*!
+ * Map a BGRT file into memory (read-only). On systems without mmap, the
+ * file is read into an allocated buffer.
+ *
+ * \param filename file to map
+ * \param size set to the size of the file in bytes
+ * \return NULL on error
+ */
+void *BgrTreeFlat_map(const char *filename, unsigned long *size) {
+#ifdef _WIN32
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+        return NULL;
+    void *data = NULL;
+    long bytes = -1;
+    if (fseek(file, 0, SEEK_END) == 0)
+        bytes = ftell(file);
+    if ((bytes > 0) && (fseek(file, 0, SEEK_SET) == 0))
+        data = malloc(bytes);
+    if (data && (fread(data, 1, bytes, file) != (size_t) bytes)) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *size = data ? bytes : 0;
+    return data;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    void *data = NULL;
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0)) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+            data = NULL;
+    }
+    close(fd);
+    *size = data ? st.st_size : 0;
+    return data;
+#endif
+}
+
+/*!
+ * Release the memory of a BGRT file (see BgrTreeFlat_map).
+ *
+ * \param data file memory
+ * \param size size of the file in bytes
+ */
+void BgrTreeFlat_unmap(void *data, unsigned long size) {
+#ifdef _WIN32
+    (void) size;
+    free(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+/*!
+ * Provide 'depth' ingroup layers. Existing layers are kept, if the
+ * depth is the same.
+ *
+ * \param flat flat BGRT to update
+ * \param depth number of layers
+ * \return false on error
+ */
+bool BgrTreeFlat_ingroup_layers(struct BgrTreeFlat *flat, unsigned int depth) {
+    if (flat->ingroup_layers && (flat->ingroup_depth == depth))
+        return true;
+    BgrTreeFlat_ingroup_clear(flat, 0);
+    free(flat->ingroup_layers);
+    flat->ingroup_layers = (BgrTreeIngroupLayer *) calloc(depth,
+            sizeof(struct BgrTreeIngroupLayer));
+    flat->ingroup_depth = flat->ingroup_layers ? depth : 0;
+    return flat->ingroup_layers != NULL;
+}
+
+/*!
+ * Release the ingroup layers from 'depth' on.
+ *
+ * \param flat flat BGRT to update
+ * \param depth first layer to release
+ */
+void BgrTreeFlat_ingroup_clear(struct BgrTreeFlat *flat, unsigned int depth) {
+    for (unsigned int i = depth; i < flat->ingroup_depth; ++i) {
+        struct BgrTreeIngroupLayer *layer = flat->ingroup_layers + i;
+        free(layer->entries);
+        layer->entries = NULL;
+        layer->size = 0;
+        layer->capacity = 0;
+    }
+}
+
+/*!
+ * Order of ingroup entries: by node.
+ */
+static inline bool ingroup_less(const struct BgrTreeIngroupEntry &a,
+        const struct BgrTreeIngroupEntry &b) {
+    return a.node < b.node;
+}
+
+/*!
+ * Sort ingroup entries by node.
+ *
+ * A traversal appends the nodes of each BGRT root in ascending order and
+ * usually processes the roots in ascending order, starting at any root.
+ * So the entries mostly consist of (at most) two sorted runs, which only
+ * need to be rotated.
+ *
+ * \param entries nodes and their values
+ * \param num_entries number of entries
+ */
+static void ingroup_sort(struct BgrTreeIngroupEntry *entries,
+        unsigned long num_entries) {
+    unsigned long split = 0;
+    for (unsigned long i = 1; i < num_entries; ++i) {
+        if (entries[i].node < entries[i - 1].node) {
+            if (split || (entries[num_entries - 1].node > entries[0].node)) {
+                std::sort(entries, entries + num_entries, ingroup_less);
+                return;
+            }
+            split = i;
+        }
+    }
+    if (split)
+        std::rotate(entries, entries + split, entries + num_entries);
+}
+
+/*!
+ * Store values in an ingroup layer. The nodes must not be in the layer
+ * yet. The entries are sorted by node (in place).
+ *
+ * \param flat flat BGRT to update
+ * \param depth layer to update
+ * \param entries nodes and their values
+ * \param num_entries number of entries
+ * \return false on error
+ */
+bool BgrTreeFlat_ingroup_store(struct BgrTreeFlat *flat, unsigned int depth,
+        struct BgrTreeIngroupEntry *entries, unsigned long num_entries) {
+    struct BgrTreeIngroupLayer *layer = flat->ingroup_layers + depth;
+    if (num_entries == 0)
+        return true;
+    ingroup_sort(entries, num_entries);
+
+    unsigned long size = layer->size + num_entries;
+    if (size > layer->capacity) {
+        struct BgrTreeIngroupEntry *tmp = (BgrTreeIngroupEntry *) realloc(
+                layer->entries, size * sizeof(struct BgrTreeIngroupEntry));
+        if (!tmp)
+            return false;
+        layer->entries = tmp;
+        layer->capacity = size;
+    }
+
+    // Merge the new entries into the layer, starting at the end.
+    unsigned long i = layer->size;
+    unsigned long j = num_entries;
+    unsigned long k = size;
+    while (j > 0) {
+        if ((i > 0) && (layer->entries[i - 1].node > entries[j - 1].node))
+            layer->entries[--k] = layer->entries[--i];
+        else
+            layer->entries[--k] = entries[--j];
+    }
+    layer->size = size;
+    return true;
+}
+
+/*!
+ * Number of bytes allocated by a flat BGRT.
+ *
+ * \param flat flat BGRT
+ * \return allocated bytes
+ */
+unsigned long BgrTreeFlat_allocated(const struct BgrTreeFlat *flat) {
+    unsigned long num_nodes = flat->num_nodes;
+    unsigned long bytes = sizeof(struct BgrTreeFlat);
+    bytes += flat->num_species * sizeof(uint32_t);
+    bytes += num_nodes * (7 * sizeof(uint32_t) + sizeof(uint8_t));
+    bytes += (num_nodes + 1) * sizeof(uint32_t);
+    bytes += flat->species_offset[num_nodes];
+    bytes += 2 * flat->signature_offset[num_nodes] * sizeof(uint32_t);
+    for (unsigned int i = 0; i < flat->ingroup_depth; ++i)
+        bytes += sizeof(struct BgrTreeIngroupLayer)
+                + flat->ingroup_layers[i].capacity
+                        * sizeof(struct BgrTreeIngroupEntry);
+    return bytes;
+}
@@ -0,0 +1,270 @@
+/*!
+ * Frozen (flat) layout of a Bipartite Graph Representation Tree
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BGRT_FLAT_H_
+#define BGRT_FLAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct BgrTree;
+
+/*!
+ * This value marks an undefined node index (no parent, no root).
+ */
+#define BGRT_FLAT_UNDEF ((uint32_t)-1)
+
+/*!
+ * Value of a node in an ingroup layer and the depth it refers to: The
+ * depth of the layer itself, or a lower depth if the node was cut off
+ * (the value is copied from that depth then).
+ */
+struct BgrTreeIngroupEntry {
+    uint32_t node;
+    uint32_t value;
+    uint32_t depth;
+};
+
+/*!
+ * Values of the nodes for one depth of the phylogenetic tree.
+ *
+ * Only the nodes that were written by the last traversal at this depth
+ * are stored, i.e. the memory needed depends on the number of visited
+ * nodes instead of the size of the tree. The entries are sorted by node,
+ * so that a traversal (which visits the nodes in ascending order) can
+ * look them up with a cursor.
+ */
+struct BgrTreeIngroupLayer {
+    struct BgrTreeIngroupEntry *entries;
+    unsigned long size;
+    unsigned long capacity;
+};
+
+/*!
+ * Read-only BGRT in a structure-of-arrays layout.
+ *
+ * The nodes are numbered in depth-first order (pre-order), i.e. the
+ * subtree of node n consists of the nodes n...subtree_end[n]-1. Instead
+ * of following child and sibling pointers, a traversal walks the node
+ * arrays from left to right and skips a subtree by jumping to its end.
+ * All per-node values are stored in separate contiguous arrays.
+ */
+struct BgrTreeFlat {
+    /*!
+     * Number of nodes.
+     */
+    uint32_t num_nodes;
+
+    /*!
+     * Number of nodes on the longest path from a root to a leaf.
+     */
+    uint32_t max_depth;
+
+    /*!
+     * Index of the root node for each species (the "nodes" array of
+     * the BGRT). BGRT_FLAT_UNDEF, if there is no root for a species.
+     */
+    uint32_t *roots;
+    unsigned int num_species;
+
+    /*!
+     * Index after the last node of the subtree of each node.
+     */
+    uint32_t *subtree_end;
+
+    /*!
+     * Index of the parent node. BGRT_FLAT_UNDEF for root nodes.
+     */
+    uint32_t *parent;
+
+    /*!
+     * Species sets of the nodes (see SpeciesSet): number of species,
+     * smallest species and the container type. The containers are
+     * stored one after the other in 'species_data', 'species_offset'
+     * holds num_nodes + 1 entries.
+     */
+    uint32_t *species_size;
+    uint32_t *species_first;
+    uint8_t *species_encoding;
+    uint32_t *species_offset;
+    unsigned char *species_data;
+
+    /*!
+     * Signatures of the nodes (handles into the signature pool of the
+     * BGRT) and their number of supposed outgroup matches. The entries
+     * of node n are stored at signature_offset[n]...signature_offset[n+1]-1.
+     */
+    uint32_t *signature_offset;
+    uint32_t *signatures;
+    uint32_t *supposed_outgroup_matches;
+
+    /*!
+     * Bounds of each subtree, computed when the layout is created:
+     * - subtree_max_species: Maximum number of species on a path from
+     *   the node down to a node with signatures (the species sets on a
+     *   path are disjoint, i.e. this bounds the number of ingroup hits
+     *   that can be added within the subtree).
+     * - subtree_min_outgroup: Minimum number of supposed outgroup matches
+     *   of the signatures within the subtree. BGRT_FLAT_UNDEF, if there
+     *   are no signatures within the subtree.
+     */
+    uint32_t *subtree_max_species;
+    uint32_t *subtree_min_outgroup;
+
+    /*!
+     * Maximum number of ingroup hits of the subtrees per depth of the
+     * phylogenetic tree (used to cut branches during the traversal).
+     * One layer per depth, see BgrTreeIngroupLayer.
+     */
+    struct BgrTreeIngroupLayer *ingroup_layers;
+    unsigned int ingroup_depth;
+
+    /*!
+     * Memory of the BGRT file the node arrays point into, NULL if the
+     * arrays were allocated by BgrTreeFlat_create. The file memory is
+     * released together with the flat BGRT (see BgrTreeFlat_unmap).
+     */
+    void *file_data;
+    unsigned long file_size;
+};
+
+/*!
+ * Create the flat layout of a BGRT.
+ *
+ * \param tree tree to convert
+ * \return NULL on error
+ */
+struct BgrTreeFlat *BgrTreeFlat_create(const struct BgrTree *tree);
+
+/*!
+ * Free memory occupied by a flat BGRT.
+ *
+ * \param flat flat BGRT to free
+ */
+void BgrTreeFlat_destroy(struct BgrTreeFlat *flat);
+
+/*!
+ * Map a BGRT file into memory (read-only). On systems without mmap, the
+ * file is read into an allocated buffer.
+ *
+ * \param filename file to map
+ * \param size set to the size of the file in bytes
+ * \return NULL on error
+ */
+void *BgrTreeFlat_map(const char *filename, unsigned long *size);
+
+/*!
+ * Release the memory of a BGRT file (see BgrTreeFlat_map).
+ *
+ * \param data file memory
+ * \param size size of the file in bytes
+ */
+void BgrTreeFlat_unmap(void *data, unsigned long size);
+
+/*!
+ * Provide 'depth' ingroup layers. Existing layers are kept, if the
+ * depth is the same.
+ *
+ * \param flat flat BGRT to update
+ * \param depth number of layers
+ * \return false on error
+ */
+bool BgrTreeFlat_ingroup_layers(struct BgrTreeFlat *flat, unsigned int depth);
+
+/*!
+ * Release the ingroup layers from 'depth' on.
+ *
+ * \param flat flat BGRT to update
+ * \param depth first layer to release
+ */
+void BgrTreeFlat_ingroup_clear(struct BgrTreeFlat *flat, unsigned int depth);
+
+/*!
+ * Store values in an ingroup layer. The nodes must not be in the layer
+ * yet. The entries are sorted by node (in place).
+ *
+ * \param flat flat BGRT to update
+ * \param depth layer to update
+ * \param entries nodes and their values
+ * \param num_entries number of entries
+ * \return false on error
+ */
+bool BgrTreeFlat_ingroup_store(struct BgrTreeFlat *flat, unsigned int depth,
+        struct BgrTreeIngroupEntry *entries, unsigned long num_entries);
+
+/*!
+ * Fetch the value of a node from an ingroup layer.
+ *
+ * The search starts at the position 'cursor', which is advanced to the
+ * first entry not below the node. The cursor has to be reset to 0 before
+ * a smaller node is looked up.
+ *
+ * \param flat flat BGRT
+ * \param depth layer to search
+ * \param node node index
+ * \param cursor position within the layer
+ * \return The entry of the node, NULL if the layer holds no value for
+ *         the node.
+ */
+static inline const struct BgrTreeIngroupEntry *BgrTreeFlat_ingroup_find(
+        const struct BgrTreeFlat *flat, unsigned int depth, uint32_t node,
+        unsigned long *cursor) {
+    const struct BgrTreeIngroupLayer *layer = flat->ingroup_layers + depth;
+    const struct BgrTreeIngroupEntry *entries = layer->entries;
+    const unsigned long size = layer->size;
+    unsigned long lo = *cursor;
+    if ((lo < size) && (entries[lo].node < node)) {
+        // Gallop over the nodes below 'node', then search the last step.
+        unsigned long step = 1;
+        unsigned long hi = lo + 1;
+        while ((hi < size) && (entries[hi].node < node)) {
+            lo = hi;
+            step *= 2;
+            hi = lo + step;
+        }
+        if (hi > size)
+            hi = size;
+        ++lo;
+        while (lo < hi) {
+            unsigned long mid = lo + (hi - lo) / 2;
+            if (entries[mid].node < node)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+    }
+    *cursor = lo;
+    if ((lo < size) && (entries[lo].node == node))
+        return entries + lo;
+    return NULL;
+}
+
+/*!
+ * Number of bytes allocated by a flat BGRT.
+ *
+ * \param flat flat BGRT
+ * \return allocated bytes
+ */
+unsigned long BgrTreeFlat_allocated(const struct BgrTreeFlat *flat);
+
+#endif /* BGRT_FLAT_H_ */
@@ -21,14 +21,23 @@
  * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "config.h"
 #include "io.h"
+#include "blockio.h"
+#include "checksum.h"
 
+#include <algorithm>
 #include <fstream>
 #include <cstdlib>
 #include <cassert>
 #include <cstring>
 #include <stdint.h>
 
+#ifdef PTHREADS
+#include "pool.h"
+#include <pthread.h>
+#endif
+
 /*!
  * Reads a fixed-length quantity type from the input stream.
  * Inline code: no error checking.
@@ -49,280 +58,449 @@ template<typename T> inline void writeType(const T& value,
 }
 
 /*!
- * Reads an unsigned variable-length quantity integer from the
- * input stream. (VLQ/Base128 VarUInt)
+ * Lists with fewer values are stored as VarUInts in BGRT_STREAM_VBYTE
+ * files (the control byte does not pay off for them), unless the file
+ * is a BGRT_STREAM_ADAPTIVE file.
  */
-inline uint32_t readVarUInt(std::istream &stream) {
-    uint32_t value = 0;
-    uint8_t bits = 0;
-    do {
-        value <<= 7;
-        stream.read(reinterpret_cast<char*>(&bits), 1);
-        value = value | (bits & 0x7F);
-    } while (bits & 0x80);
-    return value;
-}
+#define BGRT_VBYTE_MIN_LIST 4
 
 /*!
- * Writes an unsigned variable-length quantity integer to the
- * output stream. (VLQ/Base128 VarUInt)
+ * Number of bytes needed to store 'value' as VarUInt.
  */
-inline void writeVarUInt(uint32_t value, std::ostream &stream) {
-    char buffer[5];
-    buffer[4] = 0x7F & value;
-    int pos = 4;
+static inline unsigned int varUIntBytes(uint32_t value) {
+    unsigned int bytes = 1;
     while (value > 0x7F) {
         value >>= 7;
-        buffer[--pos] = (0x7F & value) | 0x80;
-    };
-    stream.write(reinterpret_cast<const char*>(buffer + pos), 5 - pos);
+        ++bytes;
+    }
+    return bytes;
 }
 
 /*!
- * Read IntSet from stream
+ * Number of bytes needed to store a list as VarUInts.
  */
-IntSet *readIntSet(std::istream &stream) {
-    // Read IntSet size...
-    unsigned int size = readVarUInt(stream);
-
-    // Create the IntSet...
-    IntSet *intset = new IntSet(size);
-    intset->setSize(size);
-
-    // Write integer values...
+static unsigned long varUIntListBytes(const uint32_t *values,
+        unsigned int size) {
+    unsigned long bytes = 0;
     for (unsigned int i = 0; i < size; ++i)
-        intset->set(i, readVarUInt(stream));
-
-    return intset;
+        bytes += varUIntBytes(values[i]);
+    return bytes;
 }
 
 /*!
- * Write IntSet to stream
+ * Number of bytes needed to store a list in the stream-vbyte layout.
  */
-bool writeIntSet(const IntSet *intset, std::ostream &stream) {
-    if (!intset)
-        return false;
-
-    // Write IntSet size...
-    writeVarUInt(intset->size(), stream);
-
-    // Write integer values...
-    for (unsigned int i = 0; i < intset->size(); ++i)
-        writeVarUInt(intset->val(i), stream);
-
-    return true;
+static unsigned long vbyteListBytes(const uint32_t *values,
+        unsigned int size) {
+    unsigned long bytes = (size + 3) / 4;
+    for (unsigned int i = 0; i < size; ++i)
+        bytes += (values[i] > 0xFFFFFF) ? 4 : (values[i] > 0xFFFF) ? 3
+                : (values[i] > 0xFF) ? 2 : 1;
+    return bytes;
 }
 
 /*!
- * Read UnorderedIntSet from stream
+ * Read the size of an integer list. In BGRT_STREAM_ADAPTIVE files, the
+ * lowest bit of the stored size tells whether the list is stored in the
+ * stream-vbyte layout. Otherwise, all lists with at least
+ * BGRT_VBYTE_MIN_LIST values are, if the file is a BGRT_STREAM_VBYTE
+ * file.
  */
-UnorderedIntSet *readUnorderedIntSet(std::istream &stream) {
-    // Read IntSet size...
-    unsigned int size = readVarUInt(stream);
-
-    // Create the UnorderedIntSet...
-    UnorderedIntSet *uintset = new UnorderedIntSet(size);
-    uintset->setSize(size);
-
-    // Write integer values...
-    for (unsigned int i = 0; i < size; ++i)
-        uintset->set(i, readVarUInt(stream));
-
-    return uintset;
+static inline unsigned int readIntListSize(BlockReader &reader,
+        unsigned int flags, bool &vbyte) {
+    unsigned int size = reader.readVarUInt();
+    if (flags & BGRT_STREAM_ADAPTIVE) {
+        vbyte = size & 1;
+        return size >> 1;
+    }
+    vbyte = (flags & BGRT_STREAM_VBYTE) && (size >= BGRT_VBYTE_MIN_LIST);
+    return size;
 }
 
 /*!
- * Write IntSet to stream
+ * Write the size of an integer list (see readIntListSize). In
+ * BGRT_STREAM_ADAPTIVE files, the stream-vbyte layout is chosen only if
+ * it is smaller than the VarUInts.
+ * \return true, if the list has to be written in the stream-vbyte layout.
  */
-bool writeUnorderedIntSet(const UnorderedIntSet *uintset,
-        std::ostream &stream) {
-    if (!uintset)
-        return false;
-
-    // Write IntSet size...
-    writeVarUInt(uintset->size(), stream);
-
-    // Write integer values...
-    for (unsigned int i = 0; i < uintset->size(); ++i)
-        writeVarUInt(uintset->val(i), stream);
-
-    return true;
+static inline bool writeIntListSize(BlockWriter &writer,
+        const uint32_t *values, unsigned int size, unsigned int flags) {
+    if (!(flags & BGRT_STREAM_ADAPTIVE)) {
+        writer.writeVarUInt(size);
+        return (flags & BGRT_STREAM_VBYTE) && (size >= BGRT_VBYTE_MIN_LIST);
+    }
+    const bool vbyte = (flags & BGRT_STREAM_VBYTE)
+            && (vbyteListBytes(values, size) < varUIntListBytes(values, size));
+    writer.writeVarUInt((size << 1) | (vbyte ? 1 : 0));
+    return vbyte;
 }
 
 /*!
- * Read a string (char *) from the stream
+ * Read the values of an integer list: VarUInts, or the stream-vbyte
+ * layout (see readIntListSize). The values are decoded into 'values',
+ * which has to hold 'size' entries.
  */
-inline char *readString(std::istream &stream) {
-    // Read string length...
-    unsigned int len = readVarUInt(stream);
-
-    // Read and append string to StrSet...
-    char *str = (char*) malloc(len + 1);
-    if (len)
-        stream.read(str, len);
-    str[len] = 0x00;
-
-    return str;
+static inline bool readIntList(BlockReader &reader, uint32_t *values,
+        unsigned int size, bool vbyte) {
+    if (vbyte)
+        return reader.readVByte(values, size);
+    for (unsigned int i = 0; i < size; ++i)
+        values[i] = reader.readVarUInt();
+    return reader.good();
 }
 
 /*!
- * Write a string to the stream
+ * Write a list of integers (see readIntList). The size is not written.
  */
-inline void writeString(const char *str, std::ostream &stream) {
-    if (str) {
-        // Write string length...
-        unsigned int len = strlen(str);
-        writeVarUInt(len, stream);
-
-        // Write string...
-        if (len)
-            stream.write(str, len);
-    } else {
-        // NULL strings are handled as empty strings
-        unsigned int len = 0;
-        writeVarUInt(len, stream);
-    }
+static inline void writeIntList(BlockWriter &writer, const uint32_t *values,
+        unsigned int size, bool vbyte) {
+    if (vbyte)
+        writer.writeVByte(values, size);
+    else
+        for (unsigned int i = 0; i < size; ++i)
+            writer.writeVarUInt(values[i]);
 }
 
 /*!
- * Read StrSet from stream
+ * Read a species set from stream.
+ *
+ * In BGRT_STREAM_SPECIES_DELTA files, the compressed container of the
+ * set (see SpeciesSet) is stored: the set size, the smallest species ID
+ * and (for two or more species) the container type and size, followed
+ * by the container. It is copied into 'set' without decoding.
+ * Otherwise, the values are read into the scratch buffer of the BGRT
+ * and compressed into 'set'.
+ * In BGRT_STREAM_ADAPTIVE files, the lowest bit of the stored set size
+ * tells whether the container or the species (as VarUInts) are stored.
+ *
+ * The species have to be sorted in ascending order (without duplicates)
+ * and below the number of species of the BGRT. Otherwise the data is
+ * marked as invalid (see BlockReader::fail).
  */
-StrSet *readStrSet(std::istream &stream) {
-    // Read StrSet size...
-    unsigned int size = readVarUInt(stream);
+bool readSpeciesSet(BlockReader &reader, SpeciesSet &set, BgrTree *bgrt,
+        unsigned int flags) {
+    // Read the set size...
+    unsigned int size = reader.readVarUInt();
+    bool container = (flags & BGRT_STREAM_SPECIES_DELTA) != 0;
+    bool vbyte = (flags & BGRT_STREAM_VBYTE)
+            && (size >= BGRT_VBYTE_MIN_LIST);
+    if (flags & BGRT_STREAM_ADAPTIVE) {
+        container = size & 1;
+        vbyte = false;
+        size >>= 1;
+    }
+
+    if (container) {
+        unsigned int first = size ? reader.readVarUInt() : 0;
+        unsigned int type = (size > 1) ? reader.readVarUInt() : 0;
+        unsigned int encoding = type & 3;
+        unsigned int bytes = type >> 2;
+        if ((encoding > SpeciesSet::BITMAP) || ((size > 1) && !bytes)) {
+            reader.fail();
+            return false;
+        }
+        const char *data = bytes ? reader.fetch(bytes) : NULL;
+        if (bytes && !data)
+            return false;
+        if (!SpeciesSet::valid(encoding, first, size,
+                (const unsigned char *) data, bytes, bgrt->num_species)) {
+            reader.fail();
+            return false;
+        }
+        return set.assign((SpeciesSet::Encoding) encoding, first, size,
+                (const unsigned char *) data, bytes);
+    }
 
-    // Create the IntSet...
-    StrSet *strset = new StrSet(size);
-    strset->setSize(size);
+    // Each species takes at least one byte.
+    if (!reader.available(size))
+        return false;
+    unsigned int *buffer = BgrTree_species_buffer(bgrt, size);
+    if (!buffer)
+        return false;
 
-    // Read string values...
-    for (unsigned int i = 0; i < size; ++i)
-        strset->set(i, readString(stream));
+    // Read integer values...
+    if (!readIntList(reader, buffer, size, vbyte))
+        return false;
+
+    // Check the order and range of the species.
+    for (unsigned int i = 0; i < size; ++i) {
+        if ((buffer[i] >= bgrt->num_species)
+                || (i && (buffer[i] <= buffer[i - 1]))) {
+            reader.fail();
+            return false;
+        }
+    }
 
-    return strset;
+    set.assign(buffer, size);
+    return true;
 }
 
 /*!
- * Write StrSet to stream
+ * Write a species set to stream (see readSpeciesSet). Without the
+ * BGRT_STREAM_SPECIES_DELTA flag, the set is decoded into the scratch
+ * buffer of the BGRT first. In BGRT_STREAM_ADAPTIVE files, the container
+ * is written only if it is smaller than the decoded species.
  */
-bool writeStrSet(const StrSet *strset, std::ostream &stream) {
-    if (!strset)
-        return false;
-
-    // Write StrSet size to stream.
-    writeVarUInt(strset->size(), stream);
+bool writeSpeciesSet(const SpeciesSet &set, BlockWriter &writer,
+        BgrTree *bgrt, unsigned int flags) {
+    bool container = (flags & BGRT_STREAM_SPECIES_DELTA) != 0;
+    unsigned int *buffer = NULL;
+    unsigned int size = set.size();
+    if (!container || (flags & BGRT_STREAM_ADAPTIVE)) {
+        buffer = BgrTree_species_buffer(bgrt, size);
+        if (!buffer)
+            return false;
+        size = set.decode(buffer);
+    }
 
-    // Write string values to stream.
-    for (unsigned int i = 0; i < strset->size(); ++i)
-        writeString(strset->val(i), stream);
+    if (flags & BGRT_STREAM_ADAPTIVE) {
+        unsigned long container_bytes = size ? varUIntBytes(set.first()) : 0;
+        if (size > 1)
+            container_bytes += varUIntBytes((set.bytes() << 2)
+                    | set.encoding()) + set.bytes();
+        container = container
+                && (container_bytes < varUIntListBytes(buffer, size));
+        writer.writeVarUInt((size << 1) | (container ? 1 : 0));
+    } else
+        writer.writeVarUInt(size);
+
+    if (container) {
+        if (size)
+            writer.writeVarUInt(set.first());
+        if (size > 1) {
+            writer.writeVarUInt((set.bytes() << 2) | set.encoding());
+            writer.write(set.container(), set.bytes());
+        }
+        return true;
+    }
 
+    // Write integer values...
+    writeIntList(writer, buffer, size, !(flags & BGRT_STREAM_ADAPTIVE)
+            && (flags & BGRT_STREAM_VBYTE) && (size >= BGRT_VBYTE_MIN_LIST));
     return true;
 }
 
 /*!
- * Write a Base4_t to stream
+ * Read UnorderedIntSet from stream. The set is allocated from the given
+ * arena, the values are decoded directly into the set. On error, the
+ * set is empty and the reader is marked as failed.
  */
-inline Base4 *readBase4_t(std::istream &stream) {
-    // Read uncompressed string length in bytes.
-    unsigned short len = readVarUInt(stream);
+UnorderedIntSet *readUnorderedIntSet(BlockReader &reader,
+        ObjectArena<UnorderedIntSet> *arena, unsigned int flags) {
+    // Read IntSet size (each value takes at least one byte)...
+    bool vbyte;
+    unsigned int size = readIntListSize(reader, flags, vbyte);
+    if (!reader.available(size))
+        size = 0;
 
-    // Calculate of base4-encoded chars (2 bits/char).
-    unsigned short base4_len = len / 4;
-    if (len % 4)
-        ++base4_len;
+    // Create the UnorderedIntSet...
+    UnorderedIntSet *uintset = arena->create(size);
+    uintset->setSize(size);
 
-    // Read and append string to StrSet...
-    char *str = (char*) malloc(base4_len);
-    if (base4_len)
-        stream.read(str, base4_len);
+    // Read integer values...
+    if (!readIntList(reader, uintset->val_ptr(), uintset->size(), vbyte))
+        uintset->setSize(0);
 
-    Base4 *base4 = new Base4();
-    base4->set(str, len);
-    return base4;
+    return uintset;
 }
 
 /*!
- * Write a Base4_t to stream
+ * Write IntSet to stream
  */
-inline void writeBase4_t(const Base4 *base4, std::ostream &stream) {
-    // Calculate the number of base4-encoded chars (2 bits/char).
-    unsigned short base4_len = base4->len() / 4;
-    if (base4->len() % 4)
-        ++base4_len;
+bool writeUnorderedIntSet(const UnorderedIntSet *uintset,
+        BlockWriter &writer, unsigned int flags) {
+    if (!uintset)
+        return false;
+
+    // Write IntSet size...
+    bool vbyte = writeIntListSize(writer, uintset->val_ptr(),
+            uintset->size(), flags);
 
-    // Write the uncompressed string length in bytes.
-    writeVarUInt(base4->len(), stream);
+    // Write integer values...
+    writeIntList(writer, uintset->val_ptr(), uintset->size(), vbyte);
 
-    // Write base4-encoded string
-    if (base4_len > 0)
-        stream.write(base4->seq(), base4_len);
+    return true;
 }
 
 /*!
- * Read Base4Set from stream
+ * Read a list of signatures from stream. The signatures are appended
+ * to the signature pool, their handles are stored in a set that is
+ * allocated from the given arena.
+ *
+ * In BGRT_STREAM_VBYTE files, the (uncompressed) signature lengths are
+ * stored as a list (see readIntListSize), followed by the signatures.
+ * Otherwise, each signature is preceded by its length.
+ * On error, the set holds the signatures read so far and the reader is
+ * marked as failed.
  */
-Base4Set *readBase4Set(std::istream &stream) {
-    // Read Base4Set size...
-    unsigned int size = readVarUInt(stream);
-
-    // Create the Base4Set...
-    Base4Set *set = new Base4Set(size);
+UnorderedIntSet *readSignatures(BlockReader &reader, BgrTree *bgrt,
+        unsigned int flags) {
+    SignaturePool *pool = bgrt->signature_pool;
+    const bool base4_compressed = bgrt->base4_compressed;
+
+    // Read the number of signatures (each one takes at least one byte)...
+    bool vbyte;
+    unsigned int size = readIntListSize(reader, flags, vbyte);
+    if (!reader.available(size))
+        size = 0;
+
+    // Create the handle set...
+    UnorderedIntSet *set = bgrt->uintset_arena->create(size);
     set->setSize(size);
 
-    // Read string values...
-    for (unsigned int i = 0; i < size; ++i) {
-        set->set(i, readBase4_t(stream));
+    // Fetch the signature lengths (the species have been compressed
+    // already, i.e. the scratch buffer can be reused).
+    unsigned int *lengths = NULL;
+    if (flags & BGRT_STREAM_VBYTE) {
+        lengths = BgrTree_species_buffer(bgrt, size);
+        if (!lengths || !readIntList(reader, lengths, size, vbyte)) {
+            set->setSize(0);
+            return set;
+        }
     }
 
+    char buffer[SIGNATURE_BUFFER_SIZE];
+    for (unsigned int i = 0; i < size; ++i) {
+        // Read the (uncompressed) signature length...
+        unsigned int len = lengths ? lengths[i] : reader.readVarUInt();
+
+        // ...and the (base4-encoded) signature.
+        unsigned int bytes = base4_compressed ? (len + 3) / 4 : len;
+        const char *seq = reader.fetch(bytes);
+        if (!seq) {
+            set->setSize(i);
+            break;
+        }
+
+        uint32_t handle = SIGNATURE_HANDLE_UNDEF;
+        if (base4_compressed)
+            handle = pool->addPacked(seq, len);
+        else {
+            char *str = buffer;
+            if (bytes >= SIGNATURE_BUFFER_SIZE)
+                str = (char*) malloc(bytes + 1);
+            if (str) {
+                memcpy(str, seq, len);
+                str[len] = 0x00;
+                handle = pool->add(str);
+            }
+            if (str != buffer)
+                free(str);
+        }
+
+        // Stop, if the signature is too long for the pool (or on an
+        // allocation failure).
+        if (handle == SIGNATURE_HANDLE_UNDEF) {
+            reader.fail();
+            set->setSize(i);
+            break;
+        }
+        set->set(i, handle);
+    }
     return set;
 }
 
 /*!
- * Write StrSet to stream
+ * Write a list of signatures (handles into the signature pool) to stream.
  */
-bool WriteBase4Set(const Base4Set *set, std::ostream &stream) {
+bool writeSignatures(const UnorderedIntSet *set, BgrTree *bgrt,
+        BlockWriter &writer, unsigned int flags) {
     if (!set)
         return false;
-
-    // Write Base4Set size to stream.
-    writeVarUInt(set->size(), stream);
-
-    // Write Base4_t values to stream.
-    for (unsigned int i = 0; i < set->size(); ++i)
-        writeBase4_t(set->val(i), stream);
-
+    const SignaturePool *pool = bgrt->signature_pool;
+
+    // Write the number of signatures and the signature lengths as list.
+    if (flags & BGRT_STREAM_VBYTE) {
+        unsigned int *lengths = BgrTree_species_buffer(bgrt, set->size());
+        if (!lengths)
+            return false;
+        for (unsigned int i = 0; i < set->size(); ++i)
+            lengths[i] = pool->length(set->val(i));
+        bool vbyte = writeIntListSize(writer, lengths, set->size(), flags);
+        writeIntList(writer, lengths, set->size(), vbyte);
+    } else
+        writeIntListSize(writer, NULL, set->size(), flags);
+
+    for (unsigned int i = 0; i < set->size(); ++i) {
+        uint32_t handle = set->val(i);
+        if (pool->isPacked()) {
+            // Write the uncompressed signature length in bytes and
+            // the base4-encoded signature.
+            unsigned int len = pool->length(handle);
+            if (!(flags & BGRT_STREAM_VBYTE))
+                writer.writeVarUInt(len);
+            if (len)
+                writer.write(pool->packed(handle), (len + 3) / 4);
+        } else {
+            const char *str = pool->get(handle, NULL);
+            if (flags & BGRT_STREAM_VBYTE)
+                writer.write(str, pool->length(handle));
+            else
+                writer.writeString(str);
+        }
+    }
     return true;
 }
 
 /*!
- * Write a BGRT node to an output stream.
+ * Read a BGRT node from an input stream.
+ * The node and its sets are allocated from the BGRT arenas.
+ *
+ * Decoding stops at the first inconsistency: A node has to hold at least
+ * one species, and the species sets on a path are disjoint, i.e. a path
+ * holds at most all species of the BGRT (which also limits the recursion
+ * depth). Each node has as many outgroup match values as signatures.
+ *
+ * \param max_species number of species the subtree may hold at most
+ *        (the species of the BGRT that are not on the path above it)
+ * \return The node, NULL on error (the reader is marked as failed then,
+ *         the nodes read so far are released with the BGRT).
  */
-BgrTreeNode *readBGRTEntry(std::istream &stream, bool base4_compressed) {
+BgrTreeNode *readBGRTEntry(BlockReader &reader, BgrTree *bgrt,
+        unsigned int flags, uint32_t max_species) {
     // Create new node...
-    BgrTreeNode *node = (BgrTreeNode *) calloc(1, sizeof(struct BgrTreeNode));
+    BgrTreeNode *node = bgrt->node_arena->create();
 
-    // Read: IntSet *species:
-    node->species = readIntSet(stream);
+    // Read: SpeciesSet species:
+    if (!readSpeciesSet(reader, node->species, bgrt, flags)
+            || (node->species.size() == 0)
+            || (node->species.size() > max_species)) {
+        reader.fail();
+        return NULL;
+    }
+    max_species -= node->species.size();
 
     // Read: UnorderedIntSet *supposed_outgroup_matches;
-    node->supposed_outgroup_matches = readUnorderedIntSet(stream);
-
-    // Write: StrSet *signatures:
-    if (base4_compressed)
-        node->signatures.base4 = readBase4Set(stream);
-    else
-        node->signatures.str = readStrSet(stream);
-
-    // Count child nodes and write the result to the stream...
-    uint16_t num_children = (uint16_t) readVarUInt(stream);
+    node->supposed_outgroup_matches = readUnorderedIntSet(reader,
+            bgrt->uintset_arena, flags);
+
+    // Read: UnorderedIntSet *signatures:
+    node->signatures = readSignatures(reader, bgrt, flags);
+    if (node->signatures->size() != node->supposed_outgroup_matches->size())
+        reader.fail();
+
+    // Count child nodes and write the result to the stream (each child
+    // takes at least four bytes)...
+    uint32_t count = reader.readVarUInt();
+    if ((count > 0xFFFF) || !reader.available((uint64_t) count * 4))
+        reader.fail();
+    if (!reader.good())
+        return NULL;
+    uint16_t num_children = (uint16_t) count;
+    node->num_children = num_children;
 
     // Read children...
     if (num_children--) {
-        BgrTreeNode *child = readBGRTEntry(stream, base4_compressed);
+        BgrTreeNode *child = readBGRTEntry(reader, bgrt, flags, max_species);
+        if (!child)
+            return NULL;
         node->children = child;
         child->parent = node;
         while (num_children) {
-            BgrTreeNode *next = readBGRTEntry(stream, base4_compressed);
+            BgrTreeNode *next = readBGRTEntry(reader, bgrt, flags,
+                    max_species);
+            if (!next)
+                return NULL;
             next->parent = node;
             child->next = next;
             child = next;
@@ -336,22 +514,19 @@ BgrTreeNode *readBGRTEntry(std::istream &stream, bool base4_compressed) {
 /*!
  * Write a BGRT node to an output stream.
  */
-bool writeBGRTEntry(BgrTreeNode *node, std::ostream &stream,
-        bool base4_compressed) {
+bool writeBGRTEntry(BgrTreeNode *node, BlockWriter &writer, BgrTree *bgrt,
+        unsigned int flags) {
     if (!node)
         return false;
 
-    // Write: IntSet *species:
-    writeIntSet(node->species, stream);
+    // Write: SpeciesSet species:
+    writeSpeciesSet(node->species, writer, bgrt, flags);
 
     // Write: UnorderedIntSet *supposed_outgroup_matches;
-    writeUnorderedIntSet(node->supposed_outgroup_matches, stream);
+    writeUnorderedIntSet(node->supposed_outgroup_matches, writer, flags);
 
-    // Write: StrSet *signatures:
-    if (base4_compressed)
-        WriteBase4Set(node->signatures.base4, stream);
-    else
-        writeStrSet(node->signatures.str, stream);
+    // Write: UnorderedIntSet *signatures:
+    writeSignatures(node->signatures, bgrt, writer, flags);
 
     // Count child nodes and write the result to the stream...
     uint16_t num_children = 0;
@@ -360,12 +535,12 @@ bool writeBGRTEntry(BgrTreeNode *node, std::ostream &stream,
         ++num_children;
         child = child->next;
     }
-    writeVarUInt(num_children, stream);
+    writer.writeVarUInt(num_children);
 
     // Write children...
     child = node->children;
     while (child) {
-        writeBGRTEntry(child, stream, base4_compressed);
+        writeBGRTEntry(child, writer, bgrt, flags);
         child = child->next;
     }
     return true;
@@ -373,246 +548,1518 @@ bool writeBGRTEntry(BgrTreeNode *node, std::ostream &stream,
 
 /*!
  * Read a BGRT header from an input stream
+ *
+ * \param max_species upper bound of the number of species, given by the
+ *        size of the file (the roots take at least one byte each)
  */
-BgrTree *readBGRTHeader(std::istream &stream) {
+BgrTree *readBGRTHeader(BlockReader &reader, uint64_t max_species) {
     // Read the BGRT encoding type.
-    bool base4_compressed = (bool) readVarUInt(stream);
+    bool base4_compressed = (bool) reader.readVarUInt();
 
     // BGRTree: read first level depth.
-    unsigned int num_species = (uint32_t) readVarUInt(stream);
+    unsigned int num_species = (uint32_t) reader.readVarUInt();
+    if (!reader.good() || (num_species > max_species))
+        return NULL;
 
     // Create the tree.
     BgrTree *bgrt = BgrTree_create(num_species, base4_compressed);
+    if (!bgrt)
+        return NULL;
 
     // Number of ingroup mismatches, that were used to compute the BGRTree.
-    bgrt->ingroup_mismatch_distance = (uint16_t) readVarUInt(stream);
+    bgrt->ingroup_mismatch_distance = (uint16_t) reader.readVarUInt();
 
     // Mismatch distance that was used to compute the BGRTree.
-    bgrt->outgroup_mismatch_distance = (uint16_t) readVarUInt(stream);
+    bgrt->outgroup_mismatch_distance = (uint16_t) reader.readVarUInt();
 
     // Minimum and maximum oligonucleotide length in the BGRTree.
-    bgrt->min_oligo_len = (uint16_t) readVarUInt(stream);
-    bgrt->max_oligo_len = (uint16_t) readVarUInt(stream);
+    bgrt->min_oligo_len = (uint16_t) reader.readVarUInt();
+    bgrt->max_oligo_len = (uint16_t) reader.readVarUInt();
 
     // Minimum and maximum G+C content used to filter the BGRTree.
     // Round two digits after the comma.
-    bgrt->min_gc = readType<float>(stream);
-    bgrt->max_gc = readType<float>(stream);
+    bgrt->min_gc = reader.readType<float>();
+    bgrt->max_gc = reader.readType<float>();
 
     // Minimum and maximum melting temp. used to filter the BGRTree.
     // Round two digits after the comma.
-    bgrt->min_temp = readType<float>(stream);
-    bgrt->max_temp = readType<float>(stream);
+    bgrt->min_temp = reader.readType<float>();
+    bgrt->max_temp = reader.readType<float>();
 
     // A comment that can be added to the BGRTree file.
-    bgrt->comment = readString(stream);
+    bgrt->comment = reader.readString();
 
     return bgrt;
 }
 
 /*!
- * Read a BGRT from an input stream.
+ * Read a NameMap from an input stream.
  */
-BgrTree *readBGRTStream(NameMap *map, std::istream &stream) {
-    // Read the BGRTheader from stream and fetch the newly created BGRTree.
-    BgrTree *bgrt = readBGRTHeader(stream);
-    if (!bgrt)
-        return NULL;
-
-    // Read NameMap size
+void readNameMap(NameMap *map, BlockReader &reader) {
+    // Read NameMap size (each name takes at least one byte)
     map->clear();
-    uint32_t map_size = (uint32_t) readVarUInt(stream);
+    uint32_t map_size = (uint32_t) reader.readVarUInt();
+    if (!reader.available(map_size))
+        return;
     map->setSize(map_size);
 
     // Read the name strings from the buffer
-    for (uint32_t id = 0; id < map_size; ++id) {
-        char *name = readString(stream);
-        map->set(id, name);
+    for (uint32_t id = 0; (id < map_size) && reader.good(); ++id) {
+        char *name = reader.readString();
+        if (name)
+            map->set(id, name);
         free(name);
     }
+}
+
+/*!
+ * Read a BGRT from a block reader (see readBGRTStream).
+ */
+static BgrTree *readBGRTBlocks(NameMap *map, BlockReader &reader,
+        unsigned int flags) {
+    // Read the BGRTheader from stream and fetch the newly created BGRTree.
+    BgrTree *bgrt = readBGRTHeader(reader, reader.left());
+    if (!bgrt)
+        return NULL;
+
+    // Read the ID <--> name mapping.
+    readNameMap(map, reader);
 
     // BGRTree: traverse through 1st level...
-    for (uint32_t i = 0; i < bgrt->num_species; ++i) {
+    for (uint32_t i = 0; (i < bgrt->num_species) && reader.good(); ++i) {
         // Fetch child nodes at position 'i'.
-        uint16_t num_children = (uint16_t) readVarUInt(stream);
+        uint16_t num_children = (uint16_t) reader.readVarUInt();
 
         // Read the child nodes from the stream...
         if (num_children)
-            bgrt->nodes[i] = readBGRTEntry(stream, bgrt->base4_compressed);
+            bgrt->nodes[i] = readBGRTEntry(reader, bgrt, flags,
+                    bgrt->num_species);
     }
 
+    // Stop at the end of a truncated file.
+    if (!reader.good()) {
+        BgrTree_destroy(bgrt);
+        return NULL;
+    }
     return bgrt;
 }
 
 /*!
- * Adler32 checksum (from an input stream).
- * Computation starts at the current(!) seekg-position.
- *
- * \param stream Input stream
- * \return Adler32 checksum
+ * Read a BGRT from an input stream.
  */
-uint32_t adler32(std::istream &stream) {
-    uint32_t s1 = 1;
-    uint32_t s2 = 0;
-    uint8_t c = stream.get();
-    while (stream.good()) {
-        s1 = (s1 + c) % 65521;
-        s2 = (s2 + s1) % 65521;
-        c = stream.get();
-    }
-    return (s2 << 16) | s1;
+BgrTree *readBGRTStream(NameMap *map, std::istream &stream,
+        unsigned int flags) {
+    BlockReader reader(stream.rdbuf());
+    return readBGRTBlocks(map, reader, flags);
 }
 
 /*!
  * BGRT File identifier
  * [0-3]  == 'BGRT'
  * [4]    == bgrt_file_version
- * [5-7]  == 0x00 (reserved)
+ * [5]    == format revision flags (stream format, see BGRT_STREAM_FLAGS)
+ * [6-7]  == 0x00 (reserved)
  */
 const char BGRT_FILE_ID[8] = { 0x42, 0x47, 0x52, 0x54, 0x02, 0x00, 0x00, 0x00 };
 
 /*!
- * Read a BGRT from a file.
+ * Position of the file version within the BGRT file identifier.
  */
-BgrTree *readBGRTFile(NameMap *map, const char *filename) {
-    // Open input file stream...
-    std::ifstream file;
-    file.open(filename, std::ios::in | std::ios::binary);
-    if (file.bad())
-        return NULL;
-
-    // Read the BGRT file identifier.
-    char header[8];
-    file.read(header, 8);
-    // Compare first 8 bytes, i.e. "do we have a BGRT file?"
-    if (strncmp(BGRT_FILE_ID, header, 8) != 0)
-        return NULL;
-
-    // Fetch the stored checksum...
-    uint32_t stored_checksum = readType<uint32_t>(file);
-    // ...and generate a file checksum from byte 12 on.
-    uint32_t checksum = adler32(file);
+#define BGRT_FILE_ID_VERSION 4
 
-    // If the checksums do not match, the file is possibly corrupted.
-    if (checksum != stored_checksum) {
-        file.close();
-        return NULL;
-    }
+/*!
+ * Position of the format revision flags within the BGRT file identifier.
+ */
+#define BGRT_FILE_ID_FLAGS 5
 
-    // Reset the read position and fetch the BGRT from the file.
-    file.clear();
-    file.seekg(12, std::ios_base::beg);
-    BgrTree *bgrt = readBGRTStream(map, file);
-    file.close();
-    return bgrt;
+/*!
+ * Check a file identifier for a stream file in a known revision of the
+ * stream format (BGRT_FILE_VERSION_STREAM or BGRT_FILE_VERSION_INDEXED).
+ */
+static bool isBGRTStreamId(const char *id) {
+    const unsigned int version = (unsigned char) id[BGRT_FILE_ID_VERSION];
+    const unsigned int flags = (unsigned char) id[BGRT_FILE_ID_FLAGS];
+    return (memcmp(BGRT_FILE_ID, id, BGRT_FILE_ID_VERSION) == 0)
+            && ((version == BGRT_FILE_VERSION_STREAM)
+                    || (version == BGRT_FILE_VERSION_INDEXED))
+            && !(flags & ~BGRT_STREAM_FLAGS)
+            && (memcmp(BGRT_FILE_ID + 6, id + 6, 2) == 0);
 }
 
 /*!
  * Write a BGRT header to an output stream
  */
-void writeBGRTHeader(BgrTree *bgrt, std::ostream &stream) {
+void writeBGRTHeader(BgrTree *bgrt, BlockWriter &writer) {
     // Write the BGRT encoding type
-    writeVarUInt(bgrt->base4_compressed, stream);
+    writer.writeVarUInt(bgrt->base4_compressed);
 
     // Write first level depth.
-    writeVarUInt(bgrt->num_species, stream);
+    writer.writeVarUInt(bgrt->num_species);
 
     // Number of ingroup mismatches, that were used to compute the BGRTree.
-    writeVarUInt(bgrt->ingroup_mismatch_distance, stream);
+    writer.writeVarUInt(bgrt->ingroup_mismatch_distance);
 
     // Mismatch distance that was used to compute the BGRTree.
-    writeVarUInt(bgrt->outgroup_mismatch_distance, stream);
+    writer.writeVarUInt(bgrt->outgroup_mismatch_distance);
 
     // Minimum and maximum oligonucleotide length in the BGRTree.
-    writeVarUInt(bgrt->min_oligo_len, stream);
-    writeVarUInt(bgrt->max_oligo_len, stream);
+    writer.writeVarUInt(bgrt->min_oligo_len);
+    writer.writeVarUInt(bgrt->max_oligo_len);
 
     // Minimum and maximum G+C content used to filter the BGRTree.
     // Round two digits after the comma.
-    writeType<float>(bgrt->min_gc, stream);
-    writeType<float>(bgrt->max_gc, stream);
+    writer.writeType<float>(bgrt->min_gc);
+    writer.writeType<float>(bgrt->max_gc);
 
     // Minimum and maximum melting temp. used to filter the BGRTree.
     // Round two digits after the comma.
-    writeType<float>(bgrt->min_temp, stream);
-    writeType<float>(bgrt->max_temp, stream);
+    writer.writeType<float>(bgrt->min_temp);
+    writer.writeType<float>(bgrt->max_temp);
 
     // A comment that can be added to the BGRTree file.
-    writeString(bgrt->comment, stream);
+    writer.writeString(bgrt->comment);
 }
 
 /*!
- * Write a BGRT to an output stream.
+ * Write a NameMap to an output stream.
  */
-bool writeBGRTStream(BgrTree *bgrt, NameMap *map, std::ostream &stream) {
-    assert(bgrt);
-
-    // Write bgrt file header
-    writeBGRTHeader(bgrt, stream);
-
+void writeNameMap(NameMap *map, BlockWriter &writer) {
     // Write NameMap size (4 bytes)
-    writeVarUInt(map->size(), stream);
+    writer.writeVarUInt(map->size());
 
     // Write NameMap
     for (uint32_t id = 0; id < map->size(); ++id) {
         // Fetch the name, and write it to the stream.
         std::string name = map->name(id);
-        writeString(name.c_str(), stream);
+        writer.writeString(name.c_str());
+    }
+}
+
+/*!
+ * Write the subtrees at position 'i' of the 1st level to a block writer.
+ */
+static void writeBGRTRoot(BgrTree *bgrt, uint32_t i, BlockWriter &writer,
+        unsigned int flags) {
+    // Count child nodes at position 'i'
+    // and write the result to the stream...
+    uint16_t num_children = 0;
+    BgrTreeNode *child = bgrt->nodes[i];
+    while (child) {
+        ++num_children;
+        child = child->next;
+    }
+    writer.writeVarUInt(num_children);
+
+    // Write the nodes to the stream...
+    if (num_children)
+        writeBGRTEntry(bgrt->nodes[i], writer, bgrt, flags);
+}
+
+#ifdef PTHREADS
+/*!
+ * Number of jobs per thread for the parallel serialisation, and the
+ * number of jobs per thread that may be buffered ahead of the one that
+ * is passed on next (bounds the memory needed for the job buffers).
+ */
+#define BGRT_WRITE_JOBS_PER_THREAD 16
+#define BGRT_WRITE_WINDOW_PER_THREAD 2
+
+/*!
+ * A contiguous range of roots, serialised into a memory buffer.
+ */
+struct BGRTWrite_job {
+    uint32_t begin;
+    uint32_t end;
+    BlockWriter *buffer;
+    bool done;
+};
+
+/*!
+ * Parameters for our pThread
+ */
+struct BGRTWrite_work {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    BgrTree *bgrt;
+    unsigned int flags;
+    uint64_t *index;
+    struct BGRTWrite_job *jobs;
+    unsigned long num_jobs;
+    unsigned long pos;
+    unsigned long window;
+    unsigned long passed;
+    bool failed;
+};
+
+/*!
+ * Serialise the root subtrees of a job. The root offsets are stored
+ * relative to the start of the job buffer.
+ */
+static bool writeBGRTRoots(const struct BGRTWrite_work *work,
+        struct BGRTWrite_job *job) {
+    job->buffer = new BlockWriter();
+
+    // The species scratch buffer of the tree must not be shared
+    // between the threads, i.e. each job uses a copy of the tree
+    // structure with a scratch buffer of its own.
+    BgrTree bgrt = *work->bgrt;
+    bgrt.species_buffer = NULL;
+    bgrt.species_buffer_size = 0;
+
+    for (uint32_t i = job->begin; i < job->end; ++i) {
+        if (work->index)
+            work->index[i] = job->buffer->written();
+        writeBGRTRoot(&bgrt, i, *job->buffer, work->flags);
+    }
+    free(bgrt.species_buffer);
+    return job->buffer->good();
+}
+
+/*!
+ * Serialise root subtrees using pThreads.
+ */
+static void *write_roots_pthread(void *ptr) {
+    struct BGRTWrite_work *work = (struct BGRTWrite_work*) ptr;
+
+    // The threads working loop...
+    while (1) {
+        // Fetch a job to process, as soon as it is within the window...
+        pthread_mutex_lock(&(work->mutex));
+        while (!work->failed && (work->pos < work->num_jobs)
+                && (work->pos >= work->passed + work->window))
+            pthread_cond_wait(&(work->cond), &(work->mutex));
+        if (work->pos == work->num_jobs || work->failed) {
+            // Stop, if no work is remaining...
+            pthread_mutex_unlock(&(work->mutex));
+            break;
+        }
+        unsigned long pos = work->pos++;
+        pthread_mutex_unlock(&(work->mutex));
+
+        bool success = writeBGRTRoots(work, work->jobs + pos);
+
+        pthread_mutex_lock(&(work->mutex));
+        work->jobs[pos].done = true;
+        if (!success)
+            work->failed = true;
+        pthread_cond_broadcast(&(work->cond));
+        pthread_mutex_unlock(&(work->mutex));
+    }
+    return NULL;
+}
+
+/*!
+ * Write the 1st level of a BGRT to a block writer using a pool of
+ * threads. The roots are split into contiguous jobs, which are
+ * serialised into memory buffers. The buffers are passed on to the
+ * writer (and thereby checksummed) in the order of the roots while
+ * the following jobs are processed, i.e. the written data is the same
+ * as if the roots were written sequentially.
+ *
+ * \param index set to the offsets of the roots, if not NULL
+ * 
+eturn false on error
+ */
+static bool writeBGRTRootsParallel(BgrTree *bgrt, BlockWriter &writer,
+        uint64_t *index, unsigned int flags) {
+    const uint32_t num_species = bgrt->num_species;
+    const unsigned int num_threads = num_processors();
+    if (num_species == 0)
+        return true;
+
+    // Split the roots into jobs, a few per thread.
+    unsigned long num_jobs = (unsigned long) num_threads
+            * BGRT_WRITE_JOBS_PER_THREAD;
+    if (num_jobs > num_species)
+        num_jobs = num_species;
+    struct BGRTWrite_job *jobs = (struct BGRTWrite_job *) calloc(num_jobs,
+            sizeof(struct BGRTWrite_job));
+    if (!jobs)
+        return false;
+    for (unsigned long j = 0; j < num_jobs; ++j) {
+        jobs[j].begin = (uint64_t) num_species * j / num_jobs;
+        jobs[j].end = (uint64_t) num_species * (j + 1) / num_jobs;
+    }
+
+    BGRTWrite_work work;
+    pthread_mutex_init(&(work.mutex), (pthread_mutexattr_t*) 0);
+    pthread_cond_init(&(work.cond), (pthread_condattr_t*) 0);
+    work.bgrt = bgrt;
+    work.flags = flags;
+    work.index = index;
+    work.jobs = jobs;
+    work.num_jobs = num_jobs;
+    work.pos = 0;
+    work.window = (unsigned long) num_threads * BGRT_WRITE_WINDOW_PER_THREAD;
+    work.passed = 0;
+    work.failed = false;
+
+    pool_init(num_threads);
+    for (unsigned int i = 0; i < num_threads; i++)
+        pool_run(write_roots_pthread, &work);
+
+    // Pass the job buffers on in the order of the roots.
+    for (unsigned long j = 0; j < num_jobs; ++j) {
+        pthread_mutex_lock(&(work.mutex));
+        while (!jobs[j].done && !work.failed)
+            pthread_cond_wait(&(work.cond), &(work.mutex));
+        bool failed = work.failed;
+        pthread_mutex_unlock(&(work.mutex));
+        if (failed)
+            break;
+
+        BlockWriter *buffer = jobs[j].buffer;
+        uint64_t offset = writer.written();
+        if (index)
+            for (uint32_t i = jobs[j].begin; i < jobs[j].end; ++i)
+                index[i] += offset;
+        writer.write(buffer->data(), buffer->written());
+        delete buffer;
+        jobs[j].buffer = NULL;
+
+        pthread_mutex_lock(&(work.mutex));
+        work.passed = j + 1;
+        if (!writer.good())
+            work.failed = true;
+        pthread_cond_broadcast(&(work.cond));
+        pthread_mutex_unlock(&(work.mutex));
+    }
+    pool_barrier();
+    pool_shutdown();
+
+    pthread_cond_destroy(&(work.cond));
+    pthread_mutex_destroy(&(work.mutex));
+    for (unsigned long j = 0; j < num_jobs; ++j)
+        delete jobs[j].buffer;
+    free(jobs);
+    return !work.failed;
+}
+#endif /* #ifdef PTHREADS */
+
+/*!
+ * Write a BGRT to a block writer (see writeBGRTStream).
+ */
+static bool writeBGRTBlocks(BgrTree *bgrt, NameMap *map, BlockWriter &writer,
+        unsigned int flags) {
+    assert(bgrt);
+
+    // The nodes of a frozen tree have been released.
+    if (bgrt->flat)
+        return false;
+
+    // Write bgrt file header
+    writeBGRTHeader(bgrt, writer);
+
+    // Write the ID <--> name mapping.
+    writeNameMap(map, writer);
+
+    // Offsets of the root subtrees (see BGRT_STREAM_ROOT_INDEX).
+    uint64_t *index = NULL;
+    if (flags & BGRT_STREAM_ROOT_INDEX) {
+        index = (uint64_t *) malloc(
+                ((size_t) bgrt->num_species + 1) * sizeof(uint64_t));
+        if (!index)
+            return false;
     }
 
     // BGRTree: traverse through 1st level...
-    for (uint32_t i = 0; i < bgrt->num_species; ++i) {
-        // Count child nodes at position 'i'
-        // and write the result to the stream...
-        uint16_t num_children = 0;
-        BgrTreeNode *child = bgrt->nodes[i];
-        while (child) {
-            ++num_children;
-            child = child->next;
+    bool written = false;
+#ifdef PTHREADS
+    if (num_processors() > 1) {
+        if (!writeBGRTRootsParallel(bgrt, writer, index, flags)) {
+            free(index);
+            return false;
         }
-        writeVarUInt(num_children, stream);
+        written = true;
+    }
+#endif
+    for (uint32_t i = 0; !written && (i < bgrt->num_species); ++i) {
+        if (index)
+            index[i] = writer.written();
+        writeBGRTRoot(bgrt, i, writer, flags);
+    }
 
-        // Write the nodes to the stream...
-        if (num_children)
-            writeBGRTEntry(bgrt->nodes[i], stream, bgrt->base4_compressed);
+    // Append the root index and its offset.
+    if (index) {
+        index[bgrt->num_species] = writer.written();
+        writer.write(index, ((size_t) bgrt->num_species + 1) * sizeof(uint64_t));
+        writer.writeType<uint64_t>(index[bgrt->num_species]);
+        free(index);
+    }
+    return writer.good();
+}
+
+/*!
+ * Write a BGRT to an output stream.
+ */
+bool writeBGRTStream(BgrTree *bgrt, NameMap *map, std::ostream &stream,
+        unsigned int flags) {
+    BlockWriter writer(stream.rdbuf());
+    bool retval = writeBGRTBlocks(bgrt, map, writer, flags);
+    return writer.flush() && retval;
+}
+
+/*!
+ * Alignment of the sections of a flat BGRT file (relative to the start
+ * of the file, which is page-aligned when it is mapped).
+ */
+#define BGRT_FILE_ALIGNMENT 64
+
+/*!
+ * Byte order mark of a flat BGRT file. The arrays are stored in the byte
+ * order of the writing machine and can only be mapped on machines with
+ * the same byte order.
+ */
+#define BGRT_FILE_BYTE_ORDER 0x01020304
+
+/*!
+ * Sections of a flat BGRT file. One per array of the flat layout, plus
+ * the entries of the signature pool.
+ */
+enum BgrTreeFileSection {
+    SECTION_ROOTS = 0,
+    SECTION_SUBTREE_END,
+    SECTION_PARENT,
+    SECTION_SPECIES_SIZE,
+    SECTION_SPECIES_FIRST,
+    SECTION_SPECIES_ENCODING,
+    SECTION_SPECIES_OFFSET,
+    SECTION_SPECIES_DATA,
+    SECTION_SIGNATURE_OFFSET,
+    SECTION_SIGNATURES,
+    SECTION_SUPPOSED_OUTGROUP_MATCHES,
+    SECTION_SUBTREE_MAX_SPECIES,
+    SECTION_SUBTREE_MIN_OUTGROUP,
+    SECTION_SIGNATURE_POOL,
+    NUM_SECTIONS
+};
+
+/*!
+ * Table of contents of a flat BGRT file, stored after the checksum
+ * (byte #12). It is followed by the metadata (the BGRT header and the
+ * name map, encoded like in the stream format) and the sections.
+ * All offsets are relative to the start of the file.
+ */
+struct BgrTreeFileTable {
+    uint32_t byte_order;
+    uint32_t num_nodes;
+    uint32_t max_depth;
+    uint32_t num_species;
+    uint32_t num_signatures;
+    uint32_t species_bytes;
+    uint32_t pool_size;
+    uint32_t pool_stride;
+    uint64_t metadata_offset;
+    uint64_t metadata_size;
+    uint64_t offset[NUM_SECTIONS];
+};
+
+/*!
+ * Computes the size of each section of a flat BGRT file.
+ */
+static void flatSectionSizes(const struct BgrTreeFileTable *table,
+        uint64_t *size) {
+    const uint64_t nodes = table->num_nodes;
+    size[SECTION_ROOTS] = (uint64_t) table->num_species * sizeof(uint32_t);
+    size[SECTION_SUBTREE_END] = nodes * sizeof(uint32_t);
+    size[SECTION_PARENT] = nodes * sizeof(uint32_t);
+    size[SECTION_SPECIES_SIZE] = nodes * sizeof(uint32_t);
+    size[SECTION_SPECIES_FIRST] = nodes * sizeof(uint32_t);
+    size[SECTION_SPECIES_ENCODING] = nodes * sizeof(uint8_t);
+    size[SECTION_SPECIES_OFFSET] = (nodes + 1) * sizeof(uint32_t);
+    size[SECTION_SPECIES_DATA] = table->species_bytes;
+    size[SECTION_SIGNATURE_OFFSET] = (nodes + 1) * sizeof(uint32_t);
+    size[SECTION_SIGNATURES] = (uint64_t) table->num_signatures
+            * sizeof(uint32_t);
+    size[SECTION_SUPPOSED_OUTGROUP_MATCHES] = (uint64_t) table->num_signatures
+            * sizeof(uint32_t);
+    size[SECTION_SUBTREE_MAX_SPECIES] = nodes * sizeof(uint32_t);
+    size[SECTION_SUBTREE_MIN_OUTGROUP] = nodes * sizeof(uint32_t);
+    size[SECTION_SIGNATURE_POOL] = (uint64_t) table->pool_size
+            * table->pool_stride;
+}
+
+/*!
+ * Validate the arrays of a mapped flat BGRT file. The checksum does not
+ * have to be verified, so the structure is checked in any case:
+ * - The nodes are stored in depth-first order, i.e. each node is within
+ *   the subtree of its parent, and the paths are not deeper than
+ *   'max_depth' (the traversal relies on both).
+ * - The roots, offsets and signature handles are within their arrays
+ *   (each offset is checked before the data it points to is read).
+ * - The species containers hold the stated number of species.
+ */
+static bool validateBGRTFlat(const struct BgrTreeFlat *flat,
+        const struct BgrTreeFileTable *table) {
+    const uint32_t num_nodes = flat->num_nodes;
+    if ((flat->max_depth > num_nodes) || (flat->species_offset[0] != 0)
+            || (flat->species_offset[num_nodes] != table->species_bytes)
+            || (flat->signature_offset[0] != 0)
+            || (flat->signature_offset[num_nodes] != table->num_signatures))
+        return false;
+
+    // The path from the root to the current node.
+    uint32_t *path = (uint32_t *) malloc(
+            ((size_t) flat->max_depth + 1) * sizeof(uint32_t));
+    bool valid = path != NULL;
+    unsigned int path_size = 0;
+    for (uint32_t n = 0; valid && (n < num_nodes); ++n) {
+        while ((path_size > 0)
+                && (flat->subtree_end[path[path_size - 1]] <= n))
+            --path_size;
+        const uint32_t parent = path_size ? path[path_size - 1]
+                : BGRT_FLAT_UNDEF;
+        const uint32_t parent_end = path_size ? flat->subtree_end[parent]
+                : num_nodes;
+        valid = (flat->parent[n] == parent) && (path_size < flat->max_depth)
+                && (flat->subtree_end[n] > n)
+                && (flat->subtree_end[n] <= parent_end)
+                && (flat->species_offset[n] <= flat->species_offset[n + 1])
+                && (flat->species_offset[n + 1] <= table->species_bytes)
+                && (flat->signature_offset[n]
+                        <= flat->signature_offset[n + 1])
+                && (flat->signature_offset[n + 1] <= table->num_signatures)
+                && SpeciesSet::valid(flat->species_encoding[n],
+                        flat->species_first[n], flat->species_size[n],
+                        flat->species_data + flat->species_offset[n],
+                        flat->species_offset[n + 1] - flat->species_offset[n],
+                        flat->num_species);
+        path[path_size++] = n;
+    }
+    free(path);
+
+    for (uint32_t s = 0; valid && (s < flat->num_species); ++s)
+        valid = (flat->roots[s] == BGRT_FLAT_UNDEF)
+                || ((flat->roots[s] < num_nodes)
+                        && (flat->parent[flat->roots[s]] == BGRT_FLAT_UNDEF));
+    for (uint32_t i = 0; valid && (i < table->num_signatures); ++i)
+        valid = flat->signatures[i] < table->pool_size;
+    return valid;
+}
+
+/*!
+ * Set up a BGRT from a mapped flat BGRT file. The table of contents has
+ * been validated. On success, the tree owns the file memory.
+ */
+static BgrTree *readBGRTFlat(NameMap *map, char *data, unsigned long size,
+        const struct BgrTreeFileTable *table) {
+    // Read the header and the name mapping.
+    BlockReader reader(data + table->metadata_offset, table->metadata_size);
+    BgrTree *bgrt = readBGRTHeader(reader, table->num_species);
+    if (!bgrt)
+        return NULL;
+    readNameMap(map, reader);
+    if (!reader.good() || (bgrt->num_species != table->num_species)) {
+        BgrTree_destroy(bgrt);
+        return NULL;
+    }
+
+    // The signatures are used in place.
+    if (!bgrt->signature_pool->attach(
+            data + table->offset[SECTION_SIGNATURE_POOL], table->pool_size,
+            table->pool_stride)) {
+        BgrTree_destroy(bgrt);
+        return NULL;
+    }
+
+    struct BgrTreeFlat *flat = (BgrTreeFlat *) calloc(1,
+            sizeof(struct BgrTreeFlat));
+    if (!flat) {
+        BgrTree_destroy(bgrt);
+        return NULL;
+    }
+    const uint64_t *offset = table->offset;
+    flat->num_nodes = table->num_nodes;
+    flat->max_depth = table->max_depth;
+    flat->num_species = table->num_species;
+    flat->roots = (uint32_t *) (data + offset[SECTION_ROOTS]);
+    flat->subtree_end = (uint32_t *) (data + offset[SECTION_SUBTREE_END]);
+    flat->parent = (uint32_t *) (data + offset[SECTION_PARENT]);
+    flat->species_size = (uint32_t *) (data + offset[SECTION_SPECIES_SIZE]);
+    flat->species_first = (uint32_t *) (data + offset[SECTION_SPECIES_FIRST]);
+    flat->species_encoding = (uint8_t *) (data
+            + offset[SECTION_SPECIES_ENCODING]);
+    flat->species_offset = (uint32_t *) (data
+            + offset[SECTION_SPECIES_OFFSET]);
+    flat->species_data = (unsigned char *) (data
+            + offset[SECTION_SPECIES_DATA]);
+    flat->signature_offset = (uint32_t *) (data
+            + offset[SECTION_SIGNATURE_OFFSET]);
+    flat->signatures = (uint32_t *) (data + offset[SECTION_SIGNATURES]);
+    flat->supposed_outgroup_matches = (uint32_t *) (data
+            + offset[SECTION_SUPPOSED_OUTGROUP_MATCHES]);
+    flat->subtree_max_species = (uint32_t *) (data
+            + offset[SECTION_SUBTREE_MAX_SPECIES]);
+    flat->subtree_min_outgroup = (uint32_t *) (data
+            + offset[SECTION_SUBTREE_MIN_OUTGROUP]);
+
+    if (!validateBGRTFlat(flat, table)) {
+        free(flat);
+        BgrTree_destroy(bgrt);
+        return NULL;
+    }
+
+    flat->file_data = data;
+    flat->file_size = size;
+    bgrt->flat = flat;
+    return bgrt;
+}
+
+/*!
+ * Read a BGRT from a flat BGRT file. The file is memory mapped, the
+ * returned tree is frozen. If 'verify' is set, the CRC32C checksum is
+ * computed over the mapped file (which reads the whole file), otherwise
+ * only the parts of the file that are accessed are read.
+ */
+static BgrTree *readBGRTFileFlat(NameMap *map, const char *filename,
+        bool verify) {
+    unsigned long size = 0;
+    char *data = (char *) BgrTreeFlat_map(filename, &size);
+    if (!data)
+        return NULL;
+
+    // Validate the identifier, checksum and table of contents.
+    struct BgrTreeFileTable table;
+    bool valid = size >= 12 + sizeof(table);
+    if (valid) {
+        uint32_t stored_checksum;
+        memcpy(&stored_checksum, data + 8, sizeof(uint32_t));
+        memcpy(&table, data + 12, sizeof(table));
+        valid = (memcmp(data, BGRT_FILE_ID, BGRT_FILE_ID_VERSION) == 0)
+                && (data[BGRT_FILE_ID_VERSION] == BGRT_FILE_VERSION_FLAT)
+                && (table.byte_order == BGRT_FILE_BYTE_ORDER)
+                && (!verify
+                        || (crc32c(0, (const unsigned char *) data + 12,
+                                size - 12) == stored_checksum))
+                && (table.metadata_offset <= size)
+                && (table.metadata_size <= size - table.metadata_offset);
+    }
+    if (valid) {
+        uint64_t section_size[NUM_SECTIONS];
+        flatSectionSizes(&table, section_size);
+        for (unsigned int i = 0; valid && (i < NUM_SECTIONS); ++i)
+            valid = (table.offset[i] % BGRT_FILE_ALIGNMENT == 0)
+                    && (table.offset[i] <= size)
+                    && (section_size[i] <= size - table.offset[i]);
+    }
+
+    BgrTree *bgrt = valid ? readBGRTFlat(map, data, size, &table) : NULL;
+    if (!bgrt)
+        BgrTreeFlat_unmap(data, size);
+    return bgrt;
+}
+
+/*!
+ * Pad an output stream with zeros up to the next aligned position.
+ *
+ * \param writer output stream
+ * \param pos current position within the file
+ * \return The (aligned) position.
+ */
+static uint64_t alignStream(BlockWriter &writer, uint64_t pos) {
+    static const char zeros[BGRT_FILE_ALIGNMENT] = { 0 };
+    uint64_t padding = (BGRT_FILE_ALIGNMENT - pos % BGRT_FILE_ALIGNMENT)
+            % BGRT_FILE_ALIGNMENT;
+    writer.write(zeros, padding);
+    return pos + padding;
+}
+
+/*!
+ * Write a BGRT to a flat BGRT file. Mutable trees are converted into the
+ * flat layout temporarily.
+ *
+ * The metadata is encoded first, so that all offsets are known before
+ * the file is written. The file is then written in one pass, the CRC32C
+ * checksum is computed on the written blocks.
+ */
+static bool writeBGRTFileFlat(BgrTree *bgrt, NameMap *map,
+        const char *filename) {
+    struct BgrTreeFlat *tmp = NULL;
+    const struct BgrTreeFlat *flat = bgrt->flat;
+    if (!flat) {
+        flat = tmp = BgrTreeFlat_create(bgrt);
+        if (!flat)
+            return false;
+    }
+
+    std::ofstream file;
+    file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        BgrTreeFlat_destroy(tmp);
+        return false;
+    }
+
+    const SignaturePool *pool = bgrt->signature_pool;
+    struct BgrTreeFileTable table;
+    memset(&table, 0, sizeof(table));
+    table.byte_order = BGRT_FILE_BYTE_ORDER;
+    table.num_nodes = flat->num_nodes;
+    table.max_depth = flat->max_depth;
+    table.num_species = flat->num_species;
+    table.num_signatures = flat->signature_offset[flat->num_nodes];
+    table.species_bytes = flat->species_offset[flat->num_nodes];
+    table.pool_size = pool->size();
+    table.pool_stride = pool->stride();
+
+    // Metadata: BGRT header and name mapping.
+    BlockWriter metadata;
+    writeBGRTHeader(bgrt, metadata);
+    writeNameMap(map, metadata);
+    table.metadata_offset = 12 + sizeof(table);
+    table.metadata_size = metadata.written();
+
+    // Sections.
+    const void *section[NUM_SECTIONS];
+    section[SECTION_ROOTS] = flat->roots;
+    section[SECTION_SUBTREE_END] = flat->subtree_end;
+    section[SECTION_PARENT] = flat->parent;
+    section[SECTION_SPECIES_SIZE] = flat->species_size;
+    section[SECTION_SPECIES_FIRST] = flat->species_first;
+    section[SECTION_SPECIES_ENCODING] = flat->species_encoding;
+    section[SECTION_SPECIES_OFFSET] = flat->species_offset;
+    section[SECTION_SPECIES_DATA] = flat->species_data;
+    section[SECTION_SIGNATURE_OFFSET] = flat->signature_offset;
+    section[SECTION_SIGNATURES] = flat->signatures;
+    section[SECTION_SUPPOSED_OUTGROUP_MATCHES] =
+            flat->supposed_outgroup_matches;
+    section[SECTION_SUBTREE_MAX_SPECIES] = flat->subtree_max_species;
+    section[SECTION_SUBTREE_MIN_OUTGROUP] = flat->subtree_min_outgroup;
+    section[SECTION_SIGNATURE_POOL] = pool->data();
+    uint64_t section_size[NUM_SECTIONS];
+    flatSectionSizes(&table, section_size);
+    uint64_t pos = table.metadata_offset + table.metadata_size;
+    for (unsigned int i = 0; i < NUM_SECTIONS; ++i) {
+        pos += (BGRT_FILE_ALIGNMENT - pos % BGRT_FILE_ALIGNMENT)
+                % BGRT_FILE_ALIGNMENT;
+        table.offset[i] = pos;
+        pos += section_size[i];
+    }
+
+    // File identifier and a wildcard for the checksum.
+    char id[8];
+    memcpy(id, BGRT_FILE_ID, 8);
+    id[BGRT_FILE_ID_VERSION] = BGRT_FILE_VERSION_FLAT;
+    file.write(id, 8);
+    writeType<uint32_t>(0, file);
+
+    // Table of contents, metadata and sections (checksummed).
+    BlockWriter writer(file.rdbuf(), CHECKSUM_CRC32C);
+    writer.write(&table, sizeof(table));
+    writer.write(metadata.data(), metadata.written());
+    for (unsigned int i = 0; i < NUM_SECTIONS; ++i) {
+        uint64_t offset = alignStream(writer, 12 + writer.written());
+        assert(offset == table.offset[i]);
+        (void) offset;
+        if (section_size[i])
+            writer.write(section[i], section_size[i]);
+    }
+    bool retval = writer.flush() && metadata.good();
+    BgrTreeFlat_destroy(tmp);
+
+    // Write the checksum.
+    file.seekp(8, std::ios_base::beg);
+    writeType<uint32_t>(writer.checksum(), file);
+
+    retval = retval && file.good();
+    file.close();
+    return retval;
+}
+
+/*!
+ * A memory mapped stream file with a root index (see
+ * BGRT_STREAM_ROOT_INDEX).
+ */
+struct BgrTreeIndexedFile {
+    /*!
+     * File memory (see BgrTreeFlat_map) and the stream after the file
+     * identifier and checksum.
+     */
+    char *data;
+    unsigned long size;
+    const char *stream;
+
+    /*!
+     * Offsets of the root subtrees within the stream (num_species + 1
+     * entries, the last one is the end of the last subtree).
+     */
+    uint64_t *index;
+
+    /*!
+     * Revision of the stream format (see BGRT_STREAM_FLAGS).
+     */
+    unsigned int flags;
+};
+
+/*!
+ * Release an indexed file (see mapBGRTFileIndexed).
+ */
+static void unmapBGRTFileIndexed(struct BgrTreeIndexedFile *file) {
+    free(file->index);
+    if (file->data)
+        BgrTreeFlat_unmap(file->data, file->size);
+    memset(file, 0, sizeof(struct BgrTreeIndexedFile));
+}
+
+/*!
+ * Map a stream file with a root index and read its header, name map and
+ * index. The root subtrees are not read (see readBGRTRoot) and the
+ * checksum is not verified.
+ *
+ * \return The tree without nodes, NULL on error.
+ */
+static BgrTree *mapBGRTFileIndexed(NameMap *map, const char *filename,
+        struct BgrTreeIndexedFile *file) {
+    memset(file, 0, sizeof(struct BgrTreeIndexedFile));
+    file->data = (char *) BgrTreeFlat_map(filename, &file->size);
+    if (!file->data)
+        return NULL;
+
+    // Validate the file identifier (stream format with a root index).
+    // The stream ends with the offset of the root index.
+    const char *data = file->data;
+    const unsigned int flags = (file->size >= 20) ?
+            (unsigned char) data[BGRT_FILE_ID_FLAGS] : 0;
+    file->flags = flags;
+    file->stream = data + 12;
+    const uint64_t stream_size = (file->size >= 20) ? file->size - 20 : 0;
+    uint64_t index_offset = 0;
+    if (stream_size)
+        memcpy(&index_offset, file->stream + stream_size, sizeof(uint64_t));
+    if ((stream_size == 0) || !isBGRTStreamId(data)
+            || !(flags & BGRT_STREAM_ROOT_INDEX)
+            || (index_offset > stream_size)) {
+        unmapBGRTFileIndexed(file);
+        return NULL;
+    }
+
+    // Read the header and name map.
+    BlockReader reader(file->stream, index_offset);
+    BgrTree *bgrt = readBGRTHeader(reader,
+            (stream_size - index_offset) / sizeof(uint64_t));
+    if (bgrt)
+        readNameMap(map, reader);
+    const uint32_t num_species = bgrt ? bgrt->num_species : 0;
+    const uint64_t roots_offset = index_offset - reader.buffered();
+    bool valid = bgrt && reader.good()
+            && (stream_size - index_offset
+                    == ((uint64_t) num_species + 1) * sizeof(uint64_t));
+
+    // Fetch and validate the index (the subtrees have to follow each
+    // other without gaps).
+    if (valid) {
+        file->index = (uint64_t *) malloc(
+                ((size_t) num_species + 1) * sizeof(uint64_t));
+        valid = file->index != NULL;
+    }
+    if (valid) {
+        const uint64_t *index = file->index;
+        memcpy(file->index, file->stream + index_offset,
+                ((size_t) num_species + 1) * sizeof(uint64_t));
+        valid = (index[0] == roots_offset)
+                && (index[num_species] == index_offset);
+        for (uint32_t i = 0; valid && (i < num_species); ++i)
+            valid = index[i] <= index[i + 1];
     }
+
+    if (!valid) {
+        BgrTree_destroy(bgrt);
+        unmapBGRTFileIndexed(file);
+        return NULL;
+    }
+    return bgrt;
+}
+
+/*!
+ * Read the subtree of root 'i' of an indexed file into 'bgrt' (its
+ * arenas and signature pool). The subtree has to fill its indexed range
+ * exactly.
+ *
+ * \param node set to the root node (NULL, if the root is empty)
+ * \return false on error
+ */
+static bool readBGRTRoot(const struct BgrTreeIndexedFile *file, BgrTree *bgrt,
+        uint32_t i, BgrTreeNode **node) {
+    BlockReader reader(file->stream + file->index[i],
+            file->index[i + 1] - file->index[i]);
+    uint16_t num_children = (uint16_t) reader.readVarUInt();
+    *node = num_children ? readBGRTEntry(reader, bgrt, file->flags,
+            bgrt->num_species) : NULL;
+    return reader.good() && !reader.buffered();
+}
+
+/*!
+ * Compute the checksum of an indexed file and compare it with the
+ * stored one.
+ */
+static bool verifyBGRTFileIndexed(const struct BgrTreeIndexedFile *file) {
+    uint32_t stored_checksum;
+    memcpy(&stored_checksum, file->data + 8, sizeof(uint32_t));
+    return adler32(1, (const unsigned char *) file->stream, file->size - 12)
+            == stored_checksum;
+}
+
+#ifdef PTHREADS
+/*!
+ * A contiguous range of roots of an indexed stream file. The subtrees
+ * are decoded into a tree of their own (i.e. into separate arenas and
+ * a separate signature pool) and merged afterwards.
+ */
+struct BGRTLoad_job {
+    uint32_t begin;
+    uint32_t end;
+    BgrTree *bgrt;
+};
+
+/*!
+ * Parameters for our pThread
+ */
+struct BGRTLoad_work {
+    pthread_mutex_t mutex;
+    const struct BgrTreeIndexedFile *file;
+    BgrTreeNode **nodes;
+    uint32_t num_species;
+    bool base4_compressed;
+    struct BGRTLoad_job *jobs;
+    unsigned long num_jobs;
+    unsigned long pos;
+    bool failed;
+};
+
+/*!
+ * Decode the root subtrees of a job. The tree of the job has the number
+ * of species of the file, so that the species sets are checked against
+ * it (see readSpeciesSet).
+ */
+static bool readBGRTRoots(const struct BGRTLoad_work *work,
+        struct BGRTLoad_job *job) {
+    job->bgrt = BgrTree_create(work->num_species, work->base4_compressed);
+    if (!job->bgrt)
+        return false;
+    for (uint32_t i = job->begin; i < job->end; ++i)
+        if (!readBGRTRoot(work->file, job->bgrt, i, work->nodes + i))
+            return false;
     return true;
 }
 
 /*!
- * Write a BGRT to a file.
+ * Decode root subtrees using pThreads.
+ */
+static void *read_roots_pthread(void *ptr) {
+    struct BGRTLoad_work *work = (struct BGRTLoad_work*) ptr;
+
+    // The threads working loop...
+    while (1) {
+        // Fetch a job to process...
+        pthread_mutex_lock(&(work->mutex));
+        if (work->pos == work->num_jobs || work->failed) {
+            // Stop, if no work is remaining...
+            pthread_mutex_unlock(&(work->mutex));
+            break;
+        }
+        unsigned long pos = work->pos++;
+        pthread_mutex_unlock(&(work->mutex));
+
+        if (!readBGRTRoots(work, work->jobs + pos)) {
+            pthread_mutex_lock(&(work->mutex));
+            work->failed = true;
+            pthread_mutex_unlock(&(work->mutex));
+        }
+    }
+    return NULL;
+}
+
+/*!
+ * Add an offset to the signature handles of a subtree.
  */
-bool writeBGRTFile(BgrTree *bgrt, NameMap *map, const char *filename) {
-    // Open I/O file stream and write the BGRT into it...
-    std::fstream file;
-    file.open(filename,
-            std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
-    if (file.bad()) {
+static void offsetSignatures(BgrTreeNode *node, uint32_t offset) {
+    for (; node; node = node->next) {
+        UnorderedIntSet *set = node->signatures;
+        if (set) {
+            unsigned int *handles = set->val_ptr();
+            for (unsigned int i = 0; i < set->size(); ++i)
+                handles[i] += offset;
+        }
+        offsetSignatures(node->children, offset);
+    }
+}
+
+/*!
+ * Read a BGRT from a stream file with a root index (see
+ * BGRT_STREAM_ROOT_INDEX). The file is memory mapped, the root subtrees
+ * are split into byte-balanced jobs and decoded by a pool of threads.
+ * The per-job arenas and signature pools are merged in the order of the
+ * roots, i.e. the tree is the same as the one read sequentially. If
+ * 'verify' is set, the checksum is verified before the subtrees are
+ * decoded.
+ *
+ * \return NULL on error. 'fallback' is set if the file could not be
+ *         mapped or its index is invalid. It has to be read
+ *         sequentially then.
+ */
+static BgrTree *readBGRTFileIndexed(NameMap *map, const char *filename,
+        bool verify, bool *fallback) {
+    struct BgrTreeIndexedFile file;
+    BgrTree *bgrt = mapBGRTFileIndexed(map, filename, &file);
+    *fallback = !bgrt;
+    if (!bgrt)
+        return NULL;
+
+    // Verify the checksum before any subtree is decoded (like
+    // BgrTreeLazy_open), so that corrupted files are never parsed.
+    bool valid = !verify || verifyBGRTFileIndexed(&file);
+
+    // Split the roots into byte-balanced jobs, a few per thread.
+    const uint32_t num_species = bgrt->num_species;
+    const uint64_t *index = file.index;
+    struct BGRTLoad_job *jobs = NULL;
+    unsigned long num_jobs = 0;
+    const unsigned int num_threads = num_processors();
+    if (valid && (num_species > 0)) {
+        unsigned long max_jobs = (unsigned long) num_threads * 8;
+        if (max_jobs > num_species)
+            max_jobs = num_species;
+        jobs = (struct BGRTLoad_job *) calloc(max_jobs,
+                sizeof(struct BGRTLoad_job));
+        valid = jobs != NULL;
+        const uint64_t total = index[num_species] - index[0];
+        uint32_t begin = 0;
+        for (unsigned long j = 0; valid && (j < max_jobs); ++j) {
+            uint64_t limit = index[0] + total / max_jobs * (j + 1);
+            uint32_t end = begin + 1;
+            if (j + 1 == max_jobs)
+                end = num_species;
+            else
+                while ((end < num_species) && (index[end] < limit))
+                    ++end;
+            jobs[num_jobs].begin = begin;
+            jobs[num_jobs].end = end;
+            ++num_jobs;
+            begin = end;
+            if (begin == num_species)
+                break;
+        }
+    }
+
+    // Decode the subtrees in parallel.
+    if (valid) {
+        BGRTLoad_work work;
+        pthread_mutex_init(&(work.mutex), (pthread_mutexattr_t*) 0);
+        work.file = &file;
+        work.nodes = bgrt->nodes;
+        work.num_species = num_species;
+        work.base4_compressed = bgrt->base4_compressed;
+        work.jobs = jobs;
+        work.num_jobs = num_jobs;
+        work.pos = 0;
+        work.failed = false;
+
+        pool_init(num_threads);
+        for (unsigned int i = 0; i < num_threads; i++)
+            pool_run(read_roots_pthread, &work);
+        pool_barrier();
+        pool_shutdown();
+
+        pthread_mutex_destroy(&(work.mutex));
+        valid = !work.failed;
+    }
+
+    // Merge the jobs in the order of the roots. The nodes are taken over
+    // by the arenas of the tree in any case, so that they are released
+    // together with the tree.
+    for (unsigned long j = 0; j < num_jobs; ++j) {
+        BgrTree *part = jobs[j].bgrt;
+        if (!part)
+            continue;
+        if (valid) {
+            uint32_t offset = bgrt->signature_pool->merge(
+                    part->signature_pool);
+            valid = offset != SIGNATURE_HANDLE_UNDEF;
+            if (valid && offset)
+                for (uint32_t i = jobs[j].begin; i < jobs[j].end; ++i)
+                    offsetSignatures(bgrt->nodes[i], offset);
+        }
+        bgrt->node_arena->adopt(part->node_arena);
+        bgrt->uintset_arena->adopt(part->uintset_arena);
+        BgrTree_destroy(part);
+    }
+    free(jobs);
+    unmapBGRTFileIndexed(&file);
+
+    if (!valid) {
+        BgrTree_destroy(bgrt);
+        return NULL;
+    }
+    return bgrt;
+}
+#endif /* #ifdef PTHREADS */
+
+/*!
+ * BGRT that is read on demand from a stream file with a root index.
+ */
+struct BgrTreeLazy {
+    /*!
+     * The mapped file.
+     */
+    struct BgrTreeIndexedFile file;
+
+    /*!
+     * Mutable tree with the loaded root subtrees.
+     */
+    BgrTree *cache;
+
+    /*!
+     * Frozen tree with the root subtrees of the last query. It shares
+     * the signature pool of the cache, the nodes are only available in
+     * the flat layout.
+     */
+    BgrTree *view;
+
+    /*!
+     * Last use of each loaded root (0, if the root is not loaded), the
+     * (encoded) size of the loaded subtrees and its limit.
+     */
+    uint64_t *last_use;
+    uint64_t clock;
+    uint64_t loaded;
+    uint64_t limit;
+};
+
+/*!
+ * Last use and (encoded) size of a loaded root (see BgrTreeLazy_load).
+ */
+struct BgrTreeLazyUse {
+    uint64_t use;
+    uint64_t size;
+};
+
+/*!
+ * Orders roots by their last use, most recent first.
+ */
+static bool compareLazyUse(const BgrTreeLazyUse &a, const BgrTreeLazyUse &b) {
+    return a.use > b.use;
+}
+
+/*!
+ * Copy the header values (see readBGRTHeader) of a tree. The comment is
+ * not copied.
+ */
+static void copyBGRTHeader(BgrTree *dest, const BgrTree *src) {
+    dest->base4_compressed = src->base4_compressed;
+    dest->ingroup_mismatch_distance = src->ingroup_mismatch_distance;
+    dest->outgroup_mismatch_distance = src->outgroup_mismatch_distance;
+    dest->min_oligo_len = src->min_oligo_len;
+    dest->max_oligo_len = src->max_oligo_len;
+    dest->min_gc = src->min_gc;
+    dest->max_gc = src->max_gc;
+    dest->min_temp = src->min_temp;
+    dest->max_temp = src->max_temp;
+}
+
+/*!
+ * Release the flat layout of the last query.
+ */
+static void lazy_release_view(struct BgrTreeLazy *lazy) {
+    BgrTreeFlat_destroy(lazy->view->flat);
+    lazy->view->flat = NULL;
+}
+
+/*!
+ * Replace the cache by a new tree that holds the roots with a 'last_use'
+ * of at least 'min_use'. Releases the memory of the evicted subtrees
+ * (including their signatures).
+ */
+static bool lazy_rebuild(struct BgrTreeLazy *lazy, uint64_t min_use) {
+    BgrTree *cache = lazy->cache;
+    BgrTree *tree = BgrTree_create(cache->num_species,
+            cache->base4_compressed);
+    if (!tree)
+        return false;
+    copyBGRTHeader(tree, cache);
+    tree->comment = cache->comment;
+    cache->comment = NULL;
+    lazy->loaded = 0;
+    bool success = true;
+    for (uint32_t i = 0; i < tree->num_species; ++i) {
+        if (lazy->last_use[i] < min_use) {
+            lazy->last_use[i] = 0;
+            continue;
+        }
+        if (success)
+            success = readBGRTRoot(&lazy->file, tree, i, tree->nodes + i);
+        if (success)
+            lazy->loaded += lazy->file.index[i + 1] - lazy->file.index[i];
+        else
+            lazy->last_use[i] = 0;
+    }
+    BgrTree_destroy(cache);
+    lazy->cache = tree;
+    lazy->view->signature_pool = tree->signature_pool;
+    return success;
+}
+
+/*!
+ * Open a BGRT file for on-demand reading.
+ */
+struct BgrTreeLazy *BgrTreeLazy_open(NameMap *map, const char *filename,
+        bool verify, unsigned long limit) {
+    struct BgrTreeLazy *lazy = (struct BgrTreeLazy *) calloc(1,
+            sizeof(struct BgrTreeLazy));
+    if (!lazy)
+        return NULL;
+    lazy->limit = limit;
+    lazy->cache = mapBGRTFileIndexed(map, filename, &lazy->file);
+    bool success = lazy->cache && (!verify || verifyBGRTFileIndexed(&lazy->file));
+
+    // The view takes over the header of the tree, but has no arenas.
+    if (success) {
+        const BgrTree *cache = lazy->cache;
+        lazy->view = (BgrTree *) calloc(1, sizeof(struct BgrTree));
+        lazy->last_use = (uint64_t *) calloc(
+                (size_t) cache->num_species + 1, sizeof(uint64_t));
+        success = lazy->view && lazy->last_use;
+    }
+    if (success) {
+        BgrTree *view = lazy->view;
+        const BgrTree *cache = lazy->cache;
+        view->nodes = (BgrTreeNode **) calloc((size_t) cache->num_species + 1,
+                sizeof(struct BgrTreeNode*));
+        success = view->nodes != NULL;
+        view->num_species = cache->num_species;
+        copyBGRTHeader(view, cache);
+        view->comment = cache->comment;
+        view->signature_pool = cache->signature_pool;
+    }
+
+    if (!success) {
+        BgrTreeLazy_close(lazy);
+        return NULL;
+    }
+    return lazy;
+}
+
+/*!
+ * Close a BGRT file that was opened for on-demand reading.
+ */
+void BgrTreeLazy_close(struct BgrTreeLazy *lazy) {
+    if (!lazy)
+        return;
+    if (lazy->view) {
+        lazy_release_view(lazy);
+        free(lazy->view->nodes);
+        free(lazy->view);
+    }
+    BgrTree_destroy(lazy->cache);
+    free(lazy->last_use);
+    unmapBGRTFileIndexed(&lazy->file);
+    free(lazy);
+}
+
+/*!
+ * The tree with the header values (and the loaded root subtrees) of a
+ * BGRT file that was opened for on-demand reading.
+ */
+struct BgrTree *BgrTreeLazy_tree(struct BgrTreeLazy *lazy) {
+    return lazy->view;
+}
+
+/*!
+ * Load the root subtrees of the given species.
+ */
+struct BgrTree *BgrTreeLazy_load(struct BgrTreeLazy *lazy,
+        const unsigned int *ids, unsigned int num_ids) {
+    lazy_release_view(lazy);
+    BgrTree *view = lazy->view;
+    const uint32_t num_species = view->num_species;
+    const uint64_t *index = lazy->file.index;
+
+    // Mark the loaded roots as used and sum up the missing subtrees.
+    const uint64_t now = ++lazy->clock;
+    uint64_t missing = 0;
+    const unsigned int n = ids ? num_ids : num_species;
+    for (unsigned int k = 0; k < n; ++k) {
+        unsigned int i = ids ? ids[k] : k;
+        if (i >= num_species)
+            continue;
+        if (lazy->last_use[i])
+            lazy->last_use[i] = now;
+        else
+            missing += index[i + 1] - index[i];
+    }
+
+    // Evict the least recently used roots, if the limit would be
+    // exceeded: The cache is rebuilt with the most recently used roots
+    // up to half of the limit (and the requested roots).
+    if (lazy->limit && missing && (lazy->loaded + missing > lazy->limit)) {
+        struct BgrTreeLazyUse *uses = (struct BgrTreeLazyUse *) malloc(
+                (size_t) num_species * sizeof(struct BgrTreeLazyUse));
+        if (!uses)
+            return NULL;
+        uint32_t num_uses = 0;
+        for (uint32_t i = 0; i < num_species; ++i) {
+            if (lazy->last_use[i] && (lazy->last_use[i] < now)) {
+                uses[num_uses].use = lazy->last_use[i];
+                uses[num_uses].size = index[i + 1] - index[i];
+                ++num_uses;
+            }
+        }
+        std::sort(uses, uses + num_uses, compareLazyUse);
+        uint64_t min_use = now;
+        uint64_t kept = 0;
+        for (uint32_t u = 0; u < num_uses; ++u) {
+            kept += uses[u].size;
+            if (kept > lazy->limit / 2)
+                break;
+            min_use = uses[u].use;
+        }
+        free(uses);
+        if (!lazy_rebuild(lazy, min_use))
+            return NULL;
+    }
+
+    // Load the missing subtrees.
+    BgrTree *cache = lazy->cache;
+    for (unsigned int k = 0; k < n; ++k) {
+        unsigned int i = ids ? ids[k] : k;
+        if ((i >= num_species) || lazy->last_use[i])
+            continue;
+        if (!readBGRTRoot(&lazy->file, cache, i, cache->nodes + i)) {
+            // The nodes read so far are released with the cache.
+            cache->nodes[i] = NULL;
+            return NULL;
+        }
+        lazy->last_use[i] = now;
+        lazy->loaded += index[i + 1] - index[i];
+    }
+
+    // Create the flat layout of the requested roots.
+    for (unsigned int k = 0; k < n; ++k) {
+        unsigned int i = ids ? ids[k] : k;
+        if (i < num_species)
+            view->nodes[i] = cache->nodes[i];
+    }
+    view->flat = BgrTreeFlat_create(view);
+    for (unsigned int k = 0; k < n; ++k) {
+        unsigned int i = ids ? ids[k] : k;
+        if (i < num_species)
+            view->nodes[i] = NULL;
+    }
+    return view->flat ? view : NULL;
+}
+
+/*!
+ * Read a BGRT from a file. Files in the flat format are memory mapped,
+ * the returned tree is frozen then (see BgrTree_thaw).
+ *
+ * Files in the stream format are read only once: The checksum is
+ * computed in blocks while the tree is parsed and compared at the end.
+ * Until then, the parser checks each size and count against the rest
+ * of the file and stops at the first inconsistency (see readBGRTEntry).
+ * If 'verify' is false, the checksum is not computed at all. In PTHREADS
+ * builds, stream files with a root index are memory mapped and decoded
+ * in parallel (see readBGRTFileIndexed).
+ */
+BgrTree *readBGRTFile(NameMap *map, const char *filename, bool verify) {
+    // Open input file stream...
+    std::ifstream file;
+    file.open(filename, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return NULL;
+
+    // Read the BGRT file identifier.
+    char header[8];
+    file.read(header, 8);
+    if (file.good() && (memcmp(BGRT_FILE_ID, header, BGRT_FILE_ID_VERSION) == 0)
+            && (header[BGRT_FILE_ID_VERSION] == BGRT_FILE_VERSION_FLAT)) {
+        file.close();
+        return readBGRTFileFlat(map, filename, verify);
+    }
+    // Compare first 8 bytes, i.e. "do we have a BGRT file?" (in a
+    // known revision of the stream format).
+    const unsigned int flags = (unsigned char) header[BGRT_FILE_ID_FLAGS];
+    if (!file.good() || !isBGRTStreamId(header))
+        return NULL;
+
+#ifdef PTHREADS
+    // Decode indexed files in parallel.
+    if ((flags & BGRT_STREAM_ROOT_INDEX) && (num_processors() > 1)) {
+        bool fallback;
+        file.close();
+        BgrTree *bgrt = readBGRTFileIndexed(map, filename, verify,
+                &fallback);
+        if (!fallback)
+            return bgrt;
+        file.open(filename, std::ios::in | std::ios::binary);
+        file.seekg(8, std::ios_base::beg);
+        if (!file.good())
+            return NULL;
+    }
+#endif
+
+    // Fetch the stored checksum...
+    uint32_t stored_checksum = readType<uint32_t>(file);
+
+    // ...and fetch the BGRT from the file, while the file checksum is
+    // generated from byte 12 on.
+    BlockReader reader(file.rdbuf(),
+            verify ? CHECKSUM_ADLER32 : CHECKSUM_NONE);
+    BgrTree *bgrt = readBGRTBlocks(map, reader, flags);
+
+    // If the checksums do not match, the file is possibly corrupted.
+    if (bgrt && verify && (reader.checksum() != stored_checksum)) {
+        BgrTree_destroy(bgrt);
+        bgrt = NULL;
+    }
+    file.close();
+    return bgrt;
+}
+
+/*!
+ * Write a BGRT to a file. Frozen trees can only be written in the flat
+ * format.
+ */
+bool writeBGRTFile(BgrTree *bgrt, NameMap *map, const char *filename,
+        unsigned int version) {
+    if (version == BGRT_FILE_VERSION_FLAT)
+        return writeBGRTFileFlat(bgrt, map, filename);
+    if (((version != BGRT_FILE_VERSION_STREAM)
+            && (version != BGRT_FILE_VERSION_INDEXED)) || bgrt->flat)
+        return false;
+
+    // Plain stream files are written without revision flags, i.e. in the
+    // format of older CaSSiS versions.
+    const unsigned int flags = (version == BGRT_FILE_VERSION_INDEXED) ?
+            BGRT_STREAM_FLAGS : 0;
+
+    // Open output file stream and write the BGRT into it...
+    std::ofstream file;
+    file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
         // Something went wrong...
         return false;
     }
 
     // Write file identifier (8 bytes).
-    file.write(BGRT_FILE_ID, 8);
+    char id[8];
+    memcpy(id, BGRT_FILE_ID, 8);
+    id[BGRT_FILE_ID_VERSION] = version;
+    id[BGRT_FILE_ID_FLAGS] = flags;
+    file.write(id, 8);
 
     // Add 4 bytes as a wildcard for the checksum.
-    uint32_t checksum = 0;
-    writeType<uint32_t>(checksum, file);
-
-    // Add the BGRT file...
-    bool retval = writeBGRTStream(bgrt, map, file);
+    writeType<uint32_t>(0, file);
 
-    // Reset the get position pointer to byte #12 and generate a file checksum.
-    file.clear();
-    file.seekg(12, std::ios_base::beg);
-    checksum = adler32(file);
+    // Add the BGRT file. The file checksum is generated from byte 12 on,
+    // while the blocks are written.
+    BlockWriter writer(file.rdbuf(), CHECKSUM_ADLER32);
+    bool retval = writeBGRTBlocks(bgrt, map, writer, flags);
+    retval = writer.flush() && retval;
 
     // Set the put position pointer to byte #8 and write the checksum.
-    file.clear();
     file.seekp(8, std::ios_base::beg);
-    writeType<uint32_t>(checksum, file);
+    writeType<uint32_t>(writer.checksum(), file);
 
     // Close and exit.
+    retval = retval && file.good();
     file.close();
     return retval;
 }
@@ -30,23 +30,148 @@
 #include <iostream>
 
 /*!
- * Read a BGRT from an input stream.
+ * BGRT file format versions:
+ * - BGRT_FILE_VERSION_STREAM: The nodes are serialized one by one
+ *   (depth-first), the tree is rebuilt node by node when it is read.
+ *   Written without revision flags, i.e. readable by older CaSSiS
+ *   versions.
+ * - BGRT_FILE_VERSION_FLAT: The arrays of the flat layout (see
+ *   BgrTreeFlat) and the signature pool are stored aligned in the byte
+ *   order of the writing machine. The file is memory mapped when it is
+ *   read and traversed in place.
+ * - BGRT_FILE_VERSION_INDEXED: The stream format, written with all
+ *   revisions of BGRT_STREAM_FLAGS (coded lists and species sets, root
+ *   index).
+ * Stream files are protected by an Adler32 checksum, flat files by a
+ * CRC32C checksum.
+ * Files are written in the BGRT_FILE_VERSION format by default. Flat
+ * files are not compressed: they are about 60% larger than indexed
+ * stream files (e.g. 42.8 MB instead of 25.6 MB) and have to be written
+ * explicitly (e.g. with bgrtconvert), if the faster loading is worth it.
  */
-BgrTree *readBGRTStream(NameMap *map, std::istream &stream);
+#define BGRT_FILE_VERSION_STREAM 2
+#define BGRT_FILE_VERSION_FLAT 3
+#define BGRT_FILE_VERSION_INDEXED 4
+#define BGRT_FILE_VERSION BGRT_FILE_VERSION_INDEXED
 
 /*!
- * Read a BGRT from a file.
+ * Revisions of the stream format (flags, stored in the file identifier):
+ * - BGRT_STREAM_VBYTE: Integer lists (species, outgroup matches and
+ *   signature lengths) are stored in the stream-vbyte layout, i.e. one
+ *   control byte with the lengths of four values, followed by the
+ *   values. Lists are decoded in bulk instead of value by value
+ *   (lists with less than four values are stored as VarUInts).
+ * - BGRT_STREAM_SPECIES_DELTA: Species sets are stored as their
+ *   compressed container (see SpeciesSet): The smallest species ID,
+ *   followed by the VarUInt gaps between the species, run-length coded
+ *   gaps or a bitmap, whichever is the smallest. The containers are
+ *   copied when the file is read, no species are decoded.
+ * - BGRT_STREAM_ROOT_INDEX: The roots are followed by an index with the
+ *   offset of each root subtree (relative to the start of the stream,
+ *   one uint64 per species plus the offset of the index itself, in the
+ *   byte order of the writing machine) and the offset of the index
+ *   (uint64). Sequential readers ignore the index; files are decoded by
+ *   several threads in parallel with it (PTHREADS builds).
+ * - BGRT_STREAM_ADAPTIVE: The lowest bit of the size of each integer list
+ *   and species set tells whether it is stored coded (stream-vbyte
+ *   layout or compressed container) or as plain VarUInts. The writer
+ *   chooses the smaller encoding for each list and set (the stream-vbyte
+ *   layout only pays off for values that do not fit into fewer VarUInt
+ *   bytes, e.g. 128..255).
+ * The flags are stored in the file identifier of both stream versions:
+ * BGRT_FILE_VERSION_STREAM files are written without flags,
+ * BGRT_FILE_VERSION_INDEXED files with all flags of BGRT_STREAM_FLAGS.
+ * Files with a subset of the flags can be read in either version.
  */
-BgrTree *readBGRTFile(NameMap *map, const char *filename);
+#define BGRT_STREAM_VBYTE 0x01
+#define BGRT_STREAM_SPECIES_DELTA 0x02
+#define BGRT_STREAM_ROOT_INDEX 0x04
+#define BGRT_STREAM_ADAPTIVE 0x08
+#define BGRT_STREAM_FLAGS (BGRT_STREAM_VBYTE | BGRT_STREAM_SPECIES_DELTA \
+        | BGRT_STREAM_ROOT_INDEX | BGRT_STREAM_ADAPTIVE)
 
 /*!
- * Write a BGRT to an output stream.
+ * Read a BGRT from an input stream. 'flags' defines the revision of the
+ * stream format (see BGRT_STREAM_FLAGS). The stream is read in blocks,
+ * i.e. it may be read beyond the end of the BGRT.
  */
-bool writeBGRTStream(BgrTree *bgrt, NameMap *map, std::ostream &stream);
+BgrTree *readBGRTStream(NameMap *map, std::istream &stream,
+        unsigned int flags = BGRT_STREAM_FLAGS);
 
 /*!
- * Write a BGRT to a file.
+ * Read a BGRT from a file. Files in the flat format are memory mapped,
+ * the returned tree is frozen then (see BgrTree_thaw).
+ * The file checksum is verified, unless 'verify' is false (e.g. for
+ * trusted local files).
  */
-bool writeBGRTFile(BgrTree *bgrt, NameMap *map, const char *filename);
+BgrTree *readBGRTFile(NameMap *map, const char *filename, bool verify = true);
+
+/*!
+ * Write a BGRT to an output stream. 'flags' defines the revision of the
+ * stream format (see BGRT_STREAM_FLAGS). With pThreads, the root subtrees
+ * are serialised in parallel; the stream is the same in any case.
+ */
+bool writeBGRTStream(BgrTree *bgrt, NameMap *map, std::ostream &stream,
+        unsigned int flags = BGRT_STREAM_FLAGS);
+
+/*!
+ * Write a BGRT to a file. Frozen trees can only be written in the flat
+ * format.
+ */
+bool writeBGRTFile(BgrTree *bgrt, NameMap *map, const char *filename,
+        unsigned int version = BGRT_FILE_VERSION);
+
+/*!
+ * BGRT that is read on demand from a stream file with a root index (see
+ * BGRT_STREAM_ROOT_INDEX). Only the header, the name map and the index
+ * are read when the file is opened. The subtree of a root is read the
+ * first time a query needs it and is kept for the following queries.
+ */
+struct BgrTreeLazy;
+
+/*!
+ * Open a BGRT file for on-demand reading. The file is memory mapped.
+ *
+ * \param map name map to fill
+ * \param filename BGRT file (stream format with a root index)
+ * \param verify verify the file checksum (reads the whole file)
+ * \param limit maximum size of the loaded subtrees (in bytes of the
+ *        file), 0 for no limit. The least recently used subtrees are
+ *        released if it is exceeded.
+ * \return NULL on error, or if the file has no root index.
+ */
+struct BgrTreeLazy *BgrTreeLazy_open(NameMap *map, const char *filename,
+        bool verify = true, unsigned long limit = 0);
+
+/*!
+ * Close a BGRT file that was opened for on-demand reading.
+ *
+ * \param lazy file to close
+ */
+void BgrTreeLazy_close(struct BgrTreeLazy *lazy);
+
+/*!
+ * The tree with the header values of a BGRT file that was opened for
+ * on-demand reading. Its nodes are provided by BgrTreeLazy_load.
+ *
+ * \param lazy opened file
+ * \return The tree (owned by 'lazy').
+ */
+struct BgrTree *BgrTreeLazy_tree(struct BgrTreeLazy *lazy);
+
+/*!
+ * Load the root subtrees of the given species. The returned tree is
+ * frozen and holds only these roots, i.e. it can be searched for
+ * signatures of a group without outgroup matches (all roots have to be
+ * loaded otherwise). The tree and its signatures are valid until the
+ * next call.
+ *
+ * \param lazy opened file
+ * \param ids species IDs, NULL for all species
+ * \param num_ids number of species IDs
+ * \return The tree (see BgrTreeLazy_tree), NULL on error.
+ */
+struct BgrTree *BgrTreeLazy_load(struct BgrTreeLazy *lazy,
+        const unsigned int *ids, unsigned int num_ids);
 
 #endif /* BGRT_IO_H_ */
@@ -68,232 +68,361 @@ void setNumProcessors(unsigned int n) {
 #endif
 
 /*!
- * Traverse a BgrTree and evaluate the one node of the PhyloTree.
- * -- Recursion.
+ * Open node on the current path of a (flat) BGRT traversal.
  */
-void traverse_BgrTree_recursion(unsigned int starting_solution,
-        struct BgrTreeNode *bgr_node, CaSSiSTreeNode *cassis_node,
-        unsigned int cassistree_depth, unsigned int max_outgroup_hits,
-        unsigned int *cutoff_array, unsigned int parent_ingroup_counter,
-        unsigned int parent_outgroup_counter, bool base4_compression) {
-    unsigned int phy_node_depth = cassis_node->depth;
+struct BGRTTraversal_path {
+    uint32_t node;
+    unsigned int ingroup_counter;
+    unsigned int outgroup_counter;
+    unsigned int cut_depth;
+    unsigned long entry;
+};
 
-    // Return without results, if the node or group is undefined
-    if (bgr_node == NULL)
-        return;
+/*!
+ * Per-thread state of a (flat) BGRT traversal: The path to the current
+ * node, which holds at least flat->max_depth + 1 entries, a cursor for
+ * each ingroup layer and the ingroup values written during the traversal.
+ * The values are stored in the ingroup layer of the PhyloTree node, after
+ * all roots were traversed.
+ */
+struct BGRTTraversal_state {
+    struct BGRTTraversal_path *path;
+    unsigned long *cursors;
+    struct BgrTreeIngroupEntry *entries;
+    unsigned long num_entries;
+    unsigned long capacity;
+    bool failed;
+};
 
 #ifdef USE_CUTTABLES
-    if (!bgr_node->ingroup_array) {
-        // Allocate memory for an ingroup array, if necessary.
-        bgr_node->ingroup_array = (unsigned int *) calloc(cassistree_depth,
-                sizeof(unsigned int));
-        assert(phy_node_depth == 0);
+/*!
+ * Append an ingroup value of a node to the traversal state. The value
+ * BGRT_FLAT_UNDEF marks a cut-off in the phylogenetic root node.
+ * \return Index of the entry, (unsigned long)-1 on error.
+ */
+static inline unsigned long add_ingroup_entry(
+        struct BGRTTraversal_state *state, uint32_t node, uint32_t value,
+        uint32_t depth) {
+    if (state->num_entries == state->capacity) {
+        unsigned long capacity = state->capacity ? state->capacity * 2 : 1024;
+        struct BgrTreeIngroupEntry *entries =
+                (struct BgrTreeIngroupEntry *) realloc(state->entries,
+                        capacity * sizeof(struct BgrTreeIngroupEntry));
+        if (!entries) {
+            state->failed = true;
+            return (unsigned long) -1;
+        }
+        state->entries = entries;
+        state->capacity = capacity;
     }
-    assert(phy_node_depth <= cassistree_depth);
+    state->entries[state->num_entries].node = node;
+    state->entries[state->num_entries].value = value;
+    state->entries[state->num_entries].depth = depth;
+    return state->num_entries++;
+}
 
-    // Create a reference to the ingroup array (may speed up r/w).
-    unsigned int *node_ingroup_array = bgr_node->ingroup_array;
+/*!
+ * Propagate a number of ingroup hits (upper limit) to the nodes on the
+ * path.
+ */
+static inline void propagate_ingroup_entries(struct BGRTTraversal_state *state,
+        unsigned int path_size, unsigned int ingroup) {
+    while (path_size > 0) {
+        unsigned long e = state->path[--path_size].entry;
+        if (e == (unsigned long) -1)
+            break;
+        uint32_t *value = &state->entries[e].value;
+        if (*value >= ingroup)
+            break;
+        *value = ingroup;
+    }
+}
+#endif
 
-    // Update (increase) the node ingroup array...
-    for (unsigned int i = 0; i < phy_node_depth; ++i)
-        if (node_ingroup_array[i] == ID_TYPE_UNDEF)
-            ++cutoff_array[i];
+/*!
+ * Create the state of a traversal.
+ */
+static void BGRTTraversal_state_init(struct BGRTTraversal_state *state,
+        const struct BgrTreeFlat *flat) {
+    state->path = (struct BGRTTraversal_path *) malloc(
+            (flat->max_depth + 1) * sizeof(struct BGRTTraversal_path));
+    state->cursors = (unsigned long *) malloc(
+            (flat->ingroup_depth + 1) * sizeof(unsigned long));
+    state->entries = NULL;
+    state->num_entries = 0;
+    state->capacity = 0;
+    state->failed = false;
+}
 
-    // Only evaluate previous runs if we aren't at the root...
-    if (phy_node_depth > 0) {
-        unsigned int cut_depth = phy_node_depth - 1;
+/*!
+ * Free the memory occupied by the state of a traversal.
+ */
+static void BGRTTraversal_state_free(struct BGRTTraversal_state *state) {
+    free(state->path);
+    free(state->cursors);
+    free(state->entries);
+}
 
-        while ((cut_depth > 0) && (cutoff_array[cut_depth] != 0))
-            --cut_depth;
+/*!
+ * Traverse the subtree of a (flat) BgrTree root node and evaluate the one
+ * node of the PhyloTree.
+ *
+ * The nodes of the subtree are stored in depth-first order. They are
+ * evaluated from left to right, a cut skips the rest of the subtree.
+ *
+ * The ingroup values of the nodes are looked up in the ingroup layers of
+ * the lower depths, i.e. of the PhyloTree nodes on the path to the root.
+ * A layer only holds the nodes that were visited at its depth. The depth
+ * used to cut a node is searched downwards from the depth used for the
+ * parent node, missing nodes are skipped. If a node was cut off, its entry
+ * refers to the (lower) depth used at that time. The values of this
+ * traversal are collected in the traversal state (see
+ * BGRTTraversal_state).
+ */
+void traverse_BgrTree_flat(unsigned int starting_solution,
+        const struct BgrTreeFlat *flat, uint32_t root,
+        CaSSiSTreeNode *cassis_node, unsigned int max_outgroup_hits,
+        struct BGRTTraversal_state *state) {
+    unsigned int phy_node_depth = cassis_node->depth;
 
-#if DEBUG_PRINTFS
-        fprintf(stderr, "Using depth %u = %u - 1 - %u "
-                "(= %u ingroup hits) at %p\n", cut_depth, phy_node_depth,
-                cut_depth, bgr_node->ingroup_array[cut_depth], bgr_node);
+    // Return without results, if the node or group is undefined
+    if (root == BGRT_FLAT_UNDEF)
+        return;
+
+    const bool inner_node = (cassis_node->left != NULL)
+            || (cassis_node->right != NULL);
+    const unsigned int *group = cassis_node->group->val_ptr();
+    const unsigned int group_size = cassis_node->group->size();
+    struct BGRTTraversal_path *path = state->path;
+#ifdef USE_CUTTABLES
+    assert(phy_node_depth < flat->ingroup_depth);
+    for (unsigned int c = 0; c < phy_node_depth; ++c)
+        state->cursors[c] = 0;
 #endif
-        if (bgr_node->ingroup_array[cut_depth] == ID_TYPE_UNDEF) {
-            // There has been a cut-off in the phylogenetic root node, if this
-            // here happens. This can only mean a cut-off because of too many
-            // outgroup hits. So it doesn't make sense to continue the
-            // evaluation of child nodes.
 
-            // Update (decrease) the node ingroup array...
-            for (unsigned int i = 0; i < phy_node_depth; ++i)
-                if (node_ingroup_array[i] == ID_TYPE_UNDEF)
-                    --cutoff_array[i];
+    unsigned int path_size = 0;
+    const uint32_t end = flat->subtree_end[root];
+    uint32_t n = root;
+    while (n < end) {
+        // Close the nodes whose subtrees have been evaluated.
+        while ((path_size > 0)
+                && (flat->subtree_end[path[path_size - 1].node] <= n))
+            --path_size;
+        assert((path_size == 0) || (path[path_size - 1].node == flat->parent[n]));
+        unsigned int parent_ingroup_counter = 0;
+        unsigned int parent_outgroup_counter = 0;
+        if (path_size > 0) {
+            parent_ingroup_counter = path[path_size - 1].ingroup_counter;
+            parent_outgroup_counter = path[path_size - 1].outgroup_counter;
+        }
+
+        // Skip subtrees without signatures. They are never entered, for
+        // any group.
+        if (flat->subtree_min_outgroup[n] == BGRT_FLAT_UNDEF) {
+            n = flat->subtree_end[n];
+            continue;
+        }
+
+#ifdef USE_CUTTABLES
+        unsigned int cut_depth = 0;
+        uint32_t value = BGRT_FLAT_UNDEF;
+
+        // Only evaluate previous runs if we aren't at the root...
+        if (phy_node_depth > 0) {
+            // Start with the depth used for the parent node and skip
+            // the depths where the node was not visited.
+            //
+            // The parent was expanded at its depth, and every entered
+            // child of an expanded node gets an entry there (either its
+            // value or a cut-off). So the first lookup succeeds, unless
+            // the layer was released after a failed store. Only then the
+            // lower layers are searched with one cursor lookup each
+            // (immediate for released, empty layers), i.e. up to O(depth)
+            // lookups per node in this degraded case.
+            cut_depth = (path_size > 0) ?
+                    path[path_size - 1].cut_depth : phy_node_depth - 1;
+            const struct BgrTreeIngroupEntry *found = BgrTreeFlat_ingroup_find(
+                    flat, cut_depth, n, state->cursors + cut_depth);
+            while (!found && (cut_depth > 0)) {
+                --cut_depth;
+                found = BgrTreeFlat_ingroup_find(flat, cut_depth, n,
+                        state->cursors + cut_depth);
+            }
+            if (found) {
+                cut_depth = found->depth;
+                value = found->value;
+            }
 
 #if DEBUG_PRINTFS
-            fprintf(stderr, "Stopping further evaluation of node %p. "
-                    "Root node was cut off.", bgr_node);
+            fprintf(stderr, "Using depth %u (= %u ingroup hits) at %u\n",
+                    cut_depth, value, n);
 #endif
-            return;
-        }
+            if (value == BGRT_FLAT_UNDEF) {
+                // There has been a cut-off in the phylogenetic root node, if
+                // this here happens. This can only mean a cut-off because of
+                // too many outgroup hits. So it doesn't make sense to continue
+                // the evaluation of child nodes.
+#if DEBUG_PRINTFS
+                fprintf(stderr, "Stopping further evaluation of node %u. "
+                        "Root node was cut off.", n);
+#endif
+                if (inner_node)
+                    add_ingroup_entry(state, n, BGRT_FLAT_UNDEF, 0);
+                n = flat->subtree_end[n];
+                continue;
+            }
 
-        // Find the lowest ingroup number we have so far (up to i outgroup hits).
-        unsigned int min_match = (unsigned int) (-1);
-        for (unsigned int i = 0; i <= max_outgroup_hits; i++)
-            min_match = MIN(min_match, cassis_node->num_matches[i]);
+            // Find the lowest ingroup number we have so far
+            // (up to i outgroup hits).
+            unsigned int min_match = (unsigned int) (-1);
+            for (unsigned int i = 0; i <= max_outgroup_hits; i++)
+                min_match = MIN(min_match, cassis_node->num_matches[i]);
 
-        // There should at least be one ingroup hit within the subtree
-        // to be of interest, so let us increase our reference to '1'.
-        if (min_match == 0)
-            ++min_match;
+            // There should at least be one ingroup hit within the subtree
+            // to be of interest, so let us increase our reference to '1'.
+            if (min_match == 0)
+                ++min_match;
 
-        // Cut the branch, if we cannot expect better results from it.
-        if (bgr_node->ingroup_array[cut_depth] < min_match) {
+            // Cut the branch, if we cannot expect better results from it.
+            if (value < min_match) {
 #if DEBUG_PRINTFS
-            fprintf(stderr,
-                    "Cutting! (1) (min_match=%u, parent_match=%u) at %p\n",
-                    min_match,
-                    (bgr_node->ingroup_array[phy_node_depth - 1 - cut_depth]),
-                    bgr_node);
+                fprintf(stderr,
+                        "Cutting! (1) (min_match=%u, parent_match=%u) at %u\n",
+                        min_match, value, n);
 #endif
-            if ((cassis_node->left != NULL) || (cassis_node->right != NULL)) {
-                // Propagate the parents value as an upper limit.
-                unsigned int upper_limit = bgr_node->ingroup_array[cut_depth];
-                struct BgrTreeNode *p = bgr_node->parent;
-                while (p != NULL) {
-                    int done = 1;
-                    if (p->ingroup_array[phy_node_depth] < upper_limit) {
-                        p->ingroup_array[phy_node_depth] = upper_limit;
-                        done = 0;
-                    }
-                    if (done)
-                        break;
-                    p = p->parent;
+                if (inner_node) {
+                    // Propagate the parents value as an upper limit.
+                    propagate_ingroup_entries(state, path_size, value);
+                    add_ingroup_entry(state, n, value, cut_depth);
                 }
-                bgr_node->ingroup_array[phy_node_depth] = -1;
+                n = flat->subtree_end[n];
+                continue;
             }
-
-            // Update (decrease) the node ingroup array...
-            for (unsigned int i = 0; i < phy_node_depth; ++i)
-                if (node_ingroup_array[i] == ID_TYPE_UNDEF)
-                    --cutoff_array[i];
-
-            return;
         }
-    }
 #endif
 
-    // Prefetch some variables to avoid costly memory accesses in the
-    // following while loop.
-    unsigned int ingroup_counter = parent_ingroup_counter;
-    unsigned int outgroup_counter = parent_outgroup_counter;
-    unsigned int node_species_size = bgr_node->species->size();
-    unsigned int group_size = cassis_node->group->size();
-    const unsigned int *v1 = bgr_node->species->val_ptr();
-    const unsigned int *v2 = cassis_node->group->val_ptr();
-    unsigned int i1 = 0;
-    unsigned int i2 = 0;
-
-    // Count the overlapping entries between our phylogenetic group
-    // and the current BgrTreeNode.
-    while ((i1 < node_species_size) && (i2 < group_size)) {
-        unsigned int v1i1 = v1[i1];
-        unsigned int v2i2 = v2[i2];
-        if (v1i1 > v2i2) {
-            // We have an entry in the PhyNode group which is not in our BgrTreeNode.
-            i2++;
-        } else if (v1i1 < v2i2) {
-            // We have an entry in the BgrTreeNode which is not in our PhyNode group.
-            outgroup_counter++;
-            i1++;
-        } else {
-            // We have found an entry in both groups.
-            ingroup_counter++;
-            i1++;
-            i2++;
-        }
-    }
-    outgroup_counter += (node_species_size - i1);
-
+        // Cut the branch, if none of the signatures within the subtree
+        // can be added to the results (see the subtree bounds).
+        unsigned int min_outgroup = parent_outgroup_counter
+                + flat->subtree_min_outgroup[n];
+        if (min_outgroup > max_outgroup_hits) {
+#ifdef USE_CUTTABLES
 #if DEBUG_PRINTFS
-    fprintf(
-            stderr,
-            "Found %u ingroup, %u/%u outgroup for group %u of size %u (signature hit %u species, first was %u) at %p!\n",
-            ingroup_counter, outgroup_counter, max_outgroup_hits,
-            cassis_node->node_index, group_size, node_species_size, v1[0],
-            bgr_node);
+            fprintf(stderr, "Cutting! (3) at %u\n", n);
 #endif
+            // Same as an exceeded outgroup hits limit (see below).
+            if (inner_node)
+                add_ingroup_entry(state, n, value, cut_depth);
+#endif
+            n = flat->subtree_end[n];
+            continue;
+        }
 
-    // Cut the branch, if we exceed our outgroup hits limit...
-    if (outgroup_counter > max_outgroup_hits) {
+        // A cut within an inner node of the PhyloTree would invalidate the
+        // ingroup arrays of the whole subtree for the following PhyloTree
+        // nodes, which costs more than it saves. So the ingroup bound is
+        // only used where no ingroup arrays are maintained.
+        if (!inner_node) {
+            unsigned int max_ingroup = parent_ingroup_counter
+                    + MIN(flat->subtree_max_species[n],
+                            group_size - parent_ingroup_counter);
+            // Read without the node lock (like the cut-off above): the
+            // counts only grow, so a stale value only prunes less.
+            unsigned int min_match = (unsigned int) (-1);
+            for (unsigned int i = min_outgroup; i <= max_outgroup_hits; i++)
+                min_match = MIN(min_match, cassis_node->num_matches[i]);
+            if (min_match == 0)
+                ++min_match;
+
+            if (max_ingroup < min_match) {
 #ifdef USE_CUTTABLES
 #if DEBUG_PRINTFS
-        fprintf(stderr, "Cutting! (2) at %p\n", bgr_node);
+                fprintf(stderr, "Cutting! (4) (min_match=%u, max_ingroup=%u) "
+                        "at %u\n", min_match, max_ingroup, n);
 #endif
-        if ((cassis_node->left != NULL) || (cassis_node->right != NULL))
-            bgr_node->ingroup_array[phy_node_depth] = ID_TYPE_UNDEF;
-
-        // Update (decrease) the node ingroup array...
-        for (unsigned int i = 0; i < phy_node_depth; ++i)
-            if (node_ingroup_array[i] == ID_TYPE_UNDEF)
-                --cutoff_array[i];
 #endif
-        return;
-    }
-
-    // Add our entry to the result array, if appropriate...
-    if ((ingroup_counter > 0) && (bgr_node->supposed_outgroup_matches)
-            && (bgr_node->supposed_outgroup_matches->size() > 0)) {
-        // Let us evaluate, if at least one of the signatures is worth being
-        // added to the results...
-        UnorderedIntSet *bgr_node_so = bgr_node->supposed_outgroup_matches;
-        for (unsigned int s = 0; s < bgr_node_so->size(); ++s) {
-            unsigned int outgroup_sum = bgr_node_so->val(s) + outgroup_counter;
-
-            // ...i.e. below max_outgroup_hits:
-            if (outgroup_sum <= max_outgroup_hits) {
-                if (ingroup_counter > cassis_node->best_ingroup_coverage)
-                    cassis_node->starting_solution = starting_solution;
-
-                cassis_node->addMatching(bgr_node->signatures.str->val(s),
-                        ingroup_counter, outgroup_sum);
+                n = flat->subtree_end[n];
+                continue;
             }
         }
-    }
 
-    /* BEST result update */
-#ifdef USE_CUTTABLES
-    if ((cassis_node->left != NULL) || (cassis_node->right != NULL)) {
+        // Count the overlapping entries between our phylogenetic group
+        // and the current node. The (compressed) species set of the node
+        // is not decoded; all other species of the node are outgroup hits.
+        unsigned int node_species_size = flat->species_size[n];
+        unsigned int node_ingroup = SpeciesSet::count(
+                (SpeciesSet::Encoding) flat->species_encoding[n],
+                flat->species_first[n], node_species_size,
+                flat->species_data + flat->species_offset[n],
+                flat->species_offset[n + 1] - flat->species_offset[n], group,
+                group_size);
+        unsigned int ingroup_counter = parent_ingroup_counter + node_ingroup;
+        unsigned int outgroup_counter = parent_outgroup_counter
+                + (node_species_size - node_ingroup);
+
 #if DEBUG_PRINTFS
-        fprintf(stderr, "Initializing depth %u -> %u (at %p)\n",
-                phy_node_depth, ingroup_counter, bgr_node);
+        fprintf(
+                stderr,
+                "Found %u ingroup, %u/%u outgroup for group %u of size %u (signature hit %u species, first was %u) at %u!\n",
+                ingroup_counter, outgroup_counter, max_outgroup_hits,
+                cassis_node->node_index, group_size, node_species_size,
+                flat->species_first[n], n);
 #endif
 
-        bgr_node->ingroup_array[phy_node_depth] = ingroup_counter;
-
-        struct BgrTreeNode *p = bgr_node->parent;
-        while (p != NULL) {
-            int done = 1;
+        // Cut the branch, if we exceed our outgroup hits limit...
+        if (outgroup_counter > max_outgroup_hits) {
+#ifdef USE_CUTTABLES
+#if DEBUG_PRINTFS
+            fprintf(stderr, "Cutting! (2) at %u\n", n);
+#endif
+            if (inner_node)
+                add_ingroup_entry(state, n, value, cut_depth);
+#endif
+            n = flat->subtree_end[n];
+            continue;
+        }
 
-            assert(p->ingroup_array[phy_node_depth] != ID_TYPE_UNDEF);
-            if (p->ingroup_array[phy_node_depth] < ingroup_counter) {
-                p->ingroup_array[phy_node_depth] = ingroup_counter;
-                done = 0;
+        // Add our entries to the result array, if appropriate...
+        if (ingroup_counter > 0) {
+            // Let us evaluate, if at least one of the signatures is worth
+            // being added to the results...
+            for (uint32_t s = flat->signature_offset[n];
+                    s < flat->signature_offset[n + 1]; ++s) {
+                unsigned int outgroup_sum = flat->supposed_outgroup_matches[s]
+                        + outgroup_counter;
+
+                // ...i.e. below max_outgroup_hits:
+                if (outgroup_sum <= max_outgroup_hits)
+                    cassis_node->addMatching(flat->signatures[s],
+                            ingroup_counter, outgroup_sum, starting_solution);
             }
+        }
 
-            if (done)
-                break;
-            p = p->parent;
+        /* BEST result update */
+#ifdef USE_CUTTABLES
+        unsigned long entry = (unsigned long) -1;
+        if (inner_node) {
+#if DEBUG_PRINTFS
+            fprintf(stderr, "Initializing depth %u -> %u (at %u)\n",
+                    phy_node_depth, ingroup_counter, n);
+#endif
+            entry = add_ingroup_entry(state, n, ingroup_counter,
+                    phy_node_depth);
+            propagate_ingroup_entries(state, path_size, ingroup_counter);
         }
-    }
 #endif
-    /* BGRT recursion */
-    struct BgrTreeNode *child = bgr_node->children;
-    while (child != NULL) {
-        traverse_BgrTree_recursion(starting_solution, child, cassis_node,
-                cassistree_depth, max_outgroup_hits, cutoff_array,
-                ingroup_counter, outgroup_counter, base4_compression);
-        child = child->next;
-    }
-
+        /* Descend into the children */
+        path[path_size].node = n;
+        path[path_size].ingroup_counter = ingroup_counter;
+        path[path_size].outgroup_counter = outgroup_counter;
 #ifdef USE_CUTTABLES
-    // Update (decrease) the node ingroup array...
-    for (unsigned int i = 0; i < phy_node_depth; ++i)
-        if (node_ingroup_array[i] == ID_TYPE_UNDEF)
-            --cutoff_array[i];
+        path[path_size].cut_depth = cut_depth;
+        path[path_size].entry = entry;
 #endif
+        ++path_size;
+        ++n;
+    }
+
 }
 
 #ifdef PTHREADS
@@ -302,12 +431,12 @@ void traverse_BgrTree_recursion(unsigned int starting_solution,
  */
 struct BGRTTraversal_work {
     pthread_mutex_t mutex;
-    struct BgrTree *bgr_tree;
+    struct BgrTreeFlat *flat;
     CaSSiSTreeNode *curr_cassis_node;
-    const CaSSiSTree *tree;
     unsigned int max_outgroup_hits;
     unsigned int remaining;
     unsigned int pos;
+    bool failed;
 };
 
 /*!
@@ -318,9 +447,9 @@ void *traverse_BgrTree_pthread(void *ptr) {
     // Fetch pointer to parameter struct.
     struct BGRTTraversal_work *work = (struct BGRTTraversal_work*) ptr;
 
-    // Create a per-thread cutoff array.
-    unsigned int *cutoff_array = (unsigned int*) calloc(
-            work->tree->tree_depth + 1, sizeof(unsigned int));
+    // Create the per-thread traversal state.
+    struct BGRTTraversal_state state;
+    BGRTTraversal_state_init(&state, work->flat);
 
     // The threads working loop...
     while (1) {
@@ -336,14 +465,21 @@ void *traverse_BgrTree_pthread(void *ptr) {
         pthread_mutex_unlock(&(work->mutex));
 
         // Process the fetched BGRT node.
-        pos = pos % work->bgr_tree->num_species;
-        traverse_BgrTree_recursion(pos, work->bgr_tree->nodes[pos],
-                work->curr_cassis_node, work->tree->tree_depth + 1,
-                work->max_outgroup_hits, cutoff_array, 0, 0,
-                work->bgr_tree->base4_compressed);
+        pos = pos % work->flat->num_species;
+        traverse_BgrTree_flat(pos, work->flat, work->flat->roots[pos],
+                work->curr_cassis_node, work->max_outgroup_hits, &state);
     }
 
-    free(cutoff_array);
+    // Store the ingroup values of this thread.
+    pthread_mutex_lock(&(work->mutex));
+    if (state.failed
+            || !BgrTreeFlat_ingroup_store(work->flat,
+                    work->curr_cassis_node->depth, state.entries,
+                    state.num_entries))
+        work->failed = true;
+    pthread_mutex_unlock(&(work->mutex));
+
+    BGRTTraversal_state_free(&state);
     return NULL;
 }
 
@@ -354,14 +490,26 @@ void *traverse_BgrTree_pthread(void *ptr) {
  *
  * This function is used to fetch the correct starting point from the
  * BgrTree, as the first level of the tree is arranged as an array.
+ *
+ * The ingroup values of an inner PhyloTree node are stored in the ingroup
+ * layer of its depth. This layer and all deeper layers hold the values of
+ * PhyloTree nodes that are not on the path to the root anymore, they are
+ * released before. If the values cannot be stored, the layer is left
+ * empty, which only disables the cut-offs based on this PhyloTree node.
  */
 void traverse_BgrTree(struct BgrTree *bgr_tree,
-        CaSSiSTreeNode *curr_cassis_node, const CaSSiSTree *cassis_tree,
-        unsigned int max_outgroup_hits) {
+        CaSSiSTreeNode *curr_cassis_node, unsigned int max_outgroup_hits) {
+
+    // The results refer to signatures from the BGRT signature pool.
+    curr_cassis_node->pool = bgr_tree->signature_pool;
 
-    // Create a 'cutoff-array'
-    unsigned int *cutoff_array = (unsigned int*) calloc(
-            cassis_tree->tree_depth + 1, sizeof(unsigned int));
+    // The traversal works on the flat layout of the tree.
+    struct BgrTreeFlat *flat = bgr_tree->flat;
+    BgrTreeFlat_ingroup_clear(flat, curr_cassis_node->depth);
+
+    // Create the traversal state.
+    struct BGRTTraversal_state state;
+    BGRTTraversal_state_init(&state, flat);
 
     // If no outgroup hits allowed:
     // Only evaluate nodes from our current phylogenetic group as starting points.
@@ -372,14 +520,11 @@ void traverse_BgrTree(struct BgrTree *bgr_tree,
             unsigned int starting_solution = curr_cassis_node->group->val(i);
 
             // Fetch the BgrTree starting node for our evaluation:
-            struct BgrTreeNode *starting_node =
-                    bgr_tree->nodes[starting_solution];
+            uint32_t starting_node = flat->roots[starting_solution];
 
             // Use the starting_node for further evaluation...
-            traverse_BgrTree_recursion(starting_solution, starting_node,
-                    curr_cassis_node, cassis_tree->tree_depth + 1,
-                    max_outgroup_hits, cutoff_array, 0, 0,
-                    bgr_tree->base4_compressed);
+            traverse_BgrTree_flat(starting_solution, flat, starting_node,
+                    curr_cassis_node, max_outgroup_hits, &state);
         }
     } else {
         // Starting solution #1
@@ -404,36 +549,47 @@ void traverse_BgrTree(struct BgrTree *bgr_tree,
 #ifndef PTHREADS
         for (unsigned int i = 0; i < bgr_tree->num_species; ++i) {
             unsigned int pos = (starting_solution + i) % bgr_tree->num_species;
-            traverse_BgrTree_recursion(pos, bgr_tree->nodes[pos],
-                    curr_cassis_node, cassis_tree->tree_depth + 1,
-                    max_outgroup_hits, cutoff_array, 0, 0,
-                    bgr_tree->base4_compressed);
+            traverse_BgrTree_flat(pos, flat, flat->roots[pos],
+                    curr_cassis_node, max_outgroup_hits, &state);
         }
 #else
         BGRTTraversal_work work;
         pthread_mutex_init(&(work.mutex), (pthread_mutexattr_t*) 0);
-        work.bgr_tree = bgr_tree;
+        work.flat = flat;
         work.curr_cassis_node = curr_cassis_node;
-        work.tree = cassis_tree;
         work.max_outgroup_hits = max_outgroup_hits;
         work.remaining = bgr_tree->num_species;
         work.pos = starting_solution;
+        work.failed = false;
 
         for (unsigned int i = 0; i < static_num_processors; i++)
         pool_run(traverse_BgrTree_pthread, &work);
 
         pool_barrier();
         pthread_mutex_destroy(&(work.mutex));
+        state.failed = state.failed || work.failed;
 #endif
     }
 
-#if 0 // DEBUG STUFF...
-    unsigned int assert_sum = 0;
-    for (int i = 0; i <= cassis_tree->tree_depth; ++i)
-    assert_sum += cutoff_array[i];
-    assert(assert_sum == 0);
-#endif
-    free(cutoff_array);
+    // Store the ingroup values for the following PhyloTree nodes.
+    if (state.failed
+            || !BgrTreeFlat_ingroup_store(flat, curr_cassis_node->depth,
+                    state.entries, state.num_entries))
+        BgrTreeFlat_ingroup_clear(flat, curr_cassis_node->depth);
+
+    BGRTTraversal_state_free(&state);
+}
+
+/*!
+ * Prepare a BgrTree for the traversal: Freezes the tree (flat layout) and
+ * provides an ingroup layer for each depth of the PhyloTree.
+ */
+static bool prepare_BgrTree(struct BgrTree *bgr_tree,
+        const CaSSiSTree *cassis_tree) {
+    if (!BgrTree_freeze(bgr_tree))
+        return false;
+    return BgrTreeFlat_ingroup_layers(bgr_tree->flat,
+            cassis_tree->tree_depth + 1);
 }
 
 /*!
@@ -453,7 +609,7 @@ void findTreeSpecificSignatures_recursion(struct BgrTree *bgr_tree,
                 (progress * 100 / cassis_tree->num_nodes));
 #endif
     // Evaluate the current node...
-    traverse_BgrTree(bgr_tree, cassis_node, cassis_tree, max_outgroup_hits);
+    traverse_BgrTree(bgr_tree, cassis_node, max_outgroup_hits);
 
     // Make a depth search -> enter left and right branches first.
     if (cassis_node->left) {
@@ -476,6 +632,10 @@ bool findTreeSpecificSignatures(struct BgrTree *bgr_tree,
     if (!bgr_tree || !cassis_tree)
         return NULL;
 
+    // Convert the BgrTree into the flat layout.
+    if (!prepare_BgrTree(bgr_tree, cassis_tree))
+        return false;
+
 #ifdef PTHREADS
     // Initialize pThread pool.
     if (static_num_processors == 0)
@@ -501,7 +661,7 @@ bool findTreeSpecificSignatures(struct BgrTree *bgr_tree,
  * Computes group specific signatures based on a given identifier list.
  */
 bool findGroupSpecificSignatures(struct BgrTree *bgr_tree, IntSet *ids,
-        unsigned int *&num_matches, StrRefSet *&signatures,
+        unsigned int *&num_matches, UnorderedIntSet *&signatures,
         unsigned int max_outgroup_hits) {
     if (!bgr_tree || !ids)
         return false;
@@ -514,7 +674,21 @@ bool findGroupSpecificSignatures(struct BgrTree *bgr_tree, IntSet *ids,
     CaSSiSTree *tree = new CaSSiSTree();
 
     // Evaluation...
-    traverse_BgrTree(bgr_tree, node, tree, max_outgroup_hits);
+    bool success = prepare_BgrTree(bgr_tree, tree);
+    if (success) {
+#ifdef PTHREADS
+        // Initialize pThread pool.
+        if (static_num_processors == 0)
+        static_num_processors = num_processors();
+
+        pool_init(static_num_processors);
+#endif
+        traverse_BgrTree(bgr_tree, node, max_outgroup_hits);
+#ifdef PTHREADS
+        // Destroy pThread pool.
+        pool_shutdown();
+#endif
+    }
 
     // Extract the results from the the fake phylogenetic node.
     num_matches = node->num_matches;
@@ -527,7 +701,7 @@ bool findGroupSpecificSignatures(struct BgrTree *bgr_tree, IntSet *ids,
     delete node;
     delete tree;
 
-    return true;
+    return success;
 }
 
 /*!
@@ -543,8 +717,22 @@ bool findNodeSpecificSignatures(struct BgrTree *bgr_tree, CaSSiSTreeNode *node,
     CaSSiSTree *tree = new CaSSiSTree();
 
     // Evaluation...
-    traverse_BgrTree(bgr_tree, node, tree, max_outgroup_hits);
+    bool success = prepare_BgrTree(bgr_tree, tree);
+    if (success) {
+#ifdef PTHREADS
+        // Initialize pThread pool.
+        if (static_num_processors == 0)
+        static_num_processors = num_processors();
+
+        pool_init(static_num_processors);
+#endif
+        traverse_BgrTree(bgr_tree, node, max_outgroup_hits);
+#ifdef PTHREADS
+        // Destroy pThread pool.
+        pool_shutdown();
+#endif
+    }
 
     delete tree;
-    return true;
+    return success;
 }
@@ -35,9 +35,10 @@ bool findTreeSpecificSignatures(struct BgrTree *bgr_tree,
 
 /*!
  * Computes group specific signatures based on a given identifier list.
+ * The signatures are returned as handles into the BGRT signature pool.
  */
 bool findGroupSpecificSignatures(struct BgrTree *bgr_tree, IntSet *ids,
-        unsigned int *&num_matches, StrRefSet *&signatures,
+        unsigned int *&num_matches, UnorderedIntSet *&signatures,
         unsigned int max_outgroup_hits);
 
 /*!
@@ -0,0 +1,402 @@
+/*!
+ * Signature pool (contiguous signature storage with 32-bit handles)
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sigpool.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+/*!
+ * Number of entries that are allocated for an empty pool.
+ */
+#define SIGNATURE_POOL_INITIAL_CAPACITY 1024
+
+/*!
+ * Maximum signature length within a packed pool (one length byte).
+ */
+#define SIGNATURE_POOL_MAX_PACKED_LEN 255
+
+/*!
+ * Base4 encoding of a base. (Identical to the Base4 class.)
+ */
+static inline char encodeBase(char base) {
+    switch (base) {
+    case 'a':
+    case 'A':
+        return 0x00;
+    case 'c':
+    case 'C':
+        return 0x01;
+    case 'g':
+    case 'G':
+        return 0x02;
+    case 't':
+    case 'T':
+    case 'u':
+    case 'U':
+        return 0x03;
+    default:
+        assert(0);
+        // This should not happen.
+        return 0x00;
+    }
+}
+
+/*!
+ * Entry size for a given maximum signature length.
+ */
+static inline unsigned int strideFor(unsigned int max_len, bool packed) {
+    if (packed)
+        return 1 + (max_len + 3) / 4;
+    return max_len + 1;
+}
+
+/*!
+ * Constructor.
+ */
+SignaturePool::SignaturePool(bool packed) :
+        m_data(NULL), m_size(0), m_capacity(0), m_stride(0), m_max_len(0),
+        m_packed(packed), m_attached(false) {
+    m_stride = strideFor(m_max_len, m_packed);
+}
+
+/*!
+ * Destructor.
+ */
+SignaturePool::~SignaturePool() {
+    if (!m_attached)
+        free(m_data);
+}
+
+/*!
+ * Returns a pointer to the next free entry.
+ * (Grows the pool and adapts the stride, if necessary.)
+ */
+char *SignaturePool::append(unsigned int length) {
+    if (m_packed && length > SIGNATURE_POOL_MAX_PACKED_LEN)
+        return NULL;
+    if (m_attached || (m_size >= SIGNATURE_HANDLE_UNDEF))
+        return NULL;
+
+    // Rebuild the pool with a bigger stride, if the signature does not fit.
+    if (length > m_max_len) {
+        unsigned int stride = strideFor(length, m_packed);
+        if (m_size > 0) {
+            char *data = (char *) calloc(m_capacity, stride);
+            if (!data)
+                return NULL;
+            for (uint32_t i = 0; i < m_size; ++i)
+                memcpy(data + (size_t) i * stride,
+                        m_data + (size_t) i * m_stride, m_stride);
+            free(m_data);
+            m_data = data;
+        } else {
+            free(m_data);
+            m_data = NULL;
+            m_capacity = 0;
+        }
+        m_max_len = length;
+        m_stride = stride;
+    }
+
+    // Grow the pool, if necessary.
+    if (m_size == m_capacity) {
+        uint32_t capacity = m_capacity ?
+                m_capacity * 2 : SIGNATURE_POOL_INITIAL_CAPACITY;
+        if (capacity < m_capacity || capacity >= SIGNATURE_HANDLE_UNDEF)
+            capacity = SIGNATURE_HANDLE_UNDEF - 1;
+        char *data = (char *) realloc(m_data, (size_t) capacity * m_stride);
+        if (!data)
+            return NULL;
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+    char *entry = m_data + (size_t) m_size * m_stride;
+    memset(entry, 0, m_stride);
+    return entry;
+}
+
+/*!
+ * Adds a signature to the pool.
+ * \return Handle of the signature. SIGNATURE_HANDLE_UNDEF on error.
+ */
+uint32_t SignaturePool::add(const char *signature) {
+    unsigned int length = strlen(signature);
+    char *entry = append(length);
+    if (!entry)
+        return SIGNATURE_HANDLE_UNDEF;
+
+    if (m_packed) {
+        entry[0] = (char) length;
+        char *seq = entry + 1;
+        for (unsigned int i = 0; i < length; ++i)
+            seq[i / 4] |= encodeBase(signature[i]) << ((i % 4) * 2);
+    } else
+        memcpy(entry, signature, length);
+
+    return m_size++;
+}
+
+/*!
+ * Adds a Base4-encoded signature with 'length' bases to the pool.
+ * \return Handle of the signature. SIGNATURE_HANDLE_UNDEF on error.
+ */
+uint32_t SignaturePool::addPacked(const char *seq, unsigned int length) {
+    if (!m_packed) {
+        // Decode the signature and store it as a string.
+        static const char CONV[4] = { 'A', 'C', 'G', 'U' };
+        char *entry = append(length);
+        if (!entry)
+            return SIGNATURE_HANDLE_UNDEF;
+        for (unsigned int i = 0; i < length; ++i)
+            entry[i] = CONV[(seq[i / 4] >> ((i % 4) * 2)) & 0x03];
+        return m_size++;
+    }
+
+    char *entry = append(length);
+    if (!entry)
+        return SIGNATURE_HANDLE_UNDEF;
+    entry[0] = (char) length;
+    if (length)
+        memcpy(entry + 1, seq, (length + 3) / 4);
+    return m_size++;
+}
+
+/*!
+ * Adds a copy of a signature from another pool.
+ * \return Handle of the signature. SIGNATURE_HANDLE_UNDEF on error.
+ */
+uint32_t SignaturePool::add(const SignaturePool *pool, uint32_t handle) {
+    if (pool->isPacked())
+        return addPacked(pool->packed(handle), pool->length(handle));
+    return add(pool->get(handle, NULL));
+}
+
+/*!
+ * Appends all signatures of another pool (with the same encoding).
+ * The handles of the appended signatures are those of 'pool' plus
+ * the returned offset.
+ * \return Handle of the first appended signature.
+ *         SIGNATURE_HANDLE_UNDEF on error.
+ */
+uint32_t SignaturePool::merge(const SignaturePool *pool) {
+    if (m_attached || (pool->m_packed != m_packed)
+            || ((uint64_t) m_size + pool->m_size >= SIGNATURE_HANDLE_UNDEF))
+        return SIGNATURE_HANDLE_UNDEF;
+    const uint32_t offset = m_size;
+    if (pool->m_size == 0)
+        return offset;
+
+    // Rebuild the pool with a bigger stride and/or capacity, if necessary.
+    const uint32_t size = m_size + pool->m_size;
+    const unsigned int max_len =
+            (pool->m_max_len > m_max_len) ? pool->m_max_len : m_max_len;
+    const unsigned int stride = strideFor(max_len, m_packed);
+    if ((stride != m_stride) || (size > m_capacity)) {
+        uint32_t capacity = m_capacity;
+        if (size > capacity)
+            capacity = (capacity * 2 > size) ? capacity * 2 : size;
+        if (capacity < size || capacity >= SIGNATURE_HANDLE_UNDEF)
+            capacity = SIGNATURE_HANDLE_UNDEF - 1;
+        if (stride == m_stride) {
+            char *data = (char *) realloc(m_data, (size_t) capacity * stride);
+            if (!data)
+                return SIGNATURE_HANDLE_UNDEF;
+            m_data = data;
+        } else {
+            char *data = (char *) calloc(capacity, stride);
+            if (!data)
+                return SIGNATURE_HANDLE_UNDEF;
+            for (uint32_t i = 0; i < m_size; ++i)
+                memcpy(data + (size_t) i * stride,
+                        m_data + (size_t) i * m_stride, m_stride);
+            free(m_data);
+            m_data = data;
+        }
+        m_capacity = capacity;
+        m_max_len = max_len;
+        m_stride = stride;
+    }
+
+    // Copy the entries (zero-padded to the stride).
+    char *dest = m_data + (size_t) m_size * m_stride;
+    if (pool->m_stride == m_stride)
+        memcpy(dest, pool->m_data, (size_t) pool->m_size * m_stride);
+    else {
+        memset(dest, 0, (size_t) pool->m_size * m_stride);
+        for (uint32_t i = 0; i < pool->m_size; ++i)
+            memcpy(dest + (size_t) i * m_stride,
+                    pool->m_data + (size_t) i * pool->m_stride,
+                    pool->m_stride);
+    }
+    m_size = size;
+    return offset;
+}
+
+/*!
+ * Returns the signature string. Plain pools return a pointer into
+ * the pool, packed pools decode the signature (as RNA) into 'buffer'.
+ */
+const char *SignaturePool::get(uint32_t handle, char *buffer) const {
+    const char *entry = m_data + (size_t) handle * m_stride;
+    if (!m_packed)
+        return entry;
+
+    static const char CONV[4] = { 'A', 'C', 'G', 'U' };
+    unsigned int length = (unsigned char) entry[0];
+    const char *seq = entry + 1;
+    for (unsigned int i = 0; i < length; ++i)
+        buffer[i] = CONV[(seq[i / 4] >> ((i % 4) * 2)) & 0x03];
+    buffer[length] = 0x00;
+    return buffer;
+}
+
+/*!
+ * Returns the length (number of bases) of a signature.
+ */
+unsigned int SignaturePool::length(uint32_t handle) const {
+    const char *entry = m_data + (size_t) handle * m_stride;
+    if (m_packed)
+        return (unsigned char) entry[0];
+    return strlen(entry);
+}
+
+/*!
+ * Returns the Base4-encoded sequence of a signature.
+ * Only available in packed pools, otherwise NULL.
+ */
+const char *SignaturePool::packed(uint32_t handle) const {
+    if (!m_packed)
+        return NULL;
+    return m_data + (size_t) handle * m_stride + 1;
+}
+
+/*!
+ * Number of signatures in the pool.
+ */
+uint32_t SignaturePool::size() const {
+    return m_size;
+}
+
+/*!
+ * True, if the signatures are stored Base4-encoded.
+ */
+bool SignaturePool::isPacked() const {
+    return m_packed;
+}
+
+/*!
+ * Size of an entry in bytes.
+ */
+unsigned int SignaturePool::stride() const {
+    return m_stride;
+}
+
+/*!
+ * Number of bytes allocated by the pool.
+ */
+unsigned long SignaturePool::allocated() const {
+    if (m_attached)
+        return 0;
+    return (unsigned long) m_capacity * m_stride;
+}
+
+/*!
+ * Returns the entries of the pool (size() * stride() bytes).
+ */
+const char *SignaturePool::data() const {
+    return m_data;
+}
+
+/*!
+ * Uses 'size' entries of 'stride' bytes at 'data' as the contents of
+ * the pool. The entries are neither copied nor freed.
+ * \return false, if the stride or an entry is invalid (a packed
+ *         signature that does not fit into its entry, or a string
+ *         without a terminal '0' character).
+ */
+bool SignaturePool::attach(const char *data, uint32_t size,
+        unsigned int stride) {
+    if ((stride < strideFor(0, m_packed)) || (m_packed
+            && (stride > strideFor(SIGNATURE_POOL_MAX_PACKED_LEN, true))))
+        return false;
+    for (uint32_t i = 0; i < size; ++i) {
+        const char *entry = data + (size_t) i * stride;
+        if (m_packed ? (strideFor((unsigned char) entry[0], true) > stride)
+                : !memchr(entry, 0x00, stride))
+            return false;
+    }
+    clear();
+    m_data = const_cast<char *>(data);
+    m_size = size;
+    m_capacity = size;
+    m_stride = stride;
+    m_max_len = m_packed ? (stride - 1) * 4 : stride - 1;
+    if (m_packed && (m_max_len > SIGNATURE_POOL_MAX_PACKED_LEN))
+        m_max_len = SIGNATURE_POOL_MAX_PACKED_LEN;
+    m_attached = true;
+    return true;
+}
+
+/*!
+ * Copies the entries of an attached pool, so that signatures can be
+ * added again. Does nothing, if the pool is not attached.
+ * \return false on error (the pool stays attached).
+ */
+bool SignaturePool::detach() {
+    if (!m_attached)
+        return true;
+    char *data = NULL;
+    if (m_size > 0) {
+        data = (char *) malloc((size_t) m_size * m_stride);
+        if (!data)
+            return false;
+        memcpy(data, m_data, (size_t) m_size * m_stride);
+    }
+    m_data = data;
+    m_attached = false;
+    return true;
+}
+
+/*!
+ * True, if the pool is attached to external entries.
+ */
+bool SignaturePool::isAttached() const {
+    return m_attached;
+}
+
+/*!
+ * Removes all signatures from the pool.
+ */
+void SignaturePool::clear() {
+    if (!m_attached)
+        free(m_data);
+    m_attached = false;
+    m_data = NULL;
+    m_size = 0;
+    m_capacity = 0;
+    m_max_len = 0;
+    m_stride = strideFor(m_max_len, m_packed);
+}
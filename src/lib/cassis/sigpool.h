@@ -0,0 +1,220 @@
+/*!
+ * Signature pool (contiguous signature storage with 32-bit handles)
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BGRT_SIGPOOL_H_
+#define BGRT_SIGPOOL_H_
+
+#include <stdint.h>
+
+/*!
+ * This value is used to mark an undefined signature handle.
+ */
+#define SIGNATURE_HANDLE_UNDEF ((uint32_t)-1)
+
+/*!
+ * Buffer size that is sufficient to decode any signature of a packed
+ * signature pool (including the terminal '0' character).
+ */
+#define SIGNATURE_BUFFER_SIZE 256
+
+/*!
+ * Append-only pool of signatures. Signatures are referenced by 32-bit
+ * handles (their index in the pool).
+ *
+ * All entries have the same size (stride), i.e. the position of an entry
+ * is computed from its handle. Two layouts are supported:
+ * - Plain: NUL-terminated strings.
+ * - Packed: one length byte, followed by the Base4-encoded sequence
+ *   (2 bits per base, same encoding as the Base4 class). Signatures in
+ *   a packed pool may have up to 255 bases.
+ *
+ * The stride is adapted (and the pool rebuilt) if a signature is added
+ * that is longer than all previous signatures.
+ *
+ * A pool can also be attached to existing entries (e.g. within a memory
+ * mapped BGRT file). Attached pools are read-only until detach() is
+ * called.
+ */
+class SignaturePool {
+public:
+    /*!
+     * Constructor.
+     * \param packed True, if the signatures should be stored Base4-encoded.
+     */
+    SignaturePool(bool packed = false);
+
+    /*!
+     * Destructor.
+     */
+    ~SignaturePool();
+
+    /*!
+     * Adds a signature to the pool.
+     * \return Handle of the signature. SIGNATURE_HANDLE_UNDEF on error.
+     */
+    uint32_t add(const char *signature);
+
+    /*!
+     * Adds a Base4-encoded signature with 'length' bases to the pool.
+     * \return Handle of the signature. SIGNATURE_HANDLE_UNDEF on error.
+     */
+    uint32_t addPacked(const char *seq, unsigned int length);
+
+    /*!
+     * Adds a copy of a signature from another pool.
+     * \return Handle of the signature. SIGNATURE_HANDLE_UNDEF on error.
+     */
+    uint32_t add(const SignaturePool *pool, uint32_t handle);
+
+    /*!
+     * Appends all signatures of another pool (with the same encoding).
+     * The handles of the appended signatures are those of 'pool' plus
+     * the returned offset.
+     * \return Handle of the first appended signature.
+     *         SIGNATURE_HANDLE_UNDEF on error.
+     */
+    uint32_t merge(const SignaturePool *pool);
+
+    /*!
+     * Returns the signature string. Plain pools return a pointer into
+     * the pool, packed pools decode the signature (as RNA) into 'buffer',
+     * which has to hold at least SIGNATURE_BUFFER_SIZE characters.
+     */
+    const char *get(uint32_t handle, char *buffer) const;
+
+    /*!
+     * Returns the length (number of bases) of a signature.
+     */
+    unsigned int length(uint32_t handle) const;
+
+    /*!
+     * Returns the Base4-encoded sequence of a signature.
+     * Only available in packed pools, otherwise NULL.
+     */
+    const char *packed(uint32_t handle) const;
+
+    /*!
+     * Number of signatures in the pool.
+     */
+    uint32_t size() const;
+
+    /*!
+     * True, if the signatures are stored Base4-encoded.
+     */
+    bool isPacked() const;
+
+    /*!
+     * Size of an entry in bytes.
+     */
+    unsigned int stride() const;
+
+    /*!
+     * Number of bytes allocated by the pool.
+     */
+    unsigned long allocated() const;
+
+    /*!
+     * Returns the entries of the pool (size() * stride() bytes).
+     */
+    const char *data() const;
+
+    /*!
+     * Uses 'size' entries of 'stride' bytes at 'data' as the contents of
+     * the pool. The entries are neither copied nor freed, i.e. they have
+     * to stay valid as long as the pool is attached.
+     * \return false, if the stride or an entry is invalid.
+     */
+    bool attach(const char *data, uint32_t size, unsigned int stride);
+
+    /*!
+     * Copies the entries of an attached pool, so that signatures can be
+     * added again. Does nothing, if the pool is not attached.
+     * \return false on error (the pool stays attached).
+     */
+    bool detach();
+
+    /*!
+     * True, if the pool is attached to external entries.
+     */
+    bool isAttached() const;
+
+    /*!
+     * Removes all signatures from the pool.
+     */
+    void clear();
+protected:
+    /*!
+     * Returns a pointer to the next free entry.
+     * (Grows the pool and adapts the stride, if necessary.)
+     */
+    char *append(unsigned int length);
+
+    /*!
+     * Sequence buffer.
+     */
+    char *m_data;
+
+    /*!
+     * Number of signatures in the pool.
+     */
+    uint32_t m_size;
+
+    /*!
+     * Number of signatures for which we have allocated space.
+     */
+    uint32_t m_capacity;
+
+    /*!
+     * Size of an entry in bytes.
+     */
+    unsigned int m_stride;
+
+    /*!
+     * Maximum signature length that fits into an entry.
+     */
+    unsigned int m_max_len;
+
+    /*!
+     * Flag: True, if the signatures are stored Base4-encoded.
+     */
+    bool m_packed;
+
+    /*!
+     * Flag: True, if the entries are not owned by the pool (see attach()).
+     */
+    bool m_attached;
+private:
+    /*!
+     * Copy constructor.
+     * Not implemented --> private.
+     */
+    SignaturePool(const SignaturePool&);
+
+    /*!
+     * Assignment operator.
+     * Not implemented. --> private.
+     */
+    SignaturePool &operator=(const SignaturePool&);
+};
+
+#endif /* BGRT_SIGPOOL_H_ */
@@ -0,0 +1,437 @@
+/*!
+ * Compressed species sets of the BGRT nodes
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "specset.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+/*!
+ * Number of bytes needed to store 'value' as VarUInt.
+ */
+static inline unsigned int varUIntBytes(unsigned int value) {
+    unsigned int bytes = 1;
+    while (value > 0x7F) {
+        value >>= 7;
+        ++bytes;
+    }
+    return bytes;
+}
+
+/*!
+ * Writes 'value' as VarUInt (least significant group first).
+ * \return Position after the written value.
+ */
+static inline unsigned char *putVarUInt(unsigned char *p, unsigned int value) {
+    while (value > 0x7F) {
+        *p++ = (unsigned char) ((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    *p++ = (unsigned char) value;
+    return p;
+}
+
+/*!
+ * Reads a VarUInt (least significant group first) and advances 'p'.
+ */
+static inline unsigned int getVarUInt(const unsigned char *&p) {
+    unsigned int value = *p & 0x7F;
+    unsigned int shift = 7;
+    while (*p++ & 0x80) {
+        value |= (unsigned int) (*p & 0x7F) << shift;
+        shift += 7;
+    }
+    return value;
+}
+
+/*!
+ * Reads a VarUInt that has to end before 'end' and advances 'p'.
+ * \return false, if the value is incomplete or too large.
+ */
+static inline bool getVarUInt(const unsigned char *&p,
+        const unsigned char *end, uint64_t &value) {
+    value = 0;
+    for (unsigned int shift = 0; (p < end) && (shift < 35); shift += 7) {
+        value |= (uint64_t) (*p & 0x7F) << shift;
+        if (!(*p++ & 0x80))
+            return value <= 0xFFFFFFFFULL;
+    }
+    return false;
+}
+
+/*!
+ * Constructor. Creates an empty set.
+ */
+SpeciesSet::SpeciesSet() :
+        m_size(0), m_first(0), m_bytes(0), m_encoding(DELTA) {
+    m_data.ptr = NULL;
+}
+
+/*!
+ * Destructor.
+ */
+SpeciesSet::~SpeciesSet() {
+    if (m_bytes > SPECIES_SET_INLINE_BYTES)
+        free(m_data.ptr);
+}
+
+/*!
+ * Replaces the contents of the set with the first n values of vals.
+ * The values have to be unique and sorted in ascending order.
+ */
+void SpeciesSet::assign(const unsigned int *vals, unsigned int n) {
+    if (m_bytes > SPECIES_SET_INLINE_BYTES)
+        free(m_data.ptr);
+    m_data.ptr = NULL;
+    m_size = n;
+    m_first = n ? vals[0] : 0;
+    m_bytes = 0;
+    m_encoding = DELTA;
+    if (n < 2)
+        return;
+
+    // Compute the size of each container.
+    unsigned long delta_bytes = 0;
+    unsigned long runs_bytes = 0;
+    unsigned int run_length = 1;
+    for (unsigned int i = 1; i < n; ++i) {
+        assert(vals[i] > vals[i - 1]);
+        unsigned int gap = vals[i] - vals[i - 1] - 1;
+        delta_bytes += varUIntBytes(gap);
+        if (gap == 0)
+            ++run_length;
+        else {
+            runs_bytes += varUIntBytes(run_length - 1) + varUIntBytes(gap - 1);
+            run_length = 1;
+        }
+    }
+    runs_bytes += varUIntBytes(run_length - 1);
+    unsigned long bitmap_bytes = (vals[n - 1] - vals[0]) / 8 + 1;
+
+    // Use the smallest container (bitmaps and runs are faster to count).
+    unsigned long bytes = delta_bytes;
+    if ((bitmap_bytes <= runs_bytes) && (bitmap_bytes <= delta_bytes)) {
+        m_encoding = BITMAP;
+        bytes = bitmap_bytes;
+    } else if (runs_bytes <= delta_bytes) {
+        m_encoding = RUNS;
+        bytes = runs_bytes;
+    }
+
+    m_bytes = bytes;
+    unsigned char *p = m_data.bytes;
+    if (bytes > SPECIES_SET_INLINE_BYTES) {
+        m_data.ptr = (unsigned char *) malloc(bytes);
+        p = m_data.ptr;
+    }
+
+    switch (m_encoding) {
+    case DELTA:
+        for (unsigned int i = 1; i < n; ++i)
+            p = putVarUInt(p, vals[i] - vals[i - 1] - 1);
+        break;
+    case RUNS:
+        run_length = 1;
+        for (unsigned int i = 1; i < n; ++i) {
+            unsigned int gap = vals[i] - vals[i - 1] - 1;
+            if (gap == 0)
+                ++run_length;
+            else {
+                p = putVarUInt(p, run_length - 1);
+                p = putVarUInt(p, gap - 1);
+                run_length = 1;
+            }
+        }
+        p = putVarUInt(p, run_length - 1);
+        break;
+    case BITMAP:
+        memset(p, 0, bytes);
+        for (unsigned int i = 0; i < n; ++i) {
+            unsigned int offset = vals[i] - m_first;
+            p[offset >> 3] |= (unsigned char) (1 << (offset & 7));
+        }
+        break;
+    }
+}
+
+/*!
+ * Replaces the contents of the set with a copy of a container (see
+ * container()). No values are decoded.
+ * \param encoding container type
+ * \param first smallest species ID of the set
+ * \param size number of species in the set
+ * \param container the container
+ * \param bytes size of the container in bytes
+ * \return false on error (allocation failure).
+ */
+bool SpeciesSet::assign(Encoding encoding, unsigned int first,
+        unsigned int size, const unsigned char *container,
+        unsigned int bytes) {
+    if (m_bytes > SPECIES_SET_INLINE_BYTES)
+        free(m_data.ptr);
+    m_data.ptr = NULL;
+    m_size = size;
+    m_first = first;
+    m_bytes = 0;
+    m_encoding = encoding;
+
+    unsigned char *p = m_data.bytes;
+    if (bytes > SPECIES_SET_INLINE_BYTES) {
+        m_data.ptr = (unsigned char *) malloc(bytes);
+        if (!m_data.ptr) {
+            m_size = 0;
+            return false;
+        }
+        p = m_data.ptr;
+    }
+    if (bytes)
+        memcpy(p, container, bytes);
+    m_bytes = bytes;
+    return true;
+}
+
+/*!
+ * Writes all species of the set in ascending order into 'buffer',
+ * which has to hold at least size() entries.
+ * \return Number of species.
+ */
+unsigned int SpeciesSet::decode(unsigned int *buffer) const {
+    return decode(encoding(), m_first, m_size, container(), m_bytes, buffer);
+}
+
+/*!
+ * Writes all species of a (copied) container in ascending order into
+ * 'buffer', which has to hold at least 'size' entries.
+ * \param encoding container type
+ * \param first smallest species ID of the set
+ * \param size number of species in the set
+ * \param container the container (see container())
+ * \param bytes size of the container in bytes
+ * \param buffer output buffer
+ * \return Number of species.
+ */
+unsigned int SpeciesSet::decode(Encoding encoding, unsigned int first,
+        unsigned int size, const unsigned char *container, unsigned int bytes,
+        unsigned int *buffer) {
+    if (size == 0)
+        return 0;
+
+    const unsigned char *p = container;
+    const unsigned char *end = p + bytes;
+    unsigned int i = 0;
+    switch (encoding) {
+    case DELTA: {
+        unsigned int value = first;
+        buffer[i++] = value;
+        while (p < end) {
+            value += getVarUInt(p) + 1;
+            buffer[i++] = value;
+        }
+        break;
+    }
+    case RUNS: {
+        unsigned int start = first;
+        while (true) {
+            unsigned int length = getVarUInt(p) + 1;
+            for (unsigned int j = 0; j < length; ++j)
+                buffer[i++] = start + j;
+            if (p >= end)
+                break;
+            start += length + getVarUInt(p) + 1;
+        }
+        break;
+    }
+    case BITMAP:
+        for (unsigned int b = 0; b < bytes; ++b) {
+            unsigned int bits = p[b];
+            while (bits) {
+                unsigned int bit = __builtin_ctz(bits);
+                buffer[i++] = first + b * 8 + bit;
+                bits &= bits - 1;
+            }
+        }
+        break;
+    }
+    assert(i == size);
+    return i;
+}
+
+/*!
+ * Checks a (copied) container, e.g. one that was read from a file:
+ * The container has to hold exactly 'size' species below 'limit',
+ * without reaching beyond its end.
+ * \param encoding container type
+ * \param first smallest species ID of the set
+ * \param size number of species in the set
+ * \param container the container (see container())
+ * \param bytes size of the container in bytes
+ * \param limit upper bound of the species IDs
+ * \return true, if the container is valid.
+ */
+bool SpeciesSet::valid(unsigned int encoding, unsigned int first,
+        unsigned int size, const unsigned char *container, unsigned int bytes,
+        unsigned int limit) {
+    if (size < 2)
+        return (bytes == 0) && ((size == 0) || (first < limit));
+    if ((bytes == 0) || (first >= limit))
+        return false;
+
+    const unsigned char *p = container;
+    const unsigned char *end = p + bytes;
+    uint64_t count = 1;
+    uint64_t last = first;
+    switch (encoding) {
+    case DELTA:
+        while (p < end) {
+            uint64_t gap;
+            if (!getVarUInt(p, end, gap))
+                return false;
+            last += gap + 1;
+            ++count;
+        }
+        break;
+    case RUNS: {
+        // Run lengths, separated by gaps (see decode()).
+        count = 0;
+        last = first;
+        while (true) {
+            uint64_t length, gap;
+            if (!getVarUInt(p, end, length))
+                return false;
+            count += length + 1;
+            last += length + 1;
+            if (p >= end)
+                break;
+            if (!getVarUInt(p, end, gap))
+                return false;
+            last += gap + 1;
+        }
+        --last;
+        break;
+    }
+    case BITMAP:
+        count = 0;
+        for (unsigned int b = 0; b < bytes; ++b) {
+            unsigned int bits = p[b];
+            count += __builtin_popcount(bits);
+            if (bits)
+                last = first + (uint64_t) b * 8 + 31 - __builtin_clz(bits);
+        }
+        break;
+    default:
+        return false;
+    }
+    return (count == size) && (last < limit);
+}
+
+/*!
+ * Counts the species that are also in 'group'.
+ * \param group species IDs, sorted in ascending order
+ * \param group_size number of species in 'group'
+ * \return Number of species in both sets.
+ */
+unsigned int SpeciesSet::count(const unsigned int *group,
+        unsigned int group_size) const {
+    return count(encoding(), m_first, m_size, container(), m_bytes, group,
+            group_size);
+}
+
+/*!
+ * Counts the species of a (copied) container that are also in 'group'.
+ * \param encoding container type
+ * \param first smallest species ID of the set
+ * \param size number of species in the set
+ * \param container the container (see container())
+ * \param bytes size of the container in bytes
+ * \param group species IDs, sorted in ascending order
+ * \param group_size number of species in 'group'
+ * \return Number of species in both sets.
+ */
+unsigned int SpeciesSet::count(Encoding encoding, unsigned int first,
+        unsigned int size, const unsigned char *container, unsigned int bytes,
+        const unsigned int *group, unsigned int group_size) {
+    const unsigned int *g_end = group + group_size;
+    const unsigned int *g = std::lower_bound(group, g_end, first);
+    if ((size == 0) || (g == g_end))
+        return 0;
+
+    const unsigned char *p = container;
+    const unsigned char *end = p + bytes;
+    unsigned int matches = 0;
+    switch (encoding) {
+    case DELTA: {
+        // Merge the gaps with the group.
+        unsigned int value = first;
+        while (true) {
+            while ((g < g_end) && (*g < value))
+                ++g;
+            if (g == g_end)
+                break;
+            if (*g == value) {
+                ++matches;
+                ++g;
+            }
+            if (p >= end)
+                break;
+            value += getVarUInt(p) + 1;
+        }
+        break;
+    }
+    case RUNS: {
+        // Count the group members within each run.
+        unsigned int start = first;
+        while (true) {
+            unsigned int stop = start + getVarUInt(p) + 1;
+            const unsigned int *g_stop = std::lower_bound(g, g_end, stop);
+            matches += g_stop - g;
+            g = g_stop;
+            if ((g == g_end) || (p >= end))
+                break;
+            start = stop + getVarUInt(p) + 1;
+            g = std::lower_bound(g, g_end, start);
+        }
+        break;
+    }
+    case BITMAP: {
+        // Look up the group members within the bitmap.
+        const unsigned int bits = bytes * 8;
+        for (; g < g_end; ++g) {
+            unsigned int offset = *g - first;
+            if (offset >= bits)
+                break;
+            matches += (p[offset >> 3] >> (offset & 7)) & 1;
+        }
+        break;
+    }
+    }
+    return matches;
+}
+
+/*!
+ * Number of bytes allocated by the set (in addition to the set itself).
+ */
+unsigned long SpeciesSet::allocated() const {
+    return (m_bytes > SPECIES_SET_INLINE_BYTES) ? m_bytes : 0;
+}
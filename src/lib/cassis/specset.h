@@ -0,0 +1,228 @@
+/*!
+ * Compressed species sets of the BGRT nodes
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) library.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BGRT_SPECSET_H_
+#define BGRT_SPECSET_H_
+
+#include <stdint.h>
+
+/*!
+ * Number of bytes that are stored within the set itself instead of
+ * being allocated separately.
+ */
+#define SPECIES_SET_INLINE_BYTES 8
+
+/*!
+ * Immutable, compressed set of species IDs.
+ *
+ * The smallest species ID is stored explicitly, the remaining species
+ * are encoded in one of the following containers. The container is
+ * chosen per set, whichever needs the fewest bytes:
+ * - Delta: VarUInt-encoded gaps between consecutive species.
+ * - Runs: VarUInt-encoded (gap, length) pairs of consecutive species.
+ * - Bitmap: One bit per species ID, starting at the smallest species.
+ * Small containers are stored inline.
+ *
+ * The number of species of a set that are also in a (sorted) group of
+ * species is computed directly on the containers.
+ */
+class SpeciesSet {
+public:
+    /*!
+     * Container types.
+     */
+    enum Encoding {
+        DELTA = 0, RUNS = 1, BITMAP = 2
+    };
+
+    /*!
+     * Constructor. Creates an empty set.
+     */
+    SpeciesSet();
+
+    /*!
+     * Destructor.
+     */
+    ~SpeciesSet();
+
+    /*!
+     * Replaces the contents of the set with the first n values of vals.
+     * The values have to be unique and sorted in ascending order.
+     */
+    void assign(const unsigned int *vals, unsigned int n);
+
+    /*!
+     * Replaces the contents of the set with a copy of a container (see
+     * container()). No values are decoded.
+     * \param encoding container type
+     * \param first smallest species ID of the set
+     * \param size number of species in the set
+     * \param container the container
+     * \param bytes size of the container in bytes
+     * \return false on error (allocation failure).
+     */
+    bool assign(Encoding encoding, unsigned int first, unsigned int size,
+            const unsigned char *container, unsigned int bytes);
+
+    /*!
+     * Writes all species of the set in ascending order into 'buffer',
+     * which has to hold at least size() entries.
+     * \return Number of species.
+     */
+    unsigned int decode(unsigned int *buffer) const;
+
+    /*!
+     * Writes all species of a (copied) container in ascending order into
+     * 'buffer', which has to hold at least 'size' entries.
+     * \param encoding container type
+     * \param first smallest species ID of the set
+     * \param size number of species in the set
+     * \param container the container (see container())
+     * \param bytes size of the container in bytes
+     * \param buffer output buffer
+     * \return Number of species.
+     */
+    static unsigned int decode(Encoding encoding, unsigned int first,
+            unsigned int size, const unsigned char *container,
+            unsigned int bytes, unsigned int *buffer);
+
+    /*!
+     * Checks a (copied) container, e.g. one that was read from a file:
+     * The container has to hold exactly 'size' species below 'limit',
+     * without reaching beyond its end.
+     * \param encoding container type
+     * \param first smallest species ID of the set
+     * \param size number of species in the set
+     * \param container the container (see container())
+     * \param bytes size of the container in bytes
+     * \param limit upper bound of the species IDs
+     * \return true, if the container is valid.
+     */
+    static bool valid(unsigned int encoding, unsigned int first,
+            unsigned int size, const unsigned char *container,
+            unsigned int bytes, unsigned int limit);
+
+    /*!
+     * Counts the species that are also in 'group'.
+     * \param group species IDs, sorted in ascending order
+     * \param group_size number of species in 'group'
+     * \return Number of species in both sets.
+     */
+    unsigned int count(const unsigned int *group,
+            unsigned int group_size) const;
+
+    /*!
+     * Counts the species of a (copied) container that are also in 'group'.
+     * \param encoding container type
+     * \param first smallest species ID of the set
+     * \param size number of species in the set
+     * \param container the container (see container())
+     * \param bytes size of the container in bytes
+     * \param group species IDs, sorted in ascending order
+     * \param group_size number of species in 'group'
+     * \return Number of species in both sets.
+     */
+    static unsigned int count(Encoding encoding, unsigned int first,
+            unsigned int size, const unsigned char *container,
+            unsigned int bytes, const unsigned int *group,
+            unsigned int group_size);
+
+    /*!
+     * Set size.
+     * \return Number of species in the set.
+     */
+    unsigned int size() const {
+        return m_size;
+    }
+
+    /*!
+     * Smallest species ID in the set. Undefined for empty sets.
+     */
+    unsigned int first() const {
+        return m_first;
+    }
+
+    /*!
+     * Container type of the set.
+     */
+    Encoding encoding() const {
+        return (Encoding) m_encoding;
+    }
+
+    /*!
+     * Returns a pointer to the container.
+     */
+    const unsigned char *container() const {
+        return (m_bytes > SPECIES_SET_INLINE_BYTES) ? m_data.ptr : m_data.bytes;
+    }
+
+    /*!
+     * Size of the container in bytes.
+     */
+    unsigned int bytes() const {
+        return m_bytes;
+    }
+
+    /*!
+     * Number of bytes allocated by the set (in addition to the set itself).
+     */
+    unsigned long allocated() const;
+protected:
+    /*!
+     * Number of species in the set.
+     */
+    unsigned int m_size;
+
+    /*!
+     * Smallest species ID in the set.
+     */
+    unsigned int m_first;
+
+    /*!
+     * Number of bytes of the container and its type.
+     */
+    unsigned int m_bytes :30;
+    unsigned int m_encoding :2;
+
+    /*!
+     * The container; stored inline, if it is small enough.
+     */
+    union {
+        unsigned char *ptr;
+        unsigned char bytes[SPECIES_SET_INLINE_BYTES];
+    } m_data;
+private:
+    /*!
+     * Copy constructor.
+     * Not implemented --> private.
+     */
+    SpeciesSet(const SpeciesSet&);
+
+    /*!
+     * Assignment operator.
+     * Not implemented. --> private.
+     */
+    SpeciesSet &operator=(const SpeciesSet&);
+};
+
+#endif /* BGRT_SPECSET_H_ */
@@ -22,9 +22,287 @@
  */
 
 #include "thermodynamics.h"
+#include "sigpool.h"
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
+#include <string>
+
+/*!
+ * Environment settings, shared by all melting temperature calculations.
+ * TODO: Predefined environment settings!
+ * All concentrations in mmol/l (millimol/liter)
+ */
+static const double c_salt = 1000.0; // == 1 mol/l
+static const double c_mg = 0.0;
+static const double c_oligo = 0.00001; // == 10 nmol/l
+
+/*!
+ * Effect on entropy by salt correction. (Ahsen et al. 1999)
+ * Increase of stability due to presence of Mg (--> effect on entropy).
+ */
+static double salt_correction(unsigned int length) {
+    double salt_effect = (c_salt / 1000) + ((c_mg / 1000) * 140);
+    return 0.368 * length * log(salt_effect); // TODO: or (length - 1)?
+}
+
+/*!
+ * Compute the melting temperature.
+ * log(c_oligo / (1000 * 4)) --> self complementary oligo.
+ * log(c_oligo / (1000 * 2)) --> _NOT_ self complementary oligo.
+ */
+static const double oligo_correction = 1.987 * log(c_oligo / (1000 * 2));
+
+static double melting_temperature(double delta_h, double delta_s) {
+    return ((1000 * delta_h) / (delta_s + oligo_correction)) - 273.15;
+}
+
+/*!
+ * Base stacking enthalpy and entropy values for the batch processing.
+ * Derived from m_array_h and m_array_s (in tenths of kcal/mol and
+ * cal/(mol * K)), shifted by an offset into the range of an unsigned byte.
+ * Indexed by (first base << 2) | next base. The batch kernels sum up these
+ * bytes and remove the offsets afterwards.
+ */
+struct NNTables {
+    unsigned char h[16];
+    unsigned char s[16];
+    int h_offset;
+    int s_offset;
+};
+
+static void nn_table(const double values[4][4], unsigned char *table,
+        int *offset) {
+    int tenths[16];
+    *offset = 0;
+    for (unsigned int i = 0; i < 16; ++i) {
+        tenths[i] = (int) floor(-10 * values[i >> 2][i & 0x03] + 0.5);
+        if (tenths[i] > *offset)
+            *offset = tenths[i];
+    }
+    for (unsigned int i = 0; i < 16; ++i)
+        table[i] = (unsigned char) (*offset - tenths[i]);
+}
+
+static struct NNTables make_nn_tables(const double h[4][4],
+        const double s[4][4]) {
+    struct NNTables tables;
+    nn_table(h, tables.h, &tables.h_offset);
+    nn_table(s, tables.s, &tables.s_offset);
+    return tables;
+}
+
+/*!
+ * Batch kernel: Sums up the (shifted) base stacking values of n packed
+ * signatures. Scalar implementation.
+ */
+static void nn_sums_scalar(const struct NNTables *nn,
+        const uint64_t *signatures, unsigned int length, unsigned int n,
+        unsigned int *sum_h, unsigned int *sum_s) {
+    for (unsigned int i = 0; i < n; ++i) {
+        uint64_t v = signatures[i];
+        unsigned int h = 0;
+        unsigned int s = 0;
+        for (unsigned int j = 1; j < length; ++j) {
+            unsigned int dinucleotide = v & 0x0F;
+            h += nn->h[dinucleotide];
+            s += nn->s[dinucleotide];
+            v >>= 2;
+        }
+        sum_h[i] = h;
+        sum_s[i] = s;
+    }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+/*!
+ * The SIMD batch kernels use the byte shuffle instruction as a table lookup.
+ *
+ * A packed signature with 'length' bases contains the dinucleotides
+ * (length-1) in the aligned 4-bit nibbles of 'v' and of 'v >> 2'. Each nibble
+ * is moved into its own byte. Bytes without a valid dinucleotide get the
+ * 0x80 flag, which lets the shuffle instruction return 0 for them.
+ */
+static uint64_t nn_invalid_mask(unsigned int valid_nibbles, unsigned int hi) {
+    uint64_t mask = 0;
+    for (unsigned int b = 0; b < 8; ++b)
+        if (2 * b + hi >= valid_nibbles)
+            mask |= ((uint64_t) 0x80) << (8 * b);
+    return mask;
+}
+
+/*!
+ * Batch kernel: SSSE3 implementation (two signatures per iteration).
+ */
+__attribute__((target("ssse3")))
+static void nn_sums_ssse3(const struct NNTables *nn,
+        const uint64_t *signatures, unsigned int length, unsigned int n,
+        unsigned int *sum_h, unsigned int *sum_s) {
+    const __m128i table_h = _mm_loadu_si128((const __m128i *) nn->h);
+    const __m128i table_s = _mm_loadu_si128((const __m128i *) nn->s);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask_lo_a = _mm_set1_epi64x(
+            nn_invalid_mask(length / 2, 0));
+    const __m128i mask_hi_a = _mm_set1_epi64x(
+            nn_invalid_mask(length / 2, 1));
+    const __m128i mask_lo_b = _mm_set1_epi64x(
+            nn_invalid_mask((length - 1) / 2, 0));
+    const __m128i mask_hi_b = _mm_set1_epi64x(
+            nn_invalid_mask((length - 1) / 2, 1));
+
+    unsigned int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (signatures + i));
+        __m128i b = _mm_srli_epi64(a, 2);
+        __m128i a_lo = _mm_or_si128(_mm_and_si128(a, nibble), mask_lo_a);
+        __m128i a_hi = _mm_or_si128(
+                _mm_and_si128(_mm_srli_epi64(a, 4), nibble), mask_hi_a);
+        __m128i b_lo = _mm_or_si128(_mm_and_si128(b, nibble), mask_lo_b);
+        __m128i b_hi = _mm_or_si128(
+                _mm_and_si128(_mm_srli_epi64(b, 4), nibble), mask_hi_b);
+
+        // Max. byte value: 4 * 34 (enthalpy) resp. 2 * 73 (entropy).
+        __m128i h = _mm_add_epi8(
+                _mm_add_epi8(_mm_shuffle_epi8(table_h, a_lo),
+                        _mm_shuffle_epi8(table_h, a_hi)),
+                _mm_add_epi8(_mm_shuffle_epi8(table_h, b_lo),
+                        _mm_shuffle_epi8(table_h, b_hi)));
+        __m128i s_a = _mm_add_epi8(_mm_shuffle_epi8(table_s, a_lo),
+                _mm_shuffle_epi8(table_s, a_hi));
+        __m128i s_b = _mm_add_epi8(_mm_shuffle_epi8(table_s, b_lo),
+                _mm_shuffle_epi8(table_s, b_hi));
+
+        uint64_t res_h[2];
+        uint64_t res_s[2];
+        _mm_storeu_si128((__m128i *) res_h, _mm_sad_epu8(h, zero));
+        _mm_storeu_si128((__m128i *) res_s,
+                _mm_add_epi64(_mm_sad_epu8(s_a, zero), _mm_sad_epu8(s_b, zero)));
+        sum_h[i] = (unsigned int) res_h[0];
+        sum_h[i + 1] = (unsigned int) res_h[1];
+        sum_s[i] = (unsigned int) res_s[0];
+        sum_s[i + 1] = (unsigned int) res_s[1];
+    }
+    nn_sums_scalar(nn, signatures + i, length, n - i, sum_h + i, sum_s + i);
+}
+
+/*!
+ * Batch kernel: AVX2 implementation (four signatures per iteration).
+ */
+__attribute__((target("avx2")))
+static void nn_sums_avx2(const struct NNTables *nn,
+        const uint64_t *signatures, unsigned int length, unsigned int n,
+        unsigned int *sum_h, unsigned int *sum_s) {
+    const __m256i table_h = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *) nn->h));
+    const __m256i table_s = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *) nn->s));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i mask_lo_a = _mm256_set1_epi64x(
+            nn_invalid_mask(length / 2, 0));
+    const __m256i mask_hi_a = _mm256_set1_epi64x(
+            nn_invalid_mask(length / 2, 1));
+    const __m256i mask_lo_b = _mm256_set1_epi64x(
+            nn_invalid_mask((length - 1) / 2, 0));
+    const __m256i mask_hi_b = _mm256_set1_epi64x(
+            nn_invalid_mask((length - 1) / 2, 1));
+
+    unsigned int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (signatures + i));
+        __m256i b = _mm256_srli_epi64(a, 2);
+        __m256i a_lo = _mm256_or_si256(_mm256_and_si256(a, nibble),
+                mask_lo_a);
+        __m256i a_hi = _mm256_or_si256(
+                _mm256_and_si256(_mm256_srli_epi64(a, 4), nibble), mask_hi_a);
+        __m256i b_lo = _mm256_or_si256(_mm256_and_si256(b, nibble),
+                mask_lo_b);
+        __m256i b_hi = _mm256_or_si256(
+                _mm256_and_si256(_mm256_srli_epi64(b, 4), nibble), mask_hi_b);
+
+        // Max. byte value: 4 * 34 (enthalpy) resp. 2 * 73 (entropy).
+        __m256i h = _mm256_add_epi8(
+                _mm256_add_epi8(_mm256_shuffle_epi8(table_h, a_lo),
+                        _mm256_shuffle_epi8(table_h, a_hi)),
+                _mm256_add_epi8(_mm256_shuffle_epi8(table_h, b_lo),
+                        _mm256_shuffle_epi8(table_h, b_hi)));
+        __m256i s_a = _mm256_add_epi8(_mm256_shuffle_epi8(table_s, a_lo),
+                _mm256_shuffle_epi8(table_s, a_hi));
+        __m256i s_b = _mm256_add_epi8(_mm256_shuffle_epi8(table_s, b_lo),
+                _mm256_shuffle_epi8(table_s, b_hi));
+
+        uint64_t res_h[4];
+        uint64_t res_s[4];
+        _mm256_storeu_si256((__m256i *) res_h, _mm256_sad_epu8(h, zero));
+        _mm256_storeu_si256((__m256i *) res_s,
+                _mm256_add_epi64(_mm256_sad_epu8(s_a, zero),
+                        _mm256_sad_epu8(s_b, zero)));
+        for (unsigned int j = 0; j < 4; ++j) {
+            sum_h[i + j] = (unsigned int) res_h[j];
+            sum_s[i + j] = (unsigned int) res_s[j];
+        }
+    }
+    nn_sums_scalar(nn, signatures + i, length, n - i, sum_h + i, sum_s + i);
+}
+#endif
+
+typedef void (*nn_sums_kernel)(const struct NNTables *, const uint64_t *,
+        unsigned int, unsigned int, unsigned int *, unsigned int *);
+
+/*!
+ * Selects the fastest batch kernel that is supported by the CPU.
+ */
+static nn_sums_kernel select_nn_sums_kernel() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return nn_sums_avx2;
+    if (__builtin_cpu_supports("ssse3"))
+        return nn_sums_ssse3;
+#endif
+    return nn_sums_scalar;
+}
+
+/*!
+ * Number of G and C bases in a packed signature.
+ * (C = 01 and G = 10 are the only encodings with two different bits.)
+ */
+static inline unsigned int count_gc(uint64_t v, uint64_t length_mask) {
+    v = (v ^ (v >> 1)) & length_mask;
+#if defined(__GNUC__)
+    return __builtin_popcountll(v);
+#else
+    unsigned int count = 0;
+    for (; v; v &= v - 1)
+        ++count;
+    return count;
+#endif
+}
+
+/*!
+ * Translation table (bases --> array indices)
+ * A/a=0x00, C/c=0x01, G/g=0x02, T/t/U/u=0x03, all other characters 0xFF.
+ */
+const unsigned char Thermodynamics::m_translation_table[256] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0x00, 0xFF, 0x01, 0xFF, 0xFF, 0xFF, 0x02, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0x00, 0xFF, 0x01, 0xFF, 0xFF, 0xFF, 0x02, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
 
 /*!
  * Enthalpy values (--> delta_h; in kcal/mol)
@@ -35,9 +313,10 @@
  * GA,GC,GG,GT
  * TA,TC,TG,TT
  */
-//const double Thermodynamics::m_array_h[4][4] = { { -7.9, -8.4, -7.8, -7.2 }, {
-//        -8.5, -8.0, -10.6, -7.8 }, { -8.2, -10.6, -8.0, -8.4 }, { -7.2, -8.2,
-//        -8.5, -7.9 } };
+const double Thermodynamics::m_array_h[4][4] = { { -7.9, -8.4, -7.8, -7.2 }, {
+        -8.5, -8.0, -10.6, -7.8 }, { -8.2, -10.6, -8.0, -8.4 }, { -7.2, -8.2,
+        -8.5, -7.9 } };
+
 /*!
  * Entropy values (--> delta_s; in cal/(mol * K))
  * (needed for base stacking)
@@ -47,74 +326,28 @@
  * GA,GC,GG,GT
  * TA,TC,TG,TT
  */
-//const double Thermodynamics::m_array_s[4][4] = {
-//        { -22.2, -22.4, -21.0, -20.4 }, { -22.7, -19.9, -27.2, -21.0 }, {
-//                -22.2, -27.2, -19.9, -22.4 }, { -21.3, -22.2, -22.7, -22.2 } };
+const double Thermodynamics::m_array_s[4][4] = {
+        { -22.2, -22.4, -21.0, -20.4 }, { -22.7, -19.9, -27.2, -21.0 }, {
+                -22.2, -27.2, -19.9, -22.4 }, { -21.3, -22.2, -22.7, -22.2 } };
+
 /*!
  * Thermodynamics -- Constructor
+ * All tables are static. Signatures up to a length of
+ * THERMODYNAMICS_BUF_SIZE are translated without heap allocations.
  */
 Thermodynamics::Thermodynamics() :
 m_test_gc(false), m_test_tm(false), m_test_tm_basic(false), m_min_gc(0), m_max_gc(
         0), m_gc(0), m_tm_basic(0), m_min_tm(0), m_max_tm(0), m_delta_h(
-                0), m_delta_s(0), m_tm(0), m_translation_table(NULL), m_buf_size(
-                        0), m_buf_vsize(0), m_buf(NULL) {
-    // Initialize translation table (bases --> array indices)
-    m_translation_table = (unsigned char *) malloc(256 * sizeof(char));
-    memset(m_translation_table, 0xFF, 256);
-    m_translation_table[(unsigned char) 'A'] = 0x00;
-    m_translation_table[(unsigned char) 'a'] = 0x00;
-    m_translation_table[(unsigned char) 'C'] = 0x01;
-    m_translation_table[(unsigned char) 'c'] = 0x01;
-    m_translation_table[(unsigned char) 'G'] = 0x02;
-    m_translation_table[(unsigned char) 'g'] = 0x02;
-    m_translation_table[(unsigned char) 'T'] = 0x03;
-    m_translation_table[(unsigned char) 't'] = 0x03;
-    m_translation_table[(unsigned char) 'U'] = 0x03;
-    m_translation_table[(unsigned char) 'u'] = 0x03;
-
-    // Enthalpy values (--> delta_h; in kcal/mol)
-    m_array_h[0][0] = -7.9; // AA
-    m_array_h[0][1] = -8.4; // AC
-    m_array_h[0][2] = -7.8; // AG
-    m_array_h[0][3] = -7.2; // AT
-    m_array_h[1][0] = -8.5; // CA
-    m_array_h[1][1] = -8.0; // CC
-    m_array_h[1][2] = -10.6; // CG
-    m_array_h[1][3] = -7.8; // CT
-    m_array_h[2][0] = -8.2; // GA
-    m_array_h[2][1] = -10.6; // GC
-    m_array_h[2][2] = -8.0; // GG
-    m_array_h[2][3] = -8.4; // GT
-    m_array_h[3][0] = -7.2; // TA
-    m_array_h[3][1] = -8.2; // TC
-    m_array_h[3][2] = -8.5; // TG
-    m_array_h[3][3] = -7.9; // TT
-
-    // Entropy values (--> delta_s; in cal/(mol * K))
-    m_array_s[0][0] = -22.2; // AA
-    m_array_s[0][1] = -22.4; // AC
-    m_array_s[0][2] = -21.0; // AG
-    m_array_s[0][3] = -20.4; // AT
-    m_array_s[1][0] = -22.7; // CA
-    m_array_s[1][1] = -19.9; // CC
-    m_array_s[1][2] = -27.2; // CG
-    m_array_s[1][3] = -21.0; // CT
-    m_array_s[2][0] = -22.2; // GA
-    m_array_s[2][1] = -27.2; // GC
-    m_array_s[2][2] = -19.9; // GG
-    m_array_s[2][3] = -22.4; // GT
-    m_array_s[3][0] = -21.3; // TA
-    m_array_s[3][1] = -22.2; // TC
-    m_array_s[3][2] = -22.7; // TG
-    m_array_s[3][3] = -22.2; // TT
+                0), m_delta_s(0), m_tm(0), m_buf_size(0), m_buf_vsize(
+                        THERMODYNAMICS_BUF_SIZE), m_buf(m_fixed_buf) {
 }
 
 /*!
  * Thermodynamics -- Destructor
  */
 Thermodynamics::~Thermodynamics() {
-    free(m_translation_table);
-    free(m_buf);
+    if (m_buf != m_fixed_buf)
+        free(m_buf);
 }
 
 /*!
@@ -201,6 +434,207 @@ void Thermodynamics::process(const char *signature) {
     internal_thermodynamics();
 }
 
+/*!
+ * Process a 2-bit packed signature (without further evaluation).
+ * No translation is necessary. The computations are identical to the ones
+ * for signature strings.
+ */
+void Thermodynamics::process(uint64_t signature, unsigned int length) {
+    if (length == 0 || length > 32) {
+        m_gc = 0;
+        m_tm_basic = 0;
+        m_delta_h = 0;
+        m_delta_s = 0;
+        m_tm = 0;
+        return;
+    }
+
+    unsigned int basecount[4] = { 0, 0, 0, 0 };
+    for (unsigned int i = 0; i < length; ++i)
+        ++basecount[(signature >> (2 * i)) & 0x03];
+    internal_basics(basecount, length);
+
+    m_delta_h = 0;
+    m_delta_s = 0;
+    m_delta_s += salt_correction(length);
+    terminal_correction((signature >> (2 * length - 2)) & 0x03);
+    terminal_correction(signature & 0x03);
+
+    // Base stacking, starting with the first dinucleotide.
+    for (unsigned int shift = 2 * length - 2; shift >= 2; shift -= 2) {
+        unsigned int first = (signature >> shift) & 0x03;
+        unsigned int next = (signature >> (shift - 2)) & 0x03;
+        m_delta_h += m_array_h[first][next];
+        m_delta_s += m_array_s[first][next];
+    }
+
+    m_tm = melting_temperature(m_delta_h, m_delta_s);
+}
+
+/*!
+ * Process a signature of a signature pool (without further evaluation).
+ * The Base4 encoding of packed pools (four bases per byte, starting at the
+ * lowest bits) is rearranged into the 2-bit packed format. Longer
+ * signatures and signatures of plain pools are processed as strings.
+ */
+void Thermodynamics::process(const SignaturePool *pool, uint32_t handle) {
+    const unsigned int length = pool->length(handle);
+    if (pool->isPacked() && (length > 0) && (length <= 32)) {
+        const unsigned char *seq = (const unsigned char *) pool->packed(
+                handle);
+        uint64_t signature = 0;
+        for (unsigned int i = 0; i < length; ++i)
+            signature = (signature << 2)
+                    | ((seq[i / 4] >> ((i % 4) * 2)) & 0x03);
+        process(signature, length);
+        return;
+    }
+    char buffer[SIGNATURE_BUFFER_SIZE];
+    process(pool->get(handle, buffer));
+}
+
+/*!
+ * Batch-processing of multiple signatures (fixed stride).
+ * Signatures are translated into the packed 2-bit format and evaluated with
+ * the packed batch kernels. Signatures with a length above 32 bases or with
+ * characters that can not be translated are evaluated one by one.
+ *
+ * \return Number of signatures that match all criteria.
+ */
+unsigned int Thermodynamics::batch_process(const char *signatures,
+        unsigned int stride, unsigned int length, unsigned int n,
+        unsigned char *pass, double *gc, double *tm) {
+    uint64_t packed[256];
+    bool packable[256];
+    unsigned int passed = 0;
+
+    for (unsigned int offset = 0; offset < n; offset += 256) {
+        unsigned int count = (n - offset < 256) ? n - offset : 256;
+        bool all_packable = (length > 0) && (length <= 32);
+
+        // Translate the signatures into the packed format.
+        for (unsigned int i = 0; i < count; ++i) {
+            const unsigned char *in = (const unsigned char *) signatures
+                    + (size_t) (offset + i) * stride;
+            uint64_t v = 0;
+            packable[i] = (length > 0) && (length <= 32);
+            for (unsigned int j = 0; packable[i] && j < length; ++j) {
+                unsigned char base = m_translation_table[in[j]];
+                if (base == 0xFF)
+                    packable[i] = false;
+                v = (v << 2) | (base & 0x03);
+            }
+            packed[i] = v;
+            all_packable &= packable[i];
+        }
+
+        if ((length > 0) && (length <= 32))
+            passed += batch_process(packed, length, count, pass + offset,
+                    gc ? gc + offset : NULL, tm ? tm + offset : NULL);
+
+        // Evaluate the remaining signatures one by one.
+        if (!all_packable) {
+            std::string signature;
+            for (unsigned int i = 0; i < count; ++i) {
+                if (packable[i])
+                    continue;
+                signature.assign(signatures + (size_t) (offset + i) * stride,
+                        length);
+                process(signature.c_str());
+                if ((length > 0) && (length <= 32))
+                    passed -= pass[offset + i];
+                pass[offset + i] = passes(m_gc, m_tm) ? 1 : 0;
+                passed += pass[offset + i];
+                if (gc)
+                    gc[offset + i] = m_gc;
+                if (tm)
+                    tm[offset + i] = m_tm;
+            }
+        }
+    }
+    return passed;
+}
+
+/*!
+ * Batch-processing of multiple 2-bit packed signatures.
+ *
+ * \return Number of signatures that match all criteria.
+ */
+unsigned int Thermodynamics::batch_process(const uint64_t *signatures,
+        unsigned int length, unsigned int n, unsigned char *pass, double *gc,
+        double *tm) {
+    if (length == 0 || length > 32) {
+        memset(pass, 0, n);
+        return 0;
+    }
+
+    // The fastest kernel is selected once.
+    static const nn_sums_kernel nn_sums = select_nn_sums_kernel();
+    static const struct NNTables nn = make_nn_tables(m_array_h, m_array_s);
+
+    const bool need_tm = m_test_tm || (tm != NULL);
+    const uint64_t gc_mask = (length == 32) ? 0x5555555555555555ULL :
+            (0x5555555555555555ULL & ((((uint64_t) 1) << (2 * length)) - 1));
+    const double salt = salt_correction(length);
+    const int nn_offset_h = (int) (length - 1) * nn.h_offset;
+    const int nn_offset_s = (int) (length - 1) * nn.s_offset;
+
+    unsigned int sum_h[256];
+    unsigned int sum_s[256];
+    unsigned int passed = 0;
+
+    for (unsigned int offset = 0; offset < n; offset += 256) {
+        unsigned int count = (n - offset < 256) ? n - offset : 256;
+        const uint64_t *chunk = signatures + offset;
+
+        if (need_tm)
+            nn_sums(&nn, chunk, length, count, sum_h, sum_s);
+
+        for (unsigned int i = 0; i < count; ++i) {
+            uint64_t v = chunk[i];
+            double gc_value = (double) count_gc(v, gc_mask) * 100
+                    / (double) length;
+            double tm_value = 0;
+
+            if (need_tm) {
+                // Primary/Terminal corrections. (SantaLucia1998)
+                int h = 0;
+                int s = 0;
+                unsigned int first = (v >> (2 * length - 2)) & 0x03;
+                unsigned int last = v & 0x03;
+                h += ((first ^ (first >> 1)) & 1) ? 1 : 23;
+                s += ((first ^ (first >> 1)) & 1) ? -28 : 41;
+                h += ((last ^ (last >> 1)) & 1) ? 1 : 23;
+                s += ((last ^ (last >> 1)) & 1) ? -28 : 41;
+
+                // Base stacking.
+                h += (int) sum_h[i] - nn_offset_h;
+                s += (int) sum_s[i] - nn_offset_s;
+                tm_value = melting_temperature(h / 10.0, s / 10.0 + salt);
+            }
+
+            pass[offset + i] = passes(gc_value, tm_value) ? 1 : 0;
+            passed += pass[offset + i];
+            if (gc)
+                gc[offset + i] = gc_value;
+            if (tm)
+                tm[offset + i] = tm_value;
+        }
+    }
+    return passed;
+}
+
+/*!
+ * Checks the given values against the enabled criteria.
+ */
+bool Thermodynamics::passes(double gc, double tm) const {
+    if (m_test_gc && (gc < m_min_gc || gc > m_max_gc))
+        return false;
+    if (m_test_tm && (tm < m_min_tm || tm > m_max_tm))
+        return false;
+    return true;
+}
+
 /*!
  * Copy the signature into our buffer and translate it into
  * a manageable format.
@@ -217,13 +651,16 @@ unsigned int Thermodynamics::translate(const char *signature) {
 
         // Reallocate memory for our buffer, if necessary...
         if (m_buf_size > m_buf_vsize) {
-            m_buf = (unsigned char *) realloc(m_buf,
+            unsigned char *buf = (unsigned char *) malloc(
                     m_buf_size * sizeof(unsigned char));
-            if (!m_buf) {
+            if (!buf) {
                 m_buf_size = 0;
-                m_buf_vsize = 0;
                 return false;
             }
+            if (m_buf != m_fixed_buf)
+                free(m_buf);
+            m_buf = buf;
+            m_buf_vsize = m_buf_size;
         }
         // Create start pointers...
         const unsigned char *in = (const unsigned char*) signature;
@@ -248,11 +685,18 @@ void Thermodynamics::internal_basics() {
     unsigned int basecount[4] = { 0, 0, 0, 0 };
     for (unsigned int i = 0; i < m_buf_size; ++i)
         ++basecount[(unsigned int) m_buf[i]];
+    internal_basics(basecount, m_buf_size);
+}
 
+/*!
+ * Internal G+C content calculation, based on the number of A, C, G and T/U.
+ */
+void Thermodynamics::internal_basics(const unsigned int *basecount,
+        unsigned int length) {
     // Compute G+C content
-    m_gc = (double) (basecount[1] + basecount[2]) * 100 / (double) m_buf_size;
+    m_gc = (double) (basecount[1] + basecount[2]) * 100 / (double) length;
 
-    if (m_buf_size < 14) {
+    if (length < 14) {
         // For lengths < 14 compute temperature according to:
         // Marmur,J., and Doty,P. (1962) J Mol Biol 5:109-118
         m_tm_basic = ((basecount[1] + basecount[2]) * 4
@@ -261,8 +705,7 @@ void Thermodynamics::internal_basics() {
         // For lengths > 13 compute temperature according to:
         // Wallace,R.B., Shaffer,J., Murphy,R.F., Bonner,J., Hirose,T., and
         // Itakura,K. (1979) Nucleic Acids Res 6:3543-3557
-        m_tm_basic = 64.9
-                + 41 * (basecount[1] + basecount[2] - 16.4) / m_buf_size;
+        m_tm_basic = 64.9 + 41 * (basecount[1] + basecount[2] - 16.4) / length;
     }
 }
 
@@ -274,39 +717,12 @@ void Thermodynamics::internal_thermodynamics() {
     m_delta_h = 0;
     m_delta_s = 0;
 
-    // TODO: Predefined environment settings!
-    // All concentrations in mmol/l (millimol/liter)
-    double c_salt = 1000.0; // == 1 mol/l
-    double c_mg = 0.0;
-    double c_oligo = 0.00001; // == 10 nmol/l
-
-    // Effect on entropy by salt correction. (Ahsen et al. 1999)
-    // Increase of stability due to presence of Mg (--> effect on entropy).
-    double salt_effect = (c_salt / 1000) + ((c_mg / 1000) * 140);
-    m_delta_s += 0.368 * m_buf_size * log(salt_effect); // TODO: or (m_buf_size - 1)?
+    // Effect on entropy by salt correction.
+    m_delta_s += salt_correction(m_buf_size);
 
     // Primary/Terminal corrections. (SantaLucia1998)
-    char firstnucleotide = m_buf[0];
-    if (firstnucleotide == 0x01 || firstnucleotide == 0x02) {
-        // Primary C or G
-        m_delta_h += 0.1;
-        m_delta_s += -2.8;
-    } else {
-        // Primary A or T
-        m_delta_h += 2.3;
-        m_delta_s += 4.1;
-    }
-
-    char lastnucleotide = m_buf[m_buf_size - 1];
-    if (lastnucleotide == 0x01 || lastnucleotide == 0x02) {
-        // Terminal C or G
-        m_delta_h += 0.1;
-        m_delta_s += -2.8;
-    } else {
-        // Terminal A or T
-        m_delta_h += 2.3;
-        m_delta_s += 4.1;
-    }
+    terminal_correction(m_buf[0]);
+    terminal_correction(m_buf[m_buf_size - 1]);
 
     // Compute delta_h and delta_s with base stacking (SantaLucia1998)
     for (unsigned int i = 0; i < m_buf_size - 1; ++i) {
@@ -317,10 +733,23 @@ void Thermodynamics::internal_thermodynamics() {
     }
 
     // Compute the melting temperature.
-    // log(c_oligo / (1000 * 4)) --> self complementary oligo.
-    // log(c_oligo / (1000 * 2)) --> _NOT_ self complementary oligo.
-    m_tm = ((1000 * m_delta_h)
-            / (m_delta_s + (1.987 * log(c_oligo / (1000 * 2))))) - 273.15;
+    m_tm = melting_temperature(m_delta_h, m_delta_s);
+}
+
+/*!
+ * Primary/Terminal correction for the first or last nucleotide.
+ * (SantaLucia1998)
+ */
+void Thermodynamics::terminal_correction(unsigned int nucleotide) {
+    if (nucleotide == 0x01 || nucleotide == 0x02) {
+        // Primary/Terminal C or G
+        m_delta_h += 0.1;
+        m_delta_s += -2.8;
+    } else {
+        // Primary/Terminal A or T
+        m_delta_h += 2.3;
+        m_delta_s += 4.1;
+    }
 }
 
 /*!
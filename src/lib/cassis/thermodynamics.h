@@ -24,6 +24,16 @@
 #ifndef THERMODYNAMICS_H_
 #define THERMODYNAMICS_H_
 
+#include <cstddef>
+#include <stdint.h>
+
+class SignaturePool;
+
+/*!
+ * Signatures up to this length are translated without heap allocations.
+ */
+#define THERMODYNAMICS_BUF_SIZE 32
+
 /*!
  * Thermodynamics class
  */
@@ -65,6 +75,42 @@ public:
      */
     bool batch_process(const char *signature);
 
+    /*!
+     * Batch-process multiple signatures of the same length.
+     * The signatures are stored one after another with a fixed stride.
+     *
+     * \param signatures Signature buffer (n * stride characters).
+     * \param stride Distance (in characters) between two signatures.
+     * \param length Length of the signatures.
+     * \param n Number of signatures.
+     * \param pass Array of n entries: 1, if a signature matches all
+     *        criteria, otherwise 0.
+     * \param gc Optional array of n G+C values (in percent) or NULL.
+     * \param tm Optional array of n melting temperatures or NULL.
+     * \return Number of signatures that match all criteria.
+     */
+    unsigned int batch_process(const char *signatures, unsigned int stride,
+            unsigned int length, unsigned int n, unsigned char *pass,
+            double *gc = NULL, double *tm = NULL);
+
+    /*!
+     * Batch-process multiple 2-bit packed signatures of the same length.
+     * Encoding: A=0, C=1, G=2, T/U=3. The first base is stored in the
+     * most significant bits. Max. signature length: 32 bases.
+     *
+     * \param signatures Array of n packed signatures.
+     * \param length Length of the signatures.
+     * \param n Number of signatures.
+     * \param pass Array of n entries: 1, if a signature matches all
+     *        criteria, otherwise 0.
+     * \param gc Optional array of n G+C values (in percent) or NULL.
+     * \param tm Optional array of n melting temperatures or NULL.
+     * \return Number of signatures that match all criteria.
+     */
+    unsigned int batch_process(const uint64_t *signatures, unsigned int length,
+            unsigned int n, unsigned char *pass, double *gc = NULL,
+            double *tm = NULL);
+
     /*!
      * Process a signature (without further evaluation)
      *
@@ -72,6 +118,26 @@ public:
      */
     void process(const char *signature);
 
+    /*!
+     * Process a 2-bit packed signature (without further evaluation).
+     * Encoding: A=0, C=1, G=2, T/U=3. The first base is stored in the
+     * most significant bits. Max. signature length: 32 bases.
+     *
+     * \param signature Packed signature that should be evaluated.
+     * \param length Length of the signature.
+     */
+    void process(uint64_t signature, unsigned int length);
+
+    /*!
+     * Process a signature of a signature pool (without further evaluation).
+     * Signatures of packed pools with up to 32 bases are evaluated in the
+     * 2-bit packed format, i.e. without decoding them.
+     *
+     * \param pool Signature pool.
+     * \param handle Handle of the signature that should be evaluated.
+     */
+    void process(const SignaturePool *pool, uint32_t handle);
+
     /*!
      * Get the G+C content value of the last processed signature.
      *
@@ -116,6 +182,14 @@ private:
      */
     unsigned int translate(const char *signature);
 
+    /*!
+     * Checks G+C content and melting temperature against the enabled
+     * criteria.
+     *
+     * \return True, if all enabled criteria are met.
+     */
+    bool passes(double gc, double tm) const;
+
     /*!
      * Flags, used to enable/disable certain tests...
      */
@@ -130,6 +204,7 @@ private:
      *   - Basic melting temperature according to Marmur1962/Wallace1979
      */
     void internal_basics();
+    void internal_basics(const unsigned int *basecount, unsigned int length);
     //
     double m_min_gc;
     double m_max_gc;
@@ -141,6 +216,7 @@ private:
      * Internal. Various extended thermodynamical calculations.
      */
     void internal_thermodynamics();
+    void terminal_correction(unsigned int nucleotide);
     //
     double m_min_tm;
     double m_max_tm;
@@ -152,16 +228,18 @@ private:
     /*!
      * Base translation, entropy and enthalpy tables...
      */
-    unsigned char *m_translation_table;
-    double m_array_h[4][4];
-    double m_array_s[4][4];
+    static const unsigned char m_translation_table[256];
+    static const double m_array_h[4][4];
+    static const double m_array_s[4][4];
 
     /*!
      * (Translated) signature buffer...
+     * Points to m_fixed_buf for short signatures.
      */
     unsigned int m_buf_size;
     unsigned int m_buf_vsize;
     unsigned char *m_buf;
+    unsigned char m_fixed_buf[THERMODYNAMICS_BUF_SIZE];
 };
 
 #endif /* THERMODYNAMICS_H_ */
@@ -38,9 +38,9 @@
 CaSSiSTreeNode::CaSSiSTreeNode(unsigned int allowed_outgroup_matches) :
 left(NULL), right(NULL), parent(NULL), this_id(ID_TYPE_UNDEF), leftmost_id(
         ID_TYPE_UNDEF), rightmost_id(ID_TYPE_UNDEF), num_matches(NULL), signatures(
-                NULL), group(NULL), starting_solution((unsigned int) -1), best_ingroup_coverage(
+                NULL), pool(NULL), depth(0), group(NULL), starting_solution((unsigned int) -1), best_ingroup_coverage(
                         0), mutex(NULL) {
-    signatures = new StrRefSet[allowed_outgroup_matches + 1];
+    signatures = new UnorderedIntSet[allowed_outgroup_matches + 1];
     num_matches = new unsigned int[allowed_outgroup_matches + 1];
 
     for (unsigned int i = 0; i <= allowed_outgroup_matches; ++i)
@@ -81,13 +81,22 @@ bool CaSSiSTreeNode::isLeaf() {
  * This function is adds a signature-sequence relationship
  * to the node. (Replaces an existing matching, if better.)
  */
-bool CaSSiSTreeNode::addMatching(char *signature, unsigned int ingroup_matches,
-        unsigned int outgroup_matches) {
+bool CaSSiSTreeNode::addMatching(uint32_t signature,
+        unsigned int ingroup_matches, unsigned int outgroup_matches,
+        unsigned int starting_solution) {
+    // Unlocked pre-check: the counts only grow, so a stale value just
+    // leads to the check under the lock.
     if ((ingroup_matches > 0)
             && (ingroup_matches >= num_matches[outgroup_matches])) {
 
 #ifdef PTHREADS
         pthread_mutex_lock((pthread_mutex_t*) mutex);
+
+        // Another thread may have found a better solution meanwhile.
+        if (ingroup_matches < num_matches[outgroup_matches]) {
+            pthread_mutex_unlock((pthread_mutex_t*) mutex);
+            return false;
+        }
 #endif
 
         if (ingroup_matches > num_matches[outgroup_matches]) {
@@ -99,8 +108,11 @@ bool CaSSiSTreeNode::addMatching(char *signature, unsigned int ingroup_matches,
         signatures[outgroup_matches].add(signature);
 
         // Store the best coverage 'score' that was achieved.
-        if (ingroup_matches > best_ingroup_coverage)
+        if (ingroup_matches > best_ingroup_coverage) {
             best_ingroup_coverage = ingroup_matches;
+            if (starting_solution != (unsigned int) -1)
+                this->starting_solution = starting_solution;
+        }
 
 #ifdef PTHREADS
         pthread_mutex_unlock((pthread_mutex_t*) mutex);
@@ -112,6 +124,23 @@ bool CaSSiSTreeNode::addMatching(char *signature, unsigned int ingroup_matches,
     return false;
 }
 
+/*!
+ * Number of signatures stored for the given number of outgroup matches.
+ */
+unsigned int CaSSiSTreeNode::numSignatures(
+        unsigned int outgroup_matches) const {
+    return signatures[outgroup_matches].size();
+}
+
+/*!
+ * Returns signature k for the given number of outgroup matches.
+ * Base4-encoded signatures are decoded (as RNA) into 'buffer'.
+ */
+const char *CaSSiSTreeNode::signature(unsigned int outgroup_matches,
+        unsigned int k, char *buffer) const {
+    return pool->get(signatures[outgroup_matches].val(k), buffer);
+}
+
 /*!
  * Computes the binary logarithm of an unsigned 32 bit value.
  * Returns 0 when 'bits' equals 0x00000000.
@@ -202,15 +231,16 @@ bool CaSSiSTree::addMatching(const char *signature, IntSet *matches,
                 representative[matches->val(num_matches - 1)]);
 
         // Add a copy of the signature to our internal list of signatures.
-        // Only pointers to them are stored in the CaSSiS Tree nodes.
-        char *sig_ptr = strdup(signature);
-        signatures.add(sig_ptr);
+        // Only handles to them are stored in the CaSSiS Tree nodes.
+        uint32_t sig_handle = signatures.add(signature);
+        if (sig_handle == SIGNATURE_HANDLE_UNDEF)
+            return false;
 
         // (4) The node at eulertour[pos] represents the LCA of the given leaves.
         CaSSiSTreeNode *node = eulertour[pos];
 
         // Propagate the matching downwards, starting with the found node.
-        propagateDownwards(node, sig_ptr, matches,
+        propagateDownwards(node, sig_handle, matches,
                 unspecified_outgroup_matches);
 
         // Propagate the matching upwards, as long as we have found an equal
@@ -223,7 +253,8 @@ bool CaSSiSTree::addMatching(const char *signature, IntSet *matches,
                 node->signatures[unspecified_outgroup_matches].clear();
                 node->num_matches[unspecified_outgroup_matches] = num_matches;
             }
-            node->signatures[unspecified_outgroup_matches].add(sig_ptr);
+            node->signatures[unspecified_outgroup_matches].add(sig_handle);
+            node->pool = &signatures;
 
             // Go one level up in the tree.
             node = node->parent;
@@ -250,7 +281,7 @@ bool CaSSiSTree::addMatching(const char *signature, IntSet *matches,
  * \param unspecified_outgroup_matches Number of outgroup matches that are not
  *        directly related to the tree structure.
  */
-void CaSSiSTree::propagateDownwards(CaSSiSTreeNode *node, char *signature,
+void CaSSiSTree::propagateDownwards(CaSSiSTreeNode *node, uint32_t signature,
         IntSet *matches, unsigned int unspecified_outgroup_matches) {
     // Find out how many outgroup matches we have including this node.
     // Check for leaves==matches left of the current subtree.
@@ -289,6 +320,7 @@ void CaSSiSTree::propagateDownwards(CaSSiSTreeNode *node, char *signature,
                 node->num_matches[outgroup_matches_here] = num_matches;
             }
             node->signatures[outgroup_matches_here].add(signature);
+            node->pool = &signatures;
         }
 
         // Propagate the matching to the child nodes, if available.
@@ -345,18 +377,11 @@ bool CaSSiSTree::enforceExtMapping_internal(const NameMap &map,
         // Process the left subtree...
         retval = enforceExtMapping_internal(map, node->left);
 
-        // Fetch NEW group IDs from the left child.
-        IntSet *group = node->left->group;
-        for (unsigned int i = 0; i < group->size(); i++)
-            node->group->add(group->val(i));
-
         // Process the right subtree...
         retval &= enforceExtMapping_internal(map, node->right);
 
-        // Fetch NEW group IDs from the right child.
-        group = node->right->group;
-        for (unsigned int i = 0; i < group->size(); i++)
-            node->group->add(group->val(i));
+        // Fetch NEW group IDs from both children.
+        node->group->merge(node->left->group, node->right->group);
 
     }
     return retval;
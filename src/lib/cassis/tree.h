@@ -26,6 +26,7 @@
 
 #include "types.h"
 #include "namemap.h"
+#include "sigpool.h"
 
 /*!
  * CaSSiS Tree node.
@@ -39,10 +40,26 @@ public:
     /*!
      * This function is adds a signature <-> sequence relationship
      * to the node. (Replaces an existing matching, if better.)
+     * If defined, 'starting_solution' is stored along with a new best
+     * ingroup coverage.
      * \return true, if successfully added. Otherwise false.
      */
-    bool addMatching(char *signature, unsigned int ingroup_matches,
-            unsigned int outgroup_matches);
+    bool addMatching(uint32_t signature, unsigned int ingroup_matches,
+            unsigned int outgroup_matches,
+            unsigned int starting_solution = (unsigned int) -1);
+
+    /*!
+     * Number of signatures stored for the given number of outgroup matches.
+     */
+    unsigned int numSignatures(unsigned int outgroup_matches) const;
+
+    /*!
+     * Returns signature k for the given number of outgroup matches.
+     * Base4-encoded signatures are decoded (as RNA) into 'buffer', which
+     * has to hold at least SIGNATURE_BUFFER_SIZE characters.
+     */
+    const char *signature(unsigned int outgroup_matches, unsigned int k,
+            char *buffer) const;
 
     /*!
      * Reference to the parent and child nodes.
@@ -64,7 +81,12 @@ public:
      * of ingroup matches.
      */
     unsigned int *num_matches;
-    StrRefSet *signatures;
+    UnorderedIntSet *signatures;
+
+    /*!
+     * Signature pool the signature handles refer to.
+     */
+    const SignaturePool *pool;
 
     /*!
      * Depth of the node within the tree
@@ -178,13 +200,13 @@ public:
      * \param unspecified_outgroup_matches Number of outgroup matches that are not
      *        directly related to the tree structure.
      */
-    void propagateDownwards(CaSSiSTreeNode *node, char *signature,
+    void propagateDownwards(CaSSiSTreeNode *node, uint32_t signature,
             IntSet *matches, unsigned int unspecified_outgroup_matches);
 
 public:
     unsigned int allowed_outgroup_matches;
     CaSSiSTreeNode *tree_root;
-    StrSet signatures;
+    SignaturePool signatures;
     NameMap leaf_mapping;
     NameMap group_mapping;
     bool uses_external_mapping;
@@ -25,6 +25,7 @@
 #ifndef BGRT_TYPE_H_
 #define BGRT_TYPE_H_
 
+#include <algorithm>
 #include <cstring>
 #include <cstdlib>
 
@@ -40,17 +41,45 @@ typedef unsigned int id_type;
 #define ID_TYPE_UNDEF ((id_type)-1)
 #endif
 
+/*!
+ * Number of bytes of set values that are stored within the set itself
+ * instead of being allocated separately (two integers or one pointer).
+ */
+#ifndef SET_INLINE_BYTES
+#define SET_INLINE_BYTES 8
+#endif
+
 /*!
  * Ordered set template class.
+ *
+ * Small sets (up to INLINE_SIZE values) are stored inline, i.e. they
+ * need no separate allocation. The values are moved to the heap once
+ * the set grows beyond that.
+ *
+ * Large sets should not be built with add() (binary search and memmove
+ * per value), but with append() and a single finalize(), or with merge().
  */
 template<typename T> class OSet {
 public:
+    /*!
+     * Number of values that are stored inline.
+     */
+    enum {
+        INLINE_SIZE = (SET_INLINE_BYTES / sizeof(T)) ? (SET_INLINE_BYTES
+                / sizeof(T)) : 1
+    };
+
     /*!
      * Constructor.
      * \param initial_size Size, that should initially be allocated.
      */
     OSet(unsigned int initial_size = 0);
 
+    /*!
+     * Constructor. Creates the union of two sets (see merge()).
+     */
+    OSet(const OSet<T> *s1, const OSet<T> *s2);
+
     /*!
      * Destructor
      */
@@ -75,6 +104,32 @@ public:
      */
     unsigned int add(const T &v);
 
+    /*!
+     * Appends a value/element v to the end of the set, without sorting
+     * and without checking for duplicates. finalize() has to be called
+     * before the set is used as an ordered set again.
+     * The set takes control over the element (i.e. will de-allocate it).
+     */
+    void append(const T &v);
+
+    /*!
+     * Sorts the values in ascending order and removes duplicates
+     * (after append()).
+     */
+    void finalize();
+
+    /*!
+     * Replaces the contents of the set with the union of s1 and s2.
+     * Neither of both may be this set.
+     * Existing entries are not de-allocated (see unref()).
+     */
+    void merge(const OSet<T> *s1, const OSet<T> *s2);
+
+    /*!
+     * Allocates space for (at least) 'size' entries.
+     */
+    void reserve(unsigned int size);
+
     /*!
      * Get value
      * \return Value at pos in the set.
@@ -113,7 +168,21 @@ public:
      * Returns a pointer to the stored values of the set.
      * Handle with care!
      */
-    const T *val_ptr();
+    const T *val_ptr() const;
+    T *val_ptr();
+
+    /*!
+     * Replaces the contents of the set with the first n values of vals.
+     * The values have to be unique and sorted in ascending order.
+     * Existing entries are not de-allocated (see unref()).
+     */
+    void assign(const T *vals, unsigned int n);
+
+    /*!
+     * Exchanges the contents (values and allocated memory) of this set
+     * and oset.
+     */
+    void swap(OSet<T> *oset);
 protected:
     /*!
      * Number of entries in the set.
@@ -122,13 +191,40 @@ protected:
 
     /*!
      * Number of entries for which we have allocated space.
+     * At least INLINE_SIZE; the values are stored inline, if the
+     * capacity does not exceed INLINE_SIZE.
      */
     unsigned int m_vsize;
 
     /*!
-     * Values in the set.
+     * Values in the set; stored inline, if the set is small enough.
      */
-    T *m_val;
+    union {
+        T *ptr;
+        T vals[INLINE_SIZE];
+    } m_data;
+
+    /*!
+     * Returns a pointer to the stored values.
+     */
+    T *data() {
+        return (m_vsize > INLINE_SIZE) ? m_data.ptr : m_data.vals;
+    }
+    const T *data() const {
+        return (m_vsize > INLINE_SIZE) ? m_data.ptr : m_data.vals;
+    }
+
+    /*!
+     * Grows the capacity to at least 'size' entries. The stored values
+     * are kept.
+     */
+    void grow(unsigned int size);
+
+    /*!
+     * Frees the allocated values (if any) and switches back to the inline
+     * storage. The stored values are lost.
+     */
+    void release();
 private:
     /*!
      * Copy constructor.
@@ -148,21 +244,58 @@ private:
  * \param initial_size Size, that should initially be allocated.
  */
 template<typename T> OSet<T>::OSet(unsigned int initial_size) :
-        m_size(0), m_vsize(0), m_val(0) {
-    if (initial_size > 0) {
-        this->m_val = (T*) calloc(initial_size, sizeof(T));
+        m_size(0), m_vsize(INLINE_SIZE) {
+    memset(&this->m_data, 0, sizeof(this->m_data));
+    if (initial_size > INLINE_SIZE) {
+        this->m_data.ptr = (T*) calloc(initial_size, sizeof(T));
         this->m_vsize = initial_size;
     }
 }
 
+/*!
+ * Constructor. Creates the union of two sets (see merge()).
+ */
+template<typename T> OSet<T>::OSet(const OSet<T> *s1, const OSet<T> *s2) :
+        m_size(0), m_vsize(INLINE_SIZE) {
+    memset(&this->m_data, 0, sizeof(this->m_data));
+    merge(s1, s2);
+}
+
 /*!
  * Destructor
  */
 template<typename T> OSet<T>::~OSet() {
     clear();
-    free(this->m_val);
-    this->m_val = NULL;
-    this->m_vsize = 0;
+    release();
+}
+
+/*!
+ * Grows the capacity to at least 'size' entries. The stored values
+ * are kept.
+ */
+template<typename T> void OSet<T>::grow(unsigned int size) {
+    if (size <= this->m_vsize)
+        return;
+    if (this->m_vsize > INLINE_SIZE)
+        this->m_data.ptr = (T*) realloc(this->m_data.ptr, sizeof(T) * size);
+    else {
+        T *nval = (T*) malloc(sizeof(T) * size);
+        memcpy(nval, this->m_data.vals, this->m_size * sizeof(T));
+        this->m_data.ptr = nval;
+    }
+    this->m_vsize = size;
+}
+
+/*!
+ * Frees the allocated values (if any) and switches back to the inline
+ * storage. The stored values are lost.
+ */
+template<typename T> void OSet<T>::release() {
+    if (this->m_vsize > INLINE_SIZE)
+        free(this->m_data.ptr);
+    this->m_data.ptr = NULL;
+    this->m_vsize = INLINE_SIZE;
+    this->m_size = 0;
 }
 
 /*!
@@ -171,7 +304,7 @@ template<typename T> OSet<T>::~OSet() {
  */
 template<typename T> bool OSet<T>::equals(const OSet<T> *oset) {
     return (this->m_size == oset->m_size)
-            && (memcmp(this->m_val, oset->m_val, this->m_size * sizeof(T)));
+            && (memcmp(data(), oset->data(), this->m_size * sizeof(T)));
 }
 
 /*!
@@ -182,13 +315,15 @@ template<typename T> bool OSet<T>::isSubsetOf(const OSet<T> *oset) {
     if (this->m_size > oset->m_size)
         return false; // This set has more entries than val -> not a subset.
 
+    const T *val = data();
+    const T *oval = oset->data();
     unsigned int o1 = 0;
     unsigned int o2 = 0;
     // Checks, if integer set2 is a subset of integer set1
     while ((o1 < oset->m_size) && (o2 < this->m_size)) {
-        if (oset->m_val[o1] > this->m_val[o2])
+        if (oval[o1] > val[o2])
             return false; // Entry does not exist in vals -> not a subset.
-        if (oset->m_val[o1] == this->m_val[o2])
+        if (oval[o1] == val[o2])
             o2++;
         o1++;
     }
@@ -205,52 +340,99 @@ template<typename T> bool OSet<T>::isSubsetOf(const OSet<T> *oset) {
 template<typename T> unsigned int OSet<T>::add(const T &v) {
     // Binary search for the insert position of val.
     // (Only done, if there are already entries in the set.)
+    const T *val = data();
     unsigned int i = 0, mid = 0, max = this->m_size;
     while (i < max) {
         mid = i + ((max - i) / 2);
-        if (v > this->m_val[mid])
+        if (v > val[mid])
             i = mid + 1;
         else
             max = mid;
     }
 
     // Return, if already in our list.
-    if ((i < this->m_size) && (this->m_val[i] == v))
+    if ((i < this->m_size) && (val[i] == v))
         return i;
 
-    if (this->m_size < this->m_vsize) {
-        memmove(&this->m_val[i + 1], &this->m_val[i],
-                (this->m_size - i) * sizeof(unsigned int));
-        this->m_val[i] = v;
-        this->m_size++;
-        return i;
-    }
     /* need to grow */
-    if (this->m_vsize >= 512)
-        this->m_vsize += 512;
-    else
-        this->m_vsize *= 2;
-    if (this->m_vsize == 0)
-        this->m_vsize = 2;
-    unsigned int *nval = (unsigned int *) malloc(
-            sizeof(unsigned int) * this->m_vsize);
-    memcpy(nval, this->m_val, i * sizeof(unsigned int));
+    if (this->m_size == this->m_vsize)
+        grow(this->m_vsize * 2);
+
+    T *nval = data();
+    memmove(&nval[i + 1], &nval[i], (this->m_size - i) * sizeof(T));
     nval[i] = v;
-    memcpy(&nval[i + 1], &this->m_val[i],
-            (this->m_size - i) * sizeof(unsigned int));
-    free(this->m_val);
-    this->m_val = nval;
     this->m_size++;
     return i;
 }
 
+/*!
+ * Appends a value/element v to the end of the set, without sorting
+ * and without checking for duplicates.
+ */
+template<typename T> void OSet<T>::append(const T &v) {
+    if (this->m_size == this->m_vsize)
+        grow(this->m_vsize * 2);
+    data()[this->m_size++] = v;
+}
+
+/*!
+ * Sorts the values in ascending order and removes duplicates.
+ */
+template<typename T> void OSet<T>::finalize() {
+    T *val = data();
+    std::sort(val, val + this->m_size);
+    this->m_size = std::unique(val, val + this->m_size) - val;
+}
+
+/*!
+ * Replaces the contents of the set with the union of s1 and s2.
+ */
+template<typename T> void OSet<T>::merge(const OSet<T> *s1,
+        const OSet<T> *s2) {
+    const unsigned int n1 = s1->m_size;
+    const unsigned int n2 = s2->m_size;
+    this->m_size = 0;
+    grow(n1 + n2);
+
+    const T *v1 = s1->data();
+    const T *v2 = s2->data();
+    T *val = data();
+    unsigned int o1 = 0, o2 = 0, c = 0;
+    while ((o1 < n1) && (o2 < n2)) {
+        if (v1[o1] < v2[o2])
+            val[c++] = v1[o1++];
+        else if (v2[o2] < v1[o1])
+            val[c++] = v2[o2++];
+        else {
+            val[c++] = v1[o1++];
+            o2++;
+        }
+    }
+    if (o1 < n1) {
+        memcpy(val + c, v1 + o1, (n1 - o1) * sizeof(T));
+        c += n1 - o1;
+    }
+    if (o2 < n2) {
+        memcpy(val + c, v2 + o2, (n2 - o2) * sizeof(T));
+        c += n2 - o2;
+    }
+    this->m_size = c;
+}
+
+/*!
+ * Allocates space for (at least) 'size' entries.
+ */
+template<typename T> void OSet<T>::reserve(unsigned int size) {
+    grow(size);
+}
+
 /*!
  * Get value
  * \return Value at pos in the set.
  */
 template<typename T> const T OSet<T>::val(unsigned int pos) const {
     // Error checking (pos valid?) not done...
-    return this->m_val[pos];
+    return data()[pos];
 }
 
 /*!
@@ -258,7 +440,7 @@ template<typename T> const T OSet<T>::val(unsigned int pos) const {
  */
 template<typename T> void OSet<T>::set(unsigned int pos, const T &value) {
     if (pos < m_vsize)
-        m_val[pos] = value;
+        data()[pos] = value;
 }
 
 /*!
@@ -291,8 +473,9 @@ template<> inline void OSet<unsigned int>::clear() {
  * Allocated memory (this->m_vals) is kept.
  */
 template<> inline void OSet<char*>::clear() {
+    char **val = data();
     for (unsigned int i = 0; i < this->m_size; ++i)
-        free(this->m_val[i]);
+        free(val[i]);
     this->m_size = 0;
 }
 
@@ -301,8 +484,9 @@ template<> inline void OSet<char*>::clear() {
  * Allocated memory (this->m_vals) is kept.
  */
 template<typename T> void OSet<T>::clear() {
+    T *val = data();
     for (unsigned int i = 0; i < this->m_size; ++i)
-        delete this->m_val[i];
+        delete val[i];
     this->m_size = 0;
 }
 
@@ -318,8 +502,48 @@ template<typename T> void OSet<T>::unref() {
  * Returns a pointer to the stored values of the set.
  * Handle with care!
  */
-template<typename T> const T *OSet<T>::val_ptr() {
-    return this->m_val;
+template<typename T> const T *OSet<T>::val_ptr() const {
+    return data();
+}
+template<typename T> T *OSet<T>::val_ptr() {
+    return data();
+}
+
+/*!
+ * Replaces the contents of the set with the first n values of vals.
+ * The values have to be unique and sorted in ascending order.
+ * Existing entries are not de-allocated (see unref()).
+ */
+template<typename T> void OSet<T>::assign(const T *vals, unsigned int n) {
+    if (n > this->m_vsize) {
+        release();
+        grow(n);
+    }
+    if (n)
+        memcpy(data(), vals, n * sizeof(T));
+    this->m_size = n;
+}
+
+/*!
+ * Exchanges the contents (values and allocated memory) of this set
+ * and oset.
+ */
+template<typename T> void OSet<T>::swap(OSet<T> *oset) {
+    // The inline values are copied along with the pointer (union).
+    unsigned int size = this->m_size;
+    unsigned int vsize = this->m_vsize;
+    T *ptr = this->m_data.ptr;
+    T vals[INLINE_SIZE];
+    memcpy(vals, this->m_data.vals, sizeof(vals));
+    this->m_size = oset->m_size;
+    this->m_vsize = oset->m_vsize;
+    memcpy(&this->m_data, &oset->m_data, sizeof(this->m_data));
+    oset->m_size = size;
+    oset->m_vsize = vsize;
+    if (vsize > INLINE_SIZE)
+        oset->m_data.ptr = ptr;
+    else
+        memcpy(oset->m_data.vals, vals, sizeof(vals));
 }
 
 /*!
@@ -357,16 +581,9 @@ template<typename T> USet<T>::USet(unsigned int initial_size) :
  * \return Position where the element was inserted.
  */
 template<typename T> unsigned int USet<T>::add(const T &v) {
-    if (this->m_vsize == this->m_size) {
-        if (this->m_vsize >= 512)
-            this->m_vsize += 512;
-        else
-            this->m_vsize *= 2;
-        if (this->m_vsize == 0)
-            this->m_vsize = 2;
-        this->m_val = (T*) realloc(this->m_val, sizeof(T) * this->m_vsize);
-    }
-    this->m_val[this->m_size] = v;
+    if (this->m_vsize == this->m_size)
+        this->grow(this->m_vsize * 2);
+    this->data()[this->m_size] = v;
 
     // Should return the position where the element was inserted. Untested.
     return this->m_size++;
@@ -417,10 +634,7 @@ template<typename T> URefSet<T>::~URefSet() {
  * Clears the set. No entries are de-allocated!
  */
 template<typename T> inline void URefSet<T>::clear() {
-    this->m_size = 0;
-    free(this->m_val);
-    this->m_val = NULL;
-    this->m_vsize = 0;
+    this->release();
 }
 
 /*!
@@ -443,4 +657,85 @@ typedef USet<unsigned int> UnorderedIntSet;
  */
 typedef OSet<unsigned int> IntSet;
 
+/*!
+ * A DNA4/Base4 type (2 bits/char)
+ */
+class Base4 {
+public:
+    /*!
+     * Base4 - Constructor.
+     */
+    Base4();
+
+    /*!
+     * Base4 - Destructor.
+     */
+    ~Base4();
+
+    /*!
+     * Convert string to DNA4/Base4 encoding.
+     */
+    void toBase4(const char *sequence);
+
+    /*!
+     * Convert DNA4/Base4 to string.
+     */
+    char *toChar(bool RNA = false) const;
+
+    /*!
+     * Convert DNA4/Base4 to string. The string is written into 'buffer',
+     * which has to hold at least len() + 1 characters.
+     * \return buffer
+     */
+    char *toChar(char *buffer, bool RNA = false) const;
+
+    /*!
+     * Create a copy of this sequence.
+     */
+    Base4 *clone() const;
+
+    /*!
+     * Directly add a base4 encoded string s and its length l.
+     * Handle with care!
+     */
+    void set(char *s, unsigned short l);
+
+    /*!
+     * Return the (uncompressed) sequence length.
+     */
+    unsigned short len() const;
+
+    /*!
+     * Return a pointer to the sequence.
+     */
+    const char *seq() const;
+protected:
+    /*!
+     * Sequence string. Base4 encoded. No terminal '0' character.
+     */
+    char *m_seq;
+
+    /*!
+     * Number of base4-encoded characters. Not(!) the length in bytes.
+     */
+    unsigned short m_len;
+private:
+    /*!
+     * Copy constructor.
+     * Not implemented --> private.
+     */
+    Base4(const Base4&);
+
+    /*!
+     * Assignment operator.
+     * Not implemented. --> private.
+     */
+    Base4 &operator=(const Base4&);
+};
+
+/*!
+ * Set of base4-encoded strings.
+ */
+typedef USet<Base4*> Base4Set;
+
 #endif /* BGRT_TYPE_H_ */
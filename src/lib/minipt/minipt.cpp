@@ -381,7 +381,7 @@ bool MiniPT::matchSignature(IntSet *&matched_ids, const char *signature,
                     ++og_matches;
                 } else {
                     // Add the matched sequence to our result set.
-                    matched_ids->add(minipt::ptstruct.data[pm->name].id);
+                    matched_ids->append(minipt::ptstruct.data[pm->name].id);
                 }
             }
         } else {
@@ -391,9 +391,10 @@ bool MiniPT::matchSignature(IntSet *&matched_ids, const char *signature,
                 ++og_matches;
             } else {
                 // Add the matched sequence to our result set.
-                matched_ids->add(minipt::ptstruct.data[pm->name].id);
+                matched_ids->append(minipt::ptstruct.data[pm->name].id);
             }
         }
     }
+    matched_ids->finalize();
     return true;
 }
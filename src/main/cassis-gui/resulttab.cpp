@@ -59,7 +59,7 @@
  * Constructor
  */
 ResultTab::ResultTab(QWidget *parentwidget) :
-QTabWidget(parentwidget), BGRT(NULL), nameMap(NULL) {
+QTabWidget(parentwidget), BGRT(NULL), lazyBGRT(NULL), nameMap(NULL) {
     setupUi();
 }
 
@@ -67,7 +67,7 @@ QTabWidget(parentwidget), BGRT(NULL), nameMap(NULL) {
  * Destructor
  */
 ResultTab::~ResultTab() {
-
+    BgrTreeLazy_close(lazyBGRT);
 }
 
 /*!
@@ -397,9 +397,15 @@ void ResultTab::slotOpenBGRT() {
     if (fileName.isEmpty())
         return;
 
-    // Create a new name map and fetch the BGRT from the file.
+    // Create a new name map and fetch the BGRT from the file. Indexed
+    // BGRT files are read on demand (see slotGroupMatch).
+    BgrTreeLazy_close(lazyBGRT);
     nameMap = new NameMap();
-    BGRT = readBGRTFile(nameMap, fileName.toAscii());
+    lazyBGRT = BgrTreeLazy_open(nameMap, fileName.toAscii());
+    if (lazyBGRT)
+        BGRT = BgrTreeLazy_tree(lazyBGRT);
+    else
+        BGRT = readBGRTFile(nameMap, fileName.toAscii());
 
     // Abort, if an error occurred.
     if (BGRT == NULL || nameMap == NULL) {
@@ -538,42 +544,49 @@ void ResultTab::slotGroupMatch(const QStringList &identifier) {
     QVector<QPointF> linechart_matches;
     qreal linechart_y_max = 0.0;
 
+    // Load the BGRT subtrees of the selected group (all subtrees, if
+    // outgroup hits are allowed).
+    BgrTree *tree = BGRT;
+    if (lazyBGRT)
+        tree = BgrTreeLazy_load(lazyBGRT,
+                outgroup_limit ? NULL : ids->val_ptr(), ids->size());
+    if (tree == NULL) {
+        QMessageBox::critical(this, "CdCaSSiS Error",
+                "Error while reading the BGRT file.");
+        delete ids;
+        return;
+    }
+
     // Fetch specific signatures for the selected group.
     unsigned int *num_matches = NULL;
-    StrRefSet *signatures = NULL;
-    findGroupSpecificSignatures(BGRT, ids, num_matches, signatures,
+    UnorderedIntSet *signatures = NULL;
+    findGroupSpecificSignatures(tree, ids, num_matches, signatures,
             outgroup_limit);
 
     Thermodynamics thermo;
 
+    // Buffer for decoded base4-encoded signatures.
+    char buffer[SIGNATURE_BUFFER_SIZE];
+
     unsigned int row_counter = 0;
     if (num_matches && signatures) {
         resultTable->setSortingEnabled(false);
         resultTable->clearContents();
 
         for (unsigned int outg = 0; outg <= outgroup_limit; ++outg) {
-            // struct ResultEntry *entry = ResultList_get(results, outg, 0);
+            unsigned int my_size = signatures[outg].size();
 
-            if (signatures[outg].size() > 0) {
+            if (my_size > 0) {
                 linechart_matches.append(QPointF(outg, num_matches[outg]));
                 if (linechart_y_max < num_matches[outg])
                     linechart_y_max = num_matches[outg];
 
-                // unsigned int my_size = 0;
-                // if (results->base4_compressed)
-                // my_size = entry->signatures.base4->size();
-                // else
-                unsigned int my_size = signatures[outg].size();
-
                 for (unsigned int j = 0; j < my_size; ++j) {
                     resultTable->insertRow(row_counter);
 
-                    // const char *signature = NULL;
-                    // if (results->base4_compressed)
-                    // signature = entry->signatures.base4->val(j)->toChar(
-                    // true); // TODO: RNA!
-                    // else
-                    const char *signature = signatures[outg].val(j);
+                    // Signatures from Base4-compressed BGRTs are decoded.
+                    const char *signature = BGRT->signature_pool->get(
+                            signatures[outg].val(j), buffer);
 
                     // Set table item 'Signature'...
                     QTableWidgetItem *item = new QTableWidgetItem(
@@ -596,12 +609,8 @@ void ResultTab::slotGroupMatch(const QStringList &identifier) {
                     item->setData(Qt::DisplayRole, +outg);
                     resultTable->setItem(row_counter, 3, item);
 
-                    thermo.process(signature);
-
-                    // Free signature string, if it was computed from a
-                    // base4 compressed string.
-                    // if (results->base4_compressed)
-                    // free((void*) signature);
+                    thermo.process(BGRT->signature_pool,
+                            signatures[outg].val(j));
 
                     // Set table item 'Tm_basic'...
                     item = new QTableWidgetItem();
@@ -627,6 +636,8 @@ void ResultTab::slotGroupMatch(const QStringList &identifier) {
         resultTable->resizeColumnsToContents();
         resultTable->setSortingEnabled(true);
     }
+    delete[] num_matches;
+    delete[] signatures;
 
     // Switch to the result table tab.
     this->setCurrentIndex(1);
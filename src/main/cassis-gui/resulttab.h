@@ -44,6 +44,7 @@ class QSpacerItem;
 class QTableWidget;
 class QVBoxLayout;
 struct BgrTree;
+struct BgrTreeLazy;
 class LineChart;
 
 class ResultTab: public QTabWidget {
@@ -153,6 +154,7 @@ LineChart *statsChart;
  * Member variables...
  */
  BgrTree *BGRT;
+BgrTreeLazy *lazyBGRT;
 NameMap *nameMap;
 };
 
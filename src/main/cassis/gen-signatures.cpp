@@ -87,12 +87,30 @@ const char *GenSignatures::next() {
     if (m_counter == m_limit)
         return NULL;
 
+    return get(m_counter++);
+}
+
+/*!
+ * Returns the oligonucleotide sequence at a given position within the
+ * enumeration order of next(), without changing the enumeration state.
+ * \return NULL if uninitialized or if the index is out of range.
+ */
+const char *GenSignatures::get(uint64_t index) {
+    if (m_length == 0 || index >= m_limit)
+        return NULL;
+
     // Fill the buffer with characters and return it...
-    uint64_t counter = m_counter++;
     unsigned int length = m_length;
     while (length--) {
-        m_buffer[length] = m_nucleotides[counter & 0x03];
-        counter >>= 2;
+        m_buffer[length] = m_nucleotides[index & 0x03];
+        index >>= 2;
     }
     return m_buffer;
 }
+
+/*!
+ * Number of oligonucleotide sequences that are generated (4^length).
+ */
+uint64_t GenSignatures::limit() const {
+    return m_limit;
+}
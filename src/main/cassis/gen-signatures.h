@@ -51,6 +51,19 @@ public:
      * \return NULL if an error occurred or all signatures were generated.
      */
     const char *next();
+
+    /*!
+     * Returns the oligonucleotide sequence at a given position within the
+     * enumeration order of next(), without changing the enumeration state.
+     * \param index Position of the sequence (0 -- 4^length-1).
+     * \return NULL if uninitialized or if the index is out of range.
+     */
+    const char *get(uint64_t index);
+
+    /*!
+     * Number of oligonucleotide sequences that are generated (4^length).
+     */
+    uint64_t limit() const;
 private:
     uint64_t m_counter;
     uint64_t m_limit;
@@ -21,6 +21,7 @@
  * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cassis/bulk.h>
 #include <cassis/config.h>
 #include <cassis/search.h>
 #include <cassis/io.h>
@@ -44,6 +45,7 @@
 #include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <cmath>
 #include <sys/time.h>
 
 #ifdef DUMP_STATS
@@ -60,6 +62,11 @@
  */
 #define DUMP_BGRT_DEPTH 1
 
+/*!
+ * Number of signature candidates that are fetched and filtered at once.
+ */
+#define CANDIDATE_BATCH_SIZE 256
+
 /*!
  * This function adds statistical depth information to the BGRTree
  */
@@ -87,6 +94,17 @@ void dumpBGRTDepth(struct BgrTree *bgr_tree) {
     unsigned short tree_depth = 0;
     unsigned int nodes = 0;
 
+    // Frozen trees (e.g. mapped BGRT files) only have the flat layout.
+    // The roots are counted twice, like in the recursion below.
+    const struct BgrTreeFlat *flat = bgr_tree->flat;
+    if (flat) {
+        tree_depth = flat->max_depth;
+        nodes = flat->num_nodes;
+        for (unsigned int i = 0; i < flat->num_species; i++)
+            if (flat->roots[i] != BGRT_FLAT_UNDEF)
+                nodes++;
+    }
+
     for (unsigned int i = 0; i < bgr_tree->num_species; i++)
         if (bgr_tree->nodes[i]) {
             nodes++;
@@ -253,6 +271,61 @@ CaSSiSTree *createCaSSiSTree(const Parameters &params) {
     return tree;
 }
 
+/*!
+ * Evaluates a signature candidate: The signature is matched against the
+ * search index and its reverse complement is checked (if requested).
+ * (The thermodynamic filters are applied beforehand.)
+ *
+ * \param matches Set of matched species IDs. Created or reused.
+ * \param outg_matches Number of outgroup matches.
+ * \param matched Set to true, if the signature matched at least one species,
+ *        regardless of the reverse complement check.
+ * \return True, if the signature is a valid signature candidate.
+ */
+bool evaluateSignature(const Parameters &params, IndexInterface *index,
+        const char *signature, IntSet *&matches, unsigned int &outg_matches,
+        bool &matched) {
+    matched = false;
+    outg_matches = 0;
+
+    // Match our signature against the search index and fetch the
+    // resulting species IDs. If something went wrong, (e.g.
+    // mismatch parameters were not met or no match occurred)
+    // 'matched_species' is NULL.
+    index->matchSignature(matches, signature, params.allowed_mm(),
+            params.mm_dist(), outg_matches, params.use_wm());
+
+    if ((matches == NULL) || (matches->size() == 0))
+        return false;
+    matched = true;
+
+    // Flags, needed to evaluate the reverse complement (if enabled).
+    bool cmpl_has_matches = false;
+    bool cmpl_matches_subset = false;
+
+    // Check reverse complement if it was requested via parameter.
+    if (params.check_r_c()) {
+        IntSet *rc_matches = NULL;
+        unsigned int rc_outg_matches = 0;
+
+        // Fetch the PT-Servers matches for the reverse complement
+        char *rc_signature = reverseComplementSequence(signature, true);
+        index->matchSignature(rc_matches, rc_signature, params.allowed_mm(),
+                params.mm_dist(), rc_outg_matches, params.use_wm());
+        free(rc_signature);
+
+        if ((rc_matches != NULL) && (rc_matches->size() != 0)) {
+            cmpl_has_matches = true;
+            cmpl_matches_subset = rc_matches->isSubsetOf(matches);
+        }
+
+        if (rc_matches != NULL)
+            delete rc_matches;
+    }
+
+    return (!cmpl_has_matches) || cmpl_matches_subset;
+}
+
 /*!
  * This function queries a search index and creates the bipartite graph.
  * It either stores the graph as a BGRT or directly in the CaSSiSTree.
@@ -303,7 +376,13 @@ int commandCreate1Pass(const Parameters &params) {
     // Create a new BGRT structure, if requested by the user.
     struct BgrTree *bgr_tree = NULL;
     if (params.command() == CommandCreate)
-        bgr_tree = BgrTree_create(mapping.size(), false); // TODO: Support Base4 compression!
+        bgr_tree = BgrTree_create(mapping.size(), params.base4());
+
+    // In bulk mode, the matches are collected and the BGRT is built
+    // after the signature matching.
+    struct BgrTreeBulk *bulk = NULL;
+    if (bgr_tree && params.bulk())
+        bulk = BgrTreeBulk_create(bgr_tree);
 
     // Class used for thermodynamic calculations...
     Thermodynamics thermo;
@@ -322,6 +401,19 @@ int commandCreate1Pass(const Parameters &params) {
     const char *signature = NULL;
     GenSignatures genSig;
 
+    // Signature candidates are fetched and filtered in batches. Candidates
+    // from the search index are buffered with a fixed stride, generated
+    // candidates ('-all') are buffered as 2-bit packed values.
+    const unsigned int batch_stride = params.max_len() + 1;
+    char *batch = (char *) malloc(CANDIDATE_BATCH_SIZE * batch_stride);
+    if (!batch) {
+        std::cerr << "Error: Signature candidate buffer could not be "
+                "allocated (out of memory).\n";
+        return EXIT_FAILURE;
+    }
+    uint64_t packed_batch[CANDIDATE_BATCH_SIZE];
+    unsigned char batch_pass[CANDIDATE_BATCH_SIZE];
+
     // Statistical information about the bipartite graph ic collected here...
     unsigned long stats_edges = 0;
     unsigned long stats_edges_raw = 0;
@@ -345,96 +437,110 @@ int commandCreate1Pass(const Parameters &params) {
             return EXIT_FAILURE;
         }
 
-        if (params.allSignatures())
-            signature = genSig.next();
-        else
-            signature = index->fetchNextSignature();
+        // Position of the next generated signature ('-all').
+        uint64_t position = 0;
 
         // Iterate through all signatures.
-        while (signature != NULL) {
+        while (true) {
+            // Fetch a batch of signature candidates.
+            unsigned int batch_count = 0;
+            if (params.allSignatures()) {
+                while (batch_count < CANDIDATE_BATCH_SIZE
+                        && position < genSig.limit())
+                    packed_batch[batch_count++] = position++;
+            } else {
+                while (batch_count < CANDIDATE_BATCH_SIZE
+                        && (signature = index->fetchNextSignature()) != NULL) {
+                    char *entry = batch + batch_count * batch_stride;
+                    strncpy(entry, signature, signature_length);
+                    entry[signature_length] = 0;
+                    ++batch_count;
+                }
+            }
+            if (batch_count == 0)
+                break;
+
             // Test signatures with filters, if necessary...
-            // This flag is used to evaluate, if a signature is valid:
-            bool signature_valid = true;
-            if (use_filters)
-                signature_valid = thermo.batch_process(signature);
+            if (!use_filters)
+                memset(batch_pass, 1, batch_count);
+            else if (params.allSignatures())
+                thermo.batch_process(packed_batch, signature_length,
+                        batch_count, batch_pass);
+            else
+                thermo.batch_process(batch, batch_stride, signature_length,
+                        batch_count, batch_pass);
 
-            if (signature_valid) {
-                // Match our signature against the search index and fetch the
-                // resulting species IDs. If something went wrong, (e.g.
-                // mismatch parameters were not met or no match occurred)
-                // 'matched_species' is NULL.
-                unsigned int outg_matches = 0;
+            for (unsigned int b = 0; b < batch_count; ++b) {
+                if (!batch_pass[b])
+                    continue;
+
+                if (params.allSignatures())
+                    signature = genSig.get(packed_batch[b]);
+                else
+                    signature = batch + b * batch_stride;
 
-                index->matchSignature(matches, signature, params.allowed_mm(),
-                        params.mm_dist(), outg_matches, params.use_wm());
+                unsigned int outg_matches = 0;
+                bool matched = false;
+                bool signature_valid = evaluateSignature(params, index,
+                        signature, matches, outg_matches, matched);
 
-                if ((matches != NULL) && (matches->size() != 0)) {
+                if (matched) {
                     // Update the statistical information...
                     stats_signatures_raw++;
                     stats_edges_raw += matches->size();
+                }
 
-                    // Flags, needed to evaluate the reverse complement (if enabled).
-                    bool cmpl_has_matches = false;
-                    bool cmpl_matches_subset = false;
-
-                    // Check reverse complement if it was requested via parameter.
-                    if (params.check_r_c()) {
-                        IntSet *rc_matches = NULL;
-                        unsigned int rc_outg_matches = 0;
-
-                        // Fetch the PT-Servers matches for the reverse complement
-                        char *rc_signature = reverseComplementSequence(
-                                signature, true);
-                        index->matchSignature(rc_matches, rc_signature,
-                                params.allowed_mm(), params.mm_dist(),
-                                rc_outg_matches, params.use_wm());
-                        free(rc_signature);
-
-                        if ((rc_matches != NULL) && (rc_matches->size() != 0)) {
-                            cmpl_has_matches = true;
-                            cmpl_matches_subset = rc_matches->isSubsetOf(
-                                    matches);
-                        }
-
-                        if (rc_matches != NULL)
-                            delete rc_matches;
-                    }
-
-                    if ((!cmpl_has_matches) || cmpl_matches_subset) {
-                        if (params.command() == Command1Pass) {
-                            // Add the signatures directly to the CaSSiSTree,
-                            // if we are running a '1Pass' job.
-                            if (outg_matches <= params.og_limit())
-                                if (tree->addMatching(signature, matches,
-                                        outg_matches)) {
-                                    // Update the statistical information
-                                    // if the matching was added.
-                                    stats_signatures++;
-                                    stats_edges += matches->size();
-                                }
-                        } else {
-                            // Otherwise build a BGRT by adding the signatures
-                            // to it. Also update the statistical information...
-                            stats_signatures++;
-                            stats_edges += matches->size();
-
-                            BgrTree_insert(bgr_tree, signature, matches,
+                if (signature_valid) {
+                    if (params.command() == Command1Pass) {
+                        // Add the signatures directly to the CaSSiSTree,
+                        // if we are running a '1Pass' job.
+                        if (outg_matches <= params.og_limit())
+                            if (tree->addMatching(signature, matches,
+                                    outg_matches)) {
+                                // Update the statistical information
+                                // if the matching was added.
+                                stats_signatures++;
+                                stats_edges += matches->size();
+                            }
+                    } else {
+                        // Otherwise build a BGRT by adding the signatures
+                        // to it. Also update the statistical information...
+                        stats_signatures++;
+                        stats_edges += matches->size();
+
+                        if (bulk) {
+                            // The bulk builder copies the matches.
+                            BgrTreeBulk_add(bulk, signature, matches,
                                     outg_matches);
+                        } else {
+                            bool inserted = BgrTree_insert(bgr_tree,
+                                    signature, matches, outg_matches);
 
                             // The BGRT keeps/manages the matches:
                             // We will clear our pointer reference.
                             matches = NULL;
+                            if (!inserted) {
+                                std::cerr << "Error: Signature could not be "
+                                        "added to the BGRT (out of memory).\n";
+                                return EXIT_FAILURE;
+                            }
                         }
-
                     }
                 }
             }
-            if (params.allSignatures())
-                signature = genSig.next();
-            else
-                signature = index->fetchNextSignature();
         }
     }
+    free(batch);
+
+    // Build the BGRT from the collected matches.
+    if (bulk) {
+        if (!BgrTreeBulk_build(bulk)) {
+            std::cerr << "Error: Bulk construction of the BGRT failed "
+                    "(out of memory).\n";
+            return EXIT_FAILURE;
+        }
+        BgrTreeBulk_destroy(bulk);
+    }
 
     // Output statistical information about the bipartite graph.
     if (params.verbose())
@@ -535,6 +641,419 @@ int commandCreate1Pass(const Parameters &params) {
     return EXIT_SUCCESS;
 }
 
+/*!
+ * Returns the current wall clock time in seconds.
+ */
+double wallClock() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec + (double) tv.tv_usec / 1000000.0;
+}
+
+/*!
+ * Returns the peak resident memory ("high water mark") of this process in
+ * kB. Returns 0, if the information is not available.
+ */
+unsigned long peakMemoryKB() {
+    unsigned long peak = 0;
+#ifndef _WIN32
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            peak = strtoul(line.c_str() + 6, NULL, 10);
+            break;
+        }
+#endif
+    return peak;
+}
+
+/*!
+ * Hash function used to draw a deterministic sample from the signature
+ * candidates (FNV-1a with a final bit mixing step).
+ */
+uint64_t sampleHash(const char *signature) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*signature) {
+        h ^= (unsigned char) *signature++;
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/*!
+ * Collects the number of nodes and the approximate memory footprint of a
+ * BGRT subtree. The memory is split into a per-node and a per-signature part.
+ */
+void footprintBGRT_rec(const struct BgrTreeNode *node,
+        const SignaturePool *pool, unsigned long *nodes,
+        unsigned long *node_bytes, unsigned long *sig_bytes) {
+    while (node != NULL) {
+        *nodes = *nodes + 1;
+        *node_bytes += sizeof(struct BgrTreeNode) + 2 * sizeof(UnorderedIntSet)
+                + node->species.allocated();
+        // Per signature: handle, outgroup matches and the pool entry.
+        *sig_bytes += node->signatures->size()
+                * (2 * sizeof(unsigned int) + pool->stride());
+        footprintBGRT_rec(node->children, pool, nodes, node_bytes,
+                sig_bytes);
+        node = node->next;
+    }
+}
+
+void footprintBGRT(const struct BgrTree *bgr_tree, unsigned long *nodes,
+        unsigned long *node_bytes, unsigned long *sig_bytes) {
+    *nodes = 0;
+    *node_bytes = bgr_tree->num_species * sizeof(struct BgrTreeNode*);
+    *sig_bytes = 0;
+    for (unsigned int i = 0; i < bgr_tree->num_species; i++)
+        footprintBGRT_rec(bgr_tree->nodes[i], bgr_tree->signature_pool,
+                nodes, node_bytes, sig_bytes);
+}
+
+/*!
+ * Releases the data structures of an 'estimate' run (see commandEstimate).
+ * NULL pointers are ignored.
+ */
+void releaseEstimate(CaSSiSTree *tree, IndexInterface *index,
+        IntSet *matches, struct BgrTree *bgr_tree, struct BgrTree *bgr_half) {
+    delete matches;
+    delete index;
+    BgrTree_destroy(bgr_half);
+    BgrTree_destroy(bgr_tree);
+    delete tree;
+}
+
+/*!
+ * CaSSiS 'estimate' function.
+ *
+ * Evaluates a sample of the signature candidates with the same code path
+ * as 'create' and '1pass' and extrapolates the size of the bipartite graph,
+ * the BGRT, runtimes and memory consumption of a complete run.
+ *
+ * The sample is drawn deterministically via a hash of the signature string.
+ * With '-all', every candidate is accessible by its position, and a
+ * (pseudo-)random permutation of the positions is evaluated instead.
+ * The number of BGRT nodes does not grow linearly with the number of
+ * signatures. Its growth is extrapolated from a second BGRT that is built
+ * from one half of the sample. The fitted growth exponent declines with
+ * the sample size, so the node count (and the derived memory and 'process'
+ * costs) is an upper estimate. In tests, it was 30% -- 40% too high with
+ * a 1% sample and 10% -- 15% too high with 5% -- 25% samples.
+ */
+int commandEstimate(const Parameters &params) {
+    // Check, if the allowed target mismatches are below the mismatch distance.
+    if (params.allowed_mm() >= params.mm_dist()) {
+        std::cerr << "Error: Mismatch distance (" << params.mm_dist()
+                << ") has to be higher than the allowed mismatches between targets ("
+                << params.allowed_mm() << "). Exiting.\n";
+        return EXIT_FAILURE;
+    }
+
+    const double fraction = params.sample_fraction();
+    const uint64_t threshold = (uint64_t) (fraction * 4294967296.0);
+
+    // Our name <--> ID mapping. If a tree was defined, the mapping is fetched
+    // from the tree (as in '1pass') and the tree is used to estimate the
+    // '1pass' and 'process' costs.
+    NameMap mapping;
+    CaSSiSTree *tree = NULL;
+    if (params.tree_filename().length() > 0) {
+        tree = createCaSSiSTree(params);
+        if (tree == NULL)
+            return EXIT_FAILURE;
+        tree->fetchMapping(mapping);
+    }
+
+    // Build the search index.
+    double time_index = wallClock();
+    IndexInterface *index = createIndexInterface(params, mapping);
+    if (index == NULL) {
+        std::cerr << "Error: Search index not initialized. "
+                "Exiting 'estimate'.\n";
+        delete tree;
+        return EXIT_FAILURE;
+    }
+    time_index = wallClock() - time_index;
+    unsigned long peak_index = peakMemoryKB();
+
+    // The sampled signatures are inserted into a BGRT. One half of the sample
+    // is additionally inserted into a second BGRT.
+    struct BgrTree *bgr_tree = BgrTree_create(mapping.size(), params.base4());
+    struct BgrTree *bgr_half = BgrTree_create(mapping.size(), params.base4());
+    if (!bgr_tree || !bgr_half) {
+        std::cerr << "Error: Unable to create the BGRT (out of memory). "
+                "Exiting 'estimate'.\n";
+        releaseEstimate(tree, index, NULL, bgr_tree, bgr_half);
+        return EXIT_FAILURE;
+    }
+
+    // Class used for thermodynamic calculations...
+    Thermodynamics thermo;
+    bool use_filters = params.use_gc() | params.use_tm();
+    if (use_filters) {
+        if (params.use_gc())
+            thermo.enable_gc_check(params.min_gc(), params.max_gc());
+        if (params.use_tm())
+            thermo.enable_tm_check(params.min_tm(), params.max_tm());
+    }
+
+    IntSet *matches = NULL;
+    const char *signature = NULL;
+    GenSignatures genSig;
+
+    // Sampled and extrapolated (est_) counters.
+    unsigned long candidates = 0;
+    unsigned long sampled = 0;
+    unsigned long sampled_sig_a = 0;
+    unsigned long sampled_sig_half = 0;
+    unsigned long sampled_sig_1pass = 0;
+    double est_candidates = 0.0;
+    double est_sig_e = 0.0, est_edges_e = 0.0;
+    double est_sig_a = 0.0, est_edges_a = 0.0;
+    double est_sig_1pass = 0.0;
+
+    double time_enumeration = 0.0;
+    double time_matching = 0.0;
+    double time_insert = 0.0;
+    double time_1pass = 0.0;
+
+    for (unsigned int signature_length = params.min_len();
+            signature_length <= params.max_len(); ++signature_length) {
+        unsigned long len_candidates = 0;
+        unsigned long len_sampled = 0;
+        unsigned long len_sig_e = 0, len_edges_e = 0;
+        unsigned long len_sig_a = 0, len_edges_a = 0;
+        unsigned long len_sig_1pass = 0;
+
+        bool done = false;
+        if (params.allSignatures())
+            done = genSig.init(signature_length, true);
+        else
+            done = index->initFetchSignature(signature_length, true);
+        if (!done) {
+            std::cerr << "An error occurred while "
+                    "initializing the signature matching.\n";
+            releaseEstimate(tree, index, matches, bgr_tree, bgr_half);
+            return EXIT_FAILURE;
+        }
+
+        // Number of samples, if all 4^len signatures are evaluated.
+        uint64_t all_samples = 0;
+        if (params.allSignatures()) {
+            all_samples = (uint64_t) (fraction * (double) genSig.limit());
+            if (all_samples == 0)
+                all_samples = 1;
+        }
+
+        double time_loop = wallClock();
+        double time_evaluated = 0.0;
+        uint64_t sample_counter = 0;
+        while (true) {
+            uint64_t hash = 0;
+            if (params.allSignatures()) {
+                if (sample_counter == all_samples)
+                    break;
+                // An odd multiplier is a permutation of the positions.
+                signature = genSig.get(
+                        (sample_counter++ * 0x9e3779b97f4a7c15ULL)
+                                & (genSig.limit() - 1));
+                hash = sampleHash(signature);
+            } else {
+                signature = index->fetchNextSignature();
+                if (signature == NULL)
+                    break;
+                ++len_candidates;
+                hash = sampleHash(signature);
+                if ((hash & 0xffffffffULL) >= threshold)
+                    continue;
+            }
+            ++len_sampled;
+
+            double t = wallClock();
+            unsigned int outg_matches = 0;
+            bool matched = false;
+            unsigned char pass = 1;
+            if (use_filters)
+                thermo.batch_process(signature, signature_length + 1,
+                        signature_length, 1, &pass);
+            bool signature_valid = pass
+                    && evaluateSignature(params, index, signature, matches,
+                            outg_matches, matched);
+            double t_matched = wallClock();
+            time_matching += t_matched - t;
+
+            if (matched) {
+                len_sig_e++;
+                len_edges_e += matches->size();
+            }
+
+            if (signature_valid) {
+                len_sig_a++;
+                len_edges_a += matches->size();
+
+                // Costs of a '1pass' run.
+                if (tree && outg_matches <= params.og_limit()) {
+                    if (tree->addMatching(signature, matches, outg_matches))
+                        len_sig_1pass++;
+                }
+                double t_1pass = wallClock();
+                time_1pass += t_1pass - t_matched;
+
+                // One half of the sample is also inserted into the second
+                // BGRT. (An independent bit of the hash value is used.)
+                if ((hash & 0x100000000ULL) == 0) {
+                    IntSet *copy = new IntSet(matches->size());
+                    for (unsigned int i = 0; i < matches->size(); ++i)
+                        copy->set(i, matches->val(i));
+                    copy->setSize(matches->size());
+                    if (!BgrTree_insert(bgr_half, signature, copy,
+                            outg_matches)) {
+                        std::cerr << "Error: Signature could not be added to "
+                                "the BGRT (out of memory). Exiting 'estimate'.\n";
+                        releaseEstimate(tree, index, matches, bgr_tree,
+                                bgr_half);
+                        return EXIT_FAILURE;
+                    }
+                    ++sampled_sig_half;
+                }
+
+                // Costs of a 'create' run.
+                double t_insert = wallClock();
+                bool inserted = BgrTree_insert(bgr_tree, signature, matches,
+                        outg_matches);
+                matches = NULL;
+                time_insert += wallClock() - t_insert;
+                if (!inserted) {
+                    std::cerr << "Error: Signature could not be added to "
+                            "the BGRT (out of memory). Exiting 'estimate'.\n";
+                    releaseEstimate(tree, index, NULL, bgr_tree, bgr_half);
+                    return EXIT_FAILURE;
+                }
+            }
+            time_evaluated += wallClock() - t;
+        }
+        time_loop = wallClock() - time_loop;
+
+        if (params.allSignatures())
+            len_candidates = genSig.limit();
+        else
+            time_enumeration += time_loop - time_evaluated;
+
+        // Extrapolate the counters of this length.
+        double scale = len_sampled ? (double) len_candidates / len_sampled : 0;
+        est_candidates += len_candidates;
+        est_sig_e += scale * len_sig_e;
+        est_edges_e += scale * len_edges_e;
+        est_sig_a += scale * len_sig_a;
+        est_edges_a += scale * len_edges_a;
+        est_sig_1pass += scale * len_sig_1pass;
+
+        candidates += len_candidates;
+        sampled += len_sampled;
+        sampled_sig_a += len_sig_a;
+        sampled_sig_1pass += len_sig_1pass;
+    }
+
+    delete matches;
+    delete index;
+
+    // Effective sample fraction (may differ from the requested one).
+    double scale = sampled ? (double) candidates / sampled : 0.0;
+
+    // Extrapolate the BGRT size. The number of nodes is assumed to grow with
+    // (number of signatures)^alpha, alpha is fitted with the two BGRTs.
+    unsigned long nodes = 0, node_bytes = 0, sig_bytes = 0;
+    unsigned long half_nodes = 0, half_node_bytes = 0, half_sig_bytes = 0;
+    footprintBGRT(bgr_tree, &nodes, &node_bytes, &sig_bytes);
+    footprintBGRT(bgr_half, &half_nodes, &half_node_bytes, &half_sig_bytes);
+    BgrTree_destroy(bgr_half);
+
+    double alpha = 1.0;
+    if (half_nodes > 0 && nodes > half_nodes && sampled_sig_half > 0
+            && sampled_sig_a > sampled_sig_half)
+        alpha = log((double) nodes / half_nodes)
+                / log((double) sampled_sig_a / sampled_sig_half);
+    if (alpha > 1.0)
+        alpha = 1.0;
+    else if (alpha < 0.0)
+        alpha = 0.0;
+
+    double sig_scale = sampled_sig_a ? est_sig_a / sampled_sig_a : 0.0;
+    double est_nodes = nodes * pow(sig_scale, alpha);
+    double est_bgrt_bytes = bgr_tree->num_species * sizeof(struct BgrTreeNode*)
+            + (nodes ? (double) node_bytes / nodes * est_nodes : 0.0)
+            + sig_scale * sig_bytes;
+
+    // Costs of a 'process' run: traverse the sampled BGRT.
+    double time_process = 0.0;
+    if (tree) {
+        CaSSiSTree *process_tree = createCaSSiSTree(params);
+        if (process_tree) {
+            reduceCaSSiSTreeDepth(process_tree);
+            time_process = wallClock();
+            findTreeSpecificSignatures(bgr_tree, process_tree,
+                    params.og_limit());
+            time_process = wallClock() - time_process;
+            delete process_tree;
+        }
+    }
+    BgrTree_destroy(bgr_tree);
+
+    // Print the estimation.
+    double node_scale = nodes ? est_nodes / nodes : 0.0;
+    std::cout.setf(std::ios::fixed);
+    std::cout.precision(0);
+    std::cout << "\nEstimation based on " << sampled << " of " << candidates
+            << " signature candidates (sample fraction: ";
+    std::cout.precision(4);
+    std::cout << (candidates ? (double) sampled / candidates : 0.0) << "):";
+    std::cout.precision(0);
+    std::cout << "\nBipartite graph (e=evaluated,a=added):"
+            << "\n\t- # Candidates:     " << est_candidates
+            << "\n\t- # Signatures (e): " << est_sig_e
+            << "\n\t- # Signatures (a): " << est_sig_a
+            << "\n\t- # Edges (e):      " << est_edges_e
+            << "\n\t- # Edges (a):      " << est_edges_a;
+    if (tree)
+        std::cout << "\n\t- # Signatures added in '1pass' (a): "
+                << est_sig_1pass;
+    std::cout << "\nBGRT ('create'):"
+            << "\n\t- # Nodes:          " << est_nodes
+            << " (upper estimate, sample: " << nodes << ", growth exponent: ";
+    std::cout.precision(2);
+    std::cout << alpha << ")"
+            << "\n\t- Memory:           " << est_bgrt_bytes / 1048576.0
+            << " MiB"
+            << "\nRuntime (index construction measured, others extrapolated):"
+            << "\n\t- Index construction:    " << time_index << " s"
+            << "\n\t- Candidate enumeration: " << time_enumeration << " s"
+            << "\n\t- Signature matching:    " << time_matching * scale << " s ("
+            << (sampled ? time_matching / sampled * 1000000.0 : 0.0)
+            << " us per candidate)"
+            << "\n\t- BGRT insertion:        " << time_insert * sig_scale
+            << " s";
+    if (tree)
+        std::cout << "\n\t- '1pass' result update: " << time_1pass * sig_scale
+                << " s" << "\n\t- 'process' traversal:   "
+                << time_process * node_scale << " s";
+    std::cout << "\nPeak memory:";
+    if (peak_index > 0)
+        std::cout << "\n\t- Search index (measured): " << peak_index / 1024.0
+                << " MiB" << "\n\t- 'create':                "
+                << peak_index / 1024.0 + est_bgrt_bytes / 1048576.0 << " MiB";
+    std::cout << "\n\t- 'process' (BGRT):        "
+            << est_bgrt_bytes / 1048576.0 << " MiB" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+    std::cout.precision(6);
+
+    delete tree;
+    return EXIT_SUCCESS;
+}
+
 /*!
  * CaSSiS 'info' function.
  */
@@ -543,7 +1062,8 @@ int commandInfo(const Parameters &params, BgrTree *bgr_tree = NULL) {
 
     if (bgr_tree == NULL) {
         name_map = new NameMap();
-        bgr_tree = readBGRTFile(name_map, params.bgrt_file().c_str());
+        bgr_tree = readBGRTFile(name_map, params.bgrt_file().c_str(),
+                params.verify());
         if (bgr_tree == NULL) {
             // The BGRT file reader was unable to process the file.
             std::cerr << "Error: unable to read the BGRT file.\n";
@@ -566,6 +1086,9 @@ int commandInfo(const Parameters &params, BgrTree *bgr_tree = NULL) {
         std::cout << "\t- Melting temp. range: " << bgr_tree->min_temp << "-"
                 << bgr_tree->max_temp << " °C" << std::endl;
 
+    if (bgr_tree->base4_compressed)
+        std::cout << "\t- Signatures: Base4-compressed" << std::endl;
+
     if (bgr_tree->comment)
         std::cout << "\t- Comment: " << bgr_tree->comment << std::endl;
 
@@ -586,9 +1109,11 @@ int commandInfo(const Parameters &params, BgrTree *bgr_tree = NULL) {
 /*!
  * Processes a file with groups defined by comma separated lists of
  * identifiers. Each line represents one group.
+ * If the BGRT is read on demand ('lazy'), the subtrees needed by each
+ * group are loaded before the group is processed.
  */
 bool processListFile(const Parameters &params, BgrTree *bgr_tree,
-        const NameMap *map) {
+        const NameMap *map, BgrTreeLazy *lazy = NULL) {
     if (!bgr_tree)
         return false;
 
@@ -622,7 +1147,22 @@ bool processListFile(const Parameters &params, BgrTree *bgr_tree,
                 std::cerr << "Error: unable to map id \"" << id_str
                         << "\" onto the BGRT.\n";
             } else
-                node->group->add(id);
+                node->group->append(id);
+        }
+        node->group->finalize();
+
+        // Load the roots of the group (all roots, if outgroup matches
+        // are allowed).
+        if (lazy) {
+            bgr_tree = BgrTreeLazy_load(lazy,
+                    params.og_limit() ? NULL : node->group->val_ptr(),
+                    node->group->size());
+            if (!bgr_tree) {
+                std::cerr << "Error: unable to read the BGRT file.\n";
+                delete node;
+                list.close();
+                return false;
+            }
         }
 
         // Fetch specific signatures for the defined group.
@@ -677,7 +1217,17 @@ int commandProcess(const Parameters &params) {
     NameMap *name_map = new NameMap();
     struct BgrTree *bgr_tree = NULL;
 
-    bgr_tree = readBGRTFile(name_map, params.bgrt_file().c_str());
+    // The groups of a list only need the subtrees of their species.
+    // Indexed BGRT files are read on demand then.
+    struct BgrTreeLazy *lazy = NULL;
+    if (params.use_list())
+        lazy = BgrTreeLazy_open(name_map, params.bgrt_file().c_str(),
+                params.verify(), params.cache_limit() * 1024 * 1024);
+    if (lazy)
+        bgr_tree = BgrTreeLazy_tree(lazy);
+    else
+        bgr_tree = readBGRTFile(name_map, params.bgrt_file().c_str(),
+                params.verify());
     if (!bgr_tree) {
         // The BGRT file reader was unable to process the file.
         std::cerr << "Error: unable to read the BGRT file.\n";
@@ -688,6 +1238,14 @@ int commandProcess(const Parameters &params) {
     if (params.verbose())
         commandInfo(params, bgr_tree);
 
+    // Convert the BGRT into the (read-only) layout used by the search.
+    if (!lazy && !BgrTree_freeze(bgr_tree)) {
+        std::cerr << "Error: unable to convert the BGRT.\n";
+        BgrTree_destroy(bgr_tree);
+        delete name_map;
+        return EXIT_FAILURE;
+    }
+
 #ifdef DUMP_STATS
     dumpStats("Process: BGRT loaded.");
 #endif
@@ -697,7 +1255,7 @@ int commandProcess(const Parameters &params) {
     if (params.use_list()) {
         // Process the list with comma separated identifier.
         // Each line represents one group that should be processed.
-        processListFile(params, bgr_tree, name_map);
+        processListFile(params, bgr_tree, name_map, lazy);
     } else {
         // Fetch the phylogenetic tree structure
         std::cout << "Creating the phylogenetic tree structure:" << std::endl;
@@ -752,7 +1310,10 @@ int commandProcess(const Parameters &params) {
     }
 
     // Do some clean-up...
-    BgrTree_destroy(bgr_tree);
+    if (lazy)
+        BgrTreeLazy_close(lazy);
+    else
+        BgrTree_destroy(bgr_tree);
     delete name_map;
 
 #ifdef DUMP_STATS
@@ -827,6 +1388,9 @@ int main(int argc, char **argv) {
     case CommandProcess:
         returnvalue = commandProcess(params);
         break;
+    case CommandEstimate:
+        returnvalue = commandEstimate(params);
+        break;
     case CommandUndef:
     default:
         returnvalue = EXIT_FAILURE;
@@ -37,7 +37,8 @@ Parameters::Parameters() :
                 18), m_use_gc(false), m_min_gc(0.0), m_max_gc(100.0), m_use_tm(
                 false), m_min_tm(-273.0), m_max_tm(273.0), m_use_wm(false), m_num_threads(
                 0), m_listfile(), m_treefile(), m_treename(), m_og_limit(0), m_all_signatures(
-                false) {
+                false), m_sample_fraction(0.01), m_base4(false), m_bulk(
+                false), m_verify(true), m_cache_limit(0) {
 }
 
 Parameters::~Parameters() {
@@ -69,6 +70,11 @@ void Parameters::reset() {
     m_og_limit = 0;
     m_num_threads = 0;
     m_all_signatures = false;
+    m_sample_fraction = 0.01;
+    m_base4 = false;
+    m_bulk = false;
+    m_verify = true;
+    m_cache_limit = 0;
 }
 
 /*!
@@ -96,6 +102,9 @@ void Parameters::dump() const {
     case CommandInfo:
         std::cout << "info\n";
         break;
+    case CommandEstimate:
+        std::cout << "estimate\n";
+        break;
     default:
         std::cout << "???\n";
         break;
@@ -156,7 +165,12 @@ void Parameters::dump() const {
 #ifdef PTHREADS
             << "\t-No. threads   = " << m_num_threads << "\n"
 #endif
-            << "\t-Outg. limit   = " << m_og_limit << "\n\n";
+            << "\t-Outg. limit   = " << m_og_limit << "\n"
+            << "\t-Sample frac.  = " << m_sample_fraction << "\n"
+            << "\t-Base4 BGRT    = " << (m_base4 ? "yes" : "no") << "\n"
+            << "\t-Bulk build    = " << (m_bulk ? "yes" : "no") << "\n"
+            << "\t-Verify BGRT   = " << (m_verify ? "yes" : "no") << "\n"
+            << "\t-Cache limit   = " << m_cache_limit << " MB\n\n";
 }
 
 bool Parameters::checkIfHelp(const char *c) {
@@ -215,6 +229,8 @@ bool Parameters::set(int argc, char **argv) {
                 setCommand(Command1Pass);
             else if (!strcmp("info", arg))
                 setCommand(CommandInfo);
+            else if (!strcmp("estimate", arg))
+                setCommand(CommandEstimate);
             else {
                 // This indicates an error...
                 std::cerr << "Parameter error: unknown command: " << arg
@@ -233,6 +249,12 @@ bool Parameters::set(int argc, char **argv) {
                     setVerbose(true);
                 } else if (!strcmp("all", arg)) {
                     setAllSignatures(true);
+                } else if (!strcmp("base4", arg)) {
+                    setBase4(true);
+                } else if (!strcmp("bulk", arg)) {
+                    setBulk(true);
+                } else if (!strcmp("noverify", arg)) {
+                    setVerify(false);
                 } else if (!strcmp("idx", arg) && remainingParams(argc, i, 1)) {
                     if (!strcmp("minipt", argv[i + 1]))
                         setIndex(IndexMiniPt);
@@ -321,7 +343,8 @@ bool Parameters::set(int argc, char **argv) {
                         return false;
                     }
                     ++dash;
-                    if (!setMin_gc(atof(arg))) {
+                    setUse_gc(true);
+                    if (!setMin_gc(atof(argv[i + 1]))) {
                         std::cerr << "Parameter error: error while parsing "
                                 "min. G+C value.\n";
                         return false;
@@ -340,6 +363,7 @@ bool Parameters::set(int argc, char **argv) {
                         return false;
                     }
                     ++dash;
+                    setUse_tm(true);
                     if (!setMin_tm(atof(argv[i + 1]))) {
                         std::cerr << "Parameter error: error while parsing "
                                 "min. temperature value.\n";
@@ -391,6 +415,22 @@ bool Parameters::set(int argc, char **argv) {
                         return false;
                     }
                     ++i;
+                } else if (!strcmp("sample", arg)
+                        && remainingParams(argc, i, 1)) {
+                    if (!setSample_fraction(atof(argv[i + 1]))) {
+                        std::cerr << "Parameter error: sample fraction has to "
+                                "be within the range (0,1].\n";
+                        return false;
+                    }
+                    ++i;
+                } else if (!strcmp("cache", arg)
+                        && remainingParams(argc, i, 1)) {
+                    if (!setCache_limit(strtoul(argv[i + 1], NULL, 10))) {
+                        std::cerr << "Parameter error: error while parsing "
+                                "cache limit.\n";
+                        return false;
+                    }
+                    ++i;
                 } else if (!strcmp("par", arg) && remainingParams(argc, i, 1)) {
                     if (!setNum_Threads(atoi(argv[i + 1]))) {
                         std::cerr << "Parameter error: error while parsing "
@@ -423,7 +463,7 @@ bool Parameters::set(int argc, char **argv) {
  */
 void Parameters::usage() const {
     std::cout
-            << "CaSSiS usage: cassis {1pass|create|process|info} [options]\n"
+            << "CaSSiS usage: cassis {1pass|create|process|info|estimate} [options]\n"
                     "\n"
                     "cassis 1pass\n"
                     "  Mandatory: -seq [... -seq] -tree\n"
@@ -432,23 +472,44 @@ void Parameters::usage() const {
                     "\n"
                     "cassis create\n"
                     "  Mandatory: -bgrt -seq [... -seq]\n"
-                    "  Optional:  -all -dist -gc -idx -len -mis -rc -temp -wm\n"
+                    "  Optional:  -all -base4 -bulk -dist -gc -idx -len -mis -rc -temp -wm\n"
                     "\n"
                     "cassis process\n"
                     "  Mandatory: -bgrt -tree|-list\n"
 #ifdef PTHREADS
-            "  Optional:  -og -out -par\n"
+            "  Optional:  -cache -noverify -og -out -par\n"
 #else
-            "  Optional:  -og -out\n"
+            "  Optional:  -cache -noverify -og -out\n"
 #endif
             "\n"
             "cassis info\n"
             "  Mandatory: -bgrt\n"
+            "  Optional:  -noverify\n"
+            "\n"
+            "cassis estimate\n"
+            "  Mandatory: -seq [... -seq]\n"
+            "  Optional:  -all -base4 -dist -gc -idx -len -mis -og -rc -sample -temp\n"
+            "             -tree -wm\n"
+            "  Comment:   Extrapolates the costs of a 'create', '1pass' and 'process'\n"
+            "             run from a sample of the signature candidates.\n"
+            "             The number of BGRT nodes is an upper estimate: the growth\n"
+            "             of the BGRT slows down with more signatures, so small\n"
+            "             samples overestimate it (by up to about 40% with the\n"
+            "             default sample fraction of 0.01).\n"
             "\n"
             "Options (alphabetical):\n"
             "  -all              Evaluate all 4^len possible signatures.\n"
             "                    (Not recommended, may take forever... Default: off)\n"
+            "  -base4            Store the signatures of a new BGRT Base4-compressed\n"
+            "                    (2 bits per base). (Default: off)\n"
             "  -bgrt <filename>  BGRT file path and name.\n"
+            "  -bulk             Collect all signatures first and build the BGRT bottom-up\n"
+            "                    in one pass (faster, but keeps all matches in memory).\n"
+            "                    (Comment: Only available in 'cassis create'.)\n"
+            "  -cache <MB>       Memory limit for the BGRT subtrees that are loaded on\n"
+            "                    demand when groups from a list are processed (measured\n"
+            "                    by their size in the BGRT file). (Default: 0 = no limit)\n"
+            "                    (Comment: Only available in 'cassis process -list'.)\n"
             "  -dist <number>    Minimal mismatch distance between a signature candidate\n"
             "                    and non-targets. Must be higher than \"-mis <number>\".\n"
             "                    (Default: 1.0 mismatches)\n"
@@ -467,6 +528,9 @@ void Parameters::usage() const {
             "                    (Comment: Only available in 'cassis process'.)\n"
             "  -mis <number>     Number of allowed mismatches within the target group.\n"
             "                    (Default: 0.0 mismatches)\n"
+            "  -noverify         Skip the checksum verification when a BGRT file is\n"
+            "                    loaded (faster, for trusted local files).\n"
+            "                    (Comment: Only available in 'cassis process|info'.)\n"
             "  -og <limit>       Number of outgroup hits up to which group signatures are\n"
             "                    computed. (Default: 0)\n"
             "  -out <format>     Defines the output format.\n"
@@ -480,6 +544,8 @@ void Parameters::usage() const {
             "  -rc               Drop signatures, if their reverse complement matches\n"
             "                    sequences not matched by the signature itself.\n"
             "                    (Default: off)\n"
+            "  -sample <number>  Fraction of the signature candidates that is evaluated\n"
+            "                    by 'cassis estimate'. (Default: 0.01)\n"
             "  -seq <filename>   MultiFasta file as sequence data source Multiple sequence\n"
             "                    sources can be defined.\n"
             "  -temp <min>-<max> Only allow signatures with a melting temperature within\n"
@@ -597,6 +663,26 @@ bool Parameters::allSignatures() const {
     return this->m_all_signatures;
 }
 
+double Parameters::sample_fraction() const {
+    return this->m_sample_fraction;
+}
+
+bool Parameters::base4() const {
+    return this->m_base4;
+}
+
+bool Parameters::bulk() const {
+    return this->m_bulk;
+}
+
+bool Parameters::verify() const {
+    return this->m_verify;
+}
+
+unsigned long Parameters::cache_limit() const {
+    return this->m_cache_limit;
+}
+
 /*!
  * Setter methods...
  * Setter return false, if an error occurred, e.g. out of range.
@@ -732,3 +818,30 @@ bool Parameters::setAllSignatures(bool a) {
     this->m_all_signatures = a;
     return true;
 }
+
+bool Parameters::setSample_fraction(double f) {
+    if (f <= 0.0 || f > 1.0)
+        return false;
+    this->m_sample_fraction = f;
+    return true;
+}
+
+bool Parameters::setBase4(bool b) {
+    this->m_base4 = b;
+    return true;
+}
+
+bool Parameters::setBulk(bool b) {
+    this->m_bulk = b;
+    return true;
+}
+
+bool Parameters::setVerify(bool v) {
+    this->m_verify = v;
+    return true;
+}
+
+bool Parameters::setCache_limit(unsigned long c) {
+    this->m_cache_limit = c;
+    return true;
+}
@@ -36,7 +36,8 @@ enum Command {
     Command1Pass,
     CommandCreate,
     CommandProcess,
-    CommandInfo
+    CommandInfo,
+    CommandEstimate
 };
 
 enum Index {
@@ -110,6 +111,11 @@ public:
     unsigned int og_limit() const;
     unsigned int num_threads() const;
     bool allSignatures() const;
+    double sample_fraction() const;
+    bool base4() const;
+    bool bulk() const;
+    bool verify() const;
+    unsigned long cache_limit() const;
 protected:
     /*!
      * Setter methods...
@@ -139,6 +145,11 @@ protected:
     bool setOg_limit(unsigned int o);
     bool setNum_Threads(unsigned int t);
     bool setAllSignatures(bool a);
+    bool setSample_fraction(double f);
+    bool setBase4(bool b);
+    bool setBulk(bool b);
+    bool setVerify(bool v);
+    bool setCache_limit(unsigned long c);
 private:
     bool checkIfHelp(const char *c);
     inline bool remainingParams(unsigned int argc, unsigned int current,
@@ -169,6 +180,11 @@ private:
     std::string m_treename;
     unsigned int m_og_limit;
     bool m_all_signatures;
+    double m_sample_fraction;
+    bool m_base4;
+    bool m_bulk;
+    bool m_verify;
+    unsigned long m_cache_limit;
 };
 
 #endif /* CASSIS_PARAMETERS_H_ */
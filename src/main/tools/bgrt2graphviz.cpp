@@ -26,6 +26,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <cstdlib>
 #include <cstring>
 
 void traverseBGRT(unsigned long &nodecounter, unsigned long parentcounter,
@@ -40,10 +41,14 @@ void traverseBGRT(unsigned long &nodecounter, unsigned long parentcounter,
     //				<< "\"];\n";
 
     stream << "n" << nodecounter << " [label=\"";
-    if (node->species->size() > 0)
-        stream << node->species->val(0);
-    for (unsigned int i = 1; i < node->species->size(); ++i)
-        stream << "," << node->species->val(i);
+    unsigned int *species = (unsigned int *) malloc(
+            (node->species.size() + 1) * sizeof(unsigned int));
+    unsigned int num_species = node->species.decode(species);
+    if (num_species > 0)
+        stream << species[0];
+    for (unsigned int i = 1; i < num_species; ++i)
+        stream << "," << species[i];
+    free(species);
 
     //if (parentcounter == 0)
     //    stream << "\" peripheries=\"2\"];\n";
@@ -79,7 +84,7 @@ int main(int argc, char **argv) {
     // Create a NameMap and open the BGRT file.
     NameMap map;
     BgrTree *bgr_tree = readBGRTFile(&map, argv[1]);
-    if (!bgr_tree) {
+    if (!bgr_tree || !BgrTree_thaw(bgr_tree)) {
         std::cerr << "Error: unable to open/read the BGRT file.\n";
         return 1;
     }
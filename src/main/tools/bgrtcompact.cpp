@@ -0,0 +1,74 @@
+/*!
+ * BGRT compaction tool
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) tools.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstring>
+
+#include <cassis/bgrt.h>
+#include <cassis/namemap.h>
+#include <cassis/io.h>
+
+/*!
+ * Usage information
+ */
+void usage() {
+    std::cout << "Usage: bgrtcompact <src-BGRT> <dest-BGRT>\n"
+            "This tool removes nodes without signatures that have only a\n"
+            "single child from a BGRT (the child takes over their species).\n";
+}
+
+int main(int argc, char **argv) {
+    // Check arguments...
+    if (argc != 3 || !strcmp(argv[1], "/?") || !strcmp(argv[1], "-h")
+            || !strcmp(argv[1], "--help")) {
+        usage();
+        return 0;
+    }
+
+    NameMap map;
+    BgrTree *tree = readBGRTFile(&map, argv[1]);
+    if (!tree || !BgrTree_thaw(tree)) {
+        std::cout << "Unable to open/read the BGRT file: " << argv[1] << "\n";
+        BgrTree_destroy(tree);
+        return -1;
+    }
+
+    BgrTreeCompactStats stats;
+    if (!BgrTree_compact(tree, &stats)) {
+        std::cout << "Unable to compact the BGRT (out of memory).\n";
+        BgrTree_destroy(tree);
+        return -1;
+    }
+    std::cout << "Removed " << stats.removed_nodes << " of "
+            << stats.num_nodes << " nodes.\n"
+            "Depth (longest path from a root): " << stats.depth_before
+            << " -> " << stats.depth_after << " nodes.\n";
+
+    if (!writeBGRTFile(tree, &map, argv[2])) {
+        std::cout << "Unable to write the BGRT file: " << argv[2] << "\n";
+        BgrTree_destroy(tree);
+        return -1;
+    }
+    BgrTree_destroy(tree);
+    return 0;
+}
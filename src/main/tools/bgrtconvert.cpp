@@ -0,0 +1,90 @@
+/*!
+ * BGRT file format conversion tool
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) tools.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include <cassis/bgrt.h>
+#include <cassis/namemap.h>
+#include <cassis/io.h>
+
+/*!
+ * Usage information
+ */
+void usage() {
+    std::cout << "Usage: bgrtconvert [-v <version>] <src-BGRT> <dest-BGRT>\n"
+            "This tool converts a BGRT file into another file format "
+            "version:\n"
+            "  " << BGRT_FILE_VERSION_STREAM << " : stream format "
+            "(readable by older CaSSiS versions)\n"
+            "  " << BGRT_FILE_VERSION_FLAT << " : flat format "
+            "(memory mapped when read, about 60% larger)\n"
+            "  " << BGRT_FILE_VERSION_INDEXED << " : coded stream format "
+            "with a root index (read on demand or in parallel, default)\n";
+}
+
+/*!
+ * Main function
+ */
+int main(int argc, char **argv) {
+    // Check arguments...
+    unsigned int version = BGRT_FILE_VERSION;
+    int arg = 1;
+    if ((argc == 5) && !strcmp(argv[1], "-v")) {
+        version = atoi(argv[2]);
+        arg = 3;
+    }
+    if ((argc != arg + 2) || !strcmp(argv[1], "/?") || !strcmp(argv[1], "-h")
+            || !strcmp(argv[1], "--help")
+            || ((version != BGRT_FILE_VERSION_STREAM)
+                    && (version != BGRT_FILE_VERSION_FLAT)
+                    && (version != BGRT_FILE_VERSION_INDEXED))) {
+        usage();
+        return 0;
+    }
+
+    NameMap map;
+    BgrTree *tree = readBGRTFile(&map, argv[arg]);
+    if (!tree) {
+        std::cout << "Unable to open/read the BGRT file: " << argv[arg]
+                << "\n";
+        return -1;
+    }
+
+    // The stream format is written from the nodes of the tree.
+    if ((version != BGRT_FILE_VERSION_FLAT) && !BgrTree_thaw(tree)) {
+        std::cout << "Unable to convert the BGRT (out of memory).\n";
+        BgrTree_destroy(tree);
+        return -1;
+    }
+
+    if (!writeBGRTFile(tree, &map, argv[arg + 1], version)) {
+        std::cout << "Unable to write the BGRT file: " << argv[arg + 1]
+                << "\n";
+        BgrTree_destroy(tree);
+        return -1;
+    }
+    BgrTree_destroy(tree);
+    return 0;
+}
@@ -60,21 +60,31 @@ int main(int argc, char **argv) {
 
     NameMap dest_map;
 
+    // The signatures of all sources are collected first. The destination
+    // BGRT is built bottom-up, once all sources were read.
+    BgrTreeBulk *bulk = BgrTreeBulk_create(dest_tree);
+
     // Merge the BGRTs...
     for (int i = 2; i < argc; ++i) {
         NameMap src_map;
         BgrTree *src_tree = readBGRTFile(&src_map, argv[i]);
 
-        if (!src_tree) {
+        if (!src_tree || !BgrTree_thaw(src_tree)) {
             std::cout << "Unable to open/read the BGRT file: " << argv[i]
                                                                        << "\n";
             return -1;
         }
 
-        BgrTree_merge(dest_tree, dest_map, src_tree, src_map);
+        BgrTree_merge(dest_tree, dest_map, src_tree, src_map, bulk);
         BgrTree_destroy(src_tree);
     }
 
+    if (!BgrTreeBulk_build(bulk)) {
+        std::cout << "Unable to build the merged BGRT (out of memory).\n";
+        return -1;
+    }
+    BgrTreeBulk_destroy(bulk);
+
     writeBGRTFile(dest_tree, &dest_map, argv[1]);
     return 0;
 }
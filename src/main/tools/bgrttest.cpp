@@ -0,0 +1,827 @@
+/*!
+ * CaSSiS self test tool.
+ * Builds BGRTs from generated signatures and checks that equivalent trees
+ * (bulk and incremental construction, compaction, file format versions)
+ * hold and return the same signatures, that corrupted files are rejected,
+ * and that the batch evaluation of signatures matches the evaluation one
+ * by one.
+ *
+ * This file is part of the
+ * Comprehensive and Sensitive Signature Search (CaSSiS) tools.
+ *
+ * Copyright (C) 2026
+ *     The CaSSiS contributors
+ *
+ * CaSSiS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * CaSSiS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with CaSSiS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <cassis/bgrt.h>
+#include <cassis/blockio.h>
+#include <cassis/bulk.h>
+#include <cassis/namemap.h>
+#include <cassis/io.h>
+#include <cassis/search.h>
+#include <cassis/sigpool.h>
+#include <cassis/thermodynamics.h>
+
+/*!
+ * Size of the generated test data.
+ */
+#define TEST_NUM_SPECIES 300
+#define TEST_NUM_SETS 500
+
+/*!
+ * Outgroup limit of the group searches.
+ */
+#define TEST_MAX_OUTGROUP 2
+
+/*!
+ * Generated signatures: Each signature belongs to one of the species
+ * sets. The sets are used as search groups as well.
+ */
+struct TestData {
+    std::vector<IntSet*> sets;
+    std::vector<std::string> signatures;
+    std::vector<unsigned int> set_of;
+    std::vector<unsigned int> outgroup_matches;
+};
+
+/*!
+ * Simple (reproducible) pseudo random numbers in [0..n).
+ */
+static unsigned int random_state = 1;
+static unsigned int nextRandom(unsigned int n) {
+    random_state = random_state * 1103515245 + 12345;
+    return (random_state >> 8) % n;
+}
+
+/*!
+ * Generates a species set. Single species, runs of consecutive species,
+ * dense ranges and sparse sets are mixed, so that all encodings of the
+ * species containers are used.
+ */
+static IntSet *randomSpecies() {
+    IntSet *set = new IntSet();
+    unsigned int first = nextRandom(TEST_NUM_SPECIES);
+    switch (nextRandom(4)) {
+    case 0:
+        for (unsigned int n = 1 + nextRandom(3); n > 0; --n)
+            set->add(nextRandom(TEST_NUM_SPECIES));
+        break;
+    case 1:
+        for (unsigned int n = 2 + nextRandom(60);
+                (n > 0) && (first < TEST_NUM_SPECIES); --n)
+            set->add(first++);
+        break;
+    case 2:
+        for (unsigned int n = 8 + nextRandom(64);
+                (n > 0) && (first < TEST_NUM_SPECIES); --n, ++first)
+            if (nextRandom(2))
+                set->add(first);
+        break;
+    default:
+        for (unsigned int n = 5 + nextRandom(40); n > 0; --n)
+            set->add(nextRandom(TEST_NUM_SPECIES));
+        break;
+    }
+    if (set->size() == 0)
+        set->add(first % TEST_NUM_SPECIES);
+    return set;
+}
+
+/*!
+ * Generates the test data with the given number of species sets.
+ */
+static void generateTestData(TestData &data, unsigned int num_sets) {
+    static const char BASES[4] = { 'A', 'C', 'G', 'U' };
+    random_state = 1;
+    for (unsigned int s = 0; s < num_sets; ++s) {
+        data.sets.push_back(randomSpecies());
+        for (unsigned int n = 1 + nextRandom(4); n > 0; --n) {
+            std::string signature(12 + nextRandom(9), 'A');
+            for (unsigned int i = 0; i < signature.size(); ++i)
+                signature[i] = BASES[nextRandom(4)];
+            data.signatures.push_back(signature);
+            data.set_of.push_back(s);
+            // Mostly small values, but also some that need more than one
+            // VarUInt byte.
+            data.outgroup_matches.push_back(
+                    nextRandom(2) ? nextRandom(8) : nextRandom(100000));
+        }
+    }
+}
+
+/*!
+ * Free the test data.
+ */
+static void releaseTestData(TestData &data) {
+    for (unsigned int s = 0; s < data.sets.size(); ++s)
+        delete data.sets[s];
+    data.sets.clear();
+}
+
+/*!
+ * Copy of a species set (BgrTree_insert frees the set).
+ */
+static IntSet *copySpecies(const IntSet *set) {
+    IntSet *copy = new IntSet(set->size());
+    for (unsigned int i = 0; i < set->size(); ++i)
+        copy->set(i, set->val(i));
+    copy->setSize(set->size());
+    return copy;
+}
+
+/*!
+ * Build a BGRT from the test data, incrementally or bottom-up (bulk).
+ */
+static BgrTree *buildTree(const TestData &data, bool base4, bool bulk) {
+    BgrTree *tree = BgrTree_create(TEST_NUM_SPECIES, base4);
+    if (!tree)
+        return NULL;
+    BgrTreeBulk *builder = bulk ? BgrTreeBulk_create(tree) : NULL;
+    bool success = !bulk || builder;
+    for (unsigned int i = 0; success && (i < data.signatures.size()); ++i) {
+        const IntSet *species = data.sets[data.set_of[i]];
+        if (bulk)
+            success = BgrTreeBulk_add(builder, data.signatures[i].c_str(),
+                    species, data.outgroup_matches[i]);
+        else
+            success = BgrTree_insert(tree, data.signatures[i].c_str(),
+                    copySpecies(species), data.outgroup_matches[i]);
+    }
+    if (builder) {
+        success = success && BgrTreeBulk_build(builder);
+        BgrTreeBulk_destroy(builder);
+    }
+    if (!success) {
+        BgrTree_destroy(tree);
+        return NULL;
+    }
+    return tree;
+}
+
+/*!
+ * Describe the signatures of a subtree (see describeTree).
+ */
+static void describeNode(const BgrTree *tree, const BgrTreeNode *node,
+        std::vector<unsigned int> &path, std::vector<std::string> &lines) {
+    const unsigned int path_size = path.size();
+    path.resize(path_size + node->species.size());
+    if (node->species.size() > 0)
+        node->species.decode(&path[path_size]);
+    std::vector<unsigned int> species(path);
+    std::sort(species.begin(), species.end());
+
+    char buffer[SIGNATURE_BUFFER_SIZE];
+    for (unsigned int s = 0; s < node->signatures->size(); ++s) {
+        std::ostringstream line;
+        line << tree->signature_pool->get(node->signatures->val(s), buffer)
+                << " " << node->supposed_outgroup_matches->val(s) << ":";
+        for (unsigned int i = 0; i < species.size(); ++i)
+            line << " " << species[i];
+        lines.push_back(line.str());
+    }
+    for (const BgrTreeNode *child = node->children; child;
+            child = child->next)
+        describeNode(tree, child, path, lines);
+    path.resize(path_size);
+}
+
+/*!
+ * Describe the signatures of a (mutable) BGRT as text: one line per
+ * signature with its number of outgroup matches and the species of its
+ * path (the union of the species sets from the root to its node). The
+ * lines are sorted, so that trees of a different shape describe the same
+ * matchings the same way.
+ */
+static std::string describeTree(const BgrTree *tree) {
+    std::vector<std::string> lines;
+    std::vector<unsigned int> path;
+    for (unsigned int r = 0; r < tree->num_species; ++r)
+        for (const BgrTreeNode *node = tree->nodes[r]; node; node = node->next)
+            describeNode(tree, node, path, lines);
+    std::sort(lines.begin(), lines.end());
+
+    std::string description;
+    for (unsigned int i = 0; i < lines.size(); ++i)
+        description += lines[i] + "\n";
+    return description;
+}
+
+/*!
+ * Search the signatures of the test groups: the species sets of the test
+ * data and the unions of two of them. The results are returned as text
+ * (one line per group and number of outgroup matches, with the sorted
+ * signatures).
+ * If 'lazy' is set, the needed subtrees are loaded from it for each group.
+ */
+static bool searchTree(BgrTree *tree, const TestData &data,
+        unsigned int max_outgroup, std::string &result,
+        BgrTreeLazy *lazy = NULL) {
+    std::ostringstream out;
+    char buffer[SIGNATURE_BUFFER_SIZE];
+    for (unsigned int s = 0; s < data.sets.size(); s += 3) {
+        IntSet *group = copySpecies(data.sets[s]);
+        if (s % 2)
+            for (unsigned int i = 0; i < data.sets[s + 1]->size(); ++i)
+                group->add(data.sets[s + 1]->val(i));
+
+        BgrTree *searched = tree;
+        if (lazy)
+            searched = BgrTreeLazy_load(lazy,
+                    max_outgroup ? NULL : group->val_ptr(), group->size());
+        unsigned int *num_matches = NULL;
+        UnorderedIntSet *signatures = NULL;
+        if (!searched || !findGroupSpecificSignatures(searched, group,
+                num_matches, signatures, max_outgroup)) {
+            delete group;
+            return false;
+        }
+        for (unsigned int outg = 0; outg <= max_outgroup; ++outg) {
+            std::vector<std::string> found;
+            for (unsigned int k = 0; k < signatures[outg].size(); ++k)
+                found.push_back(searched->signature_pool->get(
+                        signatures[outg].val(k), buffer));
+            std::sort(found.begin(), found.end());
+            out << s << "/" << outg << ": " << num_matches[outg];
+            for (unsigned int k = 0; k < found.size(); ++k)
+                out << " " << found[k];
+            out << "\n";
+        }
+        delete[] num_matches;
+        delete[] signatures;
+        delete group;
+    }
+    result = out.str();
+    return true;
+}
+
+/*!
+ * Compare two search results or tree descriptions.
+ */
+static bool sameResult(const std::string &expected, const std::string &found,
+        const char *what) {
+    if (expected == found)
+        return true;
+    std::cout << "FAILED: different signatures (" << what << ").\n";
+    return false;
+}
+
+/*!
+ * Read a file into a string.
+ */
+static bool readFile(const std::string &filename, std::string &content) {
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    content.assign((std::istreambuf_iterator<char>(file)),
+            std::istreambuf_iterator<char>());
+    return true;
+}
+
+/*!
+ * Write a string into a file.
+ */
+static bool writeFile(const std::string &filename,
+        const std::string &content) {
+    std::ofstream file(filename.c_str(),
+            std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+    file.write(content.data(), content.size());
+    return file.good();
+}
+
+/*!
+ * Compare two files byte by byte.
+ */
+static bool sameFile(const std::string &a, const std::string &b) {
+    std::string ca, cb;
+    return readFile(a, ca) && readFile(b, cb) && (ca == cb);
+}
+
+/*!
+ * Species names of the test data.
+ */
+static void createNames(NameMap &map) {
+    for (unsigned int i = 0; i < TEST_NUM_SPECIES; ++i) {
+        std::ostringstream name;
+        name << "S" << i;
+        map.append(name.str());
+    }
+}
+
+/*!
+ * BGRT file format versions.
+ */
+#define TEST_NUM_VERSIONS 3
+static const unsigned int VERSIONS[TEST_NUM_VERSIONS] = {
+        BGRT_FILE_VERSION_STREAM, BGRT_FILE_VERSION_INDEXED,
+        BGRT_FILE_VERSION_FLAT };
+
+/*!
+ * Test: Write the BGRT in all file format versions, read it back and
+ * compare the search results. Stream files have to be written the same
+ * after they were read, indexed files are read on demand as well.
+ */
+static bool testIO(const TestData &data, const std::string &dir) {
+    NameMap map;
+    createNames(map);
+
+    bool success = true;
+    for (int base4 = 0; success && (base4 < 2); ++base4) {
+        BgrTree *tree = buildTree(data, base4, false);
+        if (!tree)
+            return false;
+        std::string filename[TEST_NUM_VERSIONS];
+        for (unsigned int v = 0; success && (v < TEST_NUM_VERSIONS); ++v) {
+            std::ostringstream name;
+            name << dir << "/bgrttest_v" << VERSIONS[v] << ".bgrt";
+            filename[v] = name.str();
+            success = writeBGRTFile(tree, &map, filename[v].c_str(),
+                    VERSIONS[v]);
+        }
+        std::string expected[TEST_MAX_OUTGROUP + 1];
+        for (unsigned int og = 0; success && (og <= TEST_MAX_OUTGROUP); ++og)
+            success = searchTree(tree, data, og, expected[og]);
+        BgrTree_destroy(tree);
+        if (!success) {
+            std::cout << "FAILED: unable to write/search the BGRT.\n";
+            return false;
+        }
+
+        for (unsigned int v = 0; success && (v < TEST_NUM_VERSIONS); ++v) {
+            for (int verify = 1; success && (verify >= 0); --verify) {
+                NameMap read_map;
+                tree = readBGRTFile(&read_map, filename[v].c_str(), verify);
+                success = tree && (read_map.size() == TEST_NUM_SPECIES);
+                if (success && (VERSIONS[v] != BGRT_FILE_VERSION_FLAT)) {
+                    // Stream files are read into a mutable tree.
+                    std::string copy = filename[v] + ".copy";
+                    success = writeBGRTFile(tree, &read_map, copy.c_str(),
+                            VERSIONS[v]) && sameFile(filename[v], copy);
+                    remove(copy.c_str());
+                }
+                for (unsigned int og = 0;
+                        success && (og <= TEST_MAX_OUTGROUP); ++og) {
+                    std::string found;
+                    success = searchTree(tree, data, og, found)
+                            && sameResult(expected[og], found,
+                                    filename[v].c_str());
+                }
+                BgrTree_destroy(tree);
+            }
+        }
+
+        // Files with a root index are read on demand (a small cache limit
+        // evicts subtrees between the queries).
+        for (unsigned int v = 0; success && (v < TEST_NUM_VERSIONS); ++v) {
+            NameMap lazy_map;
+            BgrTreeLazy *lazy = BgrTreeLazy_open(&lazy_map,
+                    filename[v].c_str(), true, 4096);
+            if (VERSIONS[v] != BGRT_FILE_VERSION_INDEXED) {
+                success = !lazy;
+                BgrTreeLazy_close(lazy);
+                continue;
+            }
+            for (unsigned int og = 0;
+                    lazy && success && (og <= TEST_MAX_OUTGROUP); ++og) {
+                std::string found;
+                success = searchTree(BgrTreeLazy_tree(lazy), data, og, found,
+                        lazy) && sameResult(expected[og], found,
+                        "on demand reading");
+            }
+            success = success && lazy;
+            BgrTreeLazy_close(lazy);
+        }
+
+        for (unsigned int v = 0; v < TEST_NUM_VERSIONS; ++v)
+            remove(filename[v].c_str());
+    }
+    if (!success)
+        std::cout << "FAILED: BGRT file round trip.\n";
+    return success;
+}
+
+/*!
+ * Test: Stream files that span several read blocks are read back into
+ * the same tree (and written the same again).
+ */
+static bool testBlocks(const std::string &dir) {
+    TestData data;
+    generateTestData(data, 10 * TEST_NUM_SETS);
+    NameMap map;
+    createNames(map);
+
+    bool success = true;
+    for (int base4 = 0; success && (base4 < 2); ++base4) {
+        BgrTree *tree = buildTree(data, base4, false);
+        if (!tree) {
+            success = false;
+            break;
+        }
+        const std::string expected = describeTree(tree);
+        for (unsigned int v = 0; success && (v < TEST_NUM_VERSIONS); ++v) {
+            if (VERSIONS[v] == BGRT_FILE_VERSION_FLAT)
+                continue;
+            std::ostringstream name;
+            name << dir << "/bgrttest_blocks_v" << VERSIONS[v] << ".bgrt";
+            const std::string filename = name.str();
+            const std::string copy = filename + ".copy";
+            std::string content;
+            success = writeBGRTFile(tree, &map, filename.c_str(), VERSIONS[v])
+                    && readFile(filename, content)
+                    && (content.size() > 2 * BLOCK_IO_SIZE);
+
+            NameMap read_map;
+            BgrTree *read = success ?
+                    readBGRTFile(&read_map, filename.c_str()) : NULL;
+            success = read && (read_map.size() == TEST_NUM_SPECIES)
+                    && sameResult(expected, describeTree(read),
+                            filename.c_str())
+                    && writeBGRTFile(read, &read_map, copy.c_str(),
+                            VERSIONS[v]) && sameFile(filename, copy);
+            BgrTree_destroy(read);
+            remove(filename.c_str());
+            remove(copy.c_str());
+        }
+        BgrTree_destroy(tree);
+    }
+    releaseTestData(data);
+    if (!success)
+        std::cout << "FAILED: reading BGRT streams in blocks.\n";
+    return success;
+}
+
+/*!
+ * Number of corrupted copies per BGRT file (see testCorrupt).
+ */
+#define TEST_NUM_CORRUPTIONS 250
+
+/*!
+ * Test: Corrupted copies of the BGRT files (a flipped bit, a large
+ * VarUInt written over the data, or a truncated file) are rejected if
+ * the checksum is verified, and are read without a crash if not. A
+ * change within the file identifier (e.g. in the format flags) does not
+ * change the checksum, the file only must not crash the reader then.
+ */
+static bool testCorrupt(const TestData &data, const std::string &dir) {
+    NameMap map;
+    createNames(map);
+
+    bool success = true;
+    for (int base4 = 0; success && (base4 < 2); ++base4) {
+        BgrTree *tree = buildTree(data, base4, false);
+        if (!tree)
+            return false;
+        for (unsigned int v = 0; success && (v < TEST_NUM_VERSIONS); ++v) {
+            std::ostringstream name;
+            name << dir << "/bgrttest_corrupt_v" << VERSIONS[v] << ".bgrt";
+            const std::string filename = name.str();
+            std::string content;
+            success = writeBGRTFile(tree, &map, filename.c_str(), VERSIONS[v])
+                    && readFile(filename, content) && !content.empty();
+
+            for (unsigned int n = 0;
+                    success && (n < TEST_NUM_CORRUPTIONS); ++n) {
+                // Flip a bit, write a large VarUInt (e.g. over a size or
+                // count) or truncate the file.
+                std::string corrupt = content;
+                const unsigned int pos = nextRandom(content.size());
+                if (n % 4 == 3)
+                    corrupt.resize(pos);
+                else if (n % 4 == 2)
+                    corrupt.replace(pos, 5, "\x8F\xFF\xFF\xFF\x7F", 5);
+                else
+                    corrupt[pos] ^= (char) (1 << nextRandom(8));
+                const bool detectable = (corrupt.size() != content.size())
+                        || (corrupt.compare(8, std::string::npos, content, 8,
+                                std::string::npos) != 0);
+                success = writeFile(filename, corrupt);
+
+                for (int verify = 1; success && (verify >= 0); --verify) {
+                    NameMap read_map;
+                    BgrTree *read = readBGRTFile(&read_map, filename.c_str(),
+                            verify);
+                    if (read && verify && detectable) {
+                        std::cout << "FAILED: corrupted file " << filename
+                                << " (copy " << n << ") was read.\n";
+                        success = false;
+                    }
+                    BgrTree_destroy(read);
+                }
+
+                NameMap lazy_map;
+                BgrTreeLazy *lazy = BgrTreeLazy_open(&lazy_map,
+                        filename.c_str(), true, 4096);
+                if (lazy && detectable) {
+                    std::cout << "FAILED: corrupted file " << filename
+                            << " (copy " << n << ") was opened.\n";
+                    success = false;
+                }
+                BgrTreeLazy_close(lazy);
+            }
+            remove(filename.c_str());
+        }
+        BgrTree_destroy(tree);
+    }
+    if (!success)
+        std::cout << "FAILED: reading corrupted BGRT files.\n";
+    return success;
+}
+
+/*!
+ * Test: Bulk (bottom-up) and incremental construction hold the same
+ * signatures and return the same search results.
+ */
+static bool testBulk(const TestData &data) {
+    bool success = true;
+    for (int base4 = 0; success && (base4 < 2); ++base4) {
+        BgrTree *incremental = buildTree(data, base4, false);
+        BgrTree *bulk = buildTree(data, base4, true);
+        success = incremental && bulk
+                && sameResult(describeTree(incremental), describeTree(bulk),
+                        "the bulk built BGRT");
+        for (unsigned int og = 0; success && (og <= TEST_MAX_OUTGROUP); ++og) {
+            std::string expected, found;
+            success = searchTree(incremental, data, og, expected)
+                    && searchTree(bulk, data, og, found)
+                    && sameResult(expected, found, "the bulk built BGRT");
+        }
+        BgrTree_destroy(incremental);
+        BgrTree_destroy(bulk);
+    }
+    if (!success)
+        std::cout << "FAILED: bulk construction.\n";
+    return success;
+}
+
+/*!
+ * Inverse of the compaction: The two smallest species of each root are
+ * moved into a chain of two new nodes without signatures above the root.
+ * The species sets of all paths stay the same.
+ */
+static bool addChains(BgrTree *tree) {
+    unsigned long chains = 0;
+    for (unsigned int r = 0; r < tree->num_species; ++r) {
+        BgrTreeNode *node = tree->nodes[r];
+        if (!node || (node->species.size() < 3))
+            continue;
+        std::vector<unsigned int> species(node->species.size());
+        node->species.decode(&species[0]);
+
+        BgrTreeNode *top = BgrTree_create_node(tree, &species[0], 1);
+        BgrTreeNode *middle = BgrTree_create_node(tree, &species[1], 1);
+        if (!top || !middle)
+            return false;
+        top->next = node->next;
+        top->children = middle;
+        top->num_children = 1;
+        middle->parent = top;
+        middle->children = node;
+        middle->num_children = 1;
+        node->parent = middle;
+        node->next = NULL;
+        node->species.assign(&species[2], species.size() - 2);
+        tree->nodes[r] = top;
+        ++chains;
+    }
+    return chains > 0;
+}
+
+/*!
+ * Test: A compacted BGRT holds the same signatures and returns the same
+ * search results. Chains of nodes without signatures are added before
+ * the compaction, so that nodes are merged.
+ */
+static bool testCompact(const TestData &data) {
+    bool success = true;
+    for (int base4 = 0; success && (base4 < 2); ++base4) {
+        BgrTree *tree = buildTree(data, base4, false);
+        BgrTree *compacted = buildTree(data, base4, false);
+        BgrTreeCompactStats stats;
+        success = tree && compacted && addChains(compacted)
+                && BgrTree_compact(compacted, &stats)
+                && (stats.removed_nodes > 0)
+                && (stats.depth_after < stats.depth_before)
+                && sameResult(describeTree(tree), describeTree(compacted),
+                        "the compacted BGRT");
+        for (unsigned int og = 0; success && (og <= TEST_MAX_OUTGROUP); ++og) {
+            std::string expected, found;
+            success = searchTree(tree, data, og, expected)
+                    && searchTree(compacted, data, og, found)
+                    && sameResult(expected, found, "the compacted BGRT");
+        }
+        BgrTree_destroy(tree);
+        BgrTree_destroy(compacted);
+    }
+    if (!success)
+        std::cout << "FAILED: BGRT compaction.\n";
+    return success;
+}
+
+/*!
+ * Compare two thermodynamic values.
+ */
+static bool sameValue(double a, double b) {
+    return fabs(a - b) <= 1e-6 * (1 + fabs(a));
+}
+
+/*!
+ * 2-bit packed signature (A=0, C=1, G=2, T/U=3, the first base in the
+ * most significant bits).
+ *
+ * \return false, if the signature contains other characters.
+ */
+static bool packSignature(const char *signature, unsigned int length,
+        uint64_t &packed) {
+    packed = 0;
+    for (unsigned int i = 0; i < length; ++i) {
+        packed <<= 2;
+        switch (signature[i]) {
+        case 'A':
+            break;
+        case 'C':
+            packed |= 1;
+            break;
+        case 'G':
+            packed |= 2;
+            break;
+        case 'T':
+        case 'U':
+            packed |= 3;
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * Test: The batch evaluation of signatures (strings and packed values)
+ * returns the same values and filter decisions as the evaluation one by
+ * one. Packed signatures and packed pool signatures are evaluated like
+ * their strings.
+ */
+static bool testThermodynamics() {
+    static const char BASES[6] = { 'A', 'C', 'G', 'T', 'U', 'N' };
+    static const unsigned int LENGTHS[5] = { 12, 18, 25, 32, 40 };
+    const unsigned int n = 300;
+    const unsigned int stride = 48;
+    // The second half of the result arrays is used for packed signatures.
+    char *signatures = (char *) malloc(n * stride);
+    uint64_t *packed = (uint64_t *) malloc(n * sizeof(uint64_t));
+    unsigned int *packed_index = (unsigned int *) malloc(
+            n * sizeof(unsigned int));
+    unsigned char *pass = (unsigned char *) malloc(2 * n);
+    double *gc = (double *) malloc(2 * n * sizeof(double));
+    double *tm = (double *) malloc(2 * n * sizeof(double));
+    bool success = signatures && packed && packed_index && pass && gc && tm;
+
+    Thermodynamics batch, single;
+    batch.enable_gc_check(40, 60);
+    batch.enable_tm_check(30, 80);
+    single.enable_gc_check(40, 60);
+    single.enable_tm_check(30, 80);
+    SignaturePool pool(true);
+
+    random_state = 2;
+    for (unsigned int l = 0; success && (l < 5); ++l) {
+        const unsigned int length = LENGTHS[l];
+        memset(signatures, 0, n * stride);
+        for (unsigned int i = 0; i < n; ++i)
+            for (unsigned int j = 0; j < length; ++j)
+                // Some signatures with characters that can not be packed.
+                signatures[i * stride + j] = BASES[nextRandom(
+                        (i % 10) ? 5 : 6)];
+        unsigned int passed = batch.batch_process(signatures, stride, length,
+                n, pass, gc, tm);
+
+        unsigned int expected = 0;
+        unsigned int num_packed = 0;
+        for (unsigned int i = 0; success && (i < n); ++i) {
+            const char *signature = signatures + i * stride;
+            bool passes = single.batch_process(signature);
+            single.process(signature);
+            expected += passes ? 1 : 0;
+            success = ((pass[i] != 0) == passes)
+                    && sameValue(gc[i], single.get_gc_content())
+                    && sameValue(tm[i], single.get_tm_base_stacking());
+
+            if (success && (length <= 32)
+                    && packSignature(signature, length, packed[num_packed])) {
+                single.process(packed[num_packed], length);
+                success = sameValue(gc[i], single.get_gc_content())
+                        && sameValue(tm[i], single.get_tm_base_stacking());
+                packed_index[num_packed++] = i;
+            }
+
+            // Packed pool signatures (without 'N').
+            if (success && !strchr(signature, 'N')) {
+                single.process(&pool, pool.add(signature));
+                success = sameValue(gc[i], single.get_gc_content())
+                        && sameValue(tm[i], single.get_tm_base_stacking());
+            }
+        }
+        success = success && (passed == expected);
+
+        // Packed signatures (up to 32 bases, without 'N').
+        if (success && (num_packed > 0)) {
+            passed = batch.batch_process(packed, length, num_packed, pass + n,
+                    gc + n, tm + n);
+            expected = 0;
+            for (unsigned int k = 0; success && (k < num_packed); ++k) {
+                const unsigned int i = packed_index[k];
+                expected += pass[i] ? 1 : 0;
+                success = (pass[n + k] == pass[i])
+                        && sameValue(gc[n + k], gc[i])
+                        && sameValue(tm[n + k], tm[i]);
+            }
+            success = success && (passed == expected);
+        }
+        if (!success)
+            std::cout << "FAILED: batch evaluation of signatures with "
+                    << length << " bases.\n";
+    }
+    free(signatures);
+    free(packed);
+    free(packed_index);
+    free(pass);
+    free(gc);
+    free(tm);
+    return success;
+}
+
+/*!
+ * Usage information
+ */
+void usage() {
+    std::cout << "Usage: bgrttest <test> [<temp-dir>]\n"
+            "Runs a self test of the CaSSiS library on generated data:\n"
+            "  io      : BGRT file round trips (all format versions)\n"
+            "  blocks  : BGRT streams that span several read blocks\n"
+            "  corrupt : reading corrupted BGRT files\n"
+            "  bulk    : bulk vs. incremental BGRT construction\n"
+            "  compact : BGRT compaction\n"
+            "  thermo  : batch vs. single signature evaluation\n"
+            "Temporary files are written into <temp-dir> "
+            "(default: current directory).\n";
+}
+
+/*!
+ * Main function
+ */
+int main(int argc, char **argv) {
+    if ((argc < 2) || (argc > 3)) {
+        usage();
+        return EXIT_SUCCESS;
+    }
+    const std::string test = argv[1];
+    const std::string dir = (argc == 3) ? argv[2] : ".";
+
+    if (test == "thermo")
+        return testThermodynamics() ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (test == "blocks")
+        return testBlocks(dir) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    TestData data;
+    generateTestData(data, TEST_NUM_SETS);
+    bool success;
+    if (test == "io")
+        success = testIO(data, dir);
+    else if (test == "corrupt")
+        success = testCorrupt(data, dir);
+    else if (test == "bulk")
+        success = testBulk(data);
+    else if (test == "compact")
+        success = testCompact(data);
+    else {
+        usage();
+        success = false;
+    }
+    releaseTestData(data);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
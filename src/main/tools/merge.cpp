@@ -116,11 +116,14 @@ void mergeBGRTParams(BgrTree *dest, const BgrTree *src) {
  * \param dest_map Destination NameMap
  * \param src_bgrt Source BGRT
  * \param src_map Source NameMap
+ * \param bulk Optional bulk builder for 'dest_bgrt'. If defined, the
+ *        signatures are collected and not inserted into 'dest_bgrt'.
  * \return Number of copied nodes. Zero if an error occurred.
  *
  */
 unsigned int BgrTree_merge(struct BgrTree *dest_bgrt, NameMap &dest_map,
-        const struct BgrTree *src_bgrt, const NameMap &src_map) {
+        const struct BgrTree *src_bgrt, const NameMap &src_map,
+        struct BgrTreeBulk *bulk) {
     unsigned int copied_nodes = 0;
 
     // Check parameters...
@@ -151,6 +154,8 @@ unsigned int BgrTree_merge(struct BgrTree *dest_bgrt, NameMap &dest_map,
 
     // Create a match array. Matched IDs are stored here during traversal.
     unsigned int match_array[dest_bgrt->num_species];
+    // Species of the current node (decoded).
+    unsigned int species_array[src_bgrt->num_species];
     std::stack<unsigned int> id_stack;
     std::stack<BgrTreeNode*> node_stack;
     BgrTreeNode *node = NULL;
@@ -171,28 +176,24 @@ unsigned int BgrTree_merge(struct BgrTree *dest_bgrt, NameMap &dest_map,
                 unsigned int parents_matches = id_stack.top();
                 id_stack.pop();
 
-                if (node->species->size() > 0) { // TODO: UNNECESSARY IF...!?
+                unsigned int num_species = node->species.decode(
+                        species_array);
+                if (num_species > 0) { // TODO: UNNECESSARY IF...!?
                     // We have matched species entries in this node...
                     // WARNING: std::map operator[] may add unknown entries!
-                    for (unsigned int j = 0; j < node->species->size(); ++j)
+                    for (unsigned int j = 0; j < num_species; ++j)
                         match_array[parents_matches + j] =
-                                src2dest_mapping[node->species->val(j)];
+                                src2dest_mapping[species_array[j]];
                 }
-                unsigned int my_matches = parents_matches
-                        + node->species->size();
+                unsigned int my_matches = parents_matches + num_species;
 
-                unsigned int size = 0;
-                if (src_bgrt->base4_compressed)
-                    size = node->signatures.base4->size();
-                else
-                    size = node->signatures.str->size();
-
-                if (size > 0) {
+                if (node->signatures->size() > 0) {
                     // We have matched signatures in this node...
                     // Create an IntSet based on the current matches.
                     IntSet *set = new IntSet(my_matches);
                     for (unsigned int j = 0; j < my_matches; ++j)
-                        set->add(match_array[j]); // TODO: UNTESTED!
+                        set->append(match_array[j]); // TODO: UNTESTED!
+                    set->finalize();
 
                     //set->vals = (unsigned int*) malloc(
                     //my_matches * sizeof(unsigned int));
@@ -200,20 +201,17 @@ unsigned int BgrTree_merge(struct BgrTree *dest_bgrt, NameMap &dest_map,
                     //my_matches * sizeof(unsigned int));
                     //set->size = set->vsize = my_matches;
 
-                    // Add the signature and matching to the dest_bgrt.
-                    if (src_bgrt->base4_compressed) {
-                        for (unsigned int j = 0;
-                                j < node->signatures.base4->size(); ++j) {
-                            char *str = node->signatures.base4->val(j)->toChar(
-                                    true);
-                            BgrTree_insert(dest_bgrt, str, set,
-                                    node->supposed_outgroup_matches->val(j));
-                            // TODO: This is NOT the way it should work!
-                            // Add a separate insert function for base4 sets.
-                        }
-                    } else
-                        BgrTree_insert(dest_bgrt, node->signatures.str, set,
+                    // Add the signature and matching to the dest_bgrt
+                    // (or collect them for a bulk construction).
+                    if (bulk) {
+                        BgrTreeBulk_add(bulk, src_bgrt->signature_pool,
+                                node->signatures, set,
                                 node->supposed_outgroup_matches);
+                        delete set;
+                    } else if (!BgrTree_insert(dest_bgrt,
+                            src_bgrt->signature_pool, node->signatures, set,
+                            node->supposed_outgroup_matches))
+                        return 0;
 
                     // Increase copied nodes counter.
                     ++copied_nodes;
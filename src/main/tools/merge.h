@@ -25,6 +25,7 @@
 #define MERGE_H_
 
 #include <cassis/bgrt.h>
+#include <cassis/bulk.h>
 #include <cassis/namemap.h>
 
 ///*!
@@ -46,10 +47,13 @@
  * \param dest_map Destination NameMap
  * \param src_bgrt Source BGRT
  * \param src_map Source NameMap
+ * \param bulk Optional bulk builder for 'dest_bgrt'. If defined, the
+ *        signatures are collected and not inserted into 'dest_bgrt'.
  * \return Number of copied nodes. Zero if an error occurred.
  *
  */
 unsigned int BgrTree_merge(struct BgrTree *dest_bgrt, NameMap &dest_map,
-        const struct BgrTree *src_bgrt, const NameMap &src_map);
+        const struct BgrTree *src_bgrt, const NameMap &src_map,
+        struct BgrTreeBulk *bulk = NULL);
 
 #endif /* MERGE_H_ */
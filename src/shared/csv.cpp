@@ -85,6 +85,9 @@ bool dump2ClassicCSV(CaSSiSTree *tree) {
     // Close dump-file.
     fclose(dumpfile);
 
+    // Buffer for decoded base4-encoded signatures.
+    char buffer[SIGNATURE_BUFFER_SIZE];
+
     unsigned int outg = 0;
     while (outg <= tree->allowed_outgroup_matches) {
         // Overall number of signatures in the current CSV file...
@@ -105,7 +108,7 @@ bool dump2ClassicCSV(CaSSiSTree *tree) {
         unsigned int i;
         for (i = 0; i < tree->num_nodes; ++i) {
             CaSSiSTreeNode *node = tree->internal_node_array[i];
-            unsigned int num_result_entries = node->signatures[outg].size();
+            unsigned int num_result_entries = node->numSignatures(outg);
 
             // Only dump nodes with signatures...
             if (num_result_entries > 0) {
@@ -124,13 +127,7 @@ bool dump2ClassicCSV(CaSSiSTree *tree) {
                 // Dump signatures
                 unsigned int k;
                 for (k = 0; k < num_result_entries; ++k)
-                    // if (node->signatures[outg].base4_compressed) {
-                    //     char *str = entry->signatures.base4->val(k)->toChar(
-                    //             true); // TODO: RNA!?
-                    //     fprintf(dumpfile, ",%s", str);
-                    //     free(str);
-                    // } else
-                    fprintf(dumpfile, ",%s", node->signatures[outg].val(k));
+                    fprintf(dumpfile, ",%s", node->signature(outg, k, buffer));
 
                 fprintf(dumpfile, "\n");
                 overall_num_signatures += num_result_entries;
@@ -171,6 +168,9 @@ bool dump2ClassicCSV(CaSSiSTree *tree) {
  * \return true, if successful. Otherwise false.
  */
 bool dump2DetailedCSV(CaSSiSTree *tree) {
+    // Buffer for decoded base4-encoded signatures.
+    char buffer[SIGNATURE_BUFFER_SIZE];
+
     unsigned int outg = 0;
     while (outg <= tree->allowed_outgroup_matches) {
         // Overall number of signatures in the current CSV file...
@@ -194,7 +194,7 @@ bool dump2DetailedCSV(CaSSiSTree *tree) {
 
         for (unsigned int i = 0; i < tree->num_nodes; ++i) {
             CaSSiSTreeNode *node = tree->internal_node_array[i];
-            unsigned int num_result_entries = node->signatures[outg].size();
+            unsigned int num_result_entries = node->numSignatures(outg);
 
             // Dump: ID, Size, Coverage.
             std::string name;
@@ -208,8 +208,8 @@ bool dump2DetailedCSV(CaSSiSTree *tree) {
             if ((name.length() > 0) && (num_result_entries > 0)) {
                 for (unsigned int k = 0; k < num_result_entries; ++k) {
                     // Fetch signature and process it.
-                    const char *signature = node->signatures[outg].val(k);
-                    therm.process(signature);
+                    const char *signature = node->signature(outg, k, buffer);
+                    therm.process(node->pool, node->signatures[outg].val(k));
 
                     // Dump results in CSV format.
                     fprintf(dumpfile, "\"%s\",%i,%i,%3.1f,%3.1f,%3.1f,\"%s\"\n",
@@ -119,10 +119,6 @@ void Newick2CaSSiSTree_postprocess(const NameMap &map, CaSSiSTree *tree,
                 depth + 1);
         node->leftmost_id = node->left->leftmost_id;
 
-        IntSet *left_group = node->left->group;
-        for (unsigned int i = 0; i < left_group->size(); i++)
-            node->group->add(left_group->val(i));
-
         // In-processing (Euler Tour)
         tree->eulertour[tree->tour_index] = node;
         tree->level[tree->tour_index++] = tree->tour_level - 1;
@@ -136,9 +132,8 @@ void Newick2CaSSiSTree_postprocess(const NameMap &map, CaSSiSTree *tree,
         tree->eulertour[tree->tour_index] = node;
         tree->level[tree->tour_index++] = --tree->tour_level;
 
-        IntSet *right_group = node->right->group;
-        for (unsigned int i = 0; i < right_group->size(); i++)
-            node->group->add(right_group->val(i));
+        // The group is the union of the (sorted) child groups.
+        node->group->merge(node->left->group, node->right->group);
 
     } else if (!node->left && !node->right) {
         // We are processing a leaf node. Fetch a new leaf node id from our
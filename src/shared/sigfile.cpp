@@ -58,9 +58,12 @@ bool dump2stream(std::ostream &stream, CaSSiSTreeNode *node,
     // Create a base for thermodynamic calculations.
     Thermodynamics therm;
 
+    // Buffer for decoded base4-encoded signatures.
+    char buffer[SIGNATURE_BUFFER_SIZE];
+
     unsigned int outg = 0;
     while (outg <= og_matches) {
-        unsigned int num_result_entries = node->signatures[outg].size();
+        unsigned int num_result_entries = node->numSignatures(outg);
 
         // Only dump nodes with an id and valid signatures.
         // Dump one signature per line.
@@ -75,8 +78,8 @@ bool dump2stream(std::ostream &stream, CaSSiSTreeNode *node,
 
             for (unsigned int k = 0; k < num_result_entries; ++k) {
                 // Fetch signature and process it.
-                const char *signature = node->signatures[outg].val(k);
-                therm.process(signature);
+                const char *signature = node->signature(outg, k, buffer);
+                therm.process(node->pool, node->signatures[outg].val(k));
 
                 // Output information about the signature. #1
                 stream << "\nSignature:            3'-" << signature << "-5'\n"